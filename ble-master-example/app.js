@@ -1,2 +1,15 @@
-App({ onCreate() { }, onDestroy(options) { } })
-  
\ No newline at end of file
+import { BLESession } from './libs/ble-master'
+
+// the BLE session lives as long as the app, pages attach to it (getApp()._options.globalData.ble.attach())
+// so connections and profiles survive page navigation
+const globalData = { ble: null };
+
+App({
+    globalData,
+    onCreate() {
+        globalData.ble = new BLESession();
+    },
+    onDestroy(options) {
+        globalData.ble.close();
+    }
+})
@@ -1,7 +1,12 @@
-/** @about BLE Master 1.0.0 @min_zeppos 3.0 @author: Silver, Zepp Health. @license: MIT */
+/** @about BLE Master 1.20.1 @min_zeppos 3.0 @author: Silver, Zepp Health. @license: MIT */
+// Built from easy-ble/src by dev/build.js (npm run build), edit the modules there.
 import * as hmBle from '@zos/ble'
 
-const ENABLE_DEBUG_LOG = true;
+/* CORE */
+
+/**
+ * Shared constants, the default clock and the cancellation token. Every other module builds on this one.
+ */
 
 const ERR_IDP_NOT_FOUND             = "eBLE: The ID pointer is not found for this MAC address. Please use startListener before trying to write char/desc!";
 const ERR_IDP_NOT_FOUND_SHORT       = "eBLE: Profile ID pointer not found";
@@ -11,450 +16,4556 @@ const ERR_CHAR_READ_FAIL            = "eBLE: Failed to read characteristic";
 const ERR_DESC_READ_FAIL            = "eBLE: Failed to read descriptor";
 const ERR_CHAR_WRITE_FAIL           = "eBLE: Failed to write characteristic";
 const ERR_DESC_WRITE_FAIL           = "eBLE: Failed to write descriptor";
+const ERR_CANCELLED                 = "eBLE: Operation cancelled";
+const ERR_INVALID_MAC               = "eBLE: Invalid MAC address, expected \"a1:b2:c3:d4:e5:f6\"";
+const ERR_INVALID_DATA              = "eBLE: Invalid data, expected an ArrayBuffer, a typed array, an even-length hex string or a string of 8-bit characters";
+const ERR_INVALID_PROFILE           = "eBLE: Invalid profile object";
+const ERR_DETACHED                  = "eBLE: The page handle is detached";
+const ERR_WIRE_MESSAGE              = "eBLE: Invalid wire message, expected a ScanEngine diff or { dev_addr, uuid, time, data }";
+const ERR_WIRE_FRAME                = "eBLE: Invalid wire frame";
+const ERR_FEATURE_MISSING           = "eBLE: This feature is not built into this bundle, pass its implementation (e.g. pool: ConnectionPool)";
+const ERR_INVALID_SCENE             = "eBLE: Invalid scene, expected [{ dev_addr, uuid, data }] or [{ dev_addr, chara, desc, data }]";
 
 const SHORT_DELAY = 50; // millis
 
-class BLEMaster {
-    #devices = {};
-    #last_connected_mac = null;
-    #getDevices = () => this.#devices;
-    
-    /**
-     * @type {Write} A device writer.
-     */
-    write;
+/**
+ * The default time source. Pass your own { now, setTimeout, clearTimeout } as options.clock to run on virtual time.
+ */
+const SYSTEM_CLOCK = {
+    now: () => Date.now(),
+    setTimeout: (callback, millis) => setTimeout(callback, millis),
+    clearTimeout: (timer) => clearTimeout(timer),
+};
+
+// ScanEngine diff.upsert is flat, DIFF_STRIDE values per device in this order
+const DIFF_FIELDS                   = ["dev_addr", "dev_name", "rssi", "age", "vendor_id", "vendor_data", "service_uuid_array", "service_data_array"];
+const DIFF_STRIDE                   = DIFF_FIELDS.length;
+
+// mstConnect result.connected
+const CONNECT_STATUS_OK             = 0;
+const CONNECT_STATUS_FAILED         = 1;
+const CONNECT_STATUS_DISCONNECTED   = 2;
+
+/**
+ * Library statuses, delivered in place of a backend status when the library ends an operation itself.
+ */
+const STATUS = {
+    OK: 0,
+    TIMEOUT: -1, // the watchdog expired before the backend answered
+    CANCELLED: -2, // the operation's cancel token was cancelled
+    REJECTED: -3, // the backend call itself returned false
+};
+
+/**
+ * Trace record op codes.
+ * For SCAN_RESULT the record status holds the RSSI, for *_RESULT ops the backend status,
+ * for issued calls 0 = accepted by the backend and 1 = rejected. VALUE is the data of a read, which arrives
+ * before its READ_RESULT.
+ */
+const TRACE_OP = {
+    SCAN_START: 1,
+    SCAN_RESULT: 2,
+    SCAN_STOP: 3,
+    CONNECT: 4,
+    CONNECT_RESULT: 5,
+    DISCONNECT: 6,
+    PREPARE: 7,
+    PREPARE_RESULT: 8,
+    READ: 9,
+    READ_RESULT: 10,
+    WRITE: 11,
+    WRITE_RESULT: 12,
+    NOTIFY: 13,
+    VALUE: 14,
+};
+
+// latency metrics
+const METRIC_SCAN_FIRST_SEEN        = 0;
+const METRIC_CONNECT                = 1;
+const METRIC_PREPARE                = 2;
+const METRIC_READ                   = 3;
+const METRIC_WRITE                  = 4;
+const STATUS_MALFORMED              = "malformed"; // a scan result without a usable dev_addr
+
+/**
+ * A cancellation token with the AbortSignal surface (aborted, reason, addEventListener("abort")).
+ * Pass the same token to everything a page starts and cancel it once in onDestroy.
+ */
+class CancelToken {
+    #aborted = false;
+    #reason = undefined;
+    #listeners = new Set();
 
     /**
-     * @type {Read} A device reader.
+     * @type {boolean} True once cancel() was called.
      */
-    read;
-
-    constructor(){
-        this.write = new Write(this.#getDevices);
-        this.read = new Read(this.#getDevices);
+    get aborted() {
+        return this.#aborted;
     }
     /**
-     * @type {Get} A device information getter.
+     * @type {any} The reason passed to cancel().
      */
-    get get() {
-        return new Get(this.#getDevices);
+    get reason() {
+        return this.#reason;
     }
     /**
-     * Starts scanning for devices.
-     * @param {Function} response_callback - The callback function that will be called with the scan result for each device.
-     * @param {Object} [options={}] - Optional parameters for the scan.
-     * @param {number} [options.duration] - The duration of the scan in milliseconds. If specified, the scan will automatically stop after this duration.
-     * @param {Function} [options.on_duration] - A callback function that will be called when the scan stops due to reaching the specified duration.
-     * @returns {boolean} Returns true if the call to start the scan succeeded, false if it failed.
+     * Cancels every operation that was started with this token. Subsequent calls do nothing.
+     * @param {any} [reason] - An optional reason.
      */
-    startScan(response_callback, options = {}) {
-        const modified_callback = (scan_result) => {
-            const scan_result_str = {
-                ...scan_result,
-                dev_addr: ab2mac(scan_result.dev_addr),
-                vendor_data: ab2str_stripped(scan_result.vendor_data), // decode
-                service_data_array: scan_result.service_data_array ? scan_result.service_data_array.map(service => ({ // map (!) empty
-                    ...service,
-                    service_data: ab2str_stripped(service.service_data)
-                })) : []
-            };
-            this.#devices[scan_result_str.dev_addr] = {
-                dev_name: scan_result_str.dev_name,
-                rssi: scan_result_str.rssi,
-                service_uuid_array: scan_result_str.service_uuid_array,
-                service_data_array: scan_result_str.service_data_array,
-                vendor_id: scan_result_str.vendor_id,
-                vendor_data: scan_result_str.vendor_data
-            };
-            
-            response_callback(scan_result_str);
+    cancel(reason = ERR_CANCELLED) {
+        if (this.#aborted) return;
+        this.#aborted = true;
+        this.#reason = reason;
+        const listeners = Array.from(this.#listeners);
+        this.#listeners.clear();
+        for (const listener of listeners) listener();
+    }
+    addEventListener(type, listener) {
+        if (type === "abort" && !this.#aborted) this.#listeners.add(listener);
+    }
+    removeEventListener(type, listener) {
+        if (type === "abort") this.#listeners.delete(listener);
+    }
+}
+
+function metricOf(op) {
+    switch (op) {
+        case TRACE_OP.CONNECT: case TRACE_OP.CONNECT_RESULT: return METRIC_CONNECT;
+        case TRACE_OP.PREPARE: case TRACE_OP.PREPARE_RESULT: return METRIC_PREPARE;
+        case TRACE_OP.READ: case TRACE_OP.READ_RESULT: return METRIC_READ;
+        case TRACE_OP.WRITE: case TRACE_OP.WRITE_RESULT: return METRIC_WRITE;
+        default: return -1;
+    }
+}
+
+function noop() {}
+
+function notify(callback, response) {
+    if (callback) callback(response);
+}
+
+function emitCallback(callbacks, name, response) { // the ble.on callback, then the library's own listeners (scenes)
+    notify(callbacks[name], response);
+    if (callbacks.taps) for (const tap of callbacks.taps) tap(name, response);
+}
+
+function attrKey(dev_addr, uuid, desc) { // pairs a read/write with its completion
+    return desc === undefined ? dev_addr + "/" + uuid.toUpperCase() : dev_addr + "/" + uuid.toUpperCase() + "/" + desc.toUpperCase();
+}
+
+/* LOG */
+
+/**
+ * The library-wide leveled logger.
+ */
+
+const LOG_STRIP = false; // build-time switch. true = every log call becomes dead code and can be dropped by the minifier (npm run build -- --strip-logs)
+
+/**
+ * Log levels. Messages above the current level are skipped before any formatting happens.
+ */
+const LOG_LEVEL = {
+    NONE: 0,
+    ERROR: 1,
+    WARN: 2,
+    INFO: 3,
+    DEBUG: 4,
+};
+const DEFAULT_LOG_LEVEL = LOG_LEVEL.WARN;
+
+/**
+ * Leveled logger. A message can be a string or a function (thunk) that returns the string,
+ * the thunk is only called when the level is enabled, so expensive formatting like JSON.stringify
+ * costs nothing in production.
+ */
+class Logger {
+    level = DEFAULT_LOG_LEVEL;
+
+    error(message, ...params) {
+        if (!LOG_STRIP && this.level >= LOG_LEVEL.ERROR) this.#print(message, params);
+    }
+    warn(message, ...params) {
+        if (!LOG_STRIP && this.level >= LOG_LEVEL.WARN) this.#print(message, params);
+    }
+    info(message, ...params) {
+        if (!LOG_STRIP && this.level >= LOG_LEVEL.INFO) this.#print(message, params);
+    }
+    debug(message, ...params) {
+        if (!LOG_STRIP && this.level >= LOG_LEVEL.DEBUG) this.#print(message, params);
+    }
+    #print(message, params) {
+        console.log(typeof message === "function" ? message() : message, ...params);
+    }
+}
+
+const logger = new Logger();
+
+/* CODECS */
+
+/**
+ * Codecs between the backend's ArrayBuffers and the strings the library hands out, plus input validation.
+ * No dependencies, usable on its own.
+ */
+
+const MAC_BYTES              = 6;
+const MAC_LENGTH                    = 17; // "a1:b2:c3:d4:e5:f6"
+const HEX_PATTERN                   = /^[0-9A-Fa-f]+$/;
+const UUID_PATTERN                  = /^([0-9A-Fa-f]{4}|[0-9A-Fa-f]{8}|[0-9A-Fa-f]{8}-[0-9A-Fa-f]{4}-[0-9A-Fa-f]{4}-[0-9A-Fa-f]{4}-[0-9A-Fa-f]{12})$/;
+const HEX_CODES                     = Array.from("0123456789abcdef", (digit) => digit.charCodeAt(0));
+const CHUNK_CHARS                   = 4096; // String.fromCharCode.apply argument limit per call
+
+function str2ab_with_len(str){ // one byte per char, chars above 0xFF keep their low byte (as since 1.0.0)
+    const bytes = new Uint8Array(str.length);
+    for (let i = 0; i < str.length; i++) bytes[i] = str.charCodeAt(i);
+    return { data_ab: bytes.buffer, data_len: bytes.length };
+}
+
+function latin1ToAb(str) { // str2ab_with_len for data2ab: null if a char does not fit in 8 bits
+    const bytes = new Uint8Array(str.length);
+    for (let i = 0; i < str.length; i++) {
+        const code = str.charCodeAt(i);
+        if (code > 0xFF) return null;
+        bytes[i] = code;
+    }
+    return bytes.buffer;
+}
+
+function bytes2mac(b, i) { // the 6 bytes at b[i] as "a1:b2:..", for MACs inside a larger buffer
+    return String.fromCharCode(
+        HEX_CODES[b[i] >> 4], HEX_CODES[b[i] & 15], 58, HEX_CODES[b[i + 1] >> 4], HEX_CODES[b[i + 1] & 15], 58,
+        HEX_CODES[b[i + 2] >> 4], HEX_CODES[b[i + 2] & 15], 58, HEX_CODES[b[i + 3] >> 4], HEX_CODES[b[i + 3] & 15], 58,
+        HEX_CODES[b[i + 4] >> 4], HEX_CODES[b[i + 4] & 15], 58, HEX_CODES[b[i + 5] >> 4], HEX_CODES[b[i + 5] & 15]);
+}
+
+function ab2mac(ab) { // one flat string, no intermediate arrays or concatenations
+    const b = new Uint8Array(ab);
+    if (b.length !== MAC_BYTES) return ab2str_stripped(ab).replace(/(..)(?!$)/g, "$1:");
+    return String.fromCharCode(
+        HEX_CODES[b[0] >> 4], HEX_CODES[b[0] & 15], 58, HEX_CODES[b[1] >> 4], HEX_CODES[b[1] & 15], 58,
+        HEX_CODES[b[2] >> 4], HEX_CODES[b[2] & 15], 58, HEX_CODES[b[3] >> 4], HEX_CODES[b[3] & 15], 58,
+        HEX_CODES[b[4] >> 4], HEX_CODES[b[4] & 15], 58, HEX_CODES[b[5] >> 4], HEX_CODES[b[5] & 15]);
+}
+
+function mac2ab(mac) { // null for anything but "a1:b2:c3:d4:e5:f6" (any case)
+    if (!isMac(mac)) return null;
+    const bytes = new Uint8Array(MAC_BYTES);
+    for (let i = 0; i < MAC_BYTES; i++) {
+        bytes[i] = hexValue(mac.charCodeAt(i * 3)) * 16 + hexValue(mac.charCodeAt(i * 3 + 1));
+    }
+    return bytes.buffer;
+}
+
+function isMac(mac) {
+    if (typeof mac !== "string" || mac.length !== MAC_LENGTH) return false;
+    for (let i = 0; i < MAC_LENGTH; i++) {
+        const c = mac.charCodeAt(i);
+        if (i % 3 === 2 ? c !== 58 : hexValue(c) < 0) return false; // ':' every third char
+    }
+    return true;
+}
+
+function normalizeMac(mac) {
+    return isMac(mac) ? mac.toLowerCase() : null;
+}
+
+function hexValue(c) { // char code > 0..15, -1 if not a hex digit
+    if (c >= 48 && c <= 57) return c - 48;
+    c |= 0x20; // lowercase
+    return c >= 97 && c <= 102 ? c - 87 : -1;
+}
+
+function mac2num(mac) { // "a1:b2:.." > 48-bit number, no allocations
+    let num = 0;
+    for (let i = 0; i < mac.length; i++) {
+        const c = mac.charCodeAt(i);
+        if (c === 58) continue; // ':'
+        num = num * 16 + (c <= 57 ? c - 48 : (c | 0x20) - 87);
+    }
+    return num;
+}
+
+function num2mac(num) {
+    let mac = "";
+    for (let shift = 40; shift >= 0; shift -= 8) {
+        const byte = Math.floor(num / 2 ** shift) % 256;
+        mac += (byte < 16 ? "0" : "") + byte.toString(16) + (shift ? ":" : "");
+    }
+    return mac;
+}
+
+const hex_scratch = [];
+function ab2str_stripped(buffer) { // strip unicode
+    if (!(buffer instanceof ArrayBuffer)) return "";
+    const bytes = new Uint8Array(buffer);
+    return bytes2hex(bytes, 0, bytes.length);
+}
+
+function bytes2hex(bytes, from, to) { // lowercase hex of bytes[from..to)
+    let str = "";
+    for (let start = from; start < to; start += CHUNK_CHARS / 2) {
+        const end = Math.min(to, start + CHUNK_CHARS / 2);
+        hex_scratch.length = (end - start) * 2;
+        for (let i = start, j = 0; i < end; i++) {
+            hex_scratch[j++] = HEX_CODES[bytes[i] >> 4];
+            hex_scratch[j++] = HEX_CODES[bytes[i] & 15];
         }
-        
-        const success = hmBle.mstStartScan(modified_callback);
-        if (options.duration !== undefined) {
-            setTimeout(() => {
-                this.stopScan();
-                if (options.on_duration) {
-                    options.on_duration();
+        str += String.fromCharCode.apply(null, hex_scratch);
+    }
+    return str;
+}
+
+/**
+ * ArrayBuffer as is, typed arrays as a copy of their bytes, even-length hex strings decoded, other strings one byte per char.
+ * @returns {ArrayBuffer|null} null for anything else: odd-length hex, chars above 0xFF, numbers, objects.
+ */
+function data2ab(data) {
+    if (data instanceof ArrayBuffer) {
+        return data;
+    } else if (ArrayBuffer.isView(data)) {
+        return data.buffer.slice(data.byteOffset, data.byteOffset + data.byteLength);
+    } else if (typeof data === "string") {
+        if (HEX_PATTERN.test(data)) { // hex string
+            if (data.length % 2) return null; // the last nibble would be read as a whole byte
+            const bytes = new Uint8Array(data.length / 2);
+            for (let i = 0; i < bytes.length; i++) {
+                bytes[i] = hexValue(data.charCodeAt(i * 2)) * 16 + hexValue(data.charCodeAt(i * 2 + 1));
+            }
+            return bytes.buffer;
+        } else { // normal string
+            return latin1ToAb(data);
+        }
+    }
+    return null;
+}
+
+/**
+ * Checks the parts of a profile object that mstBuildProfile dereferences.
+ * @returns {string|null} What is wrong with it, or null if it is usable.
+ */
+function profileError(profile) {
+    if (!profile || typeof profile !== "object") return "not an object";
+    if (!(profile.dev instanceof ArrayBuffer) || profile.dev.byteLength !== MAC_BYTES) return "dev is not a 6 byte ArrayBuffer";
+    if (!Array.isArray(profile.list)) return "list is not an array";
+    if (profile.len !== undefined && profile.len !== profile.list.length) return "len does not match list";
+    for (const group of profile.list) {
+        if (!group || !Array.isArray(group.list)) return "service group without a list";
+        if (group.len !== undefined && group.len !== group.list.length) return "service group len does not match its list";
+        for (const service of group.list) {
+            if (!service || !isUuid(service.uuid)) return "service without a valid uuid";
+            if (!Array.isArray(service.list)) return "service " + service.uuid + " without a characteristic list";
+            for (const chara of service.list) {
+                if (!chara || !isUuid(chara.uuid)) return "characteristic without a valid uuid in " + service.uuid;
+                if (chara.list === undefined) continue;
+                if (!Array.isArray(chara.list)) return "characteristic " + chara.uuid + " has a list that is not an array";
+                if (chara.len !== undefined && chara.len !== chara.list.length) return "characteristic " + chara.uuid + " len does not match its list";
+                for (const desc of chara.list) {
+                    if (!desc || !isUuid(desc.uuid)) return "descriptor without a valid uuid in " + chara.uuid;
                 }
-            }, options.duration);
+            }
         }
-        return success;
     }
-    /**
-     * Stops scanning for devices.
-     * @returns {boolean} Returns true if the call to stop the scan succeeded, false if it failed.
-     */
-    stopScan() {
-        return hmBle.mstStopScan();
+    return null;
+}
+
+function isUuid(uuid) {
+    return typeof uuid === "string" && UUID_PATTERN.test(uuid);
+}
+
+/* REGISTRY */
+
+/**
+ * Device registries: where scan results and connection state are kept, and the read-only view pages get through ble.get.
+ */
+
+const REGISTRY_COMPACT              = "compact";
+const DEFAULT_REGISTRY_CAPACITY     = 64; // slots, compact registry grows by doubling
+const FLAG_CONNECTED                = 0x01;
+
+/**
+ * Creates the registry selected by options.registry ("object" by default, "compact") and options.capacity.
+ */
+function createRegistry(options, clock) {
+    return options.registry === REGISTRY_COMPACT
+        ? new CompactRegistry(options.capacity, clock)
+        : new ObjectRegistry(clock);
+}
+
+class ObjectRegistry {
+    #devices = {};
+    #size = 0;
+    #by_connect_id = new Map(); // connect_id > MAC, backend callbacks resolve their device without a walk
+    #by_profile = new Map();    // profile_idp > MAC
+    #clock;
+
+    constructor(clock = SYSTEM_CLOCK) {
+        this.#clock = clock;
     }
     /**
-     * Connects to a device.
-     * @param {string} dev_addr - The MAC address of the device to connect to.
-     * @param {Function} response_callback - The callback function that will be called with the result of the connection attempt.
-     * @returns {boolean} Returns true if the call to connect to the device succeeded, false if it failed.
+     * @type {number} The number of known devices.
      */
-    connect(dev_addr, response_callback) {
-        dev_addr = dev_addr.toLowerCase(); // failsafe
-        const dev_addr_ab = mac2ab(dev_addr);
-        const modified_callback = (result) => {
-            const result_str = {
-                ...result,
-                dev_addr: ab2mac(result.dev_addr) // dev_addr
-            };
-            if (result_str.connected === 0) {
-                this.#devices[result_str.dev_addr] = { 
-                    ...this.#devices[result_str.dev_addr], // spread the existing device object
-                    connect_id: result_str.connect_id,
-                    is_connected: true
-                };
-                this.#last_connected_mac = result_str.dev_addr;
-            }
-            response_callback(result_str);
+    get size() {
+        return this.#size;
+    }
+    has(dev_addr) {
+        return this.#devices.hasOwnProperty(dev_addr);
+    }
+    get(dev_addr) {
+        return this.#devices[dev_addr];
+    }
+    all() {
+        return this.#devices;
+    }
+    scan(dev_addr, scan_result) {
+        let device = this.#devices[dev_addr];
+        if (!device) {
+            device = this.#devices[dev_addr] = {};
+            this.#size++;
         }
-        
-        return hmBle.mstConnect(dev_addr_ab, modified_callback);
+        const last_seen = device.last_seen === undefined ? -1 : device.last_seen;
+        // update in place, this keeps the connection state (connect_id, profile_idp, is_connected) intact
+        device.dev_name = scan_result.dev_name;
+        device.rssi = scan_result.rssi;
+        device.service_uuid_array = scan_result.service_uuid_array;
+        device.service_data_array = scan_result.service_data_array;
+        device.vendor_id = scan_result.vendor_id;
+        device.vendor_data = scan_result.vendor_data;
+        device.last_seen = this.#clock.now();
+        return last_seen;
     }
-    /**
-     * Disconnects from a device.
-     * @param {string} dev_addr - The MAC address of the device to disconnect from.
-     * @returns {boolean} Returns true if the call to disconnect from the device succeeded, false if it failed or if the device was not connected.
-     */
-    disconnect(dev_addr) {
-        dev_addr = dev_addr.toLowerCase();
+    remove(dev_addr) {
+        if (!this.has(dev_addr)) return false;
         const device = this.#devices[dev_addr];
-        if (device && device.is_connected) {
-            return hmBle.mstDisconnect(device.connect_id);
+        unindex(this.#by_connect_id, device.connect_id, dev_addr);
+        unindex(this.#by_profile, device.profile_idp, dev_addr);
+        delete this.#devices[dev_addr];
+        this.#size--;
+        return true;
+    }
+    link(dev_addr, connect_id) {
+        let device = this.#devices[dev_addr];
+        if (!device) {
+            device = this.#devices[dev_addr] = {};
+            this.#size++;
         }
+        unindex(this.#by_connect_id, device.connect_id, dev_addr);
+        device.connect_id = connect_id;
+        device.is_connected = true;
+        this.#by_connect_id.set(connect_id, dev_addr);
     }
-    /**
-     * Pairs with a device.
-     * @param {string} dev_addr - The MAC address of the device to pair with.
-     * @returns {boolean} Returns true if the call to pair with the device succeeded, false if it failed or if the device was not connected.
-     */
-    pair(dev_addr) {
-        dev_addr = dev_addr.toLowerCase();
+    unlink(dev_addr) {
         const device = this.#devices[dev_addr];
-        if (device && device.is_connected) {
-            return hmBle.mstPair(device.connect_id);
-        }
+        if (device) device.is_connected = false;
+    }
+    setProfile(dev_addr, profile_idp) {
+        const device = this.#devices[dev_addr];
+        if (!device) return;
+        unindex(this.#by_profile, device.profile_idp, dev_addr);
+        device.profile_idp = profile_idp;
+        if (profile_idp !== undefined) this.#by_profile.set(profile_idp, dev_addr);
+    }
+    isConnected(dev_addr) {
+        const device = this.#devices[dev_addr];
+        return !!device && device.is_connected === true;
+    }
+    connectId(dev_addr) {
+        const device = this.#devices[dev_addr];
+        return device && device.connect_id;
+    }
+    profile(dev_addr) {
+        const device = this.#devices[dev_addr];
+        return device && device.profile_idp;
+    }
+    findByProfile(profile_idp) {
+        const dev_addr = this.#by_profile.get(profile_idp);
+        return dev_addr === undefined ? null : dev_addr;
+    }
+    findByConnectId(connect_id) {
+        const dev_addr = this.#by_connect_id.get(connect_id);
+        return dev_addr === undefined ? null : dev_addr;
+    }
+}
+
+/**
+ * Struct-of-arrays device registry. Hot per-advert fields (MAC, RSSI, last seen, flags) live in typed-array
+ * columns indexed by slot, everything else is kept by reference in sparse columns. Device objects and MAC
+ * strings are only materialized when requested through get() or all().
+ */
+class CompactRegistry {
+    #capacity;
+    #size = 0;
+    #slots = new Map(); // numeric MAC > slot
+    #mac;               // Float64Array, 48-bit MAC as a number
+    #rssi;              // Int8Array
+    #last_seen;         // Float64Array, millis
+    #flags;             // Uint8Array, FLAG_*
+    // cold columns
+    #dev_name = [];
+    #service_uuid_array = [];
+    #service_data_array = [];
+    #vendor_id = [];
+    #vendor_data = [];
+    #links = new Map(); // slot > { connect_id, profile_idp } (only for devices that were ever connected)
+    #by_connect_id = new Map(); // connect_id > MAC
+    #by_profile = new Map();    // profile_idp > MAC
+    #clock;
+
+    constructor(capacity = DEFAULT_REGISTRY_CAPACITY, clock = SYSTEM_CLOCK) {
+        this.#clock = clock;
+        this.#capacity = Math.max(1, capacity | 0);
+        this.#mac = new Float64Array(this.#capacity);
+        this.#rssi = new Int8Array(this.#capacity);
+        this.#last_seen = new Float64Array(this.#capacity);
+        this.#flags = new Uint8Array(this.#capacity);
     }
     /**
-     * Starts listening for profile preparation events and builds a profile for interaction with a device.
-     * @param {Object} profile_object - The profile object that describes how to interact with the device.
-     * @param {Function} response_callback - The callback function that will be called when a profile preparation event occurs.
-     * @returns {Object} Returns an object with a 'success' property indicating whether the call succeeded and an 'error' property containing an error message if the call failed.
+     * @type {number} The number of known devices.
      */
-    startListener(profile_object, response_callback) {
-        debugLog("startListener called with profile_object:", JSON.stringify(profile_object));
-        // 1. register the mstOnPrepare callback to handle profile preparation
-        hmBle.mstOnPrepare((backend_response) => {
-            debugLog("mstOnPrepare called with backend_response:", JSON.stringify(backend_response));
-            if (backend_response.status === 0) {
-                // save profile pointer (only if we were able to properly connect)
-                this.#devices[this.#last_connected_mac].profile_idp = backend_response.profile; // profile, status
-            } else {
-                debugLog("Error mstOnPrepare. Status:", backend_response.status);
-            }
-
-            // 3. [old] execute the response_callback with the profile pointer (profile_idp) as the argument 
-            //    [new] returns status to the end user. (profile_idp) is now hidden from the end user interactions
-            debugLog("Executing backend_response");
-            response_callback(backend_response.status); // backend_response.profile
-        });
-    
-        // add a delay before calling mstBuildProfile
-        setTimeout(() => {
-            // 2. build the profile
-            const success = hmBle.mstBuildProfile(profile_object);
-            debugLog("mstBuildProfile called with success:", success);
-        }, SHORT_DELAY);  // 100ms
-    
-        return {
-            success,
-            error: success ? null : ERR_PROFILE_CREATION_FAILED, // multilayer, proper error handling
+    get size() {
+        return this.#size;
+    }
+    has(dev_addr) {
+        return this.#slots.has(mac2num(dev_addr));
+    }
+    get(dev_addr) {
+        const slot = this.#slots.get(mac2num(dev_addr));
+        return slot === undefined ? undefined : this.#view(slot);
+    }
+    all() {
+        const devices = {};
+        for (let slot = 0; slot < this.#size; slot++) {
+            devices[num2mac(this.#mac[slot])] = this.#view(slot);
+        }
+        return devices;
+    }
+    scan(dev_addr, scan_result) {
+        const slot = this.#slotOf(dev_addr);
+        const last_seen = this.#last_seen[slot];
+        this.#rssi[slot] = scan_result.rssi;
+        this.#last_seen[slot] = this.#clock.now();
+        this.#dev_name[slot] = scan_result.dev_name;
+        this.#service_uuid_array[slot] = scan_result.service_uuid_array;
+        this.#service_data_array[slot] = scan_result.service_data_array;
+        this.#vendor_id[slot] = scan_result.vendor_id;
+        this.#vendor_data[slot] = scan_result.vendor_data;
+        return last_seen;
+    }
+    remove(dev_addr) { // the last slot moves into the freed one, columns stay dense
+        const mac = mac2num(dev_addr);
+        const slot = this.#slots.get(mac);
+        if (slot === undefined) return false;
+        const removed = this.#links.get(slot);
+        if (removed) {
+            unindex(this.#by_connect_id, removed.connect_id, num2mac(mac));
+            unindex(this.#by_profile, removed.profile_idp, num2mac(mac));
+        }
+        const last = --this.#size;
+        this.#slots.delete(mac);
+        const link = this.#links.get(last);
+        this.#links.delete(slot);
+        this.#links.delete(last);
+        if (slot !== last) {
+            this.#mac[slot] = this.#mac[last];
+            this.#rssi[slot] = this.#rssi[last];
+            this.#last_seen[slot] = this.#last_seen[last];
+            this.#flags[slot] = this.#flags[last];
+            this.#dev_name[slot] = this.#dev_name[last];
+            this.#service_uuid_array[slot] = this.#service_uuid_array[last];
+            this.#service_data_array[slot] = this.#service_data_array[last];
+            this.#vendor_id[slot] = this.#vendor_id[last];
+            this.#vendor_data[slot] = this.#vendor_data[last];
+            if (link) this.#links.set(slot, link);
+            this.#slots.set(this.#mac[slot], slot);
+        }
+        this.#flags[last] = 0;
+        this.#dev_name.length = this.#service_uuid_array.length = this.#service_data_array.length = last;
+        this.#vendor_id.length = this.#vendor_data.length = last;
+        return true;
+    }
+    link(dev_addr, connect_id) {
+        const slot = this.#slotOf(dev_addr);
+        dev_addr = num2mac(this.#mac[slot]); // the indexes hold the MACs findBy* always returned
+        const link = this.#links.get(slot);
+        if (link) {
+            unindex(this.#by_connect_id, link.connect_id, dev_addr);
+            link.connect_id = connect_id;
+        } else {
+            this.#links.set(slot, { connect_id, profile_idp: undefined });
+        }
+        this.#flags[slot] |= FLAG_CONNECTED;
+        this.#by_connect_id.set(connect_id, dev_addr);
+    }
+    unlink(dev_addr) {
+        const slot = this.#slots.get(mac2num(dev_addr));
+        if (slot !== undefined) this.#flags[slot] &= ~FLAG_CONNECTED;
+    }
+    setProfile(dev_addr, profile_idp) {
+        const mac = mac2num(dev_addr);
+        const link = this.#links.get(this.#slots.get(mac));
+        if (!link) return;
+        dev_addr = num2mac(mac);
+        unindex(this.#by_profile, link.profile_idp, dev_addr);
+        link.profile_idp = profile_idp;
+        if (profile_idp !== undefined) this.#by_profile.set(profile_idp, dev_addr);
+    }
+    isConnected(dev_addr) {
+        const slot = this.#slots.get(mac2num(dev_addr));
+        return slot !== undefined && (this.#flags[slot] & FLAG_CONNECTED) !== 0;
+    }
+    connectId(dev_addr) {
+        const link = this.#links.get(this.#slots.get(mac2num(dev_addr)));
+        return link && link.connect_id;
+    }
+    profile(dev_addr) {
+        const link = this.#links.get(this.#slots.get(mac2num(dev_addr)));
+        return link && link.profile_idp;
+    }
+    findByProfile(profile_idp) {
+        const dev_addr = this.#by_profile.get(profile_idp);
+        return dev_addr === undefined ? null : dev_addr;
+    }
+    findByConnectId(connect_id) {
+        const dev_addr = this.#by_connect_id.get(connect_id);
+        return dev_addr === undefined ? null : dev_addr;
+    }
+    #slotOf(dev_addr) {
+        const mac = mac2num(dev_addr);
+        let slot = this.#slots.get(mac);
+        if (slot === undefined) {
+            if (this.#size === this.#capacity) this.#grow();
+            slot = this.#size++;
+            this.#slots.set(mac, slot);
+            this.#mac[slot] = mac;
+            this.#last_seen[slot] = -1; // never advertised
+        }
+        return slot;
+    }
+    #grow() {
+        this.#capacity *= 2;
+        this.#mac = growTyped(this.#mac, this.#capacity);
+        this.#rssi = growTyped(this.#rssi, this.#capacity);
+        this.#last_seen = growTyped(this.#last_seen, this.#capacity);
+        this.#flags = growTyped(this.#flags, this.#capacity);
+    }
+    #view(slot) {
+        const device = {
+            dev_name: this.#dev_name[slot],
+            rssi: this.#rssi[slot],
+            service_uuid_array: this.#service_uuid_array[slot],
+            service_data_array: this.#service_data_array[slot],
+            vendor_id: this.#vendor_id[slot],
+            vendor_data: this.#vendor_data[slot],
+            last_seen: this.#last_seen[slot] < 0 ? undefined : this.#last_seen[slot]
         };
+        const link = this.#links.get(slot);
+        if (link) {
+            device.connect_id = link.connect_id;
+            device.profile_idp = link.profile_idp;
+            device.is_connected = (this.#flags[slot] & FLAG_CONNECTED) !== 0;
+        }
+        return device;
+    }
+}
+
+class Get {
+    #registry;
+    #monitor;
+    constructor(registry, monitor) {
+        this.#registry = registry;
+        this.#monitor = monitor;
     }
     /**
-     * Temporary replacement for the generateProfileObject function. 
-     * Modifies a profile object with required values for a device.
-     * @param {string} dev_addr - The MAC address of the device.
-     * @param {Object} profile_object - The profile object to be modified.
+     * Returns all devices.
+     * @returns {Object} Returns an object containing information about all devices.
+     */
+    devices() {
+        return this.#registry.all();
+    }
+    /**
+     * Returns one device.
+     * @param {string} dev_addr - The MAC address of the device.
+     * @returns {Object|undefined} Returns the device's information (same shape as an entry of devices()), or undefined if it is not known.
+     */
+    device(dev_addr) {
+        dev_addr = normalizeMac(dev_addr);
+        return dev_addr === null ? undefined : this.#registry.get(dev_addr);
+    }
+    /**
+     * Checks if a device is connected.
+     * @param {string} dev_addr - The MAC address of the device.
+     * @returns {boolean} Returns true if the device is connected, false otherwise.
+     */
+    isConnected(dev_addr){
+        dev_addr = normalizeMac(dev_addr);
+        return dev_addr !== null && this.#registry.isConnected(dev_addr);
+    }
+    /**
+     * Checks if a device exists.
+     * @param {string} dev_addr - The MAC address of the device.
+     * @returns {boolean} Returns true if the device exists, false otherwise.
+     */
+    hasDevice(dev_addr) {
+        dev_addr = normalizeMac(dev_addr);
+        return dev_addr !== null && this.#registry.has(dev_addr);
+    }
+    /**
+     * Returns the built-in metrics.
+     * @returns {Object} Returns { counters, latency, errors }. counters holds the number of each TRACE_OP event (lowercase names),
+     * latency holds { count, min, max, mean, p50, p90, p99, buckets } in millis for scan_first_seen, connect, prepare, read and write,
+     * errors holds the number of non-zero backend statuses (or "rejected" backend calls) per operation.
+     */
+    stats() {
+        return this.#monitor.stats();
+    }
+}
+
+function unindex(index, key, dev_addr) { // drops a reverse index entry unless another device took the key over since
+    if (key !== undefined && index.get(key) === dev_addr) index.delete(key);
+}
+
+function growTyped(arr, length) {
+    const grown = new arr.constructor(length);
+    grown.set(arr);
+    return grown;
+}
+
+/* DIAGNOSTICS */
+
+/**
+ * Diagnostics: the binary trace recorder, latency histograms, op/error counters and the operation watchdog.
+ * Builds without diagnostics swap this module for no-diagnostics.js.
+ */
+
+const TRACE_RECORD_WORDS            = 4;        // 16 bytes: time, op|slot, status, size
+const TRACE_NO_SLOT                 = 0xFFFFFF; // record without a device
+const METRIC_NAMES                  = ["scan_first_seen", "connect", "prepare", "read", "write"];
+const HISTOGRAM_BUCKETS             = 18; // log2 millis buckets: <1ms, <2ms, <4ms ... <65s, rest
+const STATUS_REJECTED               = "rejected"; // the backend call itself returned false
+const STATUS_EXPIRED                = "timeout";
+const STATUS_SUPERSEDED             = "superseded"; // dropped for a newer operation on the same key
+
+// watchdog deadlines per metric, millis. 0 = not watched
+const DEFAULT_TIMEOUTS              = [0, 10000, 10000, 5000, 5000];
+const WATCHDOG_TICK                 = 250; // millis
+const MAX_PENDING_PER_KEY           = 16; // operations waiting on one attribute, beyond that the oldest is given up
+const RESULT_OPS                    = [0, TRACE_OP.CONNECT_RESULT, TRACE_OP.PREPARE_RESULT, TRACE_OP.READ_RESULT, TRACE_OP.WRITE_RESULT];
+
+/**
+ * Creates the monitor for options.trace and options.watchdog (see the BLEMaster constructor).
+ */
+function createMonitor(options, clock) {
+    const trace = options.trace > 0 ? new TraceRecorder(options.trace, clock) : null;
+    return new Monitor(trace, options.watchdog, clock);
+}
+
+/**
+ * Binary ring buffer of BLE operation records. Every record is 16 bytes:
+ * [0] millis since the trace started, [1] op code << 24 | device slot, [2] status (int32), [3] size in bytes.
+ * Recording never allocates once a device slot is known, so it is cheap enough to keep on in production.
+ * A slot is freed when the last record that names its device is overwritten, so the slot table never outgrows
+ * the buffer, however many MACs rotate through a crowded scan.
+ */
+class TraceRecorder {
+    #capacity;
+    #words;
+    #status;            // Int32Array view over the same buffer, keeps the status sign
+    #head = 0;          // next record to write
+    #count = 0;
+    #clock;
+    #t0;
+    #slots = new Map(); // MAC > slot
+    #macs;              // slot > MAC
+    #refs;              // slot > live records naming it
+    #free;              // stack of free slots
+    #free_count;
+
+    constructor(capacity, clock = SYSTEM_CLOCK) {
+        this.#clock = clock;
+        this.#t0 = clock.now();
+        this.#capacity = capacity;
+        this.#words = new Uint32Array(capacity * TRACE_RECORD_WORDS);
+        this.#status = new Int32Array(this.#words.buffer);
+        this.#macs = new Array(capacity);
+        this.#refs = new Uint32Array(capacity); // a record names one device at most, capacity slots always suffice
+        this.#free = new Uint32Array(capacity);
+        this.#releaseAll();
+    }
+    /**
+     * @type {number} The number of records currently held (up to the capacity).
+     */
+    get size() {
+        return this.#count;
+    }
+    /**
+     * Appends a record, overwriting the oldest one when the buffer is full.
+     * @param {number} op - A TRACE_OP code.
+     * @param {string|null} dev_addr - The MAC address of the device, or null.
+     * @param {number} [status=0] - The status (see TRACE_OP).
+     * @param {number} [size=0] - The payload size in bytes.
+     */
+    record(op, dev_addr, status = 0, size = 0) {
+        const i = this.#head * TRACE_RECORD_WORDS;
+        if (this.#count === this.#capacity) this.#release(this.#words[i + 1] & TRACE_NO_SLOT); // the record it overwrites
+        this.#words[i] = this.#clock.now() - this.#t0;
+        this.#words[i + 1] = (op << 24 | this.#slotOf(dev_addr)) >>> 0;
+        this.#status[i + 2] = status;
+        this.#words[i + 3] = size;
+        this.#head = (this.#head + 1) % this.#capacity;
+        if (this.#count < this.#capacity) this.#count++;
+    }
+    /**
+     * Decodes the records, oldest first.
+     * @returns {Array<Object>} Returns an array of { time, op, dev_addr, status, size }, time is a clock timestamp in millis.
+     */
+    records() {
+        const records = [];
+        const first = (this.#head - this.#count + this.#capacity) % this.#capacity;
+        for (let n = 0; n < this.#count; n++) {
+            const i = ((first + n) % this.#capacity) * TRACE_RECORD_WORDS;
+            const slot = this.#words[i + 1] & TRACE_NO_SLOT;
+            records.push({
+                time: this.#t0 + this.#words[i],
+                op: this.#words[i + 1] >>> 24,
+                dev_addr: slot === TRACE_NO_SLOT ? null : this.#macs[slot],
+                status: this.#status[i + 2],
+                size: this.#words[i + 3],
+            });
+        }
+        return records;
+    }
+    /**
+     * Copies the raw records into a new buffer, oldest first. Use it to ship a trace off the device.
+     * @returns {{ buffer: ArrayBuffer, t0: number, macs: Array<string> }} Returns the records, the start timestamp and the slot > MAC table.
+     */
+    dump() {
+        const out = new Uint32Array(this.#count * TRACE_RECORD_WORDS);
+        const first = (this.#head - this.#count + this.#capacity) % this.#capacity;
+        const tail = Math.min(this.#count, this.#capacity - first) * TRACE_RECORD_WORDS;
+        out.set(this.#words.subarray(first * TRACE_RECORD_WORDS, first * TRACE_RECORD_WORDS + tail));
+        out.set(this.#words.subarray(0, out.length - tail), tail);
+        return { buffer: out.buffer, t0: this.#t0, macs: this.#macs.slice() };
+    }
+    /**
+     * @type {number} The number of device slots in use, at most the capacity.
+     */
+    get devices() {
+        return this.#slots.size;
+    }
+    /**
+     * Drops all records and their device slots.
+     */
+    clear() {
+        this.#head = 0;
+        this.#count = 0;
+        this.#t0 = this.#clock.now();
+        this.#releaseAll();
+    }
+    #slotOf(dev_addr) {
+        if (dev_addr === null || dev_addr === undefined) return TRACE_NO_SLOT;
+        let slot = this.#slots.get(dev_addr);
+        if (slot === undefined) {
+            slot = this.#free[--this.#free_count];
+            this.#slots.set(dev_addr, slot);
+            this.#macs[slot] = dev_addr;
+        }
+        this.#refs[slot]++;
+        return slot;
+    }
+    #release(slot) {
+        if (slot === TRACE_NO_SLOT || --this.#refs[slot] > 0) return;
+        this.#slots.delete(this.#macs[slot]);
+        this.#macs[slot] = undefined;
+        this.#free[this.#free_count++] = slot;
+    }
+    #releaseAll() {
+        this.#slots.clear();
+        this.#macs.fill(undefined);
+        this.#refs.fill(0);
+        for (let slot = 0; slot < this.#capacity; slot++) this.#free[slot] = this.#capacity - 1 - slot; // slot 0 is handed out first
+        this.#free_count = this.#capacity;
+    }
+}
+
+/**
+ * Fixed-memory latency histogram with log2 millisecond buckets.
+ */
+class Histogram {
+    #buckets = new Uint32Array(HISTOGRAM_BUCKETS);
+    #count = 0;
+    #sum = 0;
+    #min = Infinity;
+    #max = 0;
+
+    add(millis) {
+        const bucket = millis < 1 ? 0 : Math.min(HISTOGRAM_BUCKETS - 1, Math.floor(Math.log2(millis)) + 1);
+        this.#buckets[bucket]++;
+        this.#count++;
+        this.#sum += millis;
+        if (millis < this.#min) this.#min = millis;
+        if (millis > this.#max) this.#max = millis;
+    }
+    reset() {
+        this.#buckets.fill(0);
+        this.#count = 0;
+        this.#sum = 0;
+        this.#min = Infinity;
+        this.#max = 0;
+    }
+    summary() {
+        return {
+            count: this.#count,
+            min: this.#count ? this.#min : 0,
+            max: this.#max,
+            mean: this.#count ? Math.round(this.#sum / this.#count) : 0,
+            p50: this.#percentile(0.5),
+            p90: this.#percentile(0.9),
+            p99: this.#percentile(0.99),
+            buckets: Array.from(this.#buckets),
+        };
+    }
+    #percentile(q) { // upper bound of the bucket that holds the q-th sample
+        if (!this.#count) return 0;
+        const rank = Math.ceil(q * this.#count);
+        let seen = 0;
+        for (let i = 0; i < HISTOGRAM_BUCKETS; i++) {
+            seen += this.#buckets[i];
+            if (seen >= rank) return Math.min(this.#max, 2 ** i);
+        }
+        return this.#max;
+    }
+}
+
+/**
+ * Single entry point for operation instrumentation. Feeds the optional trace recorder,
+ * counts every op, times operations until their result arrives, counts backend errors
+ * and acts as a watchdog that expires operations the backend never answers.
+ */
+class Monitor {
+    trace;
+    /**
+     * @type {Function|null} Called with the MAC address of a device whose operation expired, when recycling is enabled.
+     */
+    onRecycle = null;
+    #counters = new Uint32Array(TRACE_OP.VALUE + 1);
+    #latency = METRIC_NAMES.map(() => new Histogram());
+    #pending = METRIC_NAMES.map(() => new Map()); // key > [{ started_at, dev_addr, on_expire, dispose }], oldest first
+    #errors = METRIC_NAMES.map(() => ({}));
+    #timeouts;
+    #recycle;
+    #timer = null;
+    #clock;
+
+    constructor(trace, watchdog = {}, clock = SYSTEM_CLOCK) {
+        this.trace = trace;
+        this.#clock = clock;
+        this.#timeouts = METRIC_NAMES.map((name, i) => {
+            if (watchdog === false || !DEFAULT_TIMEOUTS[i]) return 0;
+            return watchdog[name] !== undefined ? watchdog[name] : DEFAULT_TIMEOUTS[i];
+        });
+        this.#recycle = watchdog !== false && watchdog.recycle === true;
+    }
+    /**
+     * Starts the latency timer and the watchdog of an operation. Call it right before the backend call,
+     * so a result that is delivered synchronously still finds its operation. Operations on the same key queue up,
+     * a result settles the oldest one (the backend answers one attribute in order).
+     * @param {number} op - A TRACE_OP code.
+     * @param {string} dev_addr - The MAC address of the device.
+     * @param {string} key - Pairs the operation with its result, e.g. per characteristic.
+     * @param {Function} [on_expire] - Fails the request when the watchdog expires.
+     * @param {CancelToken} [signal] - Drops the operation when cancelled.
+     * @param {Function} [on_cancel] - Called when the operation is dropped by the signal.
+     */
+    start(op, dev_addr, key, on_expire, signal, on_cancel) {
+        const metric = metricOf(op);
+        const pending = { started_at: this.#clock.now(), dev_addr, on_expire, dispose: noop };
+        const queue = this.#pending[metric].get(key);
+        if (queue === undefined) {
+            this.#pending[metric].set(key, [pending]);
+        } else {
+            queue.push(pending);
+            if (queue.length > MAX_PENDING_PER_KEY) this.#expire(metric, this.#settle(metric, key), STATUS_SUPERSEDED);
+        }
+        if (signal) {
+            const cancel = () => {
+                this.#remove(metric, key, pending);
+                if (this.trace) this.trace.record(RESULT_OPS[metric], dev_addr, STATUS.CANCELLED);
+                if (on_cancel) on_cancel();
+            };
+            signal.addEventListener("abort", cancel);
+            pending.dispose = () => signal.removeEventListener("abort", cancel);
+        }
+        if (this.#timeouts[metric] && this.#timer === null) {
+            this.#timer = this.#clock.setTimeout(() => this.#tick(), WATCHDOG_TICK);
+        }
+    }
+    /**
+     * Records an operation handed over to the backend. A rejected call drops its started timer.
+     * @param {number} op - A TRACE_OP code.
+     * @param {string|null} dev_addr - The MAC address of the device, or null.
+     * @param {boolean} success - The return value of the backend call.
+     * @param {number} [size=0] - The payload size in bytes.
+     * @param {string} [key=dev_addr] - The key the operation was started with.
+     */
+    issued(op, dev_addr, success, size = 0, key = dev_addr) {
+        this.#counters[op]++;
+        if (this.trace) this.trace.record(op, dev_addr, success ? 0 : 1, size);
+        const metric = metricOf(op);
+        if (metric >= 0 && !success) {
+            this.#settle(metric, key, true);
+            this.#countError(metric, STATUS_REJECTED);
+        }
+    }
+    /**
+     * Records the result of an issued operation.
+     * @param {number} op - A TRACE_OP *_RESULT code.
+     * @param {string|null} dev_addr - The MAC address of the device, or null.
+     * @param {number} status - The backend status, 0 = OK.
+     * @param {number} [size=0] - The payload size in bytes.
+     * @param {string} [key=dev_addr] - The key the operation was issued with.
+     */
+    completed(op, dev_addr, status, size = 0, key = dev_addr) {
+        this.#counters[op]++;
+        if (this.trace) this.trace.record(op, dev_addr, status, size);
+        const metric = metricOf(op);
+        const pending = this.#settle(metric, key);
+        if (pending !== undefined) {
+            this.#latency[metric].add(this.#clock.now() - pending.started_at);
+        }
+        if (status !== 0) this.#countError(metric, status);
+    }
+    /**
+     * Records an event that settles no operation (scan result, notification, read value, disconnect).
+     */
+    event(op, dev_addr, status = 0, size = 0) {
+        this.#counters[op]++;
+        if (this.trace) this.trace.record(op, dev_addr, status, size);
+    }
+    /**
+     * Counts an error that is not tied to an issued operation, e.g. a malformed scan result.
+     * @param {number} metric - A METRIC_* index.
+     * @param {number|string} status - What went wrong.
+     */
+    error(metric, status) {
+        this.#countError(metric, status);
+    }
+    /**
+     * Adds a latency sample that is measured by the caller.
+     * @param {number} metric - A METRIC_* index.
+     * @param {number} millis - The latency.
+     */
+    sample(metric, millis) {
+        this.#latency[metric].add(millis);
+    }
+    reset() {
+        this.#counters.fill(0);
+        for (let i = 0; i < METRIC_NAMES.length; i++) {
+            this.#latency[i].reset();
+            this.#errors[i] = {};
+        }
+    }
+    stats() {
+        const counters = {};
+        for (const name in TRACE_OP) {
+            counters[name.toLowerCase()] = this.#counters[TRACE_OP[name]];
+        }
+        const latency = {};
+        const errors = {};
+        for (let i = 0; i < METRIC_NAMES.length; i++) {
+            latency[METRIC_NAMES[i]] = this.#latency[i].summary();
+            errors[METRIC_NAMES[i]] = { ...this.#errors[i] };
+        }
+        return { counters, latency, errors };
+    }
+    #settle(metric, key, newest = false) { // removes the oldest (or newest) pending operation and its cancel listener
+        const queue = this.#pending[metric].get(key);
+        if (queue === undefined) return undefined;
+        const pending = newest ? queue.pop() : queue.shift();
+        if (queue.length === 0) this.#pending[metric].delete(key);
+        pending.dispose();
+        return pending;
+    }
+    #remove(metric, key, pending) {
+        const queue = this.#pending[metric].get(key);
+        const index = queue === undefined ? -1 : queue.indexOf(pending);
+        if (index < 0) return;
+        queue.splice(index, 1);
+        if (queue.length === 0) this.#pending[metric].delete(key);
+        pending.dispose();
+    }
+    #countError(metric, status) {
+        const errors = this.#errors[metric];
+        errors[status] = (errors[status] || 0) + 1;
+    }
+    #tick() {
+        this.#timer = null;
+        const now = this.#clock.now();
+        let watching = false;
+        for (let metric = 0; metric < METRIC_NAMES.length; metric++) {
+            const timeout = this.#timeouts[metric];
+            if (!timeout) continue;
+            for (const [key, queue] of Array.from(this.#pending[metric])) {
+                while (queue.length > 0 && now - queue[0].started_at >= timeout) { // oldest first
+                    this.#expire(metric, this.#settle(metric, key), STATUS_EXPIRED);
+                }
+                if (queue.length > 0) watching = true;
+            }
+        }
+        if (watching && this.#timer === null) {
+            this.#timer = this.#clock.setTimeout(() => this.#tick(), WATCHDOG_TICK);
+        }
+    }
+    #expire(metric, pending, reason) {
+        logger.warn(reason === STATUS_EXPIRED ? "eBLE: Watchdog expired:" : "eBLE: Operation superseded:", METRIC_NAMES[metric], pending.dev_addr);
+        this.#counters[RESULT_OPS[metric]]++;
+        if (this.trace) this.trace.record(RESULT_OPS[metric], pending.dev_addr, STATUS.TIMEOUT);
+        this.#countError(metric, reason);
+        if (pending.on_expire) pending.on_expire();
+        if (this.#recycle && reason === STATUS_EXPIRED && metric !== METRIC_CONNECT && this.onRecycle) {
+            this.onRecycle(pending.dev_addr);
+        }
+    }
+}
+
+/* SCAN */
+
+/**
+ * Scanning: decodes every advert, keeps the registry up to date and measures the time to first sight.
+ */
+
+class Scanner {
+    #ble;
+    #clock;
+    #registry;
+    #monitor;
+    #scan_started_at = 0;
+    #scan_dispose = noop;
+
+    constructor(ble, clock, registry, monitor) {
+        this.#ble = ble;
+        this.#clock = clock;
+        this.#registry = registry;
+        this.#monitor = monitor;
+    }
+    /**
+     * Starts scanning for devices. See BLEMaster.startScan.
+     */
+    startScan(response_callback, options = {}) {
+        const signal = options.signal;
+        if (signal && signal.aborted) return false;
+        const filter = options.filter;
+        const modified_callback = (scan_result) => {
+            if (!scan_result || !(scan_result.dev_addr instanceof ArrayBuffer) || scan_result.dev_addr.byteLength !== MAC_BYTES) {
+                this.#monitor.error(METRIC_SCAN_FIRST_SEEN, STATUS_MALFORMED); // nothing to key it by, drop it here
+                return;
+            }
+            const scan_result_str = {
+                ...scan_result,
+                dev_addr: ab2mac(scan_result.dev_addr),
+                vendor_data: ab2str_stripped(scan_result.vendor_data), // decode
+                service_data_array: Array.isArray(scan_result.service_data_array) ? scan_result.service_data_array.map(service => ({ // map (!) empty
+                    ...service,
+                    service_data: ab2str_stripped(service && service.service_data)
+                })) : []
+            };
+            if (filter && !filter(scan_result_str)) return; // keeps the registry down to the devices the caller cares about
+            const last_seen = this.#registry.scan(scan_result_str.dev_addr, scan_result_str);
+            if (last_seen < this.#scan_started_at) { // first advert of this device since the scan started
+                this.#monitor.sample(METRIC_SCAN_FIRST_SEEN, this.#clock.now() - this.#scan_started_at);
+            }
+            this.#monitor.event(TRACE_OP.SCAN_RESULT, scan_result_str.dev_addr, scan_result_str.rssi, scan_result.vendor_data ? scan_result.vendor_data.byteLength : 0);
+
+            response_callback(scan_result_str);
+        }
+
+        this.#scan_dispose();
+        this.#scan_started_at = this.#clock.now();
+        const success = this.#ble.mstStartScan(modified_callback);
+        this.#monitor.issued(TRACE_OP.SCAN_START, null, success);
+        let duration_timer = null;
+        if (options.duration !== undefined) {
+            duration_timer = this.#clock.setTimeout(() => {
+                this.stopScan();
+                if (options.on_duration) {
+                    options.on_duration();
+                }
+            }, options.duration);
+        }
+        if (signal) {
+            const stop = () => {
+                this.#clock.clearTimeout(duration_timer);
+                this.stopScan();
+            };
+            signal.addEventListener("abort", stop);
+            this.#scan_dispose = () => {
+                this.#scan_dispose = noop;
+                this.#clock.clearTimeout(duration_timer);
+                signal.removeEventListener("abort", stop);
+            };
+        }
+        return success;
+    }
+    /**
+     * Stops scanning for devices. See BLEMaster.stopScan.
+     */
+    stopScan() {
+        this.#scan_dispose();
+        const success = this.#ble.mstStopScan();
+        this.#monitor.issued(TRACE_OP.SCAN_STOP, null, success);
+        return success;
+    }
+}
+
+/* CONNECTION */
+
+/**
+ * Connections: connect, disconnect, pair and stop, plus the devices owned by a cancel token.
+ */
+
+class Connections {
+    #ble;
+    #registry;
+    #monitor;
+    #connected = new Set(); // MACs with a live link
+    #owned = new Map(); // MAC > dispose, devices that are stopped when the token they were connected with is cancelled
+    /**
+     * @type {Function|null} Called with the MAC address of every device that connected successfully.
+     */
+    onConnected = null;
+    /**
+     * @type {Function|null} Called with the MAC address of a connect given up before the backend answered (watchdog expiry or cancel).
+     */
+    onAbandoned = null;
+
+    constructor(ble, registry, monitor) {
+        this.#ble = ble;
+        this.#registry = registry;
+        this.#monitor = monitor;
+    }
+    /**
+     * Connects to a device. See BLEMaster.connect.
+     */
+    connect(dev_addr, response_callback, options = {}) {
+        dev_addr = normalizeMac(dev_addr); // failsafe
+        if (dev_addr === null) {
+            logger.error(ERR_INVALID_MAC);
+            return false;
+        }
+        const signal = options.signal;
+        if (signal && signal.aborted) return false;
+        const dev_addr_ab = mac2ab(dev_addr);
+        let abandoned = false; // timed out or cancelled
+        const modified_callback = (result) => {
+            const result_str = {
+                ...result,
+                dev_addr: ab2mac(result.dev_addr) // dev_addr
+            };
+            if (abandoned) { // the request was already failed, release a late connection
+                if (result_str.connected === CONNECT_STATUS_OK) {
+                    this.#ble.mstDisconnect(result_str.connect_id);
+                }
+                return;
+            }
+            if (result_str.connected === CONNECT_STATUS_OK) {
+                this.#registry.link(result_str.dev_addr, result_str.connect_id);
+                this.#connected.add(result_str.dev_addr);
+                if (signal) this.own(signal, result_str.dev_addr);
+                if (this.onConnected) this.onConnected(result_str.dev_addr);
+            } else if (result_str.connected === CONNECT_STATUS_DISCONNECTED) {
+                this.#registry.unlink(result_str.dev_addr);
+                this.#connected.delete(result_str.dev_addr);
+                this.#disown(result_str.dev_addr);
+            }
+            if (result_str.connected === CONNECT_STATUS_DISCONNECTED) {
+                this.#monitor.event(TRACE_OP.DISCONNECT, result_str.dev_addr);
+            } else {
+                this.#monitor.completed(TRACE_OP.CONNECT_RESULT, result_str.dev_addr, result_str.connected);
+            }
+            response_callback(result_str);
+        }
+
+        this.#monitor.start(TRACE_OP.CONNECT, dev_addr, dev_addr, () => {
+            abandoned = true;
+            if (this.onAbandoned) this.onAbandoned(dev_addr);
+            response_callback({ dev_addr, connected: CONNECT_STATUS_FAILED, status: STATUS.TIMEOUT });
+        }, signal, () => {
+            abandoned = true;
+            if (this.onAbandoned) this.onAbandoned(dev_addr);
+        });
+        const success = this.#ble.mstConnect(dev_addr_ab, modified_callback);
+        this.#monitor.issued(TRACE_OP.CONNECT, dev_addr, success);
+        return success;
+    }
+    /**
+     * Disconnects from a device. See BLEMaster.disconnect.
+     */
+    disconnect(dev_addr) {
+        dev_addr = normalizeMac(dev_addr);
+        if (dev_addr !== null && this.#registry.isConnected(dev_addr)) {
+            const success = this.#ble.mstDisconnect(this.#registry.connectId(dev_addr));
+            this.#monitor.issued(TRACE_OP.DISCONNECT, dev_addr, success);
+            return success;
+        }
+    }
+    /**
+     * Pairs with a device. See BLEMaster.pair.
+     */
+    pair(dev_addr) {
+        dev_addr = normalizeMac(dev_addr);
+        if (dev_addr !== null && this.#registry.isConnected(dev_addr)) {
+            return this.#ble.mstPair(this.#registry.connectId(dev_addr));
+        }
+    }
+    /**
+     * Stops all interactions with a device. See BLEMaster.stop.
+     */
+    stop(dev_addr) {
+        dev_addr = normalizeMac(dev_addr);
+        if (dev_addr !== null && this.#registry.isConnected(dev_addr)) {
+            this.#connected.delete(dev_addr);
+            if (this.#connected.size === 0) this.#ble.mstOffAllCb(); // the backend callbacks are shared by every device
+            const profile_idp = this.#registry.profile(dev_addr);
+            if (profile_idp !== undefined) {
+                this.#ble.mstDestroyProfileInstance(profile_idp);
+                this.#registry.setProfile(dev_addr, undefined);
+            }
+            const success = this.#ble.mstDisconnect(this.#registry.connectId(dev_addr));
+            this.#registry.unlink(dev_addr);
+            this.#disown(dev_addr);
+            this.#monitor.issued(TRACE_OP.DISCONNECT, dev_addr, success);
+        }
+    }
+    /**
+     * Stops the device when the token is cancelled, until the device disconnects.
+     */
+    own(signal, dev_addr) {
+        this.#disown(dev_addr);
+        const stop = () => {
+            this.#owned.delete(dev_addr);
+            this.stop(dev_addr);
+        };
+        signal.addEventListener("abort", stop);
+        this.#owned.set(dev_addr, () => signal.removeEventListener("abort", stop));
+    }
+    #disown(dev_addr) {
+        const dispose = this.#owned.get(dev_addr);
+        if (dispose) {
+            this.#owned.delete(dev_addr);
+            dispose();
+        }
+    }
+}
+
+/* GATT */
+
+/**
+ * GATT: profile preparation, characteristic/descriptor reads and writes, and the ble.on.* callbacks.
+ */
+
+class Profiles {
+    #ble;
+    #clock;
+    #registry;
+    #monitor;
+    #callbacks;
+    #connections;
+    #known;
+    #preparing = false; // a profile is being built
+    #prepare_queue = []; // startListener calls waiting for it
+
+    constructor(ble, clock, registry, monitor, callbacks, connections, known = null) {
+        this.#ble = ble;
+        this.#clock = clock;
+        this.#registry = registry;
+        this.#monitor = monitor;
+        this.#callbacks = callbacks;
+        this.#connections = connections;
+        this.#known = known;
+    }
+    /**
+     * Builds a profile for the device of profile_object.dev. See BLEMaster.startListener.
+     * The backend has one mstOnPrepare callback, so profiles are built one at a time: a call made while another profile
+     * is being built waits for it.
+     */
+    startListener(profile_object, response_callback, options = {}) {
+        logger.debug(() => "eBLE: startListener called with profile_object: " + JSON.stringify(profile_object));
+        const signal = options.signal;
+        if (signal && signal.aborted) {
+            return { success: false, error: ERR_CANCELLED };
+        }
+        const invalid = profileError(profile_object);
+        if (invalid) { // mstBuildProfile does not validate, a malformed profile fails deep inside the backend
+            logger.error(ERR_INVALID_PROFILE + ":", invalid);
+            return { success: false, error: ERR_INVALID_PROFILE };
+        }
+        const request = { profile_object, response_callback, signal, drop: null };
+        if (this.#preparing) {
+            if (signal) { // a cancelled request leaves the queue without calling back
+                request.drop = () => {
+                    const index = this.#prepare_queue.indexOf(request);
+                    if (index >= 0) this.#prepare_queue.splice(index, 1);
+                };
+                signal.addEventListener("abort", request.drop);
+            }
+            this.#prepare_queue.push(request);
+        } else {
+            this.#prepare(request);
+        }
+
+        // the profile is built asynchronously, its status is delivered to the response_callback
+        return {
+            success: true,
+            error: null,
+        };
+    }
+    #prepare({ profile_object, response_callback, signal }) {
+        const dev_addr = ab2mac(profile_object.dev); // the device the profile is for, connects to other devices may have completed since
+        let abandoned = false; // timed out or cancelled
+        let finished = false;
+        const finish = () => { // the backend is free for the next profile
+            if (finished) return;
+            finished = true;
+            this.#prepareNext();
+        };
+        this.#preparing = true;
+        // 1. register the mstOnPrepare callback to handle profile preparation
+        this.#ble.mstOnPrepare((backend_response) => {
+            logger.debug(() => "eBLE: mstOnPrepare called with backend_response: " + JSON.stringify(backend_response));
+            if (abandoned) { // the request was already failed, release a late profile
+                if (backend_response.status === 0) {
+                    this.#ble.mstDestroyProfileInstance(backend_response.profile);
+                }
+                return;
+            }
+            this.#monitor.completed(TRACE_OP.PREPARE_RESULT, dev_addr, backend_response.status);
+            if (backend_response.status === 0) {
+                // save profile pointer (only if we were able to properly connect)
+                this.#registry.setProfile(dev_addr, backend_response.profile); // profile, status
+                if (signal) this.#connections.own(signal, dev_addr);
+            } else {
+                logger.warn("eBLE: Error mstOnPrepare. Status:", backend_response.status);
+            }
+
+            // 3. [old] execute the response_callback with the profile pointer (profile_idp) as the argument 
+            //    [new] returns status to the end user. (profile_idp) is now hidden from the end user interactions
+            logger.debug("eBLE: Executing backend_response");
+            finish();
+            response_callback(backend_response.status); // backend_response.profile
+        });
+        this.#listenAttributes();
+    
+        // add a delay before calling mstBuildProfile
+        let build_timer = null;
+        const cancel_build = () => {
+            abandoned = true;
+            this.#clock.clearTimeout(build_timer);
+            finish();
+        };
+        if (signal) signal.addEventListener("abort", cancel_build);
+        build_timer = this.#clock.setTimeout(() => {
+            if (signal) signal.removeEventListener("abort", cancel_build);
+            // 2. build the profile
+            this.#monitor.start(TRACE_OP.PREPARE, dev_addr, dev_addr, () => {
+                abandoned = true;
+                finish();
+                response_callback(STATUS.TIMEOUT);
+            }, signal, () => {
+                abandoned = true;
+                finish();
+            });
+            const success = this.#ble.mstBuildProfile(profile_object);
+            logger.debug("eBLE: mstBuildProfile called with success:", success);
+            this.#monitor.issued(TRACE_OP.PREPARE, dev_addr, success);
+            if (!success) { // nothing will answer, the caller still gets its status
+                logger.error(ERR_PROFILE_CREATION_FAILED);
+                abandoned = true;
+                finish();
+                response_callback(STATUS.REJECTED);
+            }
+        }, SHORT_DELAY);  // 100ms
+    }
+    #prepareNext() {
+        this.#preparing = false;
+        const request = this.#prepare_queue.shift();
+        if (!request) return;
+        if (request.drop) request.signal.removeEventListener("abort", request.drop);
+        this.#prepare(request);
+    }
+    /**
+     * Fills in connect_id, profile and dev of a profile object. See BLEMaster.modifyProfileObject.
+     */
+    modifyProfileObject(dev_addr, profile_object) {
+        dev_addr = normalizeMac(dev_addr);
+        const device = dev_addr === null ? undefined : this.#registry.get(dev_addr);
+        // a device connected directly (without a scan) has no dev_name in the registry, the known-devices store may have it
+        const known = dev_addr !== null && this.#known ? this.#known.get(dev_addr) : undefined;
+        if (!device && !known) {
+            logger.warn("eBLE: Device not found:", dev_addr);
+            return null;
+        }
+    
+        const modified_profile_object = {
+            ...profile_object,
+            id: device ? device.connect_id : undefined,
+            profile: device && device.dev_name !== undefined ? device.dev_name : known && known.dev_name,
+            dev: mac2ab(dev_addr),
+        };
+    
+        return modified_profile_object;
+    }
+    /**
+     * @warning [NOT IMPLEMENTED] See BLEMaster.generateProfileObject.
+     */
+     generateProfileObject(dev_addr) {
+        const device = this.#registry.get(dev_addr);
+        if (!device) {
+            logger.warn("eBLE: Device not found:", dev_addr);
+            return { success: false, error: "Device not found: " + dev_addr };
+        }
+    
+        logger.warn(ERR_NOT_IMPLEMENTED);
+        return { success: false, error: ERR_NOT_IMPLEMENTED }; // exit point
+        // TODO: implementation (most devices don't have enough data to generate a profile from the scan, needs a generalized approach)
+        const profile_object = {
+            pair: true,
+            id: device.connect_id,
+            profile: device.dev_name,
+            dev: mac2ab(dev_addr),
+            len: 1,
+            list: []
+        };
+    
+        // add services
+        for (const service_uuid of device.service_uuid_array || []) { // empty arr if we have nothing + need to make sure we gen all 5 levels
+            const service = {
+                uuid: true,
+                size: 1,
+                len: 1,
+                list: []
+            };
+            profile_object.list.push(service);
+    
+            // add characteristics
+            for (const characteristic of device.characteristics || []) {
+                if (characteristic.service_uuid === service_uuid) {
+                    const characteristic_obj = {
+                        uuid: characteristic.uuid,
+                        permission: 0,
+                        desc: 1,
+                        len: 1,
+                        list: []
+                    };
+                    service.list.push(characteristic_obj);
+    
+                    // add descriptors
+                    for (const descriptor of characteristic.descriptors || []) {
+                        const descriptor_obj = {
+                            uuid: descriptor.uuid,
+                            permission: 0
+                        };
+                        characteristic_obj.list.push(descriptor_obj);
+                    }
+                }
+            }
+        }
+    }
+    /**
+     * Registers the backend read/write/notification callbacks. Every response is measured and handed over
+     * to the matching ble.on callback with the device's MAC address and hex-string data.
+     */
+    #listenAttributes() {
+        const dispatch = (name, op, response, size) => {
+            const dev_addr = this.#registry.findByProfile(response.profile);
+            const status = response.status === undefined ? 0 : response.status;
+            if (op === TRACE_OP.NOTIFY || op === TRACE_OP.VALUE) { // a read settles on its ReadComplete
+                this.#monitor.event(op, dev_addr, status, size);
+            } else {
+                const key = response.uuid !== undefined ? attrKey(dev_addr, response.uuid) : attrKey(dev_addr, response.chara, response.desc);
+                this.#monitor.completed(op, dev_addr, status, size, key);
+            }
+            const callbacks = this.#callbacks;
+            if (callbacks[name] || (callbacks.taps && callbacks.taps.size > 0)) {
+                const response_str = { ...response, dev_addr };
+                if (response.data !== undefined) response_str.data = ab2str_stripped(response.data);
+                emitCallback(callbacks, name, response_str);
+            }
+        };
+        this.#ble.mstOnCharaReadComplete((response) => dispatch("charaReadComplete", TRACE_OP.READ_RESULT, response, 0));
+        this.#ble.mstOnCharaValueArrived((response) => dispatch("charaValueArrived", TRACE_OP.VALUE, response, response.length));
+        this.#ble.mstOnCharaWriteComplete((response) => dispatch("charaWriteComplete", TRACE_OP.WRITE_RESULT, response, 0));
+        this.#ble.mstOnDescReadComplete((response) => dispatch("descReadComplete", TRACE_OP.READ_RESULT, response, 0));
+        this.#ble.mstOnDescValueArrived((response) => dispatch("descValueArrived", TRACE_OP.VALUE, response, response.length));
+        this.#ble.mstOnDescWriteComplete((response) => dispatch("descWriteComplete", TRACE_OP.WRITE_RESULT, response, 0));
+        this.#ble.mstOnCharaNotification((response) => dispatch("charaNotification", TRACE_OP.NOTIFY, response, response.length));
+    }
+}
+
+class Write {
+    #ble;
+    #registry;
+    #monitor;
+    #callbacks;
+    
+    constructor(ble, registry, monitor, callbacks) {
+        this.#ble = ble;
+        this.#registry = registry;
+        this.#monitor = monitor;
+        this.#callbacks = callbacks;
+    }
+    /**
+     * Writes to a characteristic of a device.
+     * @param {string} dev_addr - The MAC address of the device.
+     * @param {string} uuid - The UUID of the characteristic to write to.
+     * @param {string|ArrayBuffer} data - The data to write to the characteristic.
+     * @param {Object} [options={}] - Optional parameters.
+     * @param {CancelToken} [options.signal] - Cancelling it before the write is issued skips it, after that it stops waiting for the completion.
+     * @returns {Object} Returns an object with a 'success' property indicating whether the write succeeded and an 'error' property containing an error message if the write failed.
+     */
+    characteristic(dev_addr, uuid, data, options = {}) {
+        dev_addr = normalizeMac(dev_addr);
+        if (dev_addr === null) {
+            logger.error(ERR_INVALID_MAC);
+            return { success: false, error: ERR_INVALID_MAC };
+        }
+        const signal = options.signal;
+        if (signal && signal.aborted) {
+            return { success: false, error: ERR_CANCELLED };
+        }
+        const profile_idp = this.#registry.profile(dev_addr);
+        if (profile_idp === undefined) {
+            logger.error(ERR_IDP_NOT_FOUND);
+            return { success: false, error: ERR_IDP_NOT_FOUND_SHORT }; // handle layering
+        }
+        const data_ab = data2ab(data);
+        if (data_ab === null) {
+            logger.error(ERR_INVALID_DATA);
+            return { success: false, error: ERR_INVALID_DATA };
+        }
+        const data_len = data_ab.byteLength;
+        const key = attrKey(dev_addr, uuid);
+        this.#monitor.start(TRACE_OP.WRITE, dev_addr, key, () => {
+            emitCallback(this.#callbacks, "charaWriteComplete", { dev_addr, uuid, status: STATUS.TIMEOUT });
+        }, signal);
+        const success = this.#ble.mstWriteCharacteristic(profile_idp, uuid, data_ab, data_len);
+        this.#monitor.issued(TRACE_OP.WRITE, dev_addr, success, data_len, key);
+        return {
+            success,
+            error: success ? null : ERR_CHAR_WRITE_FAIL,
+        };
+    }
+    /**
+     * Writes to a descriptor of a characteristic of a device.
+     * @param {string} dev_addr - The MAC address of the device.
+     * @param {string} chara - The UUID of the characteristic that the descriptor belongs to.
+     * @param {string} desc - The UUID of the descriptor to write to.
+     * @param {string|ArrayBuffer} data - The data to write to the descriptor.
+     * @param {Object} [options={}] - Optional parameters.
+     * @param {CancelToken} [options.signal] - Cancelling it before the write is issued skips it, after that it stops waiting for the completion.
+     * @returns {Object} Returns an object with a 'success' property indicating whether the write succeeded and an 'error' property containing an error message if the write failed.
+     */
+    descriptor(dev_addr, chara, desc, data, options = {}) {
+        dev_addr = normalizeMac(dev_addr);
+        if (dev_addr === null) {
+            logger.error(ERR_INVALID_MAC);
+            return { success: false, error: ERR_INVALID_MAC };
+        }
+        const signal = options.signal;
+        if (signal && signal.aborted) {
+            return { success: false, error: ERR_CANCELLED };
+        }
+        const profile_idp = this.#registry.profile(dev_addr);
+        if (profile_idp === undefined) {
+            logger.error(ERR_IDP_NOT_FOUND);
+            return { success: false, error: ERR_IDP_NOT_FOUND_SHORT };
+        }
+        const data_ab = data2ab(data);
+        if (data_ab === null) {
+            logger.error(ERR_INVALID_DATA);
+            return { success: false, error: ERR_INVALID_DATA };
+        }
+        const data_len = data_ab.byteLength;
+        const key = attrKey(dev_addr, chara, desc);
+        this.#monitor.start(TRACE_OP.WRITE, dev_addr, key, () => {
+            emitCallback(this.#callbacks, "descWriteComplete", { dev_addr, chara, desc, status: STATUS.TIMEOUT });
+        }, signal);
+        const success = this.#ble.mstWriteDescriptor(profile_idp, chara, desc, data_ab, data_len);
+        this.#monitor.issued(TRACE_OP.WRITE, dev_addr, success, data_len, key);
+        return {
+            success,
+            error: success ? null : ERR_DESC_WRITE_FAIL,
+        };
+    }
+}
+
+class Read {
+    #ble;
+    #registry;
+    #monitor;
+    #callbacks;
+    
+    constructor(ble, registry, monitor, callbacks) {
+        this.#ble = ble;
+        this.#registry = registry;
+        this.#monitor = monitor;
+        this.#callbacks = callbacks;
+    }
+    /**
+     * Reads from a characteristic of a device.
+     * @param {string} dev_addr - The MAC address of the device.
+     * @param {string} uuid - The UUID of the characteristic to read from.
+     * @param {Object} [options={}] - Optional parameters.
+     * @param {CancelToken} [options.signal] - Cancelling it before the read is issued skips it, after that it stops waiting for the completion.
+     * @returns {Object} Returns an object with a 'success' property indicating whether the read succeeded and an 'error' property containing an error message if the read failed.
+     */
+    characteristic(dev_addr, uuid, options = {}) {
+        dev_addr = normalizeMac(dev_addr);
+        if (dev_addr === null) {
+            logger.error(ERR_INVALID_MAC);
+            return { success: false, error: ERR_INVALID_MAC };
+        }
+        const signal = options.signal;
+        if (signal && signal.aborted) {
+            return { success: false, error: ERR_CANCELLED };
+        }
+        const profile_idp = this.#registry.profile(dev_addr);
+        if (profile_idp === undefined) {
+            logger.error(ERR_IDP_NOT_FOUND);
+            return { success: false, error: ERR_IDP_NOT_FOUND_SHORT };
+        }
+        const key = attrKey(dev_addr, uuid);
+        this.#monitor.start(TRACE_OP.READ, dev_addr, key, () => {
+            emitCallback(this.#callbacks, "charaReadComplete", { dev_addr, uuid, status: STATUS.TIMEOUT });
+        }, signal);
+        const success = this.#ble.mstReadCharacteristic(profile_idp, uuid);
+        this.#monitor.issued(TRACE_OP.READ, dev_addr, success, 0, key);
+        return {
+            success,
+            error: success ? null : ERR_CHAR_READ_FAIL,
+        };
+    }
+    /**
+     * Reads from a descriptor of a characteristic of a device.
+     * @param {string} dev_addr - The MAC address of the device.
+     * @param {string} uuid - The UUID of the characteristic that the descriptor belongs to.
+     * @param {string} desc - The UUID of the descriptor to read from.
+     * @param {Object} [options={}] - Optional parameters.
+     * @param {CancelToken} [options.signal] - Cancelling it before the read is issued skips it, after that it stops waiting for the completion.
+     * @returns {Object} Returns an object with a 'success' property indicating whether the read succeeded and an 'error' property containing an error message if the read failed.
+     */
+    descriptor(dev_addr, uuid, desc, options = {}) {
+        dev_addr = normalizeMac(dev_addr);
+        if (dev_addr === null) {
+            logger.error(ERR_INVALID_MAC);
+            return { success: false, error: ERR_INVALID_MAC };
+        }
+        const signal = options.signal;
+        if (signal && signal.aborted) {
+            return { success: false, error: ERR_CANCELLED };
+        }
+        const profile_idp = this.#registry.profile(dev_addr);
+        if (profile_idp === undefined) {
+            logger.error(ERR_IDP_NOT_FOUND);
+            return { success: false, error: ERR_IDP_NOT_FOUND_SHORT };
+        }
+        const key = attrKey(dev_addr, uuid, desc);
+        this.#monitor.start(TRACE_OP.READ, dev_addr, key, () => {
+            emitCallback(this.#callbacks, "descReadComplete", { dev_addr, chara: uuid, desc, status: STATUS.TIMEOUT });
+        }, signal);
+        const success = this.#ble.mstReadDescriptor(profile_idp, uuid, desc);
+        this.#monitor.issued(TRACE_OP.READ, dev_addr, success, 0, key);
+        return {
+            success,
+            error: success ? null : ERR_DESC_READ_FAIL,
+        };
+    }
+}
+
+class On {
+    #callbacks;
+
+    constructor(callbacks) {
+        this.#callbacks = callbacks;
+    }
+    /**
+     * Registers a callback for characteristic read completion.
+     * @param {Function} callback - Called with { dev_addr, profile, uuid, status }, status is STATUS.TIMEOUT if the watchdog expired.
+     */
+    charaReadComplete(callback) {
+        this.#callbacks.charaReadComplete = callback;
+    }
+    /**
+     * Registers a callback for characteristic values that arrive after a read.
+     * @param {Function} callback - Called with { dev_addr, profile, uuid, data, length }, data is a hex string.
+     */
+    charaValueArrived(callback) {
+        this.#callbacks.charaValueArrived = callback;
+    }
+    /**
+     * Registers a callback for characteristic write completion.
+     * @param {Function} callback - Called with { dev_addr, profile, uuid, status }, status is STATUS.TIMEOUT if the watchdog expired.
+     */
+    charaWriteComplete(callback) {
+        this.#callbacks.charaWriteComplete = callback;
+    }
+    /**
+     * Registers a callback for descriptor read completion.
+     * @param {Function} callback - Called with { dev_addr, profile, chara, desc, status }, status is STATUS.TIMEOUT if the watchdog expired.
+     */
+    descReadComplete(callback) {
+        this.#callbacks.descReadComplete = callback;
+    }
+    /**
+     * Registers a callback for descriptor values that arrive after a read.
+     * @param {Function} callback - Called with { dev_addr, profile, chara, desc, data, length }, data is a hex string.
+     */
+    descValueArrived(callback) {
+        this.#callbacks.descValueArrived = callback;
+    }
+    /**
+     * Registers a callback for descriptor write completion.
+     * @param {Function} callback - Called with { dev_addr, profile, chara, desc, status }, status is STATUS.TIMEOUT if the watchdog expired.
+     */
+    descWriteComplete(callback) {
+        this.#callbacks.descWriteComplete = callback;
+    }
+    /**
+     * Registers a callback for characteristic notifications.
+     * @param {Function} callback - Called with { dev_addr, profile, uuid, data, length }, data is a hex string.
+     */
+    charaNotification(callback) {
+        this.#callbacks.charaNotification = callback;
+    }
+}
+
+/* MASTER */
+
+/**
+ * BLEMaster: the page-level facade over scanning, connections, GATT and diagnostics.
+ */
+
+const BUILT_IN = {}; // the opt-in features the bundle's entry ships, see provideFeatures
+
+/**
+ * Builds opt-in features into every BLEMaster of a bundle, so options.pool: true (or an options object) and ble.scene()
+ * find their implementation. Called by the entries that ship them (index.js), the core bundle ships none.
+ * @param {Object} features - { power: PowerBudget, pool: ConnectionPool, known: KnownDevices, admission: ConnectScheduler,
+ * sight: connectOnSight, scene: runScene }.
+ */
+function provideFeatures(features) {
+    Object.assign(BUILT_IN, features);
+}
+
+/**
+ * Resolves an opt-in feature option: the implementation itself (pool: ConnectionPool) enables it with its defaults,
+ * { use: ConnectionPool, ...options } with options, true or an options object use the built-in implementation.
+ * @returns {Array|null} Returns [implementation, options], or null if the feature is off or not available.
+ */
+function featureOption(name, option) {
+    if (!option) return null;
+    if (typeof option === "function") return [option, {}];
+    const implementation = (option !== true && option.use) || BUILT_IN[name];
+    if (!implementation) {
+        logger.error(ERR_FEATURE_MISSING + `, options.${name} ignored`);
+        return null;
+    }
+    if (option === true) return [implementation, {}];
+    const { use, ...feature_options } = option;
+    return [implementation, feature_options];
+}
+
+class BLEMaster {
+    #registry;
+    #monitor;
+    #scanner;
+    #connections;
+    #profiles;
+    #power = null;
+    #pool = null;
+    #known = null;
+    #admission = null;
+    #sight;     // startScan's options.connect
+    #scene;
+    #clock;
+    #taps = new Set(); // the library's own listeners on the ble.on callbacks
+
+    /**
+     * @type {Write} A device writer.
+     */
+    write;
+
+    /**
+     * @type {Read} A device reader.
+     */
+    read;
+
+    /**
+     * @type {On} Read, write and notification callbacks.
+     */
+    on;
+
+    /**
+     * Creates a new BLE Master instance.
+     * @param {Object} [options={}] - Optional parameters.
+     * @param {string} [options.registry="object"] - The device registry backend. "object" keeps a plain object per device,
+     * "compact" stores scan data in typed-array columns and materializes device objects only when requested (recommended for 500+ advertising devices).
+     * @param {number} [options.capacity=64] - The number of preallocated slots for the "compact" registry. Grows automatically when exceeded.
+     * @param {number} [options.trace] - Enables the binary trace recorder with room for this many operation records (16 bytes each).
+     * @param {Object|boolean} [options.watchdog] - Deadlines in millis for outstanding backend operations, false disables the watchdog.
+     * An expired operation is failed with STATUS.TIMEOUT. Defaults: { connect: 10000, prepare: 10000, read: 5000, write: 5000, recycle: false }.
+     * With recycle: true an expired prepare/read/write also stops the device (destroys the profile and disconnects).
+     * @param {Object} [options.transport] - An object implementing the hmBle mst* surface. Defaults to @zos/ble, use it to run
+     * against a simulator or an instrumented backend.
+     * @param {Object} [options.clock] - The time source { now, setTimeout, clearTimeout }. Defaults to the system timers.
+     * @param {Object|boolean} [options.power] - Meters radio use against an energy budget and degrades gracefully when it runs low,
+     * a spent budget closes every link and refuses connects and reads/writes. One unit is one second of scanning. true for the defaults: { budget: 600, window: 3600000,
+     * costs: { scan: 1, link: 0.05, op: 0.02 }, saving_at: 0.7, critical_at: 0.9, check_interval: 10000, scan_period: 10000,
+     * scan_duty: [1, 0.4, 0.1], poll_factor: [1, 2, 4], idle_close: [0, 60000, 15000], on_level }, the arrays are per POWER_LEVEL.
+     * @param {Object|boolean} [options.pool] - Keeps links open between commands within a pool. true for the defaults: { max: 4, idle: 30000 }.
+     * A link without reads, writes or notifications for idle millis is stopped, a connect to a new device when max links
+     * (connects in flight included) are held stops the least recently used one.
+     * @param {Object|boolean} [options.known] - Remembers every device it connects to (name, service UUIDs, vendor id), so a later
+     * launch can connect to it without scanning. true keeps them in memory, { storage, key: "eble_known", max: 32 } persists them
+     * with storage.getItem / setItem (localStorage from @zos/storage).
+     * @param {Object|boolean} [options.admission] - Queues connect() calls and lets a few reach the backend at once. true for the
+     * defaults: { concurrency: 2, retries: 2, retry_delay: 500, order: "rssi" }. The queue is ordered by connect's options.priority,
+     * then first attempts before retries, then the strongest RSSI ("rssi") or call order ("fifo"). A failed attempt is queued
+     * again after retry_delay millis, the callback only sees the last one.
+     * power, pool, known and admission also take their implementation, alone (pool: ConnectionPool) or with options
+     * ({ use: ConnectionPool, max: 3 }). true and plain options objects need a bundle that builds them in (ble-master.js,
+     * ble-master-lite.js), dist/ble-master-core.js builds in none.
+     * @param {Function} [options.sight] - connectOnSight, the implementation of startScan's options.connect. Built in like power.
+     * @param {Function} [options.scene] - runScene, the implementation of scene(). Built in like power.
+     */
+    constructor(options = {}){
+        let ble = options.transport || hmBle;
+        const clock = options.clock || SYSTEM_CLOCK;
+        const callbacks = { taps: this.#taps };
+        this.#clock = clock;
+        this.#sight = options.sight || BUILT_IN.sight || null;
+        this.#scene = options.scene || BUILT_IN.scene || null;
+        const power = featureOption("power", options.power);
+        if (power) {
+            const [PowerFeature, power_options] = power;
+            this.#power = new PowerFeature(power_options, clock);
+            ble = this.#power.wrap(ble, (profile) => this.#registry.findByProfile(profile), (dev_addr) => this.stop(dev_addr));
+        }
+        const pool = featureOption("pool", options.pool);
+        if (pool) {
+            const [PoolFeature, pool_options] = pool;
+            this.#pool = new PoolFeature(pool_options, clock);
+            ble = this.#pool.wrap(ble, (profile) => this.#registry.findByProfile(profile), (dev_addr) => this.stop(dev_addr));
+        }
+        this.#registry = createRegistry(options, clock);
+        this.#monitor = createMonitor(options, clock);
+        this.#monitor.onRecycle = (dev_addr) => this.stop(dev_addr);
+        this.#scanner = new Scanner(ble, clock, this.#registry, this.#monitor);
+        this.#connections = new Connections(ble, this.#registry, this.#monitor);
+        if (this.#pool) this.#connections.onAbandoned = (dev_addr) => this.#pool.abandon(dev_addr);
+        const known = featureOption("known", options.known);
+        if (known) {
+            const [KnownFeature, known_options] = known;
+            this.#known = new KnownFeature(known_options, clock);
+            this.#connections.onConnected = (dev_addr) => this.#known.connected(dev_addr, this.#registry.get(dev_addr));
+        }
+        const admission = featureOption("admission", options.admission);
+        if (admission) {
+            const [AdmissionFeature, admission_options] = admission;
+            this.#admission = new AdmissionFeature(admission_options, clock,
+                (dev_addr, callback, connect_options) => this.#connections.connect(dev_addr, callback, connect_options),
+                (dev_addr) => {
+                    const device = this.#registry.get(dev_addr);
+                    return device && device.last_seen !== undefined ? device.rssi : undefined;
+                });
+        }
+        this.#profiles = new Profiles(ble, clock, this.#registry, this.#monitor, callbacks, this.#connections, this.#known);
+        this.write = new Write(ble, this.#registry, this.#monitor, callbacks);
+        this.read = new Read(ble, this.#registry, this.#monitor, callbacks);
+        this.on = new On(callbacks);
+    }
+    /**
+     * @type {TraceRecorder|null} The operation trace recorder, or null if tracing was not enabled with options.trace.
+     */
+    get trace() {
+        return this.#monitor.trace;
+    }
+    /**
+     * @type {PowerBudget|null} The power budget, or null if it was not enabled with options.power.
+     */
+    get power() {
+        return this.#power;
+    }
+    /**
+     * @type {ConnectionPool|null} The connection pool, or null if it was not enabled with options.pool.
+     */
+    get pool() {
+        return this.#pool;
+    }
+    /**
+     * @type {KnownDevices|null} The known-devices store, or null if it was not enabled with options.known.
+     */
+    get known() {
+        return this.#known;
+    }
+    /**
+     * @type {ConnectScheduler|null} The connection admission queue, or null if it was not enabled with options.admission.
+     */
+    get admission() {
+        return this.#admission;
+    }
+    /**
+     * @type {Get} A device information getter.
+     */
+    get get() {
+        return new Get(this.#registry, this.#monitor);
+    }
+    /**
+     * Resets all counters and latency histograms reported by get.stats().
+     */
+    resetStats() {
+        this.#monitor.reset();
+    }
+    /**
+     * Sets the library-wide log level. Messages above this level are neither formatted nor printed.
+     * @param {number} level - One of LOG_LEVEL.NONE, ERROR, WARN (default), INFO or DEBUG.
+     */
+    static setLogLevel(level) {
+        logger.level = level;
+    }
+    /**
+     * Starts scanning for devices.
+     * @param {Function} response_callback - The callback function that will be called with the scan result for each device.
+     * @param {Object} [options={}] - Optional parameters for the scan.
+     * @param {number} [options.duration] - The duration of the scan in milliseconds. If specified, the scan will automatically stop after this duration.
+     * @param {Function} [options.on_duration] - A callback function that will be called when the scan stops due to reaching the specified duration.
+     * @param {CancelToken} [options.signal] - Stops the scan when cancelled. Any AbortSignal-like object works.
+     * @param {Function} [options.filter] - Called with every decoded scan result, results it returns false for are dropped
+     * before they reach the registry and the response_callback.
+     * @param {Object} [options.connect] - Connects to targets the moment their first advert arrives (after options.filter):
+     * { targets: MAC or [MAC], profile, stop_scan: true, on_ready }. With a profile object (or a function MAC > profile object)
+     * the profile is built right after the connect, profiles are built one at a time. stop_scan: true stops the scan once every
+     * target was sighted, false keeps it running. on_ready is called once per target with { dev_addr, connected, connect_id, status },
+     * status being the startListener status (undefined without a profile), or { ..., error } if the profile was rejected.
+     * A target that is already connected is reported right away. options.signal applies to the connects and profiles too.
+     * @returns {boolean} Returns true if the call to start the scan succeeded, false if it failed.
+     */
+    startScan(response_callback, options = {}) {
+        if (options.connect) {
+            if (!this.#sight) {
+                logger.error(ERR_FEATURE_MISSING + ", options.connect needs options.sight");
+                return false;
+            }
+            response_callback = this.#sight(this, response_callback, options);
+            if (response_callback === null) return false;
+        }
+        return this.#scanner.startScan(response_callback, options);
+    }
+    /**
+     * Stops scanning for devices.
+     * @returns {boolean} Returns true if the call to stop the scan succeeded, false if it failed.
+     */
+    stopScan() {
+        return this.#scanner.stopScan();
+    }
+    /**
+     * Connects to a device.
+     * @param {string} dev_addr - The MAC address of the device to connect to.
+     * @param {Function} response_callback - The callback function that will be called with the result of the connection attempt.
+     * @param {Object} [options={}] - Optional parameters.
+     * @param {CancelToken} [options.signal] - Cancelling it abandons a pending connection attempt (without calling back)
+     * or stops the device once connected.
+     * @param {number} [options.priority=0] - With options.admission, higher priorities reach the backend first.
+     * @returns {boolean} Returns true if the call to connect to the device succeeded (with options.admission: was queued), false if it failed.
+     */
+    connect(dev_addr, response_callback, options = {}) {
+        if (this.#admission) return this.#admission.connect(dev_addr, response_callback, options);
+        return this.#connections.connect(dev_addr, response_callback, options);
+    }
+    /**
+     * Runs a scene: writes to several devices at once under one deadline, e.g. every lamp off when leaving home.
+     * The devices run in parallel, each one is connected (through options.admission if enabled) and gets its profile
+     * if it has none yet, then its writes are issued in order, each after the previous one completed.
+     * @param {Object[]} commands - { dev_addr, uuid, data } for a characteristic or { dev_addr, chara, desc, data } for
+     * a descriptor write, optionally with the device's profile object. data as for write.characteristic.
+     * @param {Function} response_callback - Called once with { done, elapsed, devices }. done is true if every device
+     * succeeded, devices maps each MAC to { result: "ok" | "failed" | "timeout", step, writes, error }: step is where it
+     * ended ("connect", "prepare", "write" or "done"), writes the number of completed writes, error the connect result,
+     * the backend status or the error message of the call that failed.
+     * @param {Object} [options={}] - Optional parameters.
+     * @param {Object|Function} [options.profile] - The profile object (or a function MAC > profile object) for devices
+     * without a profile, modified with modifyProfileObject.
+     * @param {number} [options.timeout=10000] - The deadline in millis for the whole scene, the devices not done by then time out.
+     * @param {boolean} [options.stop=false] - Stops every device once its writes completed.
+     * @param {number} [options.priority] - The connects' priority with options.admission.
+     * @param {CancelToken} [options.signal] - Cancelling it abandons the scene without calling back.
+     * A device that fails or times out is stopped if the scene connected it.
+     * @returns {boolean} Returns true if the scene started, false if a command is invalid or the signal is already cancelled.
+     */
+    scene(commands, response_callback, options = {}) {
+        if (!this.#scene) {
+            logger.error(ERR_FEATURE_MISSING + ", scene() needs options.scene");
+            return false;
+        }
+        return this.#scene(this, this.#clock, this.#taps, commands, response_callback, options);
+    }
+    /**
+     * Disconnects from a device.
+     * @param {string} dev_addr - The MAC address of the device to disconnect from.
+     * @returns {boolean} Returns true if the call to disconnect from the device succeeded, false if it failed or if the device was not connected.
+     */
+    disconnect(dev_addr) {
+        return this.#connections.disconnect(dev_addr);
+    }
+    /**
+     * Pairs with a device.
+     * @param {string} dev_addr - The MAC address of the device to pair with.
+     * @returns {boolean} Returns true if the call to pair with the device succeeded, false if it failed or if the device was not connected.
+     */
+    pair(dev_addr) {
+        return this.#connections.pair(dev_addr);
+    }
+    /**
+     * Starts listening for profile preparation events and builds a profile for interaction with a device.
+     * @param {Object} profile_object - The profile object that describes how to interact with the device.
+     * @param {Function} response_callback - The callback function that will be called when a profile preparation event occurs.
+     * Receives the backend status (0 = OK), STATUS.TIMEOUT when the backend did not answer in time or STATUS.REJECTED
+     * when it refused to build the profile.
+     * @param {Object} [options={}] - Optional parameters.
+     * @param {CancelToken} [options.signal] - Cancelling it abandons the profile preparation (without calling back)
+     * or stops the device once the profile is ready.
+     * @returns {Object} Returns an object with a 'success' property indicating whether the call succeeded and an 'error' property containing an error message if the call failed.
+     */
+    startListener(profile_object, response_callback, options = {}) {
+        return this.#profiles.startListener(profile_object, response_callback, options);
+    }
+    /**
+     * Temporary replacement for the generateProfileObject function. 
+     * Modifies a profile object with required values for a device. Works for scanned devices, connected ones and,
+     * with options.known, for known devices that were neither scanned nor connected in this launch.
+     * @param {string} dev_addr - The MAC address of the device.
+     * @param {Object} profile_object - The profile object to be modified.
      * @returns {Object|null} Returns the modified profile object for the device, or null if the device was not found.
      */
-    modifyProfileObject(dev_addr, profile_object) {
-        const device = this.#devices[dev_addr];
-        if (!device) {
-            console.log("eBLE: Device not found:", dev_addr);
+    modifyProfileObject(dev_addr, profile_object) {
+        return this.#profiles.modifyProfileObject(dev_addr, profile_object);
+    }
+    /**
+     * @warning [NOT IMPLEMENTED] Generates a generic profile object for a device.
+     * @param {string} dev_addr - The MAC address of the device.
+     * @returns {Object|null} Returns a generic profile object for the device, or null if the device was not found.
+     */
+    generateProfileObject(dev_addr) {
+        return this.#profiles.generateProfileObject(dev_addr);
+    }
+    /**
+     * Stops all interactions with a device.
+     * @param {string} dev_addr - The MAC address of the device.
+     */
+    stop(dev_addr) {
+        this.#connections.stop(dev_addr);
+    }
+}
+
+/* POWER */
+
+/**
+ * Power budget: meters radio use (scan time, held links, reads/writes/notifications) against an energy budget over a
+ * rolling window and degrades gracefully when it runs low: duty-cycled scans, longer polling intervals, idle links closed.
+ * A spent budget is enforced until the window frees some of it: scans pause, every link is closed, connects and
+ * reads/writes are refused.
+ */
+
+const POWER_LEVEL = {
+    NORMAL: 0,
+    SAVING: 1,
+    CRITICAL: 2,
+};
+
+const POWER_BUCKETS                 = 60;   // the window is metered in this many slices
+const POWER_HYSTERESIS              = 0.05; // a level is left this far below its threshold, so it does not flap
+
+// energy units: one unit is one second of scanning
+const DEFAULT_POWER = {
+    budget: 600,            // units per window, 10 minutes of scanning per hour
+    window: 3600000,        // millis
+    costs: { scan: 1, link: 0.05, op: 0.02 }, // per second of scanning, per second per held link, per read/write/notification
+    saving_at: 0.7,         // fraction of the budget used
+    critical_at: 0.9,
+    check_interval: 10000,  // millis between two checks while the radio is in use
+    scan_period: 10000,     // millis, one duty cycle
+    scan_duty: [1, 0.4, 0.1],           // share of each scan period the radio listens, per level
+    poll_factor: [1, 2, 4],             // interval() multiplier per level
+    idle_close: [0, 60000, 15000],      // millis without reads/writes/notifications before a link is closed, per level (0 = never)
+};
+
+// the backend surface the wrapper forwards
+const POWER_PASS_THROUGH = ["mstPair", "mstBuildProfile", "mstOnPrepare", "mstDestroyProfileInstance", "mstOffAllCb",
+    "mstOnCharaReadComplete", "mstOnCharaWriteComplete", "mstOnDescReadComplete", "mstOnDescValueArrived", "mstOnDescWriteComplete"];
+const POWER_OPS = ["mstReadCharacteristic", "mstReadDescriptor", "mstWriteCharacteristic", "mstWriteDescriptor"];
+const POWER_ARRIVALS = ["mstOnCharaValueArrived", "mstOnCharaNotification"];
+
+/**
+ * Meters and enforces the energy budget of one BLEMaster. Created by new BLEMaster({ power }), read through ble.power.
+ */
+class PowerBudget {
+    #clock;
+    #options;
+    #buckets = new Float64Array(POWER_BUCKETS);
+    #bucket_millis;
+    #bucket = 0;        // index of the current bucket since the epoch
+    #accrued_at;
+    #level = POWER_LEVEL.NORMAL;
+    #exhausted = false; // the whole budget is spent, the radio stays off until the window frees some
+    #reserve;           // units kept back so a last operation and the value that answers it fit the budget
+    #timer = null;
+    #timer_at = 0;      // millis the check timer fires at
+    #target = null;
+    #resolve = null;    // profile > MAC
+    #stop = null;       // MAC > void, closes a link
+    #links = new Map(); // connect_id > MAC
+    #active = new Map(); // MAC > millis of its last read, write or notification
+    #scan_callback = null;
+    #scan_wanted = false;
+    #radio_on = false;
+    #duty_timer = null;
+    #totals = { scan_millis: 0, link_millis: 0, ops: 0, duty_pauses: 0, idle_closed: 0, refused: 0 };
+
+    /**
+     * @param {Object} [options={}] - See BLEMaster's options.power.
+     * @param {Object} [clock] - { now, setTimeout, clearTimeout }.
+     */
+    constructor(options = {}, clock = SYSTEM_CLOCK) {
+        this.#clock = clock;
+        this.#options = { ...DEFAULT_POWER, ...options, costs: { ...DEFAULT_POWER.costs, ...options.costs } };
+        this.#bucket_millis = this.#options.window / POWER_BUCKETS;
+        this.#reserve = 2 * this.#options.costs.op; // a read is charged again when its value arrives
+        this.#accrued_at = clock.now();
+        this.#bucket = Math.floor(this.#accrued_at / this.#bucket_millis);
+    }
+    /**
+     * @type {number} The current POWER_LEVEL.
+     */
+    get level() {
+        return this.#level;
+    }
+    /**
+     * @type {number} Energy units spent in the current window.
+     */
+    get used() {
+        this.#accrue();
+        let sum = 0;
+        for (let i = 0; i < POWER_BUCKETS; i++) sum += this.#buckets[i];
+        return sum;
+    }
+    /**
+     * @type {number} Energy units left in the current window, 0 when overspent.
+     */
+    get remaining() {
+        return Math.max(0, this.#options.budget - this.used);
+    }
+    /**
+     * Stretches a polling interval by the current level's poll_factor. Use it for every periodic read of the app.
+     * @param {number} millis - The interval at POWER_LEVEL.NORMAL.
+     * @returns {number} Returns the interval to use now.
+     */
+    interval(millis) {
+        return millis * this.#options.poll_factor[this.#level];
+    }
+    /**
+     * @type {boolean} True while the whole budget is spent: scans are paused, links closed, connects and reads/writes refused.
+     */
+    get exhausted() {
+        return this.#exhausted;
+    }
+    /**
+     * @returns {Object} Returns { level, exhausted, used, budget, scan_millis, link_millis, ops, duty_pauses, idle_closed, refused,
+     * links }, the totals count since creation (or reset()), used is the current window.
+     */
+    report() {
+        const used = this.used;
+        return { level: this.#level, exhausted: this.#exhausted, used, budget: this.#options.budget, ...this.#totals, links: this.#links.size };
+    }
+    /**
+     * Forgets the spent energy and the totals, back to POWER_LEVEL.NORMAL.
+     */
+    reset() {
+        this.#accrue();
+        this.#buckets.fill(0);
+        for (const key in this.#totals) this.#totals[key] = 0;
+        this.#check();
+    }
+    /**
+     * Records energy spent outside the library (e.g. an app's own sensor use) against the same budget.
+     * @param {number} units - Energy units, one unit is one second of scanning.
+     */
+    spend(units) {
+        this.#accrue();
+        this.#spend(units);
+        this.#check();
+        this.#schedule(true);
+    }
+    /**
+     * Wraps a backend so every scan, link and operation is metered, and refused while the budget is spent. Used by BLEMaster.
+     * @param {Object} target - @zos/ble or any transport.
+     * @param {Function} resolve - profile > MAC of its device.
+     * @param {Function} stop - Closes the link of a MAC (BLEMaster.stop).
+     * @returns {Object} Returns the metered transport.
+     */
+    wrap(target, resolve, stop) {
+        this.#target = target;
+        this.#resolve = resolve;
+        this.#stop = stop;
+        const transport = {};
+        for (const name of POWER_PASS_THROUGH) transport[name] = (...args) => target[name](...args);
+        for (const name of POWER_OPS) {
+            transport[name] = (profile, ...args) => {
+                if (!this.#admit("operation")) return false;
+                this.#operation(profile);
+                return target[name](profile, ...args);
+            };
+        }
+        for (const name of POWER_ARRIVALS) {
+            transport[name] = (callback) => target[name]((response) => {
+                if (response) this.#operation(response.profile);
+                callback(response);
+            });
+        }
+        transport.mstStartScan = (callback) => this.#startScan(callback);
+        transport.mstStopScan = () => this.#stopScan();
+        transport.mstConnect = (dev_addr, callback) => {
+            if (!this.#admit("connect")) return false;
+            return target.mstConnect(dev_addr, (result) => {
+                if (result) this.#connectResult(result);
+                callback(result);
+            });
+        };
+        transport.mstDisconnect = (connect_id) => {
+            const success = target.mstDisconnect(connect_id);
+            if (success) this.#unlink(connect_id);
+            return success;
+        };
+        return transport;
+    }
+
+    /* METERING */
+
+    #accrue() { // charges the time since the last call to the radio state of that time
+        const now = this.#clock.now();
+        const seconds = (now - this.#accrued_at) / 1000;
+        if (seconds <= 0) return;
+        this.#accrued_at = now;
+        const costs = this.#options.costs;
+        if (this.#radio_on) this.#totals.scan_millis += seconds * 1000;
+        this.#totals.link_millis += seconds * 1000 * this.#links.size;
+        this.#spend(seconds * ((this.#radio_on ? costs.scan : 0) + this.#links.size * costs.link));
+    }
+    #spend(units) {
+        const bucket = Math.floor(this.#clock.now() / this.#bucket_millis);
+        for (let b = Math.max(this.#bucket + 1, bucket - POWER_BUCKETS + 1); b <= bucket; b++) this.#buckets[b % POWER_BUCKETS] = 0;
+        this.#bucket = Math.max(this.#bucket, bucket);
+        this.#buckets[bucket % POWER_BUCKETS] += units;
+    }
+    #operation(profile) {
+        this.#accrue();
+        this.#totals.ops++;
+        this.#spend(this.#options.costs.op);
+        const dev_addr = this.#resolve(profile);
+        if (dev_addr) this.#active.set(dev_addr, this.#clock.now());
+        this.#schedule(true);
+    }
+    #admit(what) { // false while the budget is spent
+        this.#accrue();
+        if (this.#exhausted) this.#check(); // the window may have freed some
+        if (!this.#exhausted && this.used < this.#options.budget - this.#reserve) return true;
+        this.#schedule(true); // spent between two checks, the next one closes the links now
+        logger.info(() => `eBLE: Power budget spent, ${what} refused`);
+        this.#totals.refused++;
+        return false;
+    }
+    #connectResult(result) {
+        this.#accrue();
+        if (result.connected === CONNECT_STATUS_OK) {
+            const dev_addr = result.dev_addr instanceof ArrayBuffer && result.dev_addr.byteLength === MAC_BYTES ? ab2mac(result.dev_addr) : null;
+            if (dev_addr === null) return;
+            this.#links.set(result.connect_id, dev_addr);
+            this.#active.set(dev_addr, this.#clock.now());
+            this.#schedule(true);
+        } else if (result.connected === CONNECT_STATUS_DISCONNECTED) {
+            this.#unlink(result.connect_id);
+        }
+    }
+    #unlink(connect_id) {
+        const dev_addr = this.#links.get(connect_id);
+        if (dev_addr === undefined) return;
+        this.#accrue();
+        this.#links.delete(connect_id);
+        this.#active.delete(dev_addr);
+    }
+
+    /* SCAN DUTY CYCLE */
+
+    #startScan(callback) {
+        this.#scan_callback = callback;
+        this.#check(); // the level may have recovered while nothing was metered
+        if (this.#exhausted) { // starts once the window frees some budget
+            this.#scan_wanted = true;
+            this.#schedule();
+            return true;
+        }
+        const success = this.#target.mstStartScan(callback);
+        this.#scan_wanted = success;
+        this.#radio(success);
+        this.#duty();
+        this.#schedule(true);
+        return success;
+    }
+    #stopScan() {
+        this.#scan_wanted = false;
+        this.#clock.clearTimeout(this.#duty_timer);
+        this.#duty_timer = null;
+        if (!this.#radio_on) return true; // paused by the duty cycle
+        this.#radio(false);
+        return this.#target.mstStopScan();
+    }
+    #radio(on) {
+        this.#accrue();
+        this.#radio_on = on;
+    }
+    #duty() { // (re)starts the duty cycle of the current level from the current radio state
+        this.#clock.clearTimeout(this.#duty_timer);
+        this.#duty_timer = null;
+        if (!this.#scan_wanted) return;
+        const duty = this.#exhausted ? 0 : this.#options.scan_duty[this.#level];
+        if (duty <= 0) {
+            if (this.#radio_on) {
+                this.#radio(false);
+                this.#target.mstStopScan();
+                this.#totals.duty_pauses++;
+            }
+            return;
+        }
+        if (duty >= 1) {
+            if (!this.#radio_on && this.#target.mstStartScan(this.#scan_callback)) {
+                this.#radio(true);
+                this.#schedule(true);
+            }
+            return;
+        }
+        const period = this.#options.scan_period;
+        this.#duty_timer = this.#clock.setTimeout(() => {
+            this.#duty_timer = null;
+            if (!this.#scan_wanted) return;
+            if (this.#radio_on) {
+                this.#radio(false);
+                this.#target.mstStopScan();
+                this.#totals.duty_pauses++;
+            } else if (this.#target.mstStartScan(this.#scan_callback)) {
+                this.#radio(true);
+                this.#schedule(true);
+            }
+            this.#duty();
+        }, this.#radio_on ? period * duty : period * (1 - duty));
+    }
+
+    /* POLICY */
+
+    #schedule(sooner = false) { // checks run while the radio is in use, the next one no later than the budget would be spent
+        if ((this.#timer !== null && !sooner) || (!this.#scan_wanted && this.#links.size === 0)) return;
+        const costs = this.#options.costs;
+        const rate = (this.#radio_on ? costs.scan : 0) + this.#links.size * costs.link; // units per second
+        const left = this.#options.budget - this.#reserve - this.used;
+        const delay = rate > 0 && !this.#exhausted ? Math.min(this.#options.check_interval, Math.max(0, Math.ceil(left / rate * 1000))) : this.#options.check_interval;
+        if (this.#timer !== null) { // a spend or a new drain only ever brings the check forward
+            if (this.#timer_at <= this.#clock.now() + delay) return;
+            this.#clock.clearTimeout(this.#timer);
+        }
+        this.#timer_at = this.#clock.now() + delay;
+        this.#timer = this.#clock.setTimeout(() => {
+            this.#timer = null;
+            this.#check();
+            this.#schedule();
+        }, delay);
+    }
+    #check() {
+        const used = this.used;
+        const fraction = used / this.#options.budget;
+        const { saving_at, critical_at } = this.#options;
+        let level = this.#level;
+        if (fraction >= critical_at) level = POWER_LEVEL.CRITICAL;
+        else if (fraction >= saving_at) level = Math.max(level, POWER_LEVEL.SAVING);
+        if (level === POWER_LEVEL.CRITICAL && fraction < critical_at - POWER_HYSTERESIS) level = POWER_LEVEL.SAVING;
+        if (level === POWER_LEVEL.SAVING && fraction < saving_at - POWER_HYSTERESIS) level = POWER_LEVEL.NORMAL;
+        const exhausted = used >= this.#options.budget - this.#reserve || (this.#exhausted && fraction >= 1 - POWER_HYSTERESIS);
+        if (exhausted !== this.#exhausted) {
+            logger.info(() => `eBLE: Power budget ${exhausted ? "spent, radio off" : "available again"}`);
+            this.#exhausted = exhausted;
+            this.#duty();
+        }
+        if (level !== this.#level) {
+            logger.info(() => `eBLE: Power level ${this.#level} > ${level}, ${(fraction * 100).toFixed(0)}% of the budget used`);
+            this.#level = level;
+            this.#duty();
+            if (this.#options.on_level) this.#options.on_level(level, this.report());
+        }
+        this.#closeIdle();
+    }
+    #closeIdle() { // every link once the budget is spent
+        const idle = this.#exhausted ? 0 : this.#options.idle_close[this.#level];
+        if (!idle && !this.#exhausted) return;
+        const now = this.#clock.now();
+        for (const [dev_addr, active_at] of Array.from(this.#active)) {
+            if (now - active_at < idle) continue;
+            logger.info(() => this.#exhausted ? `eBLE: Power budget spent, closing link to ${dev_addr}` : `eBLE: Power saving, closing idle link to ${dev_addr}`);
+            this.#active.delete(dev_addr);
+            this.#totals.idle_closed++;
+            this.#stop(dev_addr);
+        }
+    }
+}
+
+/* POOL */
+
+/**
+ * Connection pool: links stay open between commands, up to a maximum number of devices. A link without reads, writes
+ * or notifications for the idle period is closed, and a connect that needs a slot evicts the least recently used link.
+ */
+
+const DEFAULT_POOL = {
+    max: 4,         // links held at once, connects in flight included
+    idle: 30000,    // millis without activity before a link is closed, 0 keeps links until evicted
+};
+
+// the backend surface the wrapper forwards
+const POOL_PASS_THROUGH = ["mstStartScan", "mstStopScan", "mstPair", "mstOnPrepare", "mstDestroyProfileInstance", "mstOffAllCb"];
+const POOL_OPS = ["mstReadCharacteristic", "mstReadDescriptor", "mstWriteCharacteristic", "mstWriteDescriptor"];
+const POOL_ARRIVALS = ["mstOnCharaReadComplete", "mstOnCharaValueArrived", "mstOnCharaWriteComplete", "mstOnDescReadComplete",
+    "mstOnDescValueArrived", "mstOnDescWriteComplete", "mstOnCharaNotification"];
+
+/**
+ * Keeps the links of one BLEMaster within options.pool. Created by new BLEMaster({ pool }), read through ble.pool.
+ */
+class ConnectionPool {
+    #clock;
+    #options;
+    #resolve = null;        // profile > MAC
+    #stop = null;           // MAC > void, closes a link
+    #links = new Map();     // connect_id > MAC
+    #recent = new Map();    // MAC > millis of its last activity, least recently used first
+    #connecting = new Map(); // MAC > the connect in flight, its slot is held until the backend answers or it is abandoned
+    #timer = null;
+    #totals = { connects: 0, evicted: 0, idle_closed: 0, rejected: 0 };
+
+    /**
+     * @param {Object} [options={}] - See BLEMaster's options.pool.
+     * @param {Object} [clock] - { now, setTimeout, clearTimeout }.
+     */
+    constructor(options = {}, clock = SYSTEM_CLOCK) {
+        this.#clock = clock;
+        this.#options = { ...DEFAULT_POOL, ...options };
+    }
+    /**
+     * @type {number} The number of links the pool holds.
+     */
+    get size() {
+        return this.#recent.size;
+    }
+    /**
+     * @returns {Array<string>} Returns the MACs of the pooled devices, least recently used first (the next one to be evicted).
+     */
+    devices() {
+        return Array.from(this.#recent.keys());
+    }
+    /**
+     * @returns {Object} Returns { size, max, idle, connects, evicted, idle_closed, rejected }, the totals count since creation.
+     */
+    report() {
+        return { size: this.#recent.size, max: this.#options.max, idle: this.#options.idle, ...this.#totals };
+    }
+    /**
+     * Frees the slot of a connect the library gave up on (watchdog expiry or cancel), the backend may never answer it.
+     * A late connection is still counted until it is closed. Used by BLEMaster.
+     * @param {string} dev_addr - The MAC address of the device.
+     */
+    abandon(dev_addr) {
+        this.#connecting.delete(dev_addr);
+    }
+    /**
+     * Wraps a backend so links are counted and their use is tracked. Used by BLEMaster.
+     * @param {Object} target - @zos/ble or any transport.
+     * @param {Function} resolve - profile > MAC of its device.
+     * @param {Function} stop - Closes the link of a MAC (BLEMaster.stop).
+     * @returns {Object} Returns the pooled transport.
+     */
+    wrap(target, resolve, stop) {
+        this.#resolve = resolve;
+        this.#stop = stop;
+        const transport = {};
+        for (const name of POOL_PASS_THROUGH) transport[name] = (...args) => target[name](...args);
+        for (const name of POOL_OPS) {
+            transport[name] = (profile, ...args) => {
+                this.#touch(this.#resolve(profile));
+                return target[name](profile, ...args);
+            };
+        }
+        for (const name of POOL_ARRIVALS) {
+            transport[name] = (callback) => target[name]((response) => {
+                if (response) this.#touch(this.#resolve(response.profile));
+                callback(response);
+            });
+        }
+        transport.mstBuildProfile = (profile_object) => {
+            this.#touch(macOf(profile_object && profile_object.dev));
+            return target.mstBuildProfile(profile_object);
+        };
+        transport.mstConnect = (dev_addr, callback) => {
+            const mac = macOf(dev_addr);
+            if (mac !== null && !this.#admit(mac)) return false;
+            const attempt = {};
+            if (mac !== null) this.#connecting.set(mac, attempt);
+            const settle = () => { // a newer connect to the same device keeps its slot
+                if (this.#connecting.get(mac) === attempt) this.#connecting.delete(mac);
+            };
+            const success = target.mstConnect(dev_addr, (result) => {
+                settle();
+                if (result) this.#connectResult(result);
+                callback(result);
+            });
+            if (!success) settle();
+            return success;
+        };
+        transport.mstDisconnect = (connect_id) => {
+            const success = target.mstDisconnect(connect_id);
+            if (success) this.#unlink(connect_id);
+            return success;
+        };
+        return transport;
+    }
+
+    /* SLOTS */
+
+    #admit(dev_addr) { // makes room for a connect to dev_addr, false if every slot is a connect in flight
+        if (this.#recent.has(dev_addr) || this.#connecting.has(dev_addr)) return true;
+        while (this.#recent.size + this.#connecting.size >= this.#options.max) {
+            const oldest = this.#recent.keys().next();
+            if (oldest.done) {
+                logger.warn(`eBLE: Connection pool full, ${this.#options.max} connects in flight, ${dev_addr} rejected`);
+                this.#totals.rejected++;
+                return false;
+            }
+            logger.info(() => `eBLE: Connection pool full, evicting ${oldest.value} for ${dev_addr}`);
+            this.#totals.evicted++;
+            this.#close(oldest.value);
+        }
+        return true;
+    }
+    #connectResult(result) {
+        if (result.connected === CONNECT_STATUS_OK) {
+            const dev_addr = macOf(result.dev_addr);
+            if (dev_addr === null) return;
+            this.#totals.connects++;
+            this.#links.set(result.connect_id, dev_addr);
+            this.#recent.delete(dev_addr);
+            this.#recent.set(dev_addr, this.#clock.now());
+            this.#schedule();
+        } else if (result.connected === CONNECT_STATUS_DISCONNECTED) {
+            this.#unlink(result.connect_id);
+        }
+    }
+    #unlink(connect_id) {
+        const dev_addr = this.#links.get(connect_id);
+        if (dev_addr === undefined) return;
+        this.#links.delete(connect_id);
+        this.#recent.delete(dev_addr);
+    }
+    #touch(dev_addr) { // moves a pooled device to the most recently used end
+        if (dev_addr === null || !this.#recent.delete(dev_addr)) return;
+        this.#recent.set(dev_addr, this.#clock.now());
+    }
+    #close(dev_addr) {
+        this.#recent.delete(dev_addr);
+        for (const [connect_id, linked] of this.#links) {
+            if (linked === dev_addr) this.#links.delete(connect_id);
+        }
+        this.#stop(dev_addr);
+    }
+
+    /* IDLE REAPER */
+
+    #schedule() { // one timer, due when the least recently used link turns idle
+        const idle = this.#options.idle;
+        if (this.#timer !== null || !idle) return;
+        const oldest = this.#recent.values().next();
+        if (oldest.done) return;
+        this.#timer = this.#clock.setTimeout(() => {
+            this.#timer = null;
+            this.#reap();
+            this.#schedule();
+        }, Math.max(0, oldest.value + idle - this.#clock.now()));
+    }
+    #reap() {
+        const now = this.#clock.now();
+        for (const [dev_addr, active_at] of Array.from(this.#recent)) {
+            if (now - active_at < this.#options.idle) break; // the rest were used more recently
+            logger.info(() => `eBLE: Closing idle link to ${dev_addr}`);
+            this.#totals.idle_closed++;
+            this.#close(dev_addr);
+        }
+    }
+}
+
+function macOf(dev_addr) {
+    return dev_addr instanceof ArrayBuffer && dev_addr.byteLength === MAC_BYTES ? ab2mac(dev_addr) : null;
+}
+
+/* KNOWN */
+
+/**
+ * Known devices: what the library learned about every device it connected to, kept across app launches in a key-value
+ * storage, so the next launch can connect to them directly instead of scanning first.
+ */
+
+const DEFAULT_KNOWN = {
+    storage: null,          // { getItem(key), setItem(key, value) }, e.g. localStorage from @zos/storage. null keeps them in memory
+    key: "eble_known",      // storage key
+    max: 32,                // devices kept, the least recently connected one is forgotten first
+};
+
+/**
+ * The known-devices store of one BLEMaster. Created by new BLEMaster({ known }), read through ble.known.
+ */
+class KnownDevices {
+    #clock;
+    #options;
+    #devices = new Map(); // MAC > record, least recently connected first
+
+    /**
+     * @param {Object} [options={}] - See BLEMaster's options.known.
+     * @param {Object} [clock] - { now, setTimeout, clearTimeout }.
+     */
+    constructor(options = {}, clock = SYSTEM_CLOCK) {
+        this.#clock = clock;
+        this.#options = { ...DEFAULT_KNOWN, ...options };
+        this.#load();
+    }
+    /**
+     * @type {number} The number of known devices.
+     */
+    get size() {
+        return this.#devices.size;
+    }
+    /**
+     * @param {string} dev_addr - The MAC address of the device.
+     * @returns {boolean} Returns true if the device is known.
+     */
+    has(dev_addr) {
+        dev_addr = normalizeMac(dev_addr);
+        return dev_addr !== null && this.#devices.has(dev_addr);
+    }
+    /**
+     * @param {string} dev_addr - The MAC address of the device.
+     * @returns {Object|undefined} Returns { dev_addr, dev_name, service_uuid_array, vendor_id, connected_at, connects }, or undefined.
+     */
+    get(dev_addr) {
+        dev_addr = normalizeMac(dev_addr);
+        return dev_addr === null ? undefined : this.#devices.get(dev_addr);
+    }
+    /**
+     * @returns {Array<Object>} Returns every known device, most recently connected first.
+     */
+    list() {
+        return Array.from(this.#devices.values()).reverse();
+    }
+    /**
+     * Adds or updates a device without connecting to it, e.g. one the user set up in a settings page.
+     * @param {string} dev_addr - The MAC address of the device.
+     * @param {Object} [info={}] - { dev_name, service_uuid_array, vendor_id }.
+     * @returns {boolean} Returns true if the device was stored, false if the MAC address is invalid.
+     */
+    remember(dev_addr, info = {}) {
+        dev_addr = normalizeMac(dev_addr);
+        if (dev_addr === null) return false;
+        const record = this.#devices.get(dev_addr) || newKnownRecord(dev_addr);
+        if (info.dev_name !== undefined) record.dev_name = info.dev_name;
+        if (info.service_uuid_array !== undefined) record.service_uuid_array = info.service_uuid_array;
+        if (info.vendor_id !== undefined) record.vendor_id = info.vendor_id;
+        this.#put(record);
+        this.#save();
+        return true;
+    }
+    /**
+     * Forgets a device.
+     * @param {string} dev_addr - The MAC address of the device.
+     * @returns {boolean} Returns true if the device was known.
+     */
+    forget(dev_addr) {
+        dev_addr = normalizeMac(dev_addr);
+        if (dev_addr === null || !this.#devices.delete(dev_addr)) return false;
+        this.#save();
+        return true;
+    }
+    /**
+     * Forgets every device.
+     */
+    clear() {
+        this.#devices.clear();
+        this.#save();
+    }
+    /**
+     * Records a successful connection, with what the registry knows about the device. Used by BLEMaster.
+     * @param {string} dev_addr - The normalized MAC address.
+     * @param {Object} [device] - The registry's device record.
+     */
+    connected(dev_addr, device) {
+        const record = this.#devices.get(dev_addr) || newKnownRecord(dev_addr);
+        if (device && device.dev_name !== undefined) {
+            record.dev_name = device.dev_name;
+            record.service_uuid_array = device.service_uuid_array;
+            record.vendor_id = device.vendor_id;
+        }
+        record.connected_at = this.#clock.now();
+        record.connects++;
+        this.#put(record);
+        this.#save();
+    }
+
+    #put(record) { // moves the record to the most recently connected end, forgets the oldest beyond max
+        this.#devices.delete(record.dev_addr);
+        this.#devices.set(record.dev_addr, record);
+        while (this.#devices.size > this.#options.max) this.#devices.delete(this.#devices.keys().next().value);
+    }
+    #load() {
+        const storage = this.#options.storage;
+        if (!storage) return;
+        let records;
+        try {
+            const text = storage.getItem(this.#options.key);
+            if (!text) return;
+            records = JSON.parse(text);
+        } catch (error) {
+            logger.warn("eBLE: Known devices could not be loaded:", error);
+            return;
+        }
+        if (!Array.isArray(records)) return;
+        for (const record of records) { // stored oldest first
+            const dev_addr = record ? normalizeMac(record.dev_addr) : null;
+            if (dev_addr === null) continue;
+            this.#put({
+                dev_addr,
+                dev_name: typeof record.dev_name === "string" ? record.dev_name : undefined,
+                service_uuid_array: Array.isArray(record.service_uuid_array) ? record.service_uuid_array : undefined,
+                vendor_id: typeof record.vendor_id === "number" ? record.vendor_id : undefined,
+                connected_at: typeof record.connected_at === "number" ? record.connected_at : undefined,
+                connects: typeof record.connects === "number" ? record.connects : 0,
+            });
+        }
+    }
+    #save() {
+        const storage = this.#options.storage;
+        if (!storage) return;
+        try {
+            storage.setItem(this.#options.key, JSON.stringify(Array.from(this.#devices.values())));
+        } catch (error) {
+            logger.warn("eBLE: Known devices could not be saved:", error);
+        }
+    }
+}
+
+function newKnownRecord(dev_addr) {
+    return { dev_addr, dev_name: undefined, service_uuid_array: undefined, vendor_id: undefined, connected_at: undefined, connects: 0 };
+}
+
+/* ADMISSION */
+
+/**
+ * Connection admission: connect() calls wait in a priority queue and reach the backend a few at a time, failed attempts
+ * are retried behind the first attempts of the same priority. Firing every connect at once overloads the backend,
+ * one at a time leaves it idle while a slow device answers.
+ */
+
+const ADMISSION_ORDER_RSSI = "rssi";
+const ADMISSION_NO_RSSI = -128; // devices that were never scanned go last among equals
+
+const DEFAULT_ADMISSION = {
+    concurrency: 2,     // connects the backend works on at once
+    retries: 2,         // extra attempts after a failed connect (connected: 1, a watchdog timeout included)
+    retry_delay: 500,   // millis before a failed attempt is queued again
+    order: ADMISSION_ORDER_RSSI, // among equal priorities: "rssi" strongest first, "fifo" in call order
+};
+
+/**
+ * The admission queue of one BLEMaster. Created by new BLEMaster({ admission }), read through ble.admission.
+ */
+class ConnectScheduler {
+    #clock;
+    #options;
+    #connect;       // (dev_addr, callback, options) > boolean, Connections.connect
+    #rssi;          // MAC > RSSI of its last advert, or undefined
+    #queue = [];    // requests waiting for a slot, unsorted, picked by #next()
+    #in_flight = 0;
+    #seq = 0;
+    #totals = { admitted: 0, retries: 0, connected: 0, failed: 0 };
+
+    /**
+     * @param {Object} [options={}] - See BLEMaster's options.admission.
+     * @param {Object} [clock] - { now, setTimeout, clearTimeout }.
+     * @param {Function} connect - Issues a connect to the backend (Connections.connect).
+     * @param {Function} rssi - MAC > RSSI of its last advert.
+     */
+    constructor(options = {}, clock = SYSTEM_CLOCK, connect, rssi) {
+        this.#clock = clock;
+        this.#options = { ...DEFAULT_ADMISSION, ...options };
+        this.#connect = connect;
+        this.#rssi = rssi;
+    }
+    /**
+     * @type {number} The number of connects waiting for a slot (retries waiting for their delay excluded).
+     */
+    get queued() {
+        return this.#queue.length;
+    }
+    /**
+     * @type {number} The number of connects the backend is working on.
+     */
+    get in_flight() {
+        return this.#in_flight;
+    }
+    /**
+     * @returns {Object} Returns { queued, in_flight, admitted, retries, connected, failed }, the totals count since creation.
+     */
+    report() {
+        return { queued: this.#queue.length, in_flight: this.#in_flight, ...this.#totals };
+    }
+    /**
+     * Queues a connect. See BLEMaster.connect, options.priority orders the queue (higher first, default 0).
+     * @returns {boolean} Returns true if the connect was queued, false if the MAC address is invalid or the signal is already cancelled.
+     */
+    connect(dev_addr, response_callback, options = {}) {
+        const mac = normalizeMac(dev_addr);
+        if (mac === null) {
+            logger.error(ERR_INVALID_MAC);
+            return false;
+        }
+        const signal = options.signal;
+        if (signal && signal.aborted) return false;
+        const request = { dev_addr: mac, callback: response_callback, options, priority: options.priority || 0, attempt: 0, seq: ++this.#seq, drop: null };
+        this.#enqueue(request);
+        this.#pump();
+        return true;
+    }
+
+    #enqueue(request) {
+        const signal = request.options.signal;
+        if (signal) { // a cancelled request leaves the queue without calling back
+            request.drop = () => {
+                const index = this.#queue.indexOf(request);
+                if (index >= 0) this.#queue.splice(index, 1);
+            };
+            signal.addEventListener("abort", request.drop);
+        }
+        this.#queue.push(request);
+    }
+    #dequeue(request) {
+        const index = this.#queue.indexOf(request);
+        if (index >= 0) this.#queue.splice(index, 1);
+        if (request.drop) request.options.signal.removeEventListener("abort", request.drop);
+        request.drop = null;
+    }
+    #next() { // priority, then first attempts before retries, then RSSI (or call order)
+        const by_rssi = this.#options.order === ADMISSION_ORDER_RSSI;
+        let best = null, best_rssi = 0;
+        for (const request of this.#queue) {
+            const rssi = by_rssi ? this.#rssiOf(request.dev_addr) : 0;
+            if (best === null || request.priority > best.priority
+                || (request.priority === best.priority && (request.attempt < best.attempt
+                || (request.attempt === best.attempt && (rssi > best_rssi || (rssi === best_rssi && request.seq < best.seq)))))) {
+                best = request;
+                best_rssi = rssi;
+            }
+        }
+        return best;
+    }
+    #rssiOf(dev_addr) {
+        const rssi = this.#rssi(dev_addr);
+        return typeof rssi === "number" ? rssi : ADMISSION_NO_RSSI;
+    }
+    #pump() {
+        while (this.#in_flight < this.#options.concurrency && this.#queue.length > 0) {
+            const request = this.#next();
+            this.#dequeue(request);
+            this.#admit(request);
+        }
+    }
+    #admit(request) {
+        request.attempt++;
+        this.#in_flight++;
+        this.#totals.admitted++;
+        const signal = request.options.signal;
+        let settled = false; // the first result frees the slot, later ones (disconnects) go straight to the caller
+        const settle = () => {
+            if (settled) return false;
+            settled = true;
+            if (signal) signal.removeEventListener("abort", settle);
+            this.#in_flight--;
+            this.#clock.setTimeout(() => this.#pump(), 0); // out of the backend callback
+            return true;
+        };
+        if (signal) signal.addEventListener("abort", settle); // a cancelled connect never calls back, its slot is freed here
+        const success = this.#connect(request.dev_addr, (result) => {
+            if (!settle()) {
+                request.callback(result);
+                return;
+            }
+            if (result.connected === CONNECT_STATUS_FAILED && this.#retry(request)) return;
+            this.#totals[result.connected === CONNECT_STATUS_OK ? "connected" : "failed"]++;
+            request.callback(result);
+        }, request.options);
+        if (!success) {
+            settle();
+            if (this.#retry(request)) return;
+            this.#totals.failed++;
+            request.callback({ dev_addr: request.dev_addr, connected: CONNECT_STATUS_FAILED });
+        }
+    }
+    #retry(request) {
+        const signal = request.options.signal;
+        if (request.attempt > this.#options.retries || (signal && signal.aborted)) return false;
+        this.#totals.retries++;
+        logger.info(() => `eBLE: Connect to ${request.dev_addr} failed, attempt ${request.attempt + 1} in ${this.#options.retry_delay}ms`);
+        const timer = this.#clock.setTimeout(() => {
+            if (signal) signal.removeEventListener("abort", cancel);
+            this.#enqueue(request);
+            this.#pump();
+        }, this.#options.retry_delay);
+        const cancel = () => this.#clock.clearTimeout(timer);
+        if (signal) signal.addEventListener("abort", cancel);
+        return true;
+    }
+}
+
+/* SIGHT */
+
+/**
+ * Connect on first sight: startScan's options.connect. A target is connected the moment its first advert arrives and its
+ * profile is built right after, while the scan keeps looking for the other targets.
+ */
+
+/**
+ * Wraps a scan callback so it connects the targets of options.connect on first sight. Used by BLEMaster and SessionHandle.
+ * @param {Object} ble - The BLEMaster (or SessionHandle) that scans: connect, startListener, modifyProfileObject, stopScan, get.
+ * @param {Function} response_callback - The caller's scan callback, called after the target is handled.
+ * @param {Object} options - startScan's options, see BLEMaster.startScan.
+ * @returns {Function|null} Returns the scan callback to use, or null if options.connect.targets holds an invalid MAC address.
+ */
+function connectOnSight(ble, response_callback, options) {
+    const { targets, profile, stop_scan = true, on_ready } = options.connect;
+    const pending = new Set();
+    for (const target of Array.isArray(targets) ? targets : [targets]) {
+        const dev_addr = normalizeMac(target);
+        if (dev_addr === null) {
+            logger.error(ERR_INVALID_MAC);
             return null;
         }
-    
-        const modified_profile_object = {
-            ...profile_object,
-            id: device.connect_id,
-            profile: device.dev_name,
-            dev: mac2ab(dev_addr),
+        pending.add(dev_addr);
+    }
+    const signal = options.signal;
+
+    const ready = (response) => notify(on_ready, response);
+    const connected = (result) => { // startListener builds the profiles one at a time
+        if (result.connected !== CONNECT_STATUS_OK || !profile) {
+            ready(result);
+            return;
+        }
+        const dev_addr = result.dev_addr;
+        const profile_object = ble.modifyProfileObject(dev_addr, typeof profile === "function" ? profile(dev_addr) : profile);
+        const listening = profile_object === null ? { success: false, error: ERR_INVALID_PROFILE } : ble.startListener(profile_object, (status) => {
+            ready({ ...result, status });
+        }, { signal });
+        if (!listening.success) ready({ ...result, error: listening.error }); // rejected before it reached the backend
+    };
+    const sighted = (dev_addr) => {
+        pending.delete(dev_addr);
+        logger.debug(() => "eBLE: Target sighted, connecting: " + dev_addr);
+        if (pending.size === 0 && stop_scan) ble.stopScan();
+        if (ble.get.isConnected(dev_addr)) {
+            const device = ble.get.device(dev_addr);
+            if (!profile || device.profile_idp !== undefined) {
+                ready({ dev_addr, connected: CONNECT_STATUS_OK, connect_id: device.connect_id, status: profile ? 0 : undefined });
+            } else {
+                connected({ dev_addr, connected: CONNECT_STATUS_OK, connect_id: device.connect_id });
+            }
+            return;
+        }
+        let settled = false; // later callbacks of this connection report disconnects, not the first-sight result
+        const success = ble.connect(dev_addr, (result) => {
+            if (settled) return;
+            settled = true;
+            connected(result);
+        }, { signal });
+        if (!success) {
+            settled = true;
+            ready({ dev_addr, connected: CONNECT_STATUS_FAILED });
+        }
+    };
+    return (scan_result) => {
+        if (pending.has(scan_result.dev_addr)) sighted(scan_result.dev_addr);
+        response_callback(scan_result);
+    };
+}
+
+/* SCENE */
+
+/**
+ * Scenes: a list of writes across several devices, run in parallel under one deadline. Each device is connected and
+ * gets its profile if it needs them, then its writes run in order, each one waiting for its completion.
+ */
+
+const DEFAULT_SCENE_TIMEOUT = 10000; // millis
+
+/**
+ * Runs a scene. Used by BLEMaster.scene, see there for the commands, options and the report.
+ * @param {Object} ble - The BLEMaster that runs it: connect, startListener, modifyProfileObject, write, get, stop.
+ * @param {Object} clock - { now, setTimeout, clearTimeout }.
+ * @param {Set} taps - The library's listeners on the ble.on callbacks, the scene adds one while it runs.
+ * @returns {boolean} Returns true if the scene started, false if a command is invalid or the signal is already cancelled.
+ */
+function runScene(ble, clock, taps, commands, response_callback, options = {}) {
+    const plan = planScene(commands);
+    if (plan === null) {
+        logger.error(ERR_INVALID_SCENE);
+        return false;
+    }
+    const signal = options.signal;
+    if (signal && signal.aborted) return false;
+    const start = clock.now();
+    const devices = {};
+    const runs = [];
+    let open = plan.size;
+    let finished = false;
+
+    const finish = () => {
+        finished = true;
+        clock.clearTimeout(deadline);
+        taps.delete(tap);
+        if (signal) signal.removeEventListener("abort", abort);
+        let done = true;
+        for (const run of runs) done = done && run.report.result === "ok";
+        response_callback({ done, elapsed: clock.now() - start, devices });
+    };
+    const settle = (run, result, error) => {
+        if (finished || run.report.result !== "pending") return;
+        run.report.result = result;
+        if (error !== undefined) run.report.error = error;
+        if (result !== "ok") run.token.cancel(); // drops what is still in flight, stops a device the scene connected
+        if (--open === 0 && !starting) finish();
+    };
+    const step = (run) => {
+        const report = run.report;
+        if (report.result !== "pending") return;
+        if (!ble.get.isConnected(run.dev_addr)) {
+            report.step = "connect";
+            let settled = false; // later callbacks of this connection report disconnects
+            const success = ble.connect(run.dev_addr, (result) => {
+                if (settled) return;
+                settled = true;
+                if (result.connected !== CONNECT_STATUS_OK) return settle(run, "failed", result.connected);
+                run.owner = true;
+                step(run);
+            }, { signal: run.token, priority: options.priority });
+            if (!success) settle(run, "failed", CONNECT_STATUS_FAILED);
+            return;
+        }
+        if (ble.get.device(run.dev_addr).profile_idp === undefined) {
+            report.step = "prepare";
+            const profile = run.profile || options.profile;
+            const profile_object = profile && ble.modifyProfileObject(run.dev_addr, typeof profile === "function" ? profile(run.dev_addr) : profile);
+            const listening = profile_object ? ble.startListener(profile_object, (status) => {
+                if (status !== 0) return settle(run, "failed", status);
+                step(run);
+            }, run.owner ? { signal: run.token } : {}) : { success: false, error: ERR_INVALID_PROFILE }; // the token would take over a device the page connected
+            if (!listening.success) settle(run, "failed", listening.error);
+            return;
+        }
+        const command = run.commands[report.writes];
+        if (command === undefined) {
+            report.step = "done";
+            if (options.stop) ble.stop(run.dev_addr);
+            return settle(run, "ok");
+        }
+        report.step = "write";
+        run.waiting = command;
+        const written = command.uuid !== undefined
+            ? ble.write.characteristic(run.dev_addr, command.uuid, command.data, { signal: run.token })
+            : ble.write.descriptor(run.dev_addr, command.chara, command.desc, command.data, { signal: run.token });
+        if (!written.success) {
+            run.waiting = null;
+            settle(run, "failed", written.error);
+        }
+    };
+    const tap = (name, response) => { // the write completions, matched to the write each device waits for
+        if (name !== "charaWriteComplete" && name !== "descWriteComplete") return;
+        const run = plan.get(response.dev_addr);
+        const command = run && run.waiting;
+        if (!command || !sameAttribute(command, response)) return;
+        run.waiting = null;
+        if (response.status !== 0) return settle(run, "failed", response.status);
+        run.report.writes++;
+        step(run);
+    };
+    const expire = () => {
+        for (const run of runs) {
+            if (run.report.result === "pending") {
+                run.report.result = "timeout";
+                run.token.cancel();
+            }
+        }
+        finish();
+    };
+    const abort = () => { // a cancelled scene does not call back
+        finished = true;
+        clock.clearTimeout(deadline);
+        taps.delete(tap);
+        for (const run of runs) run.token.cancel();
+    };
+
+    const deadline = clock.setTimeout(expire, options.timeout === undefined ? DEFAULT_SCENE_TIMEOUT : options.timeout);
+    if (signal) signal.addEventListener("abort", abort);
+    taps.add(tap);
+    let starting = true; // a scene that ends before runScene returns still calls back afterwards
+    for (const [dev_addr, run] of plan) {
+        run.dev_addr = dev_addr;
+        run.token = new CancelToken();
+        run.waiting = null;
+        run.owner = false; // the scene made the connect, so its token may stop the device
+        run.report = { result: "pending", step: "connect", writes: 0 };
+        devices[dev_addr] = run.report;
+        runs.push(run);
+    }
+    for (const run of runs) {
+        if (!finished) step(run);
+    }
+    starting = false;
+    if (open === 0 && !finished) clock.setTimeout(() => { if (!finished) finish(); }, 0);
+    return true;
+}
+
+function planScene(commands) { // MAC > { commands, profile }, in the order the devices first appear
+    if (!Array.isArray(commands) || commands.length === 0) return null;
+    const plan = new Map();
+    for (const command of commands) {
+        const dev_addr = command && normalizeMac(command.dev_addr);
+        if (!dev_addr || data2ab(command.data) === null) return null;
+        if (typeof command.uuid !== "string" && (typeof command.chara !== "string" || typeof command.desc !== "string")) return null;
+        let run = plan.get(dev_addr);
+        if (!run) plan.set(dev_addr, run = { commands: [], profile: undefined });
+        run.commands.push(command);
+        if (command.profile) run.profile = command.profile;
+    }
+    return plan;
+}
+
+function sameAttribute(command, response) {
+    const same = (a, b) => typeof b === "string" && a.toUpperCase() === b.toUpperCase();
+    return command.uuid !== undefined
+        ? response.uuid !== undefined && same(command.uuid, response.uuid)
+        : same(command.chara, response.chara) && same(command.desc, response.desc);
+}
+
+/* INDEX */
+
+provideFeatures({ power: PowerBudget, pool: ConnectionPool, known: KnownDevices, admission: ConnectScheduler, sight: connectOnSight, scene: runScene });
+
+export { LOG_LEVEL };
+export { STATUS, TRACE_OP, CancelToken };
+export { ScanEngine, DeviceMirror };
+export { BLESession };
+export { POWER_LEVEL, PowerBudget };
+export { ConnectionPool };
+export { KnownDevices };
+export { ConnectScheduler };
+export { connectOnSight };
+export { runScene };
+export { WIRE_FORMAT, WireBatch, encodeFrame, decodeFrame };
+export { ab2mac, mac2ab, ab2str_stripped, data2ab, str2ab_with_len };
+export default BLEMaster;
+
+/**
+ * @changelog
+ * 1.20.1
+ * - @fix the trace recorder's MAC table is bounded by its capacity, slots of devices no longer referenced by any kept record
+ *   are reused
+ * - @fix startListener calls back with STATUS.REJECTED when mstBuildProfile refuses the profile, it used to never call back
+ * - @fix npm run build writes ble-master-example/libs/ble-master.js too, --check fails when that copy is stale
+ * - @fix BLESession: a page that cancels its connect or startListener no longer leaves the device stuck for other pages,
+ *   nor stops a device another page holds. npm run checks asserts it
+ * - @fix WireBatch.push rejects malformed messages, one of them used to make flush drop every queued message
+ * - @fix connection pool: a connect the watchdog expired or a signal cancelled held its slot forever when the backend never
+ *   answered, with max: 1 every later connect was rejected as "pool full"
+ * - @fix connection admission: a connect cancelled in flight (options.signal, a scene timeout) frees its slot, it used to hold it
+ *   forever and stall the queue
+ * - @fix the scenario scripts check the behaviour they demonstrate and exit with 1 when it fails, their shared helpers moved
+ *   to dev/common.js
+ * - @fix a read counted twice in the trace and read_result, its ValueArrived now records TRACE_OP.VALUE
+ * - @fix a second read/write to the same attribute dropped the first one's watchdog and cancel wiring, pending operations
+ *   now queue per attribute
+ * - @fix ScanEngine.start on a running engine restarted the scan and added a second flush timer, it now returns false.
+ *   stop() removes the start signal's listener
+ * - @fix wire messages: a diff without a valid seq/time, or a reading with a non-integer time, encoded as 0 in binary and
+ *   differently in JSON. They are rejected now, a reading without time is 0 in both formats
+ * - @fix str2ab_with_len returns { data_ab, data_len } for every string again, it returned null for chars above 0xFF
+ *   since 1.9.0. Only data2ab (writes) rejects those chars
+ * - @fix ble.scene: preparing a device a page had connected gave the device to the scene's token, so a failed or timed out
+ *   scene stopped it. Only devices the scene connects itself are tied to its token
+ * - @fix options.power enforces its budget: a spent budget closes every link and refuses connects and reads/writes
+ *   (power.report().refused) besides pausing scans, and the next check runs before the budget would run out. A window
+ *   used to exceed it by what links and reads cost. npm run power checks the window never does
+ * - @fix the per-feature builds did not shrink: master.js imported every opt-in feature. It no longer does, options.power,
+ *   pool, known and admission also take their implementation (pool: ConnectionPool or { use: ConnectionPool, max: 3 }),
+ *   options.sight / options.scene the ones of startScan's options.connect and scene(). ble-master.js and the lite build
+ *   build them all in and export them. New dist/ble-master-core.js without any of them, BLESession, background or wire
+ *   (80 KB, lite 183 KB). npm run build -- --check enforces a size budget per bundle
+ * 1.20.0
+ * - @perf read/write/notification callbacks look their device up by profile pointer in an index instead of walking the
+ *   registry (11x faster with 256 scanned and 64 connected devices). The registries also index connect_id (findByConnectId)
+ * - @rem the unused last-connected-device tracking, startListener targets profile_object.dev since 1.17.0
+ * 1.19.0
+ * - @add ble.scene(commands, callback, options): writes to several devices in parallel under one deadline, with a result
+ *   per device. npm run scene compares it with one connect/prepare/write/stop chain after the other
+ * - @fix startListener calls made while a profile is being built wait for it, the backend has one mstOnPrepare callback
+ * 1.18.0
+ * - @add options.admission: connect() calls are queued and reach the backend a few at a time, ordered by connect's
+ *   options.priority and RSSI, failed attempts are retried. npm run admission compares it with all at once and one at a time
+ * - @add BLESimulator connect_slots: a backend that fails connects beyond a number in flight
+ * 1.17.0
+ * - @add startScan options.connect: targets are connected the moment their first advert arrives and their profiles built
+ *   right after, while the scan looks for the others. npm run sight compares it with the scan > stop > connect ladder
+ * - @fix startListener builds the profile for profile_object.dev instead of the device that connected last
+ * 1.16.0
+ * - @add options.known: devices the library connected to are remembered (optionally in localStorage), a later launch
+ *   connects to them directly. modifyProfileObject works for known devices that were not scanned. npm run known times it
+ * 1.15.0
+ * - @add options.pool: links stay open between commands, idle ones are stopped after options.pool.idle and a connect
+ *   that needs a slot stops the least recently used link. npm run pool compares it with stop() after every command
+ * 1.14.0
+ * - @add options.power: an estimated energy budget over a rolling window. Scans are duty-cycled and then paused,
+ *   idle links closed and ble.power.interval() stretches polling as the budget runs low. npm run power shows the effect
+ * 1.13.0
+ * - @add wire format for service > page messages: encodeFrame / decodeFrame pack ScanEngine diffs and readings into
+ *   binary frames (~1/3 of the JSON size for diffs, ~1/5 for readings) or JSON, WireBatch batches them per interval.
+ *   Part of dist/ble-background.js, npm run wire compares the formats
+ * 1.12.0
+ * - @add BLESession: an app-scoped BLEMaster, pages attach handles with the same API and detach them on navigation,
+ *   connections and profiles are reused instead of rebuilt
+ * - @add get.device(dev_addr) returns one device record
+ * - @fix stop() keeps the shared backend callbacks while other devices are still connected
+ * 1.11.0
+ * - @add ScanEngine and DeviceMirror: scanning, filtering and registry upkeep in an app service, pages get batched
+ *   registry diffs (seq numbered, snapshot() to catch up). Bundled as dist/ble-background.js
+ * - @add startScan options.filter drops scan results before they reach the registry
+ * 1.10.0
+ * - @add modular source: src/ holds core, log, codecs, registry, diagnostics, scan, connection and gatt modules,
+ *   npm run build bundles them into ble-master.js and the per-feature builds in dist/:
+ *   ble-master-lite.js (no trace, stats or watchdog), ble-scan.js (BLEScanner, scan only) and ble-codecs.js
+ * - @add BLEScanner: startScan, stopScan and get without connections and GATT
+ * 1.9.0
+ * - @add boundary validation: malformed MACs, write data and profile objects are rejected with { success: false, error }
+ *   (false / null for connect, modifyProfileObject), scan results without a 6 byte dev_addr are dropped and counted
+ *   as errors.scan_first_seen.malformed in get.stats()
+ * - @add writes accept typed arrays and DataViews
+ * - @fix odd-length hex strings no longer write the last nibble as a whole byte, they are rejected
+ * - @fix strings with chars above 0xFF are rejected by writes (data2ab) instead of silently truncated
+ * - @fix mac2ab returns null instead of NaN bytes, modifyProfileObject accepts uppercase MACs
+ * - @perf ab2mac, ab2str_stripped and data2ab no longer build intermediate arrays (scan callback ~5x faster, ~5x less garbage)
+ * 1.8.0
+ * - @add named exports of the codec helpers: ab2mac, mac2ab, ab2str_stripped, data2ab, str2ab_with_len
+ * 1.7.1
+ * - @fix scan_first_seen missed devices whose first advert shared the clock value of the scan start
+ * 1.7.0
+ * - @add injectable transport and clock: new BLEMaster({ transport, clock }), defaults to @zos/ble and the system timers
+ * 1.6.0
+ * - @add CancelToken: pass { signal: token } to startScan, connect, startListener, write.* and read.*,
+ *   token.cancel() stops the scan, abandons pending operations and stops the devices connected with it
+ * 1.5.0
+ * - @add operation watchdog: connect, prepare, read and write fail with STATUS.TIMEOUT when the backend never answers,
+ *   new BLEMaster({ watchdog: { connect, prepare, read, write, recycle } }), watchdog: false disables it
+ * - @add STATUS export
+ * 1.4.0
+ * - @add ble.get.stats(): op counters, log-bucketed latency histograms (scan to first seen, connect, prepare, read, write)
+ *   and error counters by backend status. ble.resetStats() starts over
+ * 1.3.0
+ * - @add optional binary trace recorder: new BLEMaster({ trace: 512 }), ble.trace.records() / dump()
+ * - @add ble.on.* callbacks for read/write completion, arrived values and notifications
+ * - @fix a disconnect reported by the connect callback now marks the device as disconnected
+ * 1.2.0
+ * - @add leveled logger with lazy messages: BLEMaster.setLogLevel(LOG_LEVEL.DEBUG), default level is WARN
+ * - @add LOG_STRIP build-time switch to remove all logging
+ * - @rem debugLog and the hard-coded ENABLE_DEBUG_LOG
+ * - @fix startListener no longer throws a ReferenceError on return, profile build failures are logged
+ * 1.1.0
+ * - @add compact (struct-of-arrays) device registry: new BLEMaster({ registry: "compact" })
+ * - @add last_seen timestamp to the device records
+ * - @fix scanning a connected device no longer drops its connect_id and profile pointer
+ * 1.0.0
+ * - initial release
+ */
+
+/* BACKGROUND */
+
+/**
+ * Background scanning: ScanEngine runs in an app service and keeps scanning while the screen is off, pages keep a
+ * DeviceMirror that is brought up to date with the engine's batched diffs.
+ */
+
+const DEFAULT_BATCH_INTERVAL        = 1000;  // millis between two diffs
+const DEFAULT_MAX_BATCH             = 100;   // devices per diff, the rest waits for the next one
+const DEFAULT_TTL                   = 30000; // millis without an advert before a device is removed
+const DEFAULT_RSSI_DELTA            = 4;     // dBm, smaller RSSI changes are not worth a diff entry
+
+/**
+ * Scans, filters and keeps the device registry inside an app service, and hands out compact registry diffs.
+ * A diff is a plain JSON-safe object, post it to the page over whatever channel the app uses:
+ * { seq, time, full, upsert: [dev_addr, dev_name, rssi, age, vendor_id, vendor_data, service_uuid_array, service_data_array, ...], remove: [dev_addr, ...] }
+ * age is the number of millis between the device's last advert and diff.time. A full diff (snapshot()) replaces the page's list.
+ */
+class ScanEngine {
+    #registry;
+    #monitor;
+    #scanner;
+    #clock;
+    #deliver;
+    #filter;
+    #batch_interval;
+    #max_batch;
+    #ttl;
+    #rssi_delta;
+    #seq = 0;
+    #known = new Map();  // MAC > { rssi, vendor_data, last_seen }, the state the pages were last told about (or will be with the next diff)
+    #dirty = new Set();  // MACs to upsert with the next diff
+    #timer = null;
+    #running = false;
+    #abort = null;       // dispose of the start signal's listener
+
+    /**
+     * Creates a new scan engine.
+     * @param {Object} [options={}] - Optional parameters. registry, capacity, trace, transport and clock as for BLEMaster.
+     * @param {Function} [options.deliver] - Called with every diff, e.g. to post it to the page.
+     * @param {Function|Object} [options.filter] - Keeps only matching devices: a function called with each scan result, or
+     * { dev_name_prefix, service_uuid, vendor_id, min_rssi } (every given field must match).
+     * @param {number} [options.batch_interval=1000] - Millis between two diffs. Nothing is delivered while nothing changed.
+     * @param {number} [options.max_batch=100] - Devices per diff, the rest waits for the next one.
+     * @param {number} [options.ttl=30000] - Millis without an advert before a device is removed from the pages' list.
+     * @param {number} [options.rssi_delta=4] - RSSI changes below this many dBm do not put a device into the next diff.
+     */
+    constructor(options = {}) {
+        this.#clock = options.clock || SYSTEM_CLOCK;
+        this.#registry = createRegistry(options, this.#clock);
+        this.#monitor = createMonitor(options, this.#clock);
+        this.#scanner = new Scanner(options.transport || hmBle, this.#clock, this.#registry, this.#monitor);
+        this.#deliver = options.deliver || noop;
+        this.#filter = scanFilter(options.filter);
+        this.#batch_interval = options.batch_interval || DEFAULT_BATCH_INTERVAL;
+        this.#max_batch = options.max_batch || DEFAULT_MAX_BATCH;
+        this.#ttl = options.ttl || DEFAULT_TTL;
+        this.#rssi_delta = options.rssi_delta === undefined ? DEFAULT_RSSI_DELTA : options.rssi_delta;
+    }
+    /**
+     * @type {Get} The engine's own device registry.
+     */
+    get get() {
+        return new Get(this.#registry, this.#monitor);
+    }
+    /**
+     * @type {boolean} True between start() and stop().
+     */
+    get running() {
+        return this.#running;
+    }
+    /**
+     * Starts scanning and delivering diffs.
+     * @param {Object} [options={}] - { signal }, cancelling the token stops the engine.
+     * @returns {boolean} Returns true if the scan started, false if it failed or the engine is already running.
+     */
+    start(options = {}) {
+        if (this.#running) return false;
+        const signal = options.signal;
+        const success = this.#scanner.startScan((scan_result) => this.#seen(scan_result), { filter: this.#filter, signal });
+        if (!success) return false;
+        this.#running = true;
+        if (signal) {
+            const abort = () => this.stop();
+            signal.addEventListener("abort", abort);
+            this.#abort = () => signal.removeEventListener("abort", abort);
+        }
+        this.#schedule();
+        return true;
+    }
+    /**
+     * Stops scanning. Pending changes are delivered right away.
+     */
+    stop() {
+        if (!this.#running) return;
+        this.#running = false;
+        if (this.#abort) this.#abort();
+        this.#abort = null;
+        this.#scanner.stopScan();
+        this.#clock.clearTimeout(this.#timer);
+        this.#timer = null;
+        this.flush();
+    }
+    /**
+     * Delivers the pending changes now instead of at the end of the batch interval.
+     * @returns {Object|null} Returns the delivered diff, or null if nothing changed.
+     */
+    flush() {
+        const now = this.#clock.now();
+        const remove = [];
+        for (const [dev_addr, known] of this.#known) {
+            if (now - known.last_seen < this.#ttl) continue;
+            this.#known.delete(dev_addr);
+            this.#dirty.delete(dev_addr);
+            this.#registry.remove(dev_addr); // rotating MACs would grow the registry forever otherwise
+            remove.push(dev_addr);
+        }
+        const upsert = [];
+        for (const dev_addr of this.#dirty) {
+            if (upsert.length === this.#max_batch * DIFF_STRIDE) break;
+            this.#dirty.delete(dev_addr);
+            this.#pack(upsert, dev_addr, now);
+        }
+        if (!upsert.length && !remove.length) return null;
+        const diff = { seq: ++this.#seq, time: now, full: false, upsert, remove };
+        this.#deliver(diff);
+        return diff;
+    }
+    /**
+     * Builds a full diff of every device the engine currently keeps, for a page that just opened or missed a diff.
+     * It is returned, not delivered, and carries the seq of the last delivered diff.
+     * @returns {Object} Returns { seq, time, full: true, upsert, remove: [] }.
+     */
+    snapshot() {
+        const now = this.#clock.now();
+        const upsert = [];
+        for (const dev_addr of this.#known.keys()) this.#pack(upsert, dev_addr, now);
+        return { seq: this.#seq, time: now, full: true, upsert, remove: [] };
+    }
+    #seen(scan_result) { // decides whether the advert is news for the pages
+        const dev_addr = scan_result.dev_addr;
+        const now = this.#clock.now();
+        const known = this.#known.get(dev_addr);
+        if (known === undefined) {
+            this.#known.set(dev_addr, { rssi: scan_result.rssi, vendor_data: scan_result.vendor_data, last_seen: now });
+            this.#dirty.add(dev_addr);
+            return;
+        }
+        known.last_seen = now;
+        if (Math.abs(scan_result.rssi - known.rssi) >= this.#rssi_delta || scan_result.vendor_data !== known.vendor_data) {
+            known.rssi = scan_result.rssi;
+            known.vendor_data = scan_result.vendor_data;
+            this.#dirty.add(dev_addr);
+        }
+    }
+    #pack(upsert, dev_addr, now) {
+        const device = this.#registry.get(dev_addr);
+        if (!device) return;
+        upsert.push(dev_addr, device.dev_name, device.rssi, device.last_seen === undefined ? 0 : now - device.last_seen,
+            device.vendor_id, device.vendor_data, device.service_uuid_array, device.service_data_array);
+    }
+    #schedule() {
+        this.#timer = this.#clock.setTimeout(() => {
+            this.#timer = null;
+            if (!this.#running) return;
+            this.flush();
+            this.#schedule();
+        }, this.#batch_interval);
+    }
+}
+
+/**
+ * The page side of a ScanEngine: applies its diffs to a device list with the same shape as get.devices().
+ */
+class DeviceMirror {
+    #devices = {};
+    #size = 0;
+    #seq = 0;
+    #on_change;
+
+    /**
+     * @param {Function} [on_change] - Called after every applied diff with { added, updated, removed } MAC arrays.
+     */
+    constructor(on_change) {
+        this.#on_change = on_change;
+    }
+    /**
+     * @type {number} The number of devices in the list.
+     */
+    get size() {
+        return this.#size;
+    }
+    /**
+     * @type {number} The seq of the last applied diff, 0 before the first one.
+     */
+    get seq() {
+        return this.#seq;
+    }
+    /**
+     * Applies a diff from ScanEngine.
+     * @param {Object} diff - A diff delivered by the engine, or its snapshot().
+     * @returns {boolean} Returns false if a diff is missing in between (or the diff is stale), ask the engine for a snapshot() then.
+     */
+    apply(diff) {
+        if (!diff.full && diff.seq !== this.#seq + 1) {
+            if (diff.seq > this.#seq) logger.warn("eBLE: Missed a scan diff, expected", this.#seq + 1, "got", diff.seq);
+            return false;
+        }
+        const previous = diff.full ? this.#devices : null; // a snapshot replaces the list, known devices keep their objects
+        if (previous) {
+            this.#devices = {};
+            this.#size = 0;
+        }
+        const added = [], updated = [], removed = [];
+        for (let i = 0; i < diff.upsert.length; i += DIFF_STRIDE) {
+            const dev_addr = diff.upsert[i];
+            const known = previous ? previous[dev_addr] : this.#devices[dev_addr];
+            let device = this.#devices[dev_addr];
+            if (!device) {
+                device = this.#devices[dev_addr] = known || {};
+                this.#size++;
+            }
+            (known ? updated : added).push(dev_addr);
+            device.dev_name = diff.upsert[i + 1];
+            device.rssi = diff.upsert[i + 2];
+            device.last_seen = diff.time - diff.upsert[i + 3];
+            device.vendor_id = diff.upsert[i + 4];
+            device.vendor_data = diff.upsert[i + 5];
+            device.service_uuid_array = diff.upsert[i + 6];
+            device.service_data_array = diff.upsert[i + 7];
+        }
+        for (const dev_addr of diff.remove) {
+            if (!this.#devices[dev_addr]) continue;
+            delete this.#devices[dev_addr];
+            this.#size--;
+            removed.push(dev_addr);
+        }
+        if (previous) {
+            for (const dev_addr in previous) {
+                if (!this.#devices[dev_addr]) removed.push(dev_addr);
+            }
+        }
+        this.#seq = diff.seq;
+        if (this.#on_change) this.#on_change({ added, updated, removed });
+        return true;
+    }
+    /**
+     * Returns all devices, same shape as get.devices(). rssi and last_seen are as of the device's last diff entry,
+     * small RSSI changes are not sent. A device stays in the list until the engine removes it (ttl).
+     * @returns {Object} Returns the device list by MAC address.
+     */
+    devices() {
+        return this.#devices;
+    }
+    /**
+     * Checks if a device is in the list.
+     * @param {string} dev_addr - The MAC address of the device.
+     * @returns {boolean} Returns true if the device is in the list.
+     */
+    hasDevice(dev_addr) {
+        return typeof dev_addr === "string" && this.#devices.hasOwnProperty(dev_addr.toLowerCase());
+    }
+}
+
+/**
+ * Turns the filter option into a predicate over decoded scan results, or undefined for no filter.
+ */
+function scanFilter(filter) {
+    if (!filter || typeof filter === "function") return filter || undefined;
+    const { dev_name_prefix, service_uuid, vendor_id, min_rssi } = filter;
+    const uuid = service_uuid === undefined ? undefined : service_uuid.toUpperCase();
+    return (scan_result) =>
+        (min_rssi === undefined || scan_result.rssi >= min_rssi) &&
+        (vendor_id === undefined || scan_result.vendor_id === vendor_id) &&
+        (dev_name_prefix === undefined || (typeof scan_result.dev_name === "string" && scan_result.dev_name.startsWith(dev_name_prefix))) &&
+        (uuid === undefined || (Array.isArray(scan_result.service_uuid_array) &&
+            scan_result.service_uuid_array.some((candidate) => typeof candidate === "string" && candidate.toUpperCase() === uuid)));
+}
+
+/* SESSION */
+
+/**
+ * App-scoped session: one BLEMaster that outlives page navigation. Pages attach a handle with the BLEMaster API
+ * and detach it in onDestroy, connections and profiles stay with the session.
+ */
+
+const ON_CALLBACKS = ["charaReadComplete", "charaValueArrived", "charaWriteComplete", "descReadComplete", "descValueArrived", "descWriteComplete", "charaNotification"];
+
+class BLESession {
+    #ble;
+    #handles = new Map(); // handle > its ble.on callbacks
+    #shared;
+
+    /**
+     * Creates the session. Keep it in app.js globalData (or an app service) and close it in the app's onDestroy.
+     * @param {Object} [options={}] - BLEMaster options (registry, capacity, trace, watchdog, transport, clock, power, pool, known, admission).
+     */
+    constructor(options = {}) {
+        this.#ble = new BLEMaster(options);
+        this.#shared = {
+            clock: options.clock || SYSTEM_CLOCK,
+            connects: new Map(),    // MAC > Set of { handle, callback }, the pages waiting for or holding a connection
+            connecting: new Set(),  // MACs with a connect in flight
+            prepares: new Map(),    // MAC > Set of { handle, callback }, the pages waiting for a profile
+            tokens: new Map(),      // MAC > CancelToken of the session's connect and profile, cancelled once no page holds the device
+            scans: new Map(),       // handle > scan callback
+            scan: (scan_result) => {
+                for (const callback of Array.from(this.#shared.scans.values())) callback(scan_result);
+            },
+        };
+        for (const name of ON_CALLBACKS) {
+            this.#ble.on[name]((response) => {
+                for (const callbacks of this.#handles.values()) notify(callbacks[name], response);
+            });
+        }
+    }
+    /**
+     * @type {number} The number of attached handles.
+     */
+    get size() {
+        return this.#handles.size;
+    }
+    /**
+     * @type {Get} The session's device information getter.
+     */
+    get get() {
+        return this.#ble.get;
+    }
+    /**
+     * @type {PowerBudget|null} The session's power budget (options.power).
+     */
+    get power() {
+        return this.#ble.power;
+    }
+    /**
+     * @type {ConnectionPool|null} The session's connection pool (options.pool).
+     */
+    get pool() {
+        return this.#ble.pool;
+    }
+    /**
+     * @type {KnownDevices|null} The session's known-devices store (options.known).
+     */
+    get known() {
+        return this.#ble.known;
+    }
+    /**
+     * @type {ConnectScheduler|null} The session's connection admission queue (options.admission).
+     */
+    get admission() {
+        return this.#ble.admission;
+    }
+    /**
+     * Attaches a page.
+     * @returns {SessionHandle} Returns a handle with the BLEMaster API, detach it in the page's onDestroy.
+     */
+    attach() {
+        const callbacks = {};
+        const handle = new SessionHandle(this.#ble, this.#shared, callbacks, () => this.#handles.delete(handle));
+        this.#handles.set(handle, callbacks);
+        return handle;
+    }
+    /**
+     * Detaches every page, stops the scan and stops every connected device.
+     */
+    close() {
+        for (const handle of Array.from(this.#handles.keys())) handle.detach();
+        const devices = this.#ble.get.devices();
+        for (const dev_addr in devices) {
+            if (devices[dev_addr].is_connected) this.#ble.stop(dev_addr);
+        }
+        this.#shared.connects.clear();
+        this.#shared.connecting.clear();
+        this.#shared.prepares.clear();
+        this.#shared.tokens.clear();
+    }
+}
+
+/**
+ * A page's view of a BLESession. Same methods as BLEMaster, with these differences:
+ * - connect() to a device the session is already connected to calls back right away with { connected: 0, reused: true },
+ *   concurrent connects to the same device share one backend connect
+ * - startListener() for a device that already has a profile calls back with 0 without building it again
+ *   (the first profile object wins, stop(dev_addr) to rebuild), concurrent ones share one build
+ * - scans are shared: the backend scan runs while at least one handle scans, options.filter only filters this handle's callbacks
+ * - ble.on.* callbacks are per handle, every attached handle receives every response
+ * - options.signal only releases this page's hold: the connect or profile is abandoned (or the device stopped)
+ *   once no other page waits for or holds the device
+ * - nothing calls back into a detached handle
+ */
+class SessionHandle {
+    #ble;
+    #shared;
+    #release;
+    #attached = true;
+    #scan_dispose = noop;
+
+    /**
+     * @type {Write} A device writer.
+     */
+    write;
+
+    /**
+     * @type {Read} A device reader.
+     */
+    read;
+
+    /**
+     * @type {On} Read, write and notification callbacks of this handle.
+     */
+    on;
+
+    constructor(ble, shared, callbacks, release) {
+        this.#ble = ble;
+        this.#shared = shared;
+        this.#release = release;
+        this.write = ble.write;
+        this.read = ble.read;
+        this.on = new On(callbacks);
+    }
+    /**
+     * @type {boolean} True until detach().
+     */
+    get attached() {
+        return this.#attached;
+    }
+    /**
+     * @type {Get} A device information getter.
+     */
+    get get() {
+        return this.#ble.get;
+    }
+    /**
+     * @type {PowerBudget|null} The session's power budget.
+     */
+    get power() {
+        return this.#ble.power;
+    }
+    /**
+     * @type {ConnectionPool|null} The session's connection pool.
+     */
+    get pool() {
+        return this.#ble.pool;
+    }
+    /**
+     * @type {KnownDevices|null} The session's known-devices store.
+     */
+    get known() {
+        return this.#ble.known;
+    }
+    /**
+     * @type {ConnectScheduler|null} The session's connection admission queue.
+     */
+    get admission() {
+        return this.#ble.admission;
+    }
+    /**
+     * @type {TraceRecorder|null} The session's trace recorder.
+     */
+    get trace() {
+        return this.#ble.trace;
+    }
+    resetStats() {
+        this.#ble.resetStats();
+    }
+    /**
+     * Starts scanning for devices, see BLEMaster.startScan.
+     */
+    startScan(response_callback, options = {}) {
+        const signal = options.signal;
+        if (!this.#attached || (signal && signal.aborted)) return false;
+        if (options.connect) {
+            response_callback = connectOnSight(this, response_callback, options);
+            if (response_callback === null) return false;
+        }
+        const shared = this.#shared;
+        const filter = options.filter;
+        this.#scan_dispose();
+        shared.scans.set(this, filter ? (scan_result) => { if (filter(scan_result)) response_callback(scan_result); } : response_callback);
+        if (shared.scans.size === 1 && !this.#ble.startScan(shared.scan)) {
+            shared.scans.delete(this);
+            return false;
+        }
+        let duration_timer = null;
+        if (options.duration !== undefined) {
+            duration_timer = shared.clock.setTimeout(() => {
+                this.stopScan();
+                if (options.on_duration) options.on_duration();
+            }, options.duration);
+        }
+        const stop = () => this.stopScan();
+        if (signal) signal.addEventListener("abort", stop);
+        this.#scan_dispose = () => {
+            this.#scan_dispose = noop;
+            shared.clock.clearTimeout(duration_timer);
+            if (signal) signal.removeEventListener("abort", stop);
         };
-    
-        return modified_profile_object;
+        return true;
     }
     /**
-     * @warning [NOT IMPLEMENTED] Generates a generic profile object for a device.
-     * @param {string} dev_addr - The MAC address of the device.
-     * @returns {Object|null} Returns a generic profile object for the device, or null if the device was not found.
+     * Stops this handle's scan. The backend scan stops with the last scanning handle.
      */
-     generateProfileObject(dev_addr) {
-        const device = this.#devices[dev_addr];
-        if (!device) {
-            console.log("eBLE: Device not found:", dev_addr);
-            return { success: false, error: "Device not found: " + dev_addr };
+    stopScan() {
+        this.#scan_dispose();
+        const shared = this.#shared;
+        if (!shared.scans.delete(this) || shared.scans.size > 0) return true;
+        return this.#ble.stopScan();
+    }
+    /**
+     * Connects to a device, or joins the session's connection to it. See BLEMaster.connect.
+     */
+    connect(dev_addr, response_callback, options = {}) {
+        const mac = normalizeMac(dev_addr);
+        if (mac === null) return this.#ble.connect(dev_addr, response_callback, options); // rejected and logged there
+        const signal = options.signal;
+        if (!this.#attached || (signal && signal.aborted)) return false;
+        const shared = this.#shared;
+        const subscriber = { handle: this, callback: response_callback, dispose: noop };
+        let subscribers = shared.connects.get(mac);
+        if (this.#ble.get.isConnected(mac) || (subscribers && shared.connecting.has(mac))) {
+            if (!subscribers) shared.connects.set(mac, subscribers = new Set());
+            subscribers.add(subscriber);
+            this.#hold(mac, subscribers, subscriber, signal);
+            if (!shared.connecting.has(mac)) {
+                const connect_id = this.#ble.get.device(mac).connect_id;
+                shared.clock.setTimeout(() => {
+                    if (subscribers.has(subscriber)) response_callback({ dev_addr: mac, connected: CONNECT_STATUS_OK, connect_id, reused: true });
+                }, 0);
+            }
+            return true;
         }
-    
-        console.log(ERR_NOT_IMPLEMENTED);
-        return { success: false, error: ERR_NOT_IMPLEMENTED }; // exit point
-        // TODO: implementation (most devices don't have enough data to generate a profile from the scan, needs a generalized approach)
-        const profile_object = {
-            pair: true,
-            id: device.connect_id,
-            profile: device.dev_name,
-            dev: mac2ab(dev_addr),
-            len: 1,
-            list: []
-        };
-    
-        // add services
-        for (const service_uuid of device.service_uuid_array || []) { // empty arr if we have nothing + need to make sure we gen all 5 levels
-            const service = {
-                uuid: true,
-                size: 1,
-                len: 1,
-                list: []
-            };
-            profile_object.list.push(service);
-    
-            // add characteristics
-            for (const characteristic of device.characteristics || []) {
-                if (characteristic.service_uuid === service_uuid) {
-                    const characteristic_obj = {
-                        uuid: characteristic.uuid,
-                        permission: 0,
-                        desc: 1,
-                        len: 1,
-                        list: []
-                    };
-                    service.list.push(characteristic_obj);
-    
-                    // add descriptors
-                    for (const descriptor of characteristic.descriptors || []) {
-                        const descriptor_obj = {
-                            uuid: descriptor.uuid,
-                            permission: 0
-                        };
-                        characteristic_obj.list.push(descriptor_obj);
-                    }
-                }
+        subscribers = new Set([subscriber]);
+        shared.connects.set(mac, subscribers);
+        shared.connecting.add(mac);
+        const token = sessionToken(shared, mac);
+        this.#hold(mac, subscribers, subscriber, signal);
+        const success = this.#ble.connect(mac, (result) => {
+            shared.connecting.delete(mac);
+            const current = Array.from(subscribers);
+            if (result.connected !== CONNECT_STATUS_OK && shared.connects.get(mac) === subscribers) {
+                shared.connects.delete(mac);
+                for (const { dispose } of current) dispose();
+                if (!shared.prepares.has(mac) && shared.tokens.get(mac) === token) shared.tokens.delete(mac);
             }
+            for (const { callback } of current) callback(result);
+        }, { ...options, signal: token });
+        if (!success) {
+            subscriber.dispose();
+            shared.connecting.delete(mac);
+            shared.connects.delete(mac);
         }
+        return success;
     }
     /**
-     * Stops all interactions with a device.
-     * @param {string} dev_addr - The MAC address of the device.
+     * Builds a profile, or reuses the one the session already has for the device. See BLEMaster.startListener.
      */
-    stop(dev_addr) {
-        dev_addr = dev_addr.toLowerCase();
-        const device = this.#devices[dev_addr];
-        if (device && device.is_connected) {
-            hmBle.mstOffAllCb();
-            if (device.profile_idp !== undefined) {
-                hmBle.mstDestroyProfileInstance(device.profile_idp);
-            }
-            hmBle.mstDisconnect(device.connect_id);
-            device.is_connected = false;
+    startListener(profile_object, response_callback, options = {}) {
+        if (!this.#attached) return { success: false, error: ERR_DETACHED };
+        const dev = profile_object && profile_object.dev;
+        if (!(dev instanceof ArrayBuffer) || dev.byteLength !== MAC_BYTES) {
+            return this.#ble.startListener(profile_object, response_callback, options); // rejected and logged there
+        }
+        const signal = options.signal;
+        if (signal && signal.aborted) return { success: false, error: ERR_CANCELLED };
+        const shared = this.#shared;
+        const mac = ab2mac(dev);
+        const subscriber = { handle: this, callback: response_callback, dispose: noop };
+        const device = this.#ble.get.device(mac);
+        if (device && device.is_connected && device.profile_idp !== undefined) {
+            shared.clock.setTimeout(() => {
+                if (this.#attached && !(signal && signal.aborted)) response_callback(0);
+            }, 0);
+            return { success: true, error: null };
         }
+        let waiting = shared.prepares.get(mac);
+        if (waiting) {
+            waiting.add(subscriber);
+            this.#hold(mac, waiting, subscriber, signal);
+            return { success: true, error: null };
+        }
+        waiting = new Set([subscriber]);
+        shared.prepares.set(mac, waiting);
+        const token = sessionToken(shared, mac);
+        this.#hold(mac, waiting, subscriber, signal);
+        const result = this.#ble.startListener(profile_object, (status) => {
+            if (shared.prepares.get(mac) === waiting) shared.prepares.delete(mac);
+            const current = Array.from(waiting);
+            for (const { dispose } of current) dispose(); // the profile is built, the connect holds the device from here on
+            for (const { callback } of current) callback(status);
+        }, { ...options, signal: token });
+        if (!result.success) {
+            subscriber.dispose();
+            shared.prepares.delete(mac);
+        }
+        return result;
     }
-}
-
-class Write {
-    #getDevices;
-    
-    constructor(getDevices) {
-        this.#getDevices = getDevices;
+    /**
+     * Runs a scene on the session's connections, see BLEMaster.scene.
+     */
+    scene(commands, response_callback, options = {}) {
+        if (!this.#attached) return false;
+        return this.#ble.scene(commands, (report) => { if (this.#attached) response_callback(report); }, options);
+    }
+    disconnect(dev_addr) {
+        return this.#ble.disconnect(dev_addr);
+    }
+    pair(dev_addr) {
+        return this.#ble.pair(dev_addr);
+    }
+    modifyProfileObject(dev_addr, profile_object) {
+        return this.#ble.modifyProfileObject(dev_addr, profile_object);
+    }
+    generateProfileObject(dev_addr) {
+        return this.#ble.generateProfileObject(dev_addr);
     }
     /**
-     * Writes to a characteristic of a device.
-     * @param {string} dev_addr - The MAC address of the device.
-     * @param {string} uuid - The UUID of the characteristic to write to.
-     * @param {string|ArrayBuffer} data - The data to write to the characteristic.
-     * @returns {Object} Returns an object with a 'success' property indicating whether the write succeeded and an 'error' property containing an error message if the write failed.
+     * Stops the device for the whole session, every page loses it.
      */
-    characteristic(dev_addr, uuid, data) {
-        dev_addr = dev_addr.toLowerCase();
-        const device = this.#getDevices()[dev_addr];
-        if (!device || device.profile_idp === undefined) {
-            console.log(ERR_IDP_NOT_FOUND);
-            return { success: false, error: ERR_IDP_NOT_FOUND_SHORT }; // handle layering
+    stop(dev_addr) {
+        const mac = normalizeMac(dev_addr);
+        if (mac !== null) {
+            this.#shared.connects.delete(mac);
+            this.#shared.prepares.delete(mac);
+            this.#shared.tokens.delete(mac);
         }
-        const profile_idp = device.profile_idp;
-        const data_ab = data2ab(data);
-        const data_len = data_ab.byteLength;
-        const success = hmBle.mstWriteCharacteristic(profile_idp, uuid, data_ab, data_len);
-        return {
-            success,
-            error: success ? null : ERR_CHAR_WRITE_FAIL,
+        this.#ble.stop(dev_addr);
+    }
+    #hold(mac, subscribers, subscriber, signal) { // the page's token only drops the page's own subscription
+        if (!signal) return;
+        const token = this.#shared.tokens.get(mac);
+        const release = () => {
+            if (subscribers.delete(subscriber)) releaseDevice(this.#shared, mac, token);
         };
+        signal.addEventListener("abort", release);
+        subscriber.dispose = () => signal.removeEventListener("abort", release);
     }
     /**
-     * Writes to a descriptor of a characteristic of a device.
-     * @param {string} dev_addr - The MAC address of the device.
-     * @param {string} chara - The UUID of the characteristic that the descriptor belongs to.
-     * @param {string} desc - The UUID of the descriptor to write to.
-     * @param {string|ArrayBuffer} data - The data to write to the descriptor.
-     * @returns {Object} Returns an object with a 'success' property indicating whether the write succeeded and an 'error' property containing an error message if the write failed.
+     * Detaches the page: stops its scan and drops its pending callbacks. Connections and profiles stay with the session.
      */
-    descriptor(dev_addr, chara, desc, data) {
-        dev_addr = dev_addr.toLowerCase();
-        const device = this.#getDevices()[dev_addr];
-        if (!device || device.profile_idp === undefined) {
-            console.log(ERR_IDP_NOT_FOUND);
-            return { success: false, error: ERR_IDP_NOT_FOUND_SHORT };
+    detach() {
+        if (!this.#attached) return;
+        this.#attached = false;
+        this.stopScan();
+        for (const subscribers of [...this.#shared.connects.values(), ...this.#shared.prepares.values()]) {
+            for (const subscriber of subscribers) {
+                if (subscriber.handle !== this) continue;
+                subscribers.delete(subscriber);
+                subscriber.dispose();
+            }
         }
-        const profile_idp = device.profile_idp;
-        const data_ab = data2ab(data);
-        const data_len = data_ab.byteLength;
-        const success = hmBle.mstWriteDescriptor(profile_idp, chara, desc, data_ab, data_len);
-        return {
-            success,
-            error: success ? null : ERR_DESC_WRITE_FAIL,
-        };
+        this.#release();
     }
 }
 
-class Read {
-    #getDevices;
-    
-    constructor(getDevices) {
-        this.#getDevices = getDevices;
+function sessionToken(shared, mac) { // the token the session connects and builds profiles with
+    let token = shared.tokens.get(mac);
+    if (!token || token.aborted) shared.tokens.set(mac, token = new CancelToken());
+    return token;
+}
+
+function releaseDevice(shared, mac, token) { // once no page waits for or holds the device, the session lets go of it too
+    const connects = shared.connects.get(mac);
+    const prepares = shared.prepares.get(mac);
+    if ((connects && connects.size > 0) || (prepares && prepares.size > 0) || shared.tokens.get(mac) !== token) return;
+    shared.connects.delete(mac);
+    shared.connecting.delete(mac);
+    shared.prepares.delete(mac);
+    shared.tokens.delete(mac);
+    if (token) token.cancel(); // abandons a pending connect or profile, stops a device the session connected
+}
+
+/* WIRE */
+
+/**
+ * Wire format between an app service and its pages: ScanEngine diffs and characteristic readings packed into one frame.
+ * Binary frames (ArrayBuffer) carry MACs as 6 bytes, hex payloads as bytes and numbers as varints, names and UUIDs are
+ * interned per frame. JSON frames (string) are the fallback for channels that only carry text. decodeFrame takes both.
+ */
+
+const WIRE_FORMAT = {
+    BINARY: "binary",
+    JSON: "json",
+};
+
+const WIRE_VERSION                  = 1;
+const WIRE_DIFF                     = 1;
+const WIRE_READING                  = 2;
+const WIRE_INITIAL_BYTES            = 4096;
+const DEFAULT_FLUSH_INTERVAL        = 1000; // millis a message waits in a WireBatch at most
+const DEFAULT_MAX_MESSAGES          = 32;   // messages per frame, a full batch is sent right away
+
+/**
+ * Packs messages into one frame.
+ * Binary layout: version, varint count, zigzag base time, then per message its kind and fields:
+ * - diff: varint seq, time - base, full, varint upserts, per device mac, name, rssi, age, vendor_id, vendor_data,
+ *   service_uuid_array, service_data_array ({ uuid, service_data } only), varint removes, macs
+ * - reading: mac, uuid, time - base, varint length, bytes
+ * @param {Array<Object>} messages - ScanEngine diffs and readings { dev_addr, uuid, time, data }, data an ArrayBuffer,
+ * typed array or DataView. A message with an upsert array is a diff, anything else a reading. seq and time are
+ * non-negative integers (millis), a reading without time gets 0 in both formats.
+ * @param {string} [format=WIRE_FORMAT.BINARY] - WIRE_FORMAT.BINARY or WIRE_FORMAT.JSON.
+ * @returns {ArrayBuffer|string|null} Returns the frame, or null if a message is malformed (logged).
+ */
+function encodeFrame(messages, format = WIRE_FORMAT.BINARY) {
+    try {
+        if (!Array.isArray(messages)) throw new Error(ERR_WIRE_MESSAGE);
+        return format === WIRE_FORMAT.JSON ? encodeJson(messages) : encodeBinary(messages);
+    } catch (error) {
+        logger.error(error.message);
+        return null;
+    }
+}
+
+/**
+ * Unpacks a frame from encodeFrame.
+ * @param {ArrayBuffer|Uint8Array|string} frame - A binary or a JSON frame.
+ * @returns {Array<Object>|null} Returns the messages in order (readings with data as an ArrayBuffer), or null if the frame is malformed (logged).
+ */
+function decodeFrame(frame) {
+    try {
+        if (typeof frame === "string") return decodeJson(frame);
+        if (frame instanceof ArrayBuffer) return decodeBinary(new Uint8Array(frame));
+        if (frame instanceof Uint8Array) return decodeBinary(frame);
+        throw new Error(ERR_WIRE_FRAME);
+    } catch (error) {
+        logger.warn(ERR_WIRE_FRAME + ":", error.message);
+        return null;
     }
+}
+
+/**
+ * Collects messages in the service and delivers them as one frame per flush interval, or as soon as max_messages are queued.
+ * Reading data is encoded at flush time, do not modify it in between.
+ */
+class WireBatch {
+    #deliver;
+    #format;
+    #interval;
+    #max_messages;
+    #clock;
+    #queue = [];
+    #timer = null;
+
     /**
-     * Reads from a characteristic of a device.
-     * @param {string} dev_addr - The MAC address of the device.
-     * @param {string} uuid - The UUID of the characteristic to read from.
-     * @returns {Object} Returns an object with a 'success' property indicating whether the read succeeded and an 'error' property containing an error message if the read failed.
+     * @param {Object} [options={}]
+     * @param {Function} [options.deliver] - Called with every frame, e.g. to post it to the page.
+     * @param {string} [options.format=WIRE_FORMAT.BINARY] - WIRE_FORMAT.BINARY or WIRE_FORMAT.JSON.
+     * @param {number} [options.interval=1000] - Millis the first queued message waits for company.
+     * @param {number} [options.max_messages=32] - Messages per frame.
+     * @param {Object} [options.clock] - { now, setTimeout, clearTimeout }, defaults to the system timers.
      */
-    characteristic(dev_addr, uuid) {
-        dev_addr = dev_addr.toLowerCase();
-        const device = this.#getDevices()[dev_addr];
-        if (!device || device.profile_idp === undefined) {
-            console.log(ERR_IDP_NOT_FOUND);
-            return { success: false, error: ERR_IDP_NOT_FOUND_SHORT };
-        }
-        const profile_idp = device.profile_idp;
-        const success = hmBle.mstReadCharacteristic(profile_idp, uuid);
-        return {
-            success,
-            error: success ? null : ERR_CHAR_READ_FAIL,
-        };
+    constructor(options = {}) {
+        this.#deliver = options.deliver || noop;
+        this.#format = options.format || WIRE_FORMAT.BINARY;
+        this.#interval = options.interval || DEFAULT_FLUSH_INTERVAL;
+        this.#max_messages = options.max_messages || DEFAULT_MAX_MESSAGES;
+        this.#clock = options.clock || SYSTEM_CLOCK;
     }
     /**
-     * Reads from a descriptor of a characteristic of a device.
-     * @param {string} dev_addr - The MAC address of the device.
-     * @param {string} uuid - The UUID of the characteristic that the descriptor belongs to.
-     * @param {string} desc - The UUID of the descriptor to read from.
-     * @returns {Object} Returns an object with a 'success' property indicating whether the read succeeded and an 'error' property containing an error message if the read failed.
+     * @type {number} The number of queued messages.
      */
-    descriptor(dev_addr, uuid, desc) {
-        dev_addr = dev_addr.toLowerCase();
-        const device = this.#getDevices()[dev_addr];
-        if (!device || device.profile_idp === undefined) {
-            console.log(ERR_IDP_NOT_FOUND);
-            return { success: false, error: ERR_IDP_NOT_FOUND_SHORT };
+    get size() {
+        return this.#queue.length;
+    }
+    /**
+     * Queues a message, see encodeFrame. A malformed message is rejected here, so it cannot spoil the frame of the others.
+     * @returns {boolean} Returns true if the message was queued, false if it is malformed (logged).
+     */
+    push(message) {
+        if (!isWireMessage(message)) {
+            logger.error(ERR_WIRE_MESSAGE);
+            return false;
         }
-        const profile_idp = device.profile_idp;
-        const success = hmBle.mstReadDescriptor(profile_idp, uuid, desc);
-        return {
-            success,
-            error: success ? null : ERR_DESC_READ_FAIL,
-        };
+        this.#queue.push(message);
+        if (this.#queue.length >= this.#max_messages) {
+            this.flush();
+        } else if (this.#timer === null) {
+            this.#timer = this.#clock.setTimeout(() => {
+                this.#timer = null;
+                this.flush();
+            }, this.#interval);
+        }
+        return true;
+    }
+    /**
+     * Delivers the queued messages now.
+     * @returns {ArrayBuffer|string|null} Returns the delivered frame, or null if nothing was queued or a queued message
+     * was modified into a malformed one since push().
+     */
+    flush() {
+        this.#clock.clearTimeout(this.#timer);
+        this.#timer = null;
+        if (!this.#queue.length) return null;
+        const frame = encodeFrame(this.#queue, this.#format);
+        this.#queue = [];
+        if (frame !== null) this.#deliver(frame);
+        return frame;
     }
 }
 
-class Get {
-    #getDevices;
-    constructor(getDevices) {
-        this.#getDevices = getDevices;
+/* BINARY */
+
+class WireWriter {
+    #bytes = new Uint8Array(WIRE_INITIAL_BYTES);
+    #length = 0;
+    #strings = new Map(); // string > index, per frame
+
+    begin() {
+        this.#length = 0;
+        this.#strings.clear();
     }
-    /**
-     * Returns all devices.
-     * @returns {Object} Returns an object containing information about all devices.
-     */
-    devices() {
-        return this.#getDevices();
+    end() {
+        return this.#bytes.slice(0, this.#length).buffer;
+    }
+    byte(value) {
+        this.#reserve(1);
+        this.#bytes[this.#length++] = value;
+    }
+    varint(value) { // unsigned LEB128, safe up to 2^53
+        if (value < 0x80 && value >= 0 && this.#length < this.#bytes.length) { // most lengths, indexes and rssi
+            this.#bytes[this.#length++] = value;
+            return;
+        }
+        this.#reserve(8);
+        while (value >= 0x80) {
+            this.#bytes[this.#length++] = (value % 0x80) | 0x80;
+            value = Math.floor(value / 0x80);
+        }
+        this.#bytes[this.#length++] = value;
+    }
+    int(value) { // zigzag, small negatives (rssi) stay one byte
+        if (typeof value !== "number" || !Number.isFinite(value)) value = 0;
+        this.varint(value < 0 ? -value * 2 - 1 : value * 2);
+    }
+    optionalInt(value) { // 0 = undefined
+        if (typeof value !== "number" || !Number.isFinite(value)) return this.varint(0);
+        this.varint((value < 0 ? -value * 2 - 1 : value * 2) + 1);
+    }
+    mac(mac) {
+        if (!isMac(mac)) throw new Error(ERR_WIRE_MESSAGE);
+        this.#reserve(MAC_BYTES);
+        for (let i = 0; i < MAC_BYTES; i++) {
+            this.#bytes[this.#length++] = hexValue(mac.charCodeAt(i * 3)) * 16 + hexValue(mac.charCodeAt(i * 3 + 1));
+        }
     }
     /**
-     * Checks if a device is connected.
-     * @param {string} dev_addr - The MAC address of the device.
-     * @returns {boolean} Returns true if the device is connected, false otherwise.
+     * Interned strings: 0 = undefined, 1 = new string (varint length, varint char codes), n = the (n - 2)th string of the frame.
      */
-    isConnected(dev_addr){
-        dev_addr = dev_addr.toLowerCase();
-        const device = this.#getDevices()[dev_addr];
-        return device && device.is_connected;
+    str(value) {
+        if (typeof value !== "string") return this.varint(0);
+        const index = this.#strings.get(value);
+        if (index !== undefined) return this.varint(index + 2);
+        this.#strings.set(value, this.#strings.size);
+        this.varint(1);
+        this.#chars(value);
+    }
+    strs(values) { // 0 = not an array, n + 1 = n strings
+        if (!Array.isArray(values)) return this.varint(0);
+        this.varint(values.length + 1);
+        for (let i = 0; i < values.length; i++) this.str(values[i]);
     }
     /**
-     * Checks if a device exists.
-     * @param {string} dev_addr - The MAC address of the device.
-     * @returns {boolean} Returns true if the device exists, false otherwise.
+     * Decoded payloads (ab2str_stripped output): 0 = undefined, 2n + 1 = n bytes of lowercase hex, 2n + 2 = n chars of anything else.
      */
-    hasDevice(dev_addr) {
-        return this.#getDevices().hasOwnProperty(dev_addr.toLowerCase());
+    hex(value) {
+        if (typeof value !== "string") return this.varint(0);
+        if (!isLowerHex(value)) {
+            this.varint(value.length * 2 + 2);
+            for (let i = 0; i < value.length; i++) this.varint(value.charCodeAt(i));
+            return;
+        }
+        const count = value.length / 2;
+        this.varint(count * 2 + 1);
+        this.#reserve(count);
+        for (let i = 0; i < count; i++) {
+            this.#bytes[this.#length++] = hexValue(value.charCodeAt(i * 2)) * 16 + hexValue(value.charCodeAt(i * 2 + 1));
+        }
+    }
+    bytes(data) {
+        const buffer = typeof data === "string" ? null : data2ab(data);
+        if (buffer === null) throw new Error(ERR_WIRE_MESSAGE);
+        this.varint(buffer.byteLength);
+        this.#reserve(buffer.byteLength);
+        this.#bytes.set(new Uint8Array(buffer), this.#length);
+        this.#length += buffer.byteLength;
+    }
+    #chars(value) {
+        this.varint(value.length);
+        this.#reserve(value.length);
+        for (let i = 0; i < value.length; i++) {
+            const c = value.charCodeAt(i);
+            if (c < 0x80) this.#bytes[this.#length++] = c;
+            else this.varint(c);
+        }
+    }
+    #reserve(count) {
+        if (this.#length + count <= this.#bytes.length) return;
+        const grown = new Uint8Array(Math.max(this.#bytes.length * 2, this.#length + count));
+        grown.set(this.#bytes.subarray(0, this.#length));
+        this.#bytes = grown;
     }
 }
 
-/* HELPERS */
+class WireReader {
+    #bytes;
+    #offset = 0;
+    #strings = [];
 
-function str2ab_with_len(str){
-    const data_arr = str.split('').map(char => char.charCodeAt(0));
-    return { data_ab: new Uint8Array(data_arr).buffer, data_len: data_arr.length };
+    constructor(bytes) {
+        this.#bytes = bytes;
+    }
+    get done() {
+        return this.#offset >= this.#bytes.length;
+    }
+    byte() {
+        if (this.#offset >= this.#bytes.length) throw new Error("truncated");
+        return this.#bytes[this.#offset++];
+    }
+    varint() {
+        let value = 0, scale = 1, byte;
+        do {
+            if (scale > 2 ** 49) throw new Error("varint too long");
+            byte = this.byte();
+            value += (byte & 0x7F) * scale;
+            scale *= 0x80;
+        } while (byte & 0x80);
+        return value;
+    }
+    int() {
+        const value = this.varint();
+        return value % 2 ? -(value + 1) / 2 : value / 2;
+    }
+    optionalInt() {
+        const value = this.varint();
+        if (value === 0) return undefined;
+        return (value - 1) % 2 ? -value / 2 : (value - 1) / 2;
+    }
+    count() { // a length that must fit into the rest of the frame, so garbage cannot allocate huge arrays
+        const value = this.varint();
+        if (value > this.#bytes.length - this.#offset) throw new Error("length beyond the end of the frame");
+        return value;
+    }
+    mac() {
+        this.#need(MAC_BYTES);
+        const mac = bytes2mac(this.#bytes, this.#offset);
+        this.#offset += MAC_BYTES;
+        return mac;
+    }
+    str() {
+        const tag = this.varint();
+        if (tag === 0) return undefined;
+        if (tag > 1) {
+            if (tag - 2 >= this.#strings.length) throw new Error("unknown string");
+            return this.#strings[tag - 2];
+        }
+        const value = this.#chars(this.count());
+        this.#strings.push(value);
+        return value;
+    }
+    strs() {
+        const tag = this.count();
+        if (tag === 0) return undefined;
+        const values = new Array(tag - 1);
+        for (let i = 0; i < values.length; i++) values[i] = this.str();
+        return values;
+    }
+    hex() {
+        const tag = this.varint();
+        if (tag === 0) return undefined;
+        if (tag % 2 === 0) return this.#chars((tag - 2) / 2);
+        const count = (tag - 1) / 2;
+        this.#need(count);
+        this.#offset += count;
+        return bytes2hex(this.#bytes, this.#offset - count, this.#offset);
+    }
+    bytes() {
+        const count = this.count();
+        this.#offset += count;
+        return this.#bytes.slice(this.#offset - count, this.#offset).buffer;
+    }
+    #chars(count) {
+        if (count > this.#bytes.length - this.#offset) throw new Error("length beyond the end of the frame");
+        wire_chars.length = count;
+        for (let i = 0; i < count; i++) {
+            const c = this.#bytes[this.#offset];
+            if (c < 0x80) {
+                wire_chars[i] = c;
+                this.#offset++;
+            } else {
+                wire_chars[i] = this.varint();
+            }
+        }
+        return String.fromCharCode.apply(null, wire_chars);
+    }
+    #need(count) {
+        if (this.#offset + count > this.#bytes.length) throw new Error("truncated");
+    }
 }
 
-function ab2mac(ab) {
-    const bytes = new Uint8Array(ab);
-    const mac = Array.from(bytes).map(byte => byte.toString(16).padStart(2, '0')).join(':');
-    return mac;
-}
+const wire_writer = new WireWriter(); // shared, every frame is sliced out of it
+const wire_chars = []; // char code scratch of WireReader, strings are short (names, UUIDs)
 
-function mac2ab(mac) {
-    const bytes = mac.split(':').map(byte => parseInt(byte, 16));
-    const ab = new Uint8Array(bytes).buffer;
-    return ab;
+function encodeBinary(messages) {
+    const w = wire_writer;
+    w.begin();
+    w.byte(WIRE_VERSION);
+    w.varint(messages.length);
+    const base = messages.length ? messageTime(messages[0]) : 0;
+    w.int(base);
+    for (const message of messages) {
+        if (!message || typeof message !== "object") throw new Error(ERR_WIRE_MESSAGE);
+        if (Array.isArray(message.upsert)) {
+            const { upsert, remove } = message;
+            if (upsert.length % DIFF_STRIDE || !Array.isArray(remove) || !isWireCount(message.seq) || !isWireCount(message.time)) {
+                throw new Error(ERR_WIRE_MESSAGE);
+            }
+            w.byte(WIRE_DIFF);
+            w.varint(message.seq);
+            w.int(messageTime(message) - base);
+            w.byte(message.full ? 1 : 0);
+            w.varint(upsert.length / DIFF_STRIDE);
+            for (let i = 0; i < upsert.length; i += DIFF_STRIDE) {
+                w.mac(upsert[i]);
+                w.str(upsert[i + 1]);
+                w.int(upsert[i + 2]);
+                w.int(upsert[i + 3]);
+                w.optionalInt(upsert[i + 4]);
+                w.hex(upsert[i + 5]);
+                w.strs(upsert[i + 6]);
+                const service_data_array = upsert[i + 7];
+                if (!Array.isArray(service_data_array)) {
+                    w.varint(0);
+                    continue;
+                }
+                w.varint(service_data_array.length + 1);
+                for (const service of service_data_array) {
+                    w.str(service && service.uuid);
+                    w.hex(service && service.service_data);
+                }
+            }
+            w.varint(remove.length);
+            for (const dev_addr of remove) w.mac(dev_addr);
+        } else {
+            if (typeof message.uuid !== "string" || !isReadingTime(message.time)) throw new Error(ERR_WIRE_MESSAGE);
+            w.byte(WIRE_READING);
+            w.mac(message.dev_addr);
+            w.str(message.uuid);
+            w.int(messageTime(message) - base);
+            w.bytes(message.data);
+        }
+    }
+    return w.end();
 }
 
-function ab2str_stripped(buffer) { // strip unicode
-    return Array.prototype.map.call(new Uint8Array(buffer), u => ('00' + u.toString(16)).slice(-2)).join('');
+function decodeBinary(bytes) {
+    const r = new WireReader(bytes);
+    const version = r.byte();
+    if (version !== WIRE_VERSION) throw new Error("unsupported version " + version);
+    const messages = new Array(r.count());
+    const base = r.int();
+    for (let m = 0; m < messages.length; m++) {
+        const kind = r.byte();
+        if (kind === WIRE_DIFF) {
+            const seq = r.varint();
+            const time = base + r.int();
+            const full = r.byte() === 1;
+            const upsert = new Array(r.count() * DIFF_STRIDE);
+            for (let i = 0; i < upsert.length; i += DIFF_STRIDE) {
+                upsert[i] = r.mac();
+                upsert[i + 1] = r.str();
+                upsert[i + 2] = r.int();
+                upsert[i + 3] = r.int();
+                upsert[i + 4] = r.optionalInt();
+                upsert[i + 5] = r.hex();
+                upsert[i + 6] = r.strs();
+                const tag = r.count();
+                const service_data_array = tag === 0 ? undefined : new Array(tag - 1);
+                for (let s = 0; s < tag - 1; s++) service_data_array[s] = { uuid: r.str(), service_data: r.hex() };
+                upsert[i + 7] = service_data_array;
+            }
+            const remove = new Array(r.count());
+            for (let i = 0; i < remove.length; i++) remove[i] = r.mac();
+            messages[m] = { seq, time, full, upsert, remove };
+        } else if (kind === WIRE_READING) {
+            const dev_addr = r.mac();
+            const uuid = r.str();
+            const time = base + r.int();
+            messages[m] = { dev_addr, uuid, time, data: r.bytes() };
+        } else {
+            throw new Error("unknown message kind " + kind);
+        }
+    }
+    if (!r.done) throw new Error("trailing bytes");
+    return messages;
 }
 
-function debugLog(...params) {
-    if (ENABLE_DEBUG_LOG) {
-        console.log("eBLE:", ...params);
+/* JSON */
+
+function encodeJson(messages) {
+    const out = new Array(messages.length);
+    for (let i = 0; i < messages.length; i++) {
+        const message = messages[i];
+        if (!message || typeof message !== "object") throw new Error(ERR_WIRE_MESSAGE);
+        if (Array.isArray(message.upsert)) {
+            if (!isWireDiff(message)) throw new Error(ERR_WIRE_MESSAGE);
+            out[i] = message;
+            continue;
+        }
+        const data = typeof message.data === "string" ? null : data2ab(message.data);
+        if (!isMac(message.dev_addr) || typeof message.uuid !== "string" || !isReadingTime(message.time) || data === null) {
+            throw new Error(ERR_WIRE_MESSAGE);
+        }
+        out[i] = { dev_addr: message.dev_addr.toLowerCase(), uuid: message.uuid, time: messageTime(message), data: ab2str_stripped(data) };
     }
+    return JSON.stringify({ v: WIRE_VERSION, m: out });
 }
 
-function data2ab(data) {
-    if (data instanceof ArrayBuffer) {
-        return data;
-    } else if (typeof data === "string") {
-        if (/^[0-9A-Fa-f]+$/.test(data)) { // hex string
-            return new Uint8Array(data.match(/.{1,2}/g).map(byte => parseInt(byte, 16))).buffer;
-        } else { // normal string
-            return str2ab_with_len(data).data_ab;
-        }
+function decodeJson(text) {
+    const frame = JSON.parse(text);
+    if (!frame || frame.v !== WIRE_VERSION || !Array.isArray(frame.m)) throw new Error("not a wire frame");
+    for (const message of frame.m) {
+        if (!message || typeof message !== "object") throw new Error("not a message");
+        if (Array.isArray(message.upsert)) continue;
+        if (typeof message.data !== "string" || !isLowerHex(message.data)) throw new Error("reading data is not hex");
+        message.data = data2ab(message.data);
     }
+    return frame.m;
 }
 
-export default BLEMaster;
+function isWireMessage(message) { // what both encoders check on the way
+    if (!message || typeof message !== "object") return false;
+    if (Array.isArray(message.upsert)) return isWireDiff(message);
+    return isMac(message.dev_addr) && typeof message.uuid === "string" && isReadingTime(message.time) &&
+        typeof message.data !== "string" && data2ab(message.data) !== null;
+}
 
-/**
- * @changelog
- * 1.0.0
- * - initial release
- */
+function isWireDiff(diff) { // what encodeBinary checks on the way
+    const { upsert, remove } = diff;
+    if (upsert.length % DIFF_STRIDE || !Array.isArray(remove) || !isWireCount(diff.seq) || !isWireCount(diff.time)) return false;
+    for (let i = 0; i < upsert.length; i += DIFF_STRIDE) if (!isMac(upsert[i])) return false;
+    for (let i = 0; i < remove.length; i++) if (!isMac(remove[i])) return false;
+    return true;
+}
+
+function isWireCount(value) { // seq and time: what a varint carries and JSON gives back unchanged
+    return Number.isSafeInteger(value) && value >= 0;
+}
+
+function isReadingTime(value) {
+    return value === undefined || isWireCount(value);
+}
+
+function messageTime(message) { // after the checks above: an integer or missing
+    return message.time === undefined ? 0 : message.time;
+}
+
+function isLowerHex(value) {
+    if (value.length % 2) return false;
+    for (let i = 0; i < value.length; i++) {
+        const c = value.charCodeAt(i);
+        if (!((c >= 48 && c <= 57) || (c >= 97 && c <= 102))) return false;
+    }
+    return true;
+}
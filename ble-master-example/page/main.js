@@ -3,8 +3,8 @@ import { setPageBrightTime } from '@zos/display'
 import VisLog from '../libs/vis-log';
 const vis = new VisLog("main.js");
 
-import BLEMaster from '../libs/ble-master'
-const ble = new BLEMaster();
+// a handle to the app's BLE session (see app.js), attached in build() and detached in onDestroy()
+let ble = null;
 
 // insert your MACs here
 const LAMP_MAC = "a1:a2:a3:a4:a5:a6";
@@ -77,8 +77,9 @@ class MainPage {
         });
     }
     stop(){
-        vis.log("BLE: Stop & Destroy");
-        ble.stop(MAC);
+        // the session keeps the connection for the next visit, call ble.stop(MAC) to drop it
+        vis.log("BLE: Detach");
+        ble.detach();
     }
 }
 
@@ -87,6 +88,8 @@ Page({
     build() {
         setPageBrightTime({ brightTime: 60000 }) // don't turn off the screen for a minute
 
+        ble = getApp()._options.globalData.ble.attach();
+
         this.mainPage = new MainPage();
         this.mainPage.init();
     },
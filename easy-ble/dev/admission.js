@@ -0,0 +1,115 @@
+/** @about Connection admission scenario: connecting a room of lamps with every connect at once, one at a time and options.admission.
+ * Usage (from easy-ble/):
+ *   npm run admission                           12 lamps, a backend that works on 2 connects at once, 10 seeds
+ *   npm run admission -- --lamps=20 --slots=3 --concurrency=3 --runs=20
+ *   npm run admission -- --json                 summary as JSON, for scripts
+ * The lamps sit at different distances: the far ones (RSSI below -85) answer slowly and fail 40% of their connects,
+ * the middle ones 10%. The backend fails every connect issued while `slots` are in flight (connect_slots in the simulator).
+ * Every strategy retries a failed connect up to twice. All of them scan for two seconds first, so the RSSIs are known.
+ * mean ms is the mean time until a lamp is connected, ready/s the lamps connected per second until the last one.
+ * Exits with 1 if admission overloads a backend it fits in, connects fewer lamps than firing every connect at once, or
+ * is not faster than one connect at a time.
+ */
+import BLEMaster from '../ble-master.js';
+import { BLESimulator, createRandom } from './ble-sim.js';
+import { parseArgs, row, lampMacs, lampPeripheral, mean, claim, verdict } from './common.js';
+
+const args = parseArgs();
+const LAMPS = Number(args.lamps || 12);
+const SLOTS = Number(args.slots || 2);
+const CONCURRENCY = Number(args.concurrency || SLOTS);
+const RUNS = Number(args.runs || 10);
+const RETRIES = 2;
+const TIMEOUT = 120000;
+
+function room(seed) {
+    const random = createRandom(seed);
+    return lampMacs(LAMPS).map((mac, i) => {
+        const rssi = -50 - Math.round(random() * 45);
+        const far = rssi < -85, middle = rssi < -70;
+        return lampPeripheral(mac, i, {
+            rssi,
+            latency: { connect: far ? [1200, 2500] : middle ? [600, 1200] : [300, 600] },
+            faults: { connect_failure: far ? 0.4 : middle ? 0.1 : 0 },
+        });
+    });
+}
+
+function run(strategy, seed) {
+    const peripherals = room(seed);
+    const sim = new BLESimulator({ seed, connect_slots: SLOTS, peripherals });
+    const options = { transport: sim, clock: sim.clock, watchdog: false };
+    if (strategy.startsWith("admission")) options.admission = { concurrency: CONCURRENCY, retries: RETRIES, order: strategy === "admission fifo" ? "fifo" : "rssi" };
+    const ble = new BLEMaster(options);
+    ble.startScan(() => {});
+    sim.clock.advance(2000);
+    ble.stopScan();
+
+    const start = sim.clock.now();
+    const ready = [];
+    let settled = 0;
+    const macs = peripherals.map((p) => p.mac);
+    const connect = (mac, attempt, done) => ble.connect(mac, (result) => {
+        if (result.connected === 2) return;
+        if (result.connected === 0) ready.push(sim.clock.now() - start);
+        if (result.connected === 1 && attempt < RETRIES && !options.admission) return connect(mac, attempt + 1, done);
+        settled++;
+        if (done) done();
+    });
+    if (strategy === "serial") {
+        const next = (i) => { if (i < macs.length) connect(macs[i], 0, () => next(i + 1)); };
+        next(0);
+    } else {
+        for (const mac of macs) connect(mac, 0); // "burst" and admission: every connect right away, admission queues them
+    }
+    while (settled < macs.length && sim.clock.now() - start < TIMEOUT) sim.clock.advance(10);
+    ready.sort((a, b) => a - b);
+    return {
+        ready: ready.length,
+        mean: ready.length ? mean(ready) : 0,
+        half: ready.length >= LAMPS / 2 ? ready[Math.ceil(LAMPS / 2) - 1] : -1,
+        last: ready.length ? ready[ready.length - 1] : -1,
+        connects: sim.calls.mstConnect || 0,
+        overload: sim.injected.connect_overload || 0,
+    };
+}
+
+const results = [];
+for (const strategy of ["burst", "serial", "admission", "admission fifo"]) {
+    const runs = [];
+    for (let seed = 1; seed <= RUNS; seed++) runs.push(run(strategy, seed));
+    const average = (key) => mean(runs.map((r) => r[key]));
+    const halves = runs.filter((r) => r.half >= 0);
+    results.push({
+        strategy,
+        ready: average("ready"),
+        mean_ms: Math.round(average("mean")),
+        half_ms: halves.length ? Math.round(mean(halves.map((r) => r.half))) : -1,
+        last_ms: Math.round(average("last")),
+        per_sec: mean(runs.map((r) => r.last > 0 ? r.ready / (r.last / 1000) : 0)),
+        connects: average("connects"),
+        overload: average("overload"),
+    });
+}
+
+const [burst, serial, ...admitted] = results;
+const claims = [];
+for (const r of admitted) {
+    if (CONCURRENCY <= SLOTS) claims.push(claim(`${r.strategy}: no connect overloads the backend`, r.overload === 0));
+    claims.push(
+        claim(`${r.strategy}: connects more lamps than every connect at once`, r.ready > burst.ready),
+        claim(`${r.strategy}: lamps are connected sooner than one at a time`, r.mean_ms < serial.mean_ms),
+    );
+}
+
+const WIDTHS = [16, 7, 9, 9, 9, 9, 10];
+if (args.json) {
+    console.log(JSON.stringify({ lamps: LAMPS, slots: SLOTS, concurrency: CONCURRENCY, runs: RUNS, results, claims }, null, 2));
+} else {
+    console.log(`${LAMPS} lamps, backend with ${SLOTS} connect slots, admission concurrency ${CONCURRENCY}, means over ${RUNS} rooms`);
+    console.log(row(WIDTHS, ["strategy", "ready", "mean ms", "half ms", "last ms", "ready/s", "connects", "overloaded"]));
+    for (const r of results) {
+        console.log(row(WIDTHS, [r.strategy, r.ready.toFixed(1), r.mean_ms, r.half_ms, r.last_ms, r.per_sec.toFixed(2), r.connects.toFixed(1), r.overload.toFixed(1)]));
+    }
+}
+verdict(claims, args.json);
@@ -0,0 +1,269 @@
+/** @about Microbenchmarks for the codec helpers and the scan callback path, and the heap each registry retains per scanned
+ * device, checked against stored baselines.
+ * Usage (from easy-ble/):
+ *   npm run bench                          compare with dev/bench-baseline.json, exit code 1 on a regression
+ *   npm run bench -- --update              store the current numbers as the new baseline
+ *   npm run bench -- --filter=mac          only the cases whose name contains "mac"
+ *   npm run bench -- --tolerance=0.4       allowed slowdown / allocation growth, default 0.35
+ * Allocations are heap bytes allocated per op, garbage included, measured right after a forced GC (needs node --expose-gc).
+ * Retained bytes are what the registry keeps per scanned device after a forced GC: the growth from RETAINED_DEVICES to twice
+ * as many distinct devices, so the BLEMaster itself is not counted. The compact registry must retain less than the object one.
+ * Baselines are machine specific: refresh them with --update on the machine that runs the comparison.
+ */
+import { readFileSync, writeFileSync, existsSync } from 'node:fs';
+import { fileURLToPath } from 'node:url';
+import BLEMaster, { ab2mac, mac2ab, ab2str_stripped, data2ab, str2ab_with_len } from '../ble-master.js';
+import { parseArgs, pad } from './common.js';
+
+const BASELINE_FILE = fileURLToPath(new URL('./bench-baseline.json', import.meta.url));
+const WARMUP_MILLIS = 200;
+const SAMPLE_MILLIS = 300;
+const SAMPLES = 7;          // best of these, the least disturbed by the rest of the machine
+const ALLOC_OPS = 2000;     // small enough to fit the young generation without a scavenge
+const ALLOC_SAMPLES = 3;
+const ALLOC_SLACK = 32;     // bytes/op, below this allocation changes are noise
+const SCAN_DEVICES = 256;
+const LINKED_DEVICES = 64;
+const RETAINED_DEVICES = 4096;  // enough that one device's bytes are not lost in the noise of a GC
+const RETAINED_SAMPLES = 5;     // the median of these
+
+const args = parseArgs();
+const tolerance = args.tolerance === undefined ? 0.35 : Number(args.tolerance);
+
+let sink; // keeps results alive so the JIT cannot drop the work
+
+/* CASES */
+
+const MAC = "a1:b2:c3:d4:e5:f6";
+const MAC_AB = mac2ab(MAC);
+const PAYLOAD_AB = new Uint8Array([0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x10]).buffer;
+
+const cases = [
+    { name: "ab2mac", fn: () => ab2mac(MAC_AB) },
+    { name: "mac2ab", fn: () => mac2ab(MAC) },
+    { name: "ab2str_stripped 16B", fn: () => ab2str_stripped(PAYLOAD_AB) },
+    { name: "data2ab hex 16B", fn: () => data2ab("0102030405060708090a0b0c0d0e0f10") },
+    { name: "data2ab text 16B", fn: () => data2ab("hello, zepp os!!") },
+    { name: "data2ab ArrayBuffer", fn: () => data2ab(PAYLOAD_AB) },
+    { name: "str2ab_with_len 16B", fn: () => str2ab_with_len("hello, zepp os!!") },
+    scanCase("startScan callback object", "object"),
+    scanCase("startScan callback compact", "compact"),
+    notifyCase("notify dispatch object", "object"),
+    notifyCase("notify dispatch compact", "compact"),
+];
+
+/**
+ * The full path of one advert: backend callback > registry update > metrics > user callback.
+ * The transport only captures the scan callback, the adverts are built up front so the case measures the library.
+ */
+function scanCase(name, registry) {
+    let scan = null;
+    const transport = { mstStartScan: (callback) => { scan = callback; return true; }, mstStopScan: () => true };
+    const ble = new BLEMaster({ transport, registry, capacity: SCAN_DEVICES });
+    ble.startScan((result) => { sink = result; });
+    const adverts = [];
+    for (let i = 0; i < SCAN_DEVICES; i++) {
+        adverts.push({
+            dev_addr: new Uint8Array([0xc0, 0xff, 0xee, 0x00, i >> 8, i & 0xff]).buffer,
+            dev_name: "tag" + i,
+            rssi: -40 - (i & 31),
+            service_uuid_array: ["181D"],
+            service_data_array: [],
+            vendor_id: 0x0157,
+            vendor_data: PAYLOAD_AB,
+        });
+    }
+    let i = 0;
+    return { name, fn: () => scan(adverts[i++ & (SCAN_DEVICES - 1)]) };
+}
+
+/**
+ * A notification from one of LINKED_DEVICES connected devices with profiles: backend callback > device lookup by
+ * profile pointer > metrics > user callback. The registry also holds SCAN_DEVICES scanned devices that never connected.
+ */
+function notifyCase(name, registry) {
+    const callbacks = {};
+    let profile_idp = 0;
+    const transport = {
+        mstStartScan: (callback) => { callbacks.scan = callback; return true; },
+        mstStopScan: () => true,
+        mstConnect: (dev_addr, callback) => { callback({ dev_addr, connected: 0, connect_id: 1000 + profile_idp }); return true; },
+        mstOnPrepare: (callback) => { callbacks.prepare = callback; },
+        mstBuildProfile: () => { callbacks.prepare({ profile: ++profile_idp, status: 0 }); return true; },
+        mstOffAllCb: () => {},
+    };
+    for (const op of ["CharaReadComplete", "CharaValueArrived", "CharaWriteComplete", "DescReadComplete", "DescValueArrived", "DescWriteComplete", "CharaNotification"]) {
+        transport["mstOn" + op] = (callback) => { callbacks[op] = callback; };
+    }
+    const clock = { now: () => 0, setTimeout: (callback) => { callback(); return 0; }, clearTimeout: () => {} };
+    const ble = new BLEMaster({ transport, clock, registry, capacity: SCAN_DEVICES + LINKED_DEVICES, watchdog: false });
+    ble.startScan(() => {});
+    for (let i = 0; i < SCAN_DEVICES; i++) {
+        callbacks.scan({ dev_addr: new Uint8Array([0xc0, 0xff, 0xee, 0x00, i >> 8, i & 0xff]).buffer, dev_name: "tag" + i, rssi: -60 });
+    }
+    ble.stopScan();
+    const profile = { pair: true, id: 0, profile: "none", dev: null, len: 1, list: [{ uuid: true, size: 1, len: 1,
+        list: [{ uuid: "A032", permission: 0, desc: 1, len: 1, list: [{ uuid: "A040", permission: 32, desc: 0, len: 0, list: [] }] }] }] };
+    for (let i = 0; i < LINKED_DEVICES; i++) {
+        const mac = "a1:a2:a3:a4:a5:" + i.toString(16).padStart(2, "0");
+        ble.connect(mac, () => {});
+        ble.startListener(ble.modifyProfileObject(mac, profile), () => {});
+    }
+    ble.on.charaNotification((response) => { sink = response; });
+    const notifications = [];
+    for (let i = 1; i <= LINKED_DEVICES; i++) notifications.push({ profile: i, uuid: "A040", data: PAYLOAD_AB, length: 16 });
+    let i = 0;
+    return { name, fn: () => callbacks.CharaNotification(notifications[i++ & (LINKED_DEVICES - 1)]) };
+}
+
+const footprints = [
+    retainedCase("retained per device object", "object"),
+    retainedCase("retained per device compact", "compact"),
+];
+
+/**
+ * Scans distinct devices into a registry with room for all of them, so the compact registry never grows in between.
+ */
+function retainedCase(name, registry) {
+    return {
+        name,
+        fn: () => {
+            sink = null; // frees the previous sample's BLEMaster before this one measures
+            let scan = null;
+            const transport = { mstStartScan: (callback) => { scan = callback; return true; }, mstStopScan: () => true };
+            const ble = new BLEMaster({ transport, registry, capacity: 2 * RETAINED_DEVICES });
+            ble.startScan(() => {});
+            const fill = (from) => {
+                for (let i = from; i < from + RETAINED_DEVICES; i++) {
+                    scan({
+                        dev_addr: new Uint8Array([0xc0, 0xff, 0xee, i >> 16, (i >> 8) & 0xff, i & 0xff]).buffer,
+                        dev_name: "tag" + i,
+                        rssi: -40 - (i & 31),
+                        service_uuid_array: ["181D"],
+                        service_data_array: [],
+                        vendor_id: 0x0157,
+                        vendor_data: PAYLOAD_AB.slice(0, 8),
+                    });
+                }
+            };
+            fill(0);
+            const before = heapRetained();
+            fill(RETAINED_DEVICES);
+            sink = ble;
+            return (heapRetained() - before) / RETAINED_DEVICES;
+        },
+    };
+}
+
+/* MEASUREMENT */
+
+function opsPerSec(fn) {
+    run(fn, WARMUP_MILLIS);
+    const samples = [];
+    for (let s = 0; s < SAMPLES; s++) samples.push(run(fn, SAMPLE_MILLIS));
+    return Math.max(...samples);
+}
+
+function run(fn, millis) {
+    let ops = 0, batch = 64;
+    const start = performance.now();
+    let elapsed = 0;
+    while (elapsed < millis) {
+        for (let i = 0; i < batch; i++) sink = fn();
+        ops += batch;
+        elapsed = performance.now() - start;
+        if (batch < 65536) batch *= 2;
+    }
+    return ops / (elapsed / 1000);
+}
+
+function bytesPerOp(fn) {
+    if (typeof globalThis.gc !== "function") return null;
+    let best = Infinity;
+    for (let s = 0; s < ALLOC_SAMPLES; s++) {
+        globalThis.gc();
+        const before = process.memoryUsage().heapUsed; // grows with every allocation, garbage included, until the next scavenge
+        for (let i = 0; i < ALLOC_OPS; i++) sink = fn();
+        const after = process.memoryUsage().heapUsed;
+        if (after >= before) best = Math.min(best, (after - before) / ALLOC_OPS); // a scavenge in between spoils the sample
+    }
+    return best === Infinity ? null : Math.round(best);
+}
+
+function heapRetained() {
+    globalThis.gc();
+    const memory = process.memoryUsage();
+    return memory.heapUsed + memory.arrayBuffers; // the compact registry's columns live in array buffers
+}
+
+function bytesRetained(fn) {
+    if (typeof globalThis.gc !== "function") return null;
+    fn(); // warm up, the first run also compiles the path
+    const samples = [];
+    for (let s = 0; s < RETAINED_SAMPLES; s++) samples.push(fn());
+    samples.sort((a, b) => a - b);
+    return Math.round(samples[RETAINED_SAMPLES >> 1]);
+}
+
+/* REPORT */
+
+const baseline = existsSync(BASELINE_FILE) ? JSON.parse(readFileSync(BASELINE_FILE, "utf8")) : null;
+const current = {};
+const regressions = [];
+
+console.log(pad("case", 28) + pad("ops/sec", 14) + pad("B/op", 8) + pad("baseline", 14) + "delta");
+for (const { name, fn } of cases) {
+    if (args.filter && !name.includes(args.filter)) continue;
+    const ops = Math.round(opsPerSec(fn));
+    const bytes = bytesPerOp(fn);
+    current[name] = { ops_per_sec: ops, bytes_per_op: bytes };
+
+    const base = baseline && baseline.cases[name];
+    let delta = "";
+    if (base) {
+        const ratio = ops / base.ops_per_sec - 1;
+        delta = (ratio >= 0 ? "+" : "") + (ratio * 100).toFixed(1) + "%";
+        if (ratio < -tolerance) regressions.push(`${name}: ${ops} ops/sec, baseline ${base.ops_per_sec}`);
+        if (bytes !== null && base.bytes_per_op !== null && bytes > base.bytes_per_op * (1 + tolerance) + ALLOC_SLACK) {
+            regressions.push(`${name}: ${bytes} B/op, baseline ${base.bytes_per_op}`);
+        }
+    }
+    console.log(pad(name, 28) + pad(ops.toLocaleString("en"), 14) + pad(bytes === null ? "n/a" : bytes, 8) +
+        pad(base ? base.ops_per_sec.toLocaleString("en") : "-", 14) + delta);
+}
+
+const retained = {};
+console.log("\n" + pad("case", 28) + pad("B/device", 14) + pad("baseline", 14) + "delta");
+for (const { name, fn } of footprints) {
+    if (args.filter && !name.includes(args.filter)) continue;
+    const bytes = bytesRetained(fn);
+    retained[name] = { bytes_per_device: bytes };
+
+    const base = baseline && baseline.retained && baseline.retained[name];
+    let delta = "";
+    if (base && bytes !== null && base.bytes_per_device !== null) {
+        const ratio = bytes / base.bytes_per_device - 1;
+        delta = (ratio >= 0 ? "+" : "") + (ratio * 100).toFixed(1) + "%";
+        if (bytes > base.bytes_per_device * (1 + tolerance) + ALLOC_SLACK) {
+            regressions.push(`${name}: ${bytes} B/device, baseline ${base.bytes_per_device}`);
+        }
+    }
+    console.log(pad(name, 28) + pad(bytes === null ? "n/a" : bytes, 14) + pad(base ? base.bytes_per_device : "-", 14) + delta);
+}
+const object_bytes = retained["retained per device object"], compact_bytes = retained["retained per device compact"];
+if (object_bytes && compact_bytes && object_bytes.bytes_per_device !== null && compact_bytes.bytes_per_device >= object_bytes.bytes_per_device) {
+    regressions.push(`the compact registry retains ${compact_bytes.bytes_per_device} B/device, the object one ${object_bytes.bytes_per_device}`);
+}
+
+if (args.update) {
+    const cases_out = { ...(baseline && baseline.cases), ...current };
+    const retained_out = { ...(baseline && baseline.retained), ...retained };
+    writeFileSync(BASELINE_FILE, JSON.stringify({ node: process.version, updated: new Date().toISOString(), cases: cases_out, retained: retained_out }, null, 2) + "\n");
+    console.log(`baseline written to ${BASELINE_FILE}`);
+} else if (regressions.length) {
+    console.log(`\n${regressions.length} regression(s), tolerance ${tolerance * 100}%:`);
+    for (const line of regressions) console.log("  " + line);
+    process.exitCode = 1;
+} else if (!baseline) {
+    console.log("\nno baseline yet, run with --update to store one");
+}
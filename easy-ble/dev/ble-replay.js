@@ -0,0 +1,537 @@
+/** @about BLE Session Replay 1.0.0 @author: Silver, Zepp Health. @license: MIT
+ * Records every @zos/ble callback of a session into a compact binary file, and plays it back as a transport.
+ * No Node APIs: copy this file next to ble-master.js in an app to capture real sessions on the watch.
+ * Record:
+ *   import * as hmBle from '@zos/ble';
+ *   const recorder = new SessionRecorder(hmBle);
+ *   const ble = new BLEMaster({ transport: recorder });
+ *   ... session ...
+ *   const file = recorder.save(); // ArrayBuffer, e.g. for writeFileSync from @zos/fs
+ * Replay:
+ *   const replay = new SessionReplay(file, { clock: new VirtualClock() }); // or { speed: 10 } on real timers
+ *   const ble = new BLEMaster({ transport: replay, clock: replay.clock });
+ *   ble.startScan(...); replay.play(() => console.log("done"));
+ */
+
+const MAGIC = [0x45, 0x42, 0x4C, 0x52]; // "EBLR"
+const VERSION = 1;
+const INITIAL_BYTES = 4096;
+const MAC_BYTES = 6;
+
+const ERR_NOT_A_SESSION = "eBLE: not a session file";
+const ERR_VERSION = "eBLE: unsupported session file version";
+const ERR_TRUNCATED = "eBLE: session file is truncated";
+
+// record kinds, one per backend callback
+export const REC = {
+    SCAN: 1,
+    CONNECT: 2,
+    PREPARE: 3,
+    CHARA_READ: 4,
+    CHARA_VALUE: 5,
+    CHARA_WRITE: 6,
+    DESC_READ: 7,
+    DESC_VALUE: 8,
+    DESC_WRITE: 9,
+    NOTIFY: 10,
+};
+
+// field layout per kind. length fields are not stored, they follow from data
+const LAYOUT = {
+    [REC.SCAN]: [["dev_addr", "mac"], ["dev_name", "str"], ["rssi", "int"], ["vendor_id", "int?"], ["vendor_data", "bytes"],
+        ["service_uuid_array", "strs"], ["service_data_array", "sdata"]],
+    [REC.CONNECT]: [["dev_addr", "mac"], ["connected", "int"], ["connect_id", "int"]],
+    [REC.PREPARE]: [["profile", "int"], ["status", "int"]],
+    [REC.CHARA_READ]: [["profile", "int"], ["uuid", "str"], ["status", "int"]],
+    [REC.CHARA_VALUE]: [["profile", "int"], ["uuid", "str"], ["data", "bytes"]],
+    [REC.CHARA_WRITE]: [["profile", "int"], ["uuid", "str"], ["status", "int"]],
+    [REC.DESC_READ]: [["profile", "int"], ["chara", "str"], ["desc", "str"], ["status", "int"]],
+    [REC.DESC_VALUE]: [["profile", "int"], ["chara", "str"], ["desc", "str"], ["data", "bytes"]],
+    [REC.DESC_WRITE]: [["profile", "int"], ["chara", "str"], ["desc", "str"], ["status", "int"]],
+    [REC.NOTIFY]: [["profile", "int"], ["uuid", "str"], ["data", "bytes"]],
+};
+
+// mstOn* registration > record kind
+const LISTENERS = {
+    mstOnPrepare: REC.PREPARE,
+    mstOnCharaReadComplete: REC.CHARA_READ,
+    mstOnCharaValueArrived: REC.CHARA_VALUE,
+    mstOnCharaWriteComplete: REC.CHARA_WRITE,
+    mstOnDescReadComplete: REC.DESC_READ,
+    mstOnDescValueArrived: REC.DESC_VALUE,
+    mstOnDescWriteComplete: REC.DESC_WRITE,
+    mstOnCharaNotification: REC.NOTIFY,
+};
+const LISTENER_OF = {};
+for (const name in LISTENERS) LISTENER_OF[LISTENERS[name]] = name;
+
+const PASS_THROUGH = ["mstStopScan", "mstDisconnect", "mstPair", "mstBuildProfile", "mstDestroyProfileInstance",
+    "mstReadCharacteristic", "mstReadDescriptor", "mstWriteCharacteristic", "mstWriteDescriptor", "mstOffAllCb"];
+
+const REAL_TIME = {
+    now: () => Date.now(),
+    setTimeout: (callback, millis) => setTimeout(callback, millis),
+    clearTimeout: (id) => clearTimeout(id),
+};
+
+/**
+ * Transport wrapper that forwards every call to the real backend and records the callbacks it delivers.
+ * Layout: "EBLR", version, then per record: kind, varint millis since the previous record, fields.
+ * Strings (names, UUIDs) are interned, so a UUID costs one byte after its first use.
+ */
+export class SessionRecorder {
+    #target;
+    #clock;
+    #writer = new Writer();
+    #last = -1;
+    #count = 0;
+
+    /**
+     * @param {Object} target - The backend to record, @zos/ble or any transport (e.g. a BLESimulator).
+     * @param {Object} [options={}]
+     * @param {Object} [options.clock] - Timestamps source { now() }, defaults to Date.
+     */
+    constructor(target, options = {}) {
+        this.#target = target;
+        this.#clock = options.clock || REAL_TIME;
+        this.#writer.raw(MAGIC);
+        this.#writer.byte(VERSION);
+        for (const name of PASS_THROUGH) {
+            this[name] = (...args) => this.#target[name](...args);
+        }
+        for (const name in LISTENERS) {
+            const kind = LISTENERS[name];
+            this[name] = (callback) => this.#target[name](this.#wrap(kind, callback));
+        }
+    }
+    /**
+     * @type {number} Number of recorded callbacks.
+     */
+    get size() {
+        return this.#count;
+    }
+    /**
+     * @type {number} Bytes recorded so far.
+     */
+    get bytes() {
+        return this.#writer.length;
+    }
+    /**
+     * @returns {ArrayBuffer} The session file.
+     */
+    save() {
+        return this.#writer.buffer();
+    }
+    /**
+     * Drops everything recorded so far and starts a new session.
+     */
+    clear() {
+        this.#writer = new Writer();
+        this.#writer.raw(MAGIC);
+        this.#writer.byte(VERSION);
+        this.#last = -1;
+        this.#count = 0;
+    }
+    mstStartScan(callback) {
+        return this.#target.mstStartScan(this.#wrap(REC.SCAN, callback));
+    }
+    mstConnect(dev_addr, callback) {
+        return this.#target.mstConnect(dev_addr, this.#wrap(REC.CONNECT, callback));
+    }
+
+    #wrap(kind, callback) {
+        return (response) => {
+            this.#record(kind, response);
+            callback(response);
+        };
+    }
+    #record(kind, response) {
+        const now = this.#clock.now();
+        this.#writer.byte(kind);
+        this.#writer.varint(this.#last < 0 ? 0 : Math.max(0, now - this.#last));
+        this.#last = now;
+        for (const [name, type] of LAYOUT[kind]) this.#writer.field(type, response[name]);
+        this.#count++;
+    }
+}
+
+/**
+ * Decodes a session file.
+ * @param {ArrayBuffer} buffer
+ * @returns {Array<{time: number, kind: number, response: Object}>} time is millis since the first record.
+ */
+export function decodeSession(buffer) {
+    const reader = new Reader(buffer);
+    for (const byte of MAGIC) {
+        if (reader.byte() !== byte) throw new Error(ERR_NOT_A_SESSION);
+    }
+    if (reader.byte() !== VERSION) throw new Error(ERR_VERSION);
+    const records = [];
+    let time = 0;
+    while (!reader.done) {
+        const kind = reader.byte();
+        const layout = LAYOUT[kind];
+        if (!layout) throw new Error(ERR_NOT_A_SESSION);
+        time += reader.varint();
+        const response = {};
+        for (const [name, type] of layout) {
+            const value = reader.field(type);
+            if (value !== undefined) response[name] = value;
+        }
+        if (response.data !== undefined) response.length = response.data.byteLength;
+        records.push({ time, kind, response });
+    }
+    return records;
+}
+
+/**
+ * Transport that plays a recorded session back into BLEMaster.
+ * Scan results reach the scan callback only while a scan runs. Connect results and attribute callbacks wait
+ * until the library asks for them (mstConnect for that MAC, the mstOn* registration), so a replay stays in step
+ * with code that connects a little later than the recorded app did.
+ */
+export class SessionReplay {
+    /**
+     * @type {Object} The clock that drives the playback. Pass it to BLEMaster as options.clock.
+     */
+    clock;
+    /**
+     * @type {Array<Object>} The decoded records.
+     */
+    records;
+    /**
+     * @type {Object<string, number>} Number of calls per mst* function.
+     */
+    calls = {};
+    /**
+     * @type {{delivered: number, held: number, dropped: number}} Playback counters.
+     */
+    stats = { delivered: 0, held: 0, dropped: 0 };
+
+    #speed;
+    #cursor = 0;
+    #started_at = 0;
+    #timer = null;
+    #on_done = null;
+    #scan_callback = null;
+    #connect_callbacks = new Map(); // MAC > callback
+    #callbacks = {};
+    #held = new Map(); // MAC or mstOn* name > [response]
+
+    /**
+     * @param {ArrayBuffer} buffer - A session file from SessionRecorder.save().
+     * @param {Object} [options={}]
+     * @param {Object} [options.clock] - { now, setTimeout, clearTimeout }, defaults to real timers. A VirtualClock replays
+     * the original timing exactly, as fast as it is advanced.
+     * @param {number} [options.speed=1] - Playback speed on the clock: 1 = original, 10 = ten times faster,
+     * Infinity = everything at once, synchronously inside play().
+     */
+    constructor(buffer, options = {}) {
+        this.records = decodeSession(buffer);
+        this.clock = options.clock || REAL_TIME;
+        this.#speed = options.speed === undefined ? 1 : options.speed;
+        for (const name of PASS_THROUGH) {
+            this[name] = () => {
+                this.#countCall(name);
+                return true;
+            };
+        }
+        for (const name in LISTENERS) {
+            this[name] = (callback) => {
+                this.#countCall(name);
+                this.#callbacks[name] = callback;
+                this.#flush(name, callback);
+            };
+        }
+        this.mstOffAllCb = () => {
+            this.#countCall("mstOffAllCb");
+            this.#callbacks = {};
+        };
+    }
+    /**
+     * @type {number} Recorded session length in millis.
+     */
+    get duration() {
+        return this.records.length ? this.records[this.records.length - 1].time : 0;
+    }
+    /**
+     * Starts the playback.
+     * @param {Function} [on_done] - Called after the last record.
+     */
+    play(on_done) {
+        this.stop();
+        this.#cursor = 0;
+        this.#on_done = on_done || null;
+        this.#started_at = this.clock.now();
+        if (this.#speed === Infinity) {
+            while (this.#cursor < this.records.length) this.#deliver(this.records[this.#cursor++]);
+            this.#finish();
+            return;
+        }
+        this.#next();
+    }
+    /**
+     * Stops the playback, held responses are kept.
+     */
+    stop() {
+        if (this.#timer !== null) this.clock.clearTimeout(this.#timer);
+        this.#timer = null;
+    }
+    mstStartScan(callback) {
+        this.#countCall("mstStartScan");
+        this.#scan_callback = callback;
+        return true;
+    }
+    mstStopScan() {
+        this.#countCall("mstStopScan");
+        this.#scan_callback = null;
+        return true;
+    }
+    mstConnect(dev_addr_ab, callback) {
+        this.#countCall("mstConnect");
+        const dev_addr = mac(dev_addr_ab);
+        this.#connect_callbacks.set(dev_addr, callback);
+        this.#flush(dev_addr, callback);
+        return true;
+    }
+
+    #countCall(name) {
+        this.calls[name] = (this.calls[name] || 0) + 1;
+    }
+    #next() {
+        if (this.#cursor >= this.records.length) {
+            this.#timer = null;
+            this.#finish();
+            return;
+        }
+        const record = this.records[this.#cursor];
+        const due = this.#started_at + record.time / this.#speed - this.clock.now();
+        this.#timer = this.clock.setTimeout(() => {
+            // deliver everything that is due, one timer per distinct timestamp
+            const now = this.clock.now();
+            while (this.#cursor < this.records.length && this.#started_at + this.records[this.#cursor].time / this.#speed <= now) {
+                this.#deliver(this.records[this.#cursor++]);
+            }
+            this.#next();
+        }, Math.max(0, due));
+    }
+    #finish() {
+        const on_done = this.#on_done;
+        this.#on_done = null;
+        if (on_done) on_done();
+    }
+    #deliver(record) {
+        const response = copy(record.response);
+        if (record.kind === REC.SCAN) {
+            if (!this.#scan_callback) {
+                this.stats.dropped++;
+                return;
+            }
+            this.stats.delivered++;
+            this.#scan_callback(response);
+            return;
+        }
+        const key = record.kind === REC.CONNECT ? mac(response.dev_addr) : LISTENER_OF[record.kind];
+        const callback = record.kind === REC.CONNECT ? this.#connect_callbacks.get(key) : this.#callbacks[key];
+        if (!callback) {
+            if (!this.#held.has(key)) this.#held.set(key, []);
+            this.#held.get(key).push(response);
+            this.stats.held++;
+            return;
+        }
+        this.stats.delivered++;
+        callback(response);
+    }
+    #flush(key, callback) {
+        const held = this.#held.get(key);
+        if (!held) return;
+        this.#held.delete(key);
+        this.clock.setTimeout(() => { // the backend never answers inside the call
+            for (const response of held) {
+                this.stats.held--;
+                this.stats.delivered++;
+                callback(response);
+            }
+        }, 0);
+    }
+}
+
+/* ENCODING */
+
+class Writer {
+    #bytes = new Uint8Array(INITIAL_BYTES);
+    #length = 0;
+    #strings = new Map(); // string > index
+
+    get length() {
+        return this.#length;
+    }
+    buffer() {
+        return this.#bytes.slice(0, this.#length).buffer;
+    }
+    byte(value) {
+        this.#reserve(1);
+        this.#bytes[this.#length++] = value;
+    }
+    raw(bytes) {
+        this.#reserve(bytes.length);
+        this.#bytes.set(bytes, this.#length);
+        this.#length += bytes.length;
+    }
+    varint(value) { // unsigned LEB128, safe up to 2^53
+        while (value >= 0x80) {
+            this.byte((value % 0x80) | 0x80);
+            value = Math.floor(value / 0x80);
+        }
+        this.byte(value);
+    }
+    int(value) { // zigzag, so small negatives (status -1, rssi) stay short
+        value = value || 0;
+        this.varint(value < 0 ? -value * 2 - 1 : value * 2);
+    }
+    /**
+     * Strings: 0 = undefined, 1 = new string (length, code points), n = the (n - 2)th interned string.
+     */
+    str(value) {
+        if (value === undefined || value === null) return this.varint(0);
+        const index = this.#strings.get(value);
+        if (index !== undefined) return this.varint(index + 2);
+        this.#strings.set(value, this.#strings.size);
+        this.varint(1);
+        this.varint(value.length);
+        for (let i = 0; i < value.length; i++) this.varint(value.charCodeAt(i));
+    }
+    field(type, value) {
+        switch (type) {
+            case "mac":
+                return this.raw(new Uint8Array(value, 0, MAC_BYTES));
+            case "int":
+                return this.int(value);
+            case "int?":
+                if (value === undefined || value === null) return this.varint(0);
+                return this.varint((value < 0 ? -value * 2 - 1 : value * 2) + 1);
+            case "str":
+                return this.str(value);
+            case "bytes":
+                if (!value) return this.varint(0);
+                this.varint(value.byteLength + 1);
+                return this.raw(new Uint8Array(value));
+            case "strs":
+                if (!value) return this.varint(0);
+                this.varint(value.length + 1);
+                for (const item of value) this.str(item);
+                return;
+            case "sdata":
+                if (!value) return this.varint(0);
+                this.varint(value.length + 1);
+                for (const item of value) {
+                    this.str(item.uuid);
+                    this.field("bytes", item.service_data);
+                }
+                return;
+        }
+    }
+    #reserve(count) {
+        if (this.#length + count <= this.#bytes.length) return;
+        const grown = new Uint8Array(Math.max(this.#bytes.length * 2, this.#length + count));
+        grown.set(this.#bytes.subarray(0, this.#length));
+        this.#bytes = grown;
+    }
+}
+
+class Reader {
+    #bytes;
+    #offset = 0;
+    #strings = [];
+
+    constructor(buffer) {
+        this.#bytes = new Uint8Array(buffer);
+    }
+    get done() {
+        return this.#offset >= this.#bytes.length;
+    }
+    byte() {
+        if (this.#offset >= this.#bytes.length) throw new Error(ERR_TRUNCATED);
+        return this.#bytes[this.#offset++];
+    }
+    raw(count) {
+        if (this.#offset + count > this.#bytes.length) throw new Error(ERR_TRUNCATED);
+        const out = this.#bytes.slice(this.#offset, this.#offset + count).buffer;
+        this.#offset += count;
+        return out;
+    }
+    varint() {
+        let value = 0, scale = 1, byte;
+        do {
+            byte = this.byte();
+            value += (byte & 0x7F) * scale;
+            scale *= 0x80;
+        } while (byte & 0x80);
+        return value;
+    }
+    int() {
+        const value = this.varint();
+        return value % 2 ? -(value + 1) / 2 : value / 2;
+    }
+    str() {
+        const tag = this.varint();
+        if (tag === 0) return undefined;
+        if (tag > 1) return this.#strings[tag - 2];
+        const length = this.varint();
+        let value = "";
+        for (let i = 0; i < length; i++) value += String.fromCharCode(this.varint());
+        this.#strings.push(value);
+        return value;
+    }
+    field(type) {
+        switch (type) {
+            case "mac":
+                return this.raw(MAC_BYTES);
+            case "int":
+                return this.int();
+            case "int?": {
+                const value = this.varint();
+                if (value === 0) return undefined;
+                return (value - 1) % 2 ? -value / 2 : (value - 1) / 2;
+            }
+            case "str":
+                return this.str();
+            case "bytes": {
+                const length = this.varint();
+                return length === 0 ? undefined : this.raw(length - 1);
+            }
+            case "strs": {
+                const count = this.varint();
+                if (count === 0) return undefined;
+                const out = [];
+                for (let i = 1; i < count; i++) out.push(this.str());
+                return out;
+            }
+            case "sdata": {
+                const count = this.varint();
+                if (count === 0) return undefined;
+                const out = [];
+                for (let i = 1; i < count; i++) out.push({ uuid: this.str(), service_data: this.field("bytes") });
+                return out;
+            }
+        }
+    }
+}
+
+/* HELPERS */
+
+function mac(ab) {
+    return Array.from(new Uint8Array(ab), (byte) => byte.toString(16).padStart(2, '0')).join(':');
+}
+
+function copy(response) { // fresh buffers per delivery, like the backend
+    const out = { ...response };
+    for (const name in out) {
+        if (out[name] instanceof ArrayBuffer) out[name] = out[name].slice(0);
+    }
+    if (out.service_data_array) {
+        out.service_data_array = out.service_data_array.map(({ uuid, service_data }) => ({ uuid, service_data: service_data && service_data.slice(0) }));
+    }
+    if (out.service_uuid_array) out.service_uuid_array = out.service_uuid_array.slice();
+    return out;
+}
@@ -0,0 +1,568 @@
+/** @about BLE Simulator 1.1.0 @author: Silver, Zepp Health. @license: MIT
+ * Deterministic stand-in for @zos/ble: virtual peripherals (adverts, GATT tables, latencies) driven by a virtual clock.
+ * Usage:
+ *   const sim = new BLESimulator({ peripherals: [{ mac: "a1:a2:a3:a4:a5:a6", name: "lamp", gatt: { "A032": { "A040": {} } } }] });
+ *   const ble = new BLEMaster({ transport: sim, clock: sim.clock });
+ *   ble.startScan(...); sim.clock.advance(1000);
+ * Faults (lost adverts, late or missing callbacks, link drops, failed prepares, rejected writes) are opt-in, see options.faults.
+ */
+
+const DEFAULT_LATENCY = {
+    connect: 120,
+    disconnect: 20,
+    prepare: 300,
+    read: 40,
+    write: 40,
+};
+const DEFAULT_ADVERT_INTERVAL = 100; // millis
+const DEFAULT_RSSI = -60;
+const RSSI_JITTER = 3;
+
+// mstConnect result.connected
+const CONNECTED = 0;
+const CONNECT_FAILED = 1;
+const DISCONNECTED = 2;
+
+const STATUS_OK = 0;
+const STATUS_FAIL = 1;
+
+// every probability is per event, 0 (never) to 1 (always)
+const DEFAULT_FAULTS = {
+    advert_loss: 0,      // an advert never reaches the scan callback
+    callback_loss: 0,    // a connect/prepare/read/write completion never arrives
+    callback_delay: 0,   // a completion arrives late, by `delay` extra millis
+    delay: [500, 3000],  // number or [min, max]
+    connect_failure: 0,  // mstConnect reports connected: 1
+    disconnect_rate: 0,  // spurious link drops per connection per second
+    prepare_failure: 0,  // mstOnPrepare reports `prepare_status`
+    prepare_status: STATUS_FAIL,
+    read_failure: 0,     // a read completes with STATUS_FAIL and no value
+    write_reject: 0,     // mstWrite* returns false, nothing is sent
+    write_failure: 0,    // a write completes with STATUS_FAIL, the value is not stored
+};
+const FAULT_SEED_SALT = 0x9E3779B9; // faults draw from their own stream, so enabling them does not shift radio timing
+
+/**
+ * Virtual time. Timers only fire when the clock is advanced, in deadline order (ties in creation order).
+ */
+export class VirtualClock {
+    #now;
+    #seq = 0;
+    #timers = []; // sorted by [at, seq]
+
+    constructor(start = 0) {
+        this.#now = start;
+    }
+    now() {
+        return this.#now;
+    }
+    setTimeout(callback, millis = 0) {
+        const timer = { id: ++this.#seq, at: this.#now + Math.max(0, millis || 0), callback };
+        let lo = 0, hi = this.#timers.length;
+        while (lo < hi) { // keep the queue sorted, equal deadlines stay in creation order
+            const mid = (lo + hi) >> 1;
+            if (this.#timers[mid].at <= timer.at) lo = mid + 1; else hi = mid;
+        }
+        this.#timers.splice(lo, 0, timer);
+        return timer.id;
+    }
+    clearTimeout(id) {
+        const index = this.#timers.findIndex((timer) => timer.id === id);
+        if (index >= 0) this.#timers.splice(index, 1);
+    }
+    /**
+     * @type {number} The number of timers waiting to fire.
+     */
+    get pending() {
+        return this.#timers.length;
+    }
+    /**
+     * Moves time forward, firing every timer that falls due on the way.
+     * @param {number} millis - How far to move.
+     */
+    advance(millis) {
+        const until = this.#now + millis;
+        while (this.#timers.length && this.#timers[0].at <= until) {
+            const timer = this.#timers.shift();
+            this.#now = timer.at;
+            timer.callback();
+        }
+        this.#now = until;
+    }
+    /**
+     * Fires timers until none are left or the time limit is reached.
+     * @param {number} [max_millis=60000] - Stops here even if periodic timers keep the queue busy.
+     */
+    runUntilIdle(max_millis = 60000) {
+        const until = this.#now + max_millis;
+        while (this.#timers.length && this.#timers[0].at <= until) {
+            this.advance(this.#timers[0].at - this.#now);
+        }
+    }
+    /**
+     * Replaces the global setTimeout/clearTimeout/Date.now with this clock, for code that cannot take a clock option.
+     * @returns {Function} Restores the originals.
+     */
+    install() {
+        const original = { setTimeout: globalThis.setTimeout, clearTimeout: globalThis.clearTimeout, now: Date.now };
+        globalThis.setTimeout = (callback, millis) => this.setTimeout(callback, millis);
+        globalThis.clearTimeout = (id) => this.clearTimeout(id);
+        Date.now = () => this.#now;
+        return () => {
+            globalThis.setTimeout = original.setTimeout;
+            globalThis.clearTimeout = original.clearTimeout;
+            Date.now = original.now;
+        };
+    }
+}
+
+/**
+ * Seeded PRNG (mulberry32), every run with the same seed produces the same radio behavior.
+ */
+export function createRandom(seed = 1) {
+    let state = seed >>> 0;
+    return () => {
+        state = (state + 0x6D2B79F5) >>> 0;
+        let t = state;
+        t = Math.imul(t ^ (t >>> 15), t | 1);
+        t ^= t + Math.imul(t ^ (t >>> 7), t | 61);
+        return ((t ^ (t >>> 14)) >>> 0) / 4294967296;
+    };
+}
+
+/**
+ * Simulated @zos/ble backend. Implements the mst* surface used by BLE Master.
+ */
+export class BLESimulator {
+    /**
+     * @type {VirtualClock} The clock that drives the simulation. Pass it to BLEMaster as options.clock.
+     */
+    clock;
+    /**
+     * @type {Object<string, number>} Number of calls per mst* function.
+     */
+    calls = {};
+    /**
+     * @type {Array<Object>} Every accepted write: { time, dev_addr, uuid, desc, data } (data is a hex string).
+     */
+    writes = [];
+    /**
+     * @type {Object<string, number>} Number of injected faults per kind (advert_loss, callback_loss, ...).
+     */
+    injected = {};
+
+    #random;
+    #fault_random;
+    #latency;
+    #faults;
+    #peripherals = new Map(); // MAC > peripheral
+    #scan_callback = null;
+    #scan_timers = [];
+    #connections = new Map(); // connect_id > { dev_addr, callback, profiles: Set }
+    #profiles = new Map();    // profile_idp > connect_id
+    #next_connect_id = 1;
+    #connect_slots;
+    #connects_in_flight = 0;
+    #next_profile = 0x1000;
+    #callbacks = {};
+
+    /**
+     * @param {Object} [options={}]
+     * @param {VirtualClock} [options.clock] - Defaults to a new clock starting at 0.
+     * @param {Array<Object>} [options.peripherals=[]] - Peripheral configs, see addPeripheral().
+     * @param {Object} [options.latency] - Default latencies in millis: { connect, disconnect, prepare, read, write },
+     * each a number or a [min, max] range.
+     * @param {number} [options.seed=1] - Seed for RSSI jitter, advert phase, latency ranges and faults.
+     * @param {Object} [options.faults] - Fault probabilities, all off by default:
+     * { advert_loss, callback_loss, callback_delay, delay, connect_failure, disconnect_rate,
+     * prepare_failure, prepare_status, read_failure, write_reject, write_failure }. See setFaults().
+     * @param {number} [options.connect_slots=Infinity] - Connects the backend works on at once. A connect issued while this many
+     * are in flight fails with connected: 1 (counted as injected.connect_overload). A connect whose completion is lost keeps its slot.
+     */
+    constructor(options = {}) {
+        const seed = options.seed === undefined ? 1 : options.seed;
+        this.clock = options.clock || new VirtualClock();
+        this.#random = createRandom(seed);
+        this.#fault_random = createRandom(seed ^ FAULT_SEED_SALT);
+        this.#latency = { ...DEFAULT_LATENCY, ...options.latency };
+        this.#faults = { ...DEFAULT_FAULTS, ...options.faults };
+        this.#connect_slots = options.connect_slots === undefined ? Infinity : options.connect_slots;
+        for (const config of options.peripherals || []) {
+            this.addPeripheral(config);
+        }
+    }
+    /**
+     * Adds a virtual peripheral. If a scan is running it starts advertising right away.
+     * @param {Object} config
+     * @param {string} config.mac - MAC address "a1:b2:c3:d4:e5:f6".
+     * @param {string} [config.name] - Advertised device name.
+     * @param {number} [config.rssi=-60] - Mean RSSI, adverts jitter by +-3.
+     * @param {number} [config.advert_interval=100] - Millis between adverts.
+     * @param {number} [config.vendor_id] - Manufacturer ID.
+     * @param {string} [config.vendor_data] - Manufacturer data as a hex string.
+     * @param {Array<string>} [config.service_uuids] - Advertised service UUIDs.
+     * @param {Array<{uuid: string, data: string}>} [config.service_data] - Advertised service data, hex strings.
+     * @param {Object} [config.gatt] - { [service_uuid]: { [chara_uuid]: { value: "hex", descriptors: { [desc_uuid]: "hex" } } } }.
+     * @param {Object} [config.latency] - Per-peripheral latency overrides.
+     * @param {Object} [config.faults] - Per-peripheral fault overrides, same keys as options.faults.
+     * @returns {Object} The peripheral record.
+     */
+    addPeripheral(config) {
+        const dev_addr = config.mac.toLowerCase();
+        const gatt = new Map(); // CHARA > { value, descriptors: Map }
+        for (const service_uuid in config.gatt || {}) {
+            const service = config.gatt[service_uuid];
+            for (const chara_uuid in service) {
+                const chara = service[chara_uuid] || {};
+                const descriptors = new Map();
+                for (const desc_uuid in chara.descriptors || {}) {
+                    descriptors.set(desc_uuid.toUpperCase(), hex2bytes(chara.descriptors[desc_uuid]));
+                }
+                gatt.set(chara_uuid.toUpperCase(), { value: hex2bytes(chara.value || ""), descriptors });
+            }
+        }
+        const peripheral = {
+            dev_addr,
+            name: config.name === undefined ? "" : config.name,
+            rssi: config.rssi === undefined ? DEFAULT_RSSI : config.rssi,
+            advert_interval: config.advert_interval || DEFAULT_ADVERT_INTERVAL,
+            vendor_id: config.vendor_id,
+            vendor_data: config.vendor_data === undefined ? null : hex2bytes(config.vendor_data),
+            service_uuids: config.service_uuids || [],
+            service_data: (config.service_data || []).map(({ uuid, data }) => ({ uuid, data: hex2bytes(data) })),
+            gatt,
+            latency: config.latency || {},
+            faults: config.faults || {},
+            in_range: true,
+        };
+        this.#peripherals.set(dev_addr, peripheral);
+        if (this.#scan_callback) this.#advertise(peripheral);
+        return peripheral;
+    }
+    /**
+     * Takes a peripheral out of range: it stops advertising and its connections drop.
+     * @param {string} dev_addr - The MAC address.
+     */
+    removePeripheral(dev_addr) {
+        const peripheral = this.#peripherals.get(dev_addr.toLowerCase());
+        if (!peripheral) return;
+        peripheral.in_range = false;
+        this.#peripherals.delete(peripheral.dev_addr);
+        this.disconnectPeripheral(peripheral.dev_addr);
+    }
+    /**
+     * Drops every connection to a peripheral, as if the link was lost.
+     * @param {string} dev_addr - The MAC address.
+     */
+    disconnectPeripheral(dev_addr) {
+        dev_addr = dev_addr.toLowerCase();
+        for (const [connect_id, connection] of this.#connections) {
+            if (connection.dev_addr === dev_addr) this.#drop(connect_id);
+        }
+    }
+    /**
+     * Sends a notification from a peripheral to every profile built for it.
+     * @param {string} dev_addr - The MAC address.
+     * @param {string} uuid - The characteristic UUID.
+     * @param {string|ArrayBuffer} data - Hex string or buffer.
+     */
+    notify(dev_addr, uuid, data) {
+        dev_addr = dev_addr.toLowerCase();
+        const bytes = typeof data === "string" ? hex2bytes(data) : new Uint8Array(data);
+        for (const [profile, connect_id] of this.#profiles) {
+            if (this.#connections.get(connect_id).dev_addr !== dev_addr) continue;
+            this.#emit("mstOnCharaNotification", { profile, uuid, data: bytes.slice().buffer, length: bytes.length });
+        }
+    }
+    /**
+     * Changes fault probabilities mid-run, e.g. to degrade the link after the happy path is set up.
+     * disconnect_rate applies to connections made from now on.
+     * @param {Object} faults - Keys to change, see options.faults.
+     * @param {string} [dev_addr] - Only for this peripheral, otherwise the defaults for all of them.
+     */
+    setFaults(faults, dev_addr) {
+        if (dev_addr === undefined) {
+            Object.assign(this.#faults, faults);
+            return;
+        }
+        const peripheral = this.#peripherals.get(dev_addr.toLowerCase());
+        if (peripheral) Object.assign(peripheral.faults, faults);
+    }
+    /**
+     * Current value of a characteristic, as a hex string.
+     */
+    valueOf(dev_addr, uuid) {
+        const peripheral = this.#peripherals.get(dev_addr.toLowerCase());
+        const chara = peripheral && peripheral.gatt.get(uuid.toUpperCase());
+        return chara ? bytes2hex(chara.value) : undefined;
+    }
+
+    /* @zos/ble surface */
+
+    mstStartScan(callback) {
+        this.#count("mstStartScan");
+        this.#stopAdverts();
+        this.#scan_callback = callback;
+        for (const peripheral of this.#peripherals.values()) this.#advertise(peripheral);
+        return true;
+    }
+    mstStopScan() {
+        this.#count("mstStopScan");
+        this.#stopAdverts();
+        this.#scan_callback = null;
+        return true;
+    }
+    mstConnect(dev_addr_ab, callback) {
+        this.#count("mstConnect");
+        const dev_addr = ab2mac(dev_addr_ab);
+        const peripheral = this.#peripherals.get(dev_addr);
+        const overloaded = this.#connects_in_flight >= this.#connect_slots;
+        this.#connects_in_flight++;
+        this.#complete("connect", peripheral, () => {
+            this.#connects_in_flight--;
+            if (overloaded) this.injected.connect_overload = (this.injected.connect_overload || 0) + 1;
+            if (overloaded || !peripheral || !peripheral.in_range || this.#fault("connect_failure", peripheral)) {
+                callback({ dev_addr: mac2ab(dev_addr), connected: CONNECT_FAILED, connect_id: -1 });
+                return;
+            }
+            const connect_id = this.#next_connect_id++;
+            const connection = { dev_addr, callback, profiles: new Set(), drop_timer: null };
+            this.#connections.set(connect_id, connection);
+            this.#scheduleDrop(connect_id, connection, peripheral);
+            callback({ dev_addr: mac2ab(dev_addr), connected: CONNECTED, connect_id });
+        });
+        return true;
+    }
+    mstDisconnect(connect_id) {
+        this.#count("mstDisconnect");
+        const connection = this.#connections.get(connect_id);
+        if (!connection) return false;
+        const peripheral = this.#peripherals.get(connection.dev_addr);
+        this.clock.setTimeout(() => this.#drop(connect_id), this.#delay("disconnect", peripheral));
+        return true;
+    }
+    mstPair(connect_id) {
+        this.#count("mstPair");
+        return this.#connections.has(connect_id);
+    }
+    mstOnPrepare(callback) {
+        this.#count("mstOnPrepare");
+        this.#callbacks.mstOnPrepare = callback;
+    }
+    mstBuildProfile(profile_object) {
+        this.#count("mstBuildProfile");
+        if (!profile_object || !(profile_object.dev instanceof ArrayBuffer)) return false;
+        const dev_addr = ab2mac(profile_object.dev);
+        const peripheral = this.#peripherals.get(dev_addr);
+        this.#complete("prepare", peripheral, () => {
+            const connect_id = this.#connectionOf(dev_addr, profile_object.id);
+            if (connect_id === undefined) {
+                this.#emit("mstOnPrepare", { profile: 0, status: STATUS_FAIL });
+                return;
+            }
+            if (this.#fault("prepare_failure", peripheral)) {
+                this.#emit("mstOnPrepare", { profile: 0, status: this.#faultOption("prepare_status", peripheral) });
+                return;
+            }
+            const profile = this.#next_profile++;
+            this.#profiles.set(profile, connect_id);
+            this.#connections.get(connect_id).profiles.add(profile);
+            this.#emit("mstOnPrepare", { profile, status: STATUS_OK });
+        });
+        return true;
+    }
+    mstDestroyProfileInstance(profile) {
+        this.#count("mstDestroyProfileInstance");
+        const connect_id = this.#profiles.get(profile);
+        if (connect_id === undefined) return false;
+        this.#profiles.delete(profile);
+        this.#connections.get(connect_id).profiles.delete(profile);
+        return true;
+    }
+    mstReadCharacteristic(profile, uuid) {
+        this.#count("mstReadCharacteristic");
+        const peripheral = this.#peripheralOf(profile);
+        if (!peripheral) return false;
+        this.#complete("read", peripheral, () => {
+            const chara = !this.#fault("read_failure", peripheral) && peripheral.gatt.get(uuid.toUpperCase());
+            if (chara) {
+                this.#emit("mstOnCharaValueArrived", { profile, uuid, data: chara.value.slice().buffer, length: chara.value.length });
+            }
+            this.#emit("mstOnCharaReadComplete", { profile, uuid, status: chara ? STATUS_OK : STATUS_FAIL });
+        });
+        return true;
+    }
+    mstReadDescriptor(profile, chara_uuid, desc_uuid) {
+        this.#count("mstReadDescriptor");
+        const peripheral = this.#peripheralOf(profile);
+        if (!peripheral) return false;
+        this.#complete("read", peripheral, () => {
+            const chara = !this.#fault("read_failure", peripheral) && peripheral.gatt.get(chara_uuid.toUpperCase());
+            const value = chara && chara.descriptors.get(desc_uuid.toUpperCase());
+            if (value) {
+                this.#emit("mstOnDescValueArrived", { profile, chara: chara_uuid, desc: desc_uuid, data: value.slice().buffer, length: value.length });
+            }
+            this.#emit("mstOnDescReadComplete", { profile, chara: chara_uuid, desc: desc_uuid, status: value ? STATUS_OK : STATUS_FAIL });
+        });
+        return true;
+    }
+    mstWriteCharacteristic(profile, uuid, data, length) {
+        this.#count("mstWriteCharacteristic");
+        const peripheral = this.#peripheralOf(profile);
+        if (!peripheral || this.#fault("write_reject", peripheral)) return false;
+        const bytes = new Uint8Array(data, 0, length);
+        this.writes.push({ time: this.clock.now(), dev_addr: peripheral.dev_addr, uuid, desc: undefined, data: bytes2hex(bytes) });
+        this.#complete("write", peripheral, () => {
+            const chara = !this.#fault("write_failure", peripheral) && peripheral.gatt.get(uuid.toUpperCase());
+            if (chara) chara.value = bytes.slice();
+            this.#emit("mstOnCharaWriteComplete", { profile, uuid, status: chara ? STATUS_OK : STATUS_FAIL });
+        });
+        return true;
+    }
+    mstWriteDescriptor(profile, chara_uuid, desc_uuid, data, length) {
+        this.#count("mstWriteDescriptor");
+        const peripheral = this.#peripheralOf(profile);
+        if (!peripheral || this.#fault("write_reject", peripheral)) return false;
+        const bytes = new Uint8Array(data, 0, length);
+        this.writes.push({ time: this.clock.now(), dev_addr: peripheral.dev_addr, uuid: chara_uuid, desc: desc_uuid, data: bytes2hex(bytes) });
+        this.#complete("write", peripheral, () => {
+            const chara = !this.#fault("write_failure", peripheral) && peripheral.gatt.get(chara_uuid.toUpperCase());
+            const known = chara && chara.descriptors.has(desc_uuid.toUpperCase());
+            if (known) chara.descriptors.set(desc_uuid.toUpperCase(), bytes.slice());
+            this.#emit("mstOnDescWriteComplete", { profile, chara: chara_uuid, desc: desc_uuid, status: known ? STATUS_OK : STATUS_FAIL });
+        });
+        return true;
+    }
+    mstOnCharaReadComplete(callback) { this.#callbacks.mstOnCharaReadComplete = callback; }
+    mstOnCharaValueArrived(callback) { this.#callbacks.mstOnCharaValueArrived = callback; }
+    mstOnCharaWriteComplete(callback) { this.#callbacks.mstOnCharaWriteComplete = callback; }
+    mstOnDescReadComplete(callback) { this.#callbacks.mstOnDescReadComplete = callback; }
+    mstOnDescValueArrived(callback) { this.#callbacks.mstOnDescValueArrived = callback; }
+    mstOnDescWriteComplete(callback) { this.#callbacks.mstOnDescWriteComplete = callback; }
+    mstOnCharaNotification(callback) { this.#callbacks.mstOnCharaNotification = callback; }
+    mstOffAllCb() {
+        this.#count("mstOffAllCb");
+        this.#callbacks = {};
+    }
+
+    /* internals */
+
+    #count(name) {
+        this.calls[name] = (this.calls[name] || 0) + 1;
+    }
+    #emit(name, response) {
+        const callback = this.#callbacks[name];
+        if (callback) callback(response);
+    }
+    #delay(kind, peripheral) {
+        const latency = peripheral && peripheral.latency[kind] !== undefined ? peripheral.latency[kind] : this.#latency[kind];
+        if (Array.isArray(latency)) {
+            return Math.round(latency[0] + this.#random() * (latency[1] - latency[0]));
+        }
+        return latency;
+    }
+    /**
+     * Schedules a backend completion after its latency, unless the fault dice lose it or make it late.
+     */
+    #complete(kind, peripheral, callback) {
+        if (this.#fault("callback_loss", peripheral)) return;
+        let millis = this.#delay(kind, peripheral);
+        if (this.#fault("callback_delay", peripheral)) {
+            const delay = this.#faultOption("delay", peripheral);
+            millis += Array.isArray(delay) ? Math.round(delay[0] + this.#fault_random() * (delay[1] - delay[0])) : delay;
+        }
+        this.clock.setTimeout(callback, millis);
+    }
+    #faultOption(kind, peripheral) {
+        return peripheral && peripheral.faults[kind] !== undefined ? peripheral.faults[kind] : this.#faults[kind];
+    }
+    /**
+     * Rolls the dice for one fault kind and counts it when it hits.
+     */
+    #fault(kind, peripheral) {
+        const probability = this.#faultOption(kind, peripheral);
+        if (!probability || this.#fault_random() >= probability) return false;
+        this.injected[kind] = (this.injected[kind] || 0) + 1;
+        return true;
+    }
+    /**
+     * Exponentially distributed link lifetime for disconnect_rate, drops arrive as a Poisson process.
+     */
+    #scheduleDrop(connect_id, connection, peripheral) {
+        const rate = this.#faultOption("disconnect_rate", peripheral);
+        if (!rate) return;
+        const millis = Math.round(-Math.log(1 - this.#fault_random()) / rate * 1000);
+        connection.drop_timer = this.clock.setTimeout(() => {
+            connection.drop_timer = null;
+            this.injected.disconnect_rate = (this.injected.disconnect_rate || 0) + 1;
+            this.#drop(connect_id);
+        }, millis);
+    }
+    #advertise(peripheral) {
+        const tick = () => {
+            if (!this.#scan_callback || !peripheral.in_range) return;
+            if (!this.#fault("advert_loss", peripheral)) this.#scan_callback(this.#advert(peripheral));
+            this.#scan_timers.push(this.clock.setTimeout(tick, peripheral.advert_interval));
+        };
+        // random phase, so peripherals with the same interval do not advertise in lockstep
+        this.#scan_timers.push(this.clock.setTimeout(tick, Math.floor(this.#random() * peripheral.advert_interval)));
+    }
+    #advert(peripheral) {
+        return {
+            dev_addr: mac2ab(peripheral.dev_addr),
+            dev_name: peripheral.name,
+            rssi: peripheral.rssi + Math.round((this.#random() * 2 - 1) * RSSI_JITTER),
+            service_uuid_array: peripheral.service_uuids.slice(),
+            service_data_array: peripheral.service_data.map(({ uuid, data }) => ({ uuid, service_data: data.slice().buffer })),
+            vendor_id: peripheral.vendor_id,
+            vendor_data: peripheral.vendor_data ? peripheral.vendor_data.slice().buffer : undefined,
+        };
+    }
+    #stopAdverts() {
+        for (const timer of this.#scan_timers) this.clock.clearTimeout(timer);
+        this.#scan_timers = [];
+    }
+    #connectionOf(dev_addr, connect_id) {
+        const connection = this.#connections.get(connect_id);
+        if (connection && connection.dev_addr === dev_addr) return connect_id;
+        for (const [id, candidate] of this.#connections) {
+            if (candidate.dev_addr === dev_addr) return id;
+        }
+        return undefined;
+    }
+    #peripheralOf(profile) {
+        const connect_id = this.#profiles.get(profile);
+        if (connect_id === undefined) return null;
+        return this.#peripherals.get(this.#connections.get(connect_id).dev_addr) || null;
+    }
+    #drop(connect_id) {
+        const connection = this.#connections.get(connect_id);
+        if (!connection) return;
+        if (connection.drop_timer !== null) this.clock.clearTimeout(connection.drop_timer);
+        for (const profile of connection.profiles) this.#profiles.delete(profile);
+        this.#connections.delete(connect_id);
+        connection.callback({ dev_addr: mac2ab(connection.dev_addr), connected: DISCONNECTED, connect_id });
+    }
+}
+
+/* HELPERS */
+
+function hex2bytes(hex) {
+    const bytes = new Uint8Array(hex.length >> 1);
+    for (let i = 0; i < bytes.length; i++) bytes[i] = parseInt(hex.substr(i * 2, 2), 16);
+    return bytes;
+}
+
+function bytes2hex(bytes) {
+    let hex = "";
+    for (let i = 0; i < bytes.length; i++) hex += (bytes[i] < 16 ? "0" : "") + bytes[i].toString(16);
+    return hex;
+}
+
+function ab2mac(ab) {
+    return Array.from(new Uint8Array(ab), (byte) => byte.toString(16).padStart(2, "0")).join(":");
+}
+
+function mac2ab(mac) {
+    return new Uint8Array(mac.split(":").map((byte) => parseInt(byte, 16))).buffer;
+}
@@ -0,0 +1,182 @@
+/** @about Builds the single-file bundles from src/: every bundle is one ES module with only @zos/ble as an import,
+ * ready to be copied into an app's libs folder.
+ * Usage (from easy-ble/):
+ *   npm run build                       writes ble-master.js (and the example app's copy) and dist/*.js, prints their sizes and load times
+ *   npm run build -- --check            exits with 1 if a committed bundle or copy is not what src/ builds to, or a bundle is
+ *                                       over its size budget
+ *   npm run build -- --strip-logs --out=build/prod   LOG_STRIP = true, bundles written to build/prod/
+ * A bundle is its entry module with every relative import inlined (dependencies first) and the exports of the other
+ * modules dropped. An alias swaps a module for another one with the same exports, that is how diagnostics are left out.
+ * Top-level names must be unique across src/ (the build fails otherwise), renaming imports ("as") is not supported.
+ * Every bundle has a size budget (max_bytes), raise it on purpose when a change needs to. A bundle fails to build if it
+ * pulls in a module it excludes, that keeps the opt-in features out of the core bundle.
+ */
+import { readFileSync, writeFileSync, mkdirSync, existsSync } from 'node:fs';
+import { dirname, basename, join, relative, resolve } from 'node:path';
+import { fileURLToPath, pathToFileURL } from 'node:url';
+import { gzipSync } from 'node:zlib';
+import { parseArgs } from './common.js';
+
+const ROOT = fileURLToPath(new URL('..', import.meta.url));
+const SRC = join(ROOT, 'src');
+const WITHOUT_DIAGNOSTICS = { "diagnostics.js": "no-diagnostics.js" };
+const OPT_IN_FEATURES = ["power.js", "pool.js", "known.js", "admission.js", "sight.js", "scene.js", "session.js", "background.js", "wire.js"];
+
+const BUNDLES = [
+    { file: "ble-master.js", entry: "index.js", copies: ["../ble-master-example/libs/ble-master.js"], max_bytes: 210000 },
+    { file: "dist/ble-master-lite.js", entry: "index.js", alias: WITHOUT_DIAGNOSTICS, label: "lite", max_bytes: 195000 },
+    { file: "dist/ble-master-core.js", entry: "master-core.js", alias: WITHOUT_DIAGNOSTICS, label: "core", max_bytes: 86000, excludes: OPT_IN_FEATURES },
+    { file: "dist/ble-scan.js", entry: "scanner.js", alias: WITHOUT_DIAGNOSTICS, label: "scan", max_bytes: 40000 },
+    { file: "dist/ble-background.js", entry: "service.js", alias: WITHOUT_DIAGNOSTICS, label: "background", max_bytes: 70000 },
+    { file: "dist/ble-codecs.js", entry: "codecs.js", label: "codecs", max_bytes: 9000 },
+];
+
+const IMPORT_PATTERN = /^import\s+([\s\S]*?)\s+from\s+['"]([^'"]+)['"];?[ \t]*\n/gm;
+const REEXPORT_PATTERN = /^export\s*\{([^}]*)\}\s*from\s*['"]([^'"]+)['"];?[ \t]*$/gm;
+const DECLARATION_PATTERN = /^(?:export\s+)?(?:class|function|const|let|var)\s+([A-Za-z_$][\w$]*)/gm;
+const ABOUT_PATTERN = /^\/\*\* @about .*\*\/\n/;
+
+const args = parseArgs();
+
+const version = readFileSync(join(SRC, 'index.js'), 'utf8').match(/@about BLE Master (\S+)/)[1];
+
+/* BUNDLING */
+
+function bundle({ entry, alias = {}, label, excludes = [] }) {
+    const order = [];       // module files, dependencies first
+    const sources = {};
+    const externals = [];   // import statements of non-relative modules, deduplicated
+    const visit = (name, from) => {
+        name = alias[name] || name;
+        if (sources[name] !== undefined) return name;
+        const path = join(SRC, name);
+        if (!existsSync(path)) throw new Error(`${from}: cannot resolve ./${name}`);
+        sources[name] = null; // in progress, a cycle simply reuses the partial order
+        const text = readFileSync(path, 'utf8').replace(ABOUT_PATTERN, "");
+        for (const [statement, names, specifier] of text.matchAll(IMPORT_PATTERN)) {
+            if (!specifier.startsWith('./')) {
+                if (!externals.includes(statement.trim())) externals.push(statement.trim());
+                continue;
+            }
+            if (/\bas\b/.test(names)) throw new Error(`${name}: renamed imports are not supported: ${statement.trim()}`);
+            visit(specifier.slice(2), name);
+        }
+        sources[name] = text;
+        order.push(name);
+        return name;
+    };
+    const entry_name = visit(entry, "entry");
+    for (const [, , specifier] of sources[entry_name].matchAll(REEXPORT_PATTERN)) visit(specifier.slice(2), entry_name);
+
+    for (const name of order) {
+        if (excludes.includes(name)) throw new Error(`${entry}: pulls in ${name}, which this bundle excludes`);
+    }
+    checkImports(order, sources, alias);
+    checkCollisions(order, sources);
+
+    const parts = order.map((name) => {
+        let text = sources[name].replace(IMPORT_PATTERN, "");
+        if (name === entry_name) {
+            text = text.replace(REEXPORT_PATTERN, (statement, names) => `export {${names}};`);
+        } else {
+            text = text
+                .replace(/^export\s+(?=(?:class|function|const|let|var)\s)/gm, "")
+                .replace(/^export\s*\{[^}]*\}[^\n]*\n/gm, "")
+                .replace(/^export default [^\n]*\n/gm, "");
+        }
+        return `/* ${basename(name, '.js').replace(/-/g, " ").toUpperCase()} */\n\n` + text.trim() + "\n";
+    });
+    let code = `/** @about BLE Master ${version}${label ? " (" + label + ")" : ""} @min_zeppos 3.0 @author: Silver, Zepp Health. @license: MIT */\n` +
+        `// Built from easy-ble/src by dev/build.js (npm run build), edit the modules there.\n` +
+        externals.map((statement) => statement + "\n").join("") + "\n" + parts.join("\n");
+    if (args["strip-logs"]) code = code.replace("const LOG_STRIP = false;", "const LOG_STRIP = true;");
+    return { code, modules: order.length };
+}
+
+function exportsOf(text) {
+    const names = new Set();
+    for (const [, name] of text.matchAll(/^export\s+(?:class|function|const|let|var)\s+([A-Za-z_$][\w$]*)/gm)) names.add(name);
+    for (const [, list] of text.matchAll(/^export\s*\{([^}]*)\}/gm)) {
+        for (const name of list.split(",")) if (name.trim()) names.add(name.trim());
+    }
+    return names;
+}
+
+function checkImports(order, sources, alias) { // every named import must exist in the module it resolves to, after aliasing
+    for (const name of order) {
+        const lists = [...sources[name].matchAll(IMPORT_PATTERN), ...sources[name].matchAll(REEXPORT_PATTERN)];
+        for (const match of lists) {
+            const [statement] = match;
+            const specifier = statement.match(/['"]([^'"]+)['"]/)[1];
+            if (!specifier.startsWith('./')) continue;
+            const target = alias[specifier.slice(2)] || specifier.slice(2);
+            const list = statement.match(/\{([^}]*)\}/);
+            if (!list) throw new Error(`${name}: only named imports of relative modules are supported: ${statement.trim()}`);
+            const provided = exportsOf(sources[target]);
+            for (const imported of list[1].split(",").map((part) => part.trim()).filter(Boolean)) {
+                if (!provided.has(imported)) throw new Error(`${name}: ${target} does not export ${imported}`);
+            }
+        }
+    }
+}
+
+function checkCollisions(order, sources) { // modules share one scope once inlined
+    const owner = {};
+    for (const name of order) {
+        for (const [, declared] of sources[name].replace(/^\s*\/\*[\s\S]*?\*\//gm, "").matchAll(DECLARATION_PATTERN)) {
+            if (owner[declared] && owner[declared] !== name) {
+                throw new Error(`${declared} is declared in both ${owner[declared]} and ${name}`);
+            }
+            owner[declared] = name;
+        }
+    }
+}
+
+/* RUN */
+
+const out_dir = args.out ? resolve(args.out) : ROOT;
+const results = [];
+let stale = 0;
+for (const config of BUNDLES) {
+    const { code, modules } = bundle(config);
+    const file = args.out ? join(out_dir, basename(config.file)) : join(ROOT, config.file);
+    const copies = args.out || !config.copies ? [] : config.copies.map((copy) => join(ROOT, copy)); // committed next to their users
+    for (const target of [file, ...copies]) {
+        if (args.check) {
+            const current = existsSync(target) ? readFileSync(target, 'utf8') : "";
+            if (current !== code) {
+                console.log(`${relative(process.cwd(), target)} is out of date, run npm run build`);
+                stale++;
+            }
+        } else {
+            mkdirSync(dirname(target), { recursive: true });
+            writeFileSync(target, code);
+        }
+    }
+    const bytes = Buffer.byteLength(code);
+    if (bytes > config.max_bytes) {
+        console.log(`${relative(process.cwd(), file)} is ${bytes} bytes, over its budget of ${config.max_bytes}`);
+        stale++;
+    }
+    results.push({ file, modules, bytes, max_bytes: config.max_bytes, gzip: gzipSync(code).length });
+}
+if (args.check) process.exit(stale ? 1 : 0);
+
+// load time: fresh import of each bundle (read, parse, evaluate), best of a few rounds
+const ROUNDS = 5;
+for (let round = 0; round < ROUNDS; round++) {
+    for (const result of results) {
+        const t0 = performance.now();
+        await import(pathToFileURL(result.file).href + "?round=" + round);
+        const millis = performance.now() - t0;
+        if (round > 0 && !(result.load <= millis)) result.load = millis; // round 0 warms up the loader
+    }
+}
+
+const width = Math.max(...results.map(({ file }) => relative(process.cwd(), file).length)) + 2;
+console.log("bundle".padEnd(width) + "modules".padEnd(9) + "bytes".padEnd(9) + "budget".padEnd(9) + "gzip".padEnd(8) + "load");
+for (const { file, modules, bytes, max_bytes, gzip, load } of results) {
+    console.log(relative(process.cwd(), file).padEnd(width) + String(modules).padEnd(9) + String(bytes).padEnd(9) +
+        String(max_bytes).padEnd(9) + String(gzip).padEnd(8) + load.toFixed(2) + "ms");
+}
+if (stale) process.exitCode = 1;
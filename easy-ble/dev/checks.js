@@ -0,0 +1,310 @@
+/** @about Lifecycle checks: cancelled, lost, refused and malformed operations must leave no state behind. Exits with 1 if a check fails.
+ * Usage (from easy-ble/):
+ *   npm run checks                              every check
+ *   npm run checks -- --filter=session          only the checks whose name contains "session"
+ *   npm run checks -- --verbose                 with the library's log
+ * Every check runs on a fresh simulator on virtual time. The scenario scripts (npm run sight, scene...) measure,
+ * these assert the paths the scenarios never take.
+ */
+import BLEMaster, { BLESession, CancelToken, ScanEngine, ConnectionPool, runScene, LOG_LEVEL, TRACE_OP, WireBatch, WIRE_FORMAT, decodeFrame, data2ab, str2ab_with_len } from '../ble-master.js';
+import BLEMasterCore from '../dist/ble-master-core.js';
+import { BLESimulator } from './ble-sim.js';
+import { parseArgs, LAMP_CHARA as CHARA, LAMP_PROFILE as PROFILE, lampPeripheral } from './common.js';
+
+const args = parseArgs();
+BLEMaster.setLogLevel(args.verbose ? LOG_LEVEL.DEBUG : LOG_LEVEL.NONE); // the checks provoke errors on purpose
+BLEMasterCore.setLogLevel(args.verbose ? LOG_LEVEL.DEBUG : LOG_LEVEL.NONE); // the core bundle has its own logger
+
+const LAMP = "a1:a2:a3:a4:a5:01";
+const LAMP2 = "a1:a2:a3:a4:a5:02";
+
+function simulator(options = {}) {
+    return new BLESimulator({
+        seed: 1,
+        latency: { connect: [300, 600], prepare: [400, 800], write: [20, 60] },
+        peripherals: [lampPeripheral(LAMP, 1)],
+        ...options,
+    });
+}
+
+function lostAndLamp() { // LAMP never answers a connect, LAMP2 does
+    return simulator({ peripherals: [
+        lampPeripheral(LAMP, 1, { faults: { callback_loss: 1 } }),
+        lampPeripheral(LAMP2, 2),
+    ] });
+}
+
+const checks = [
+    ["session: a cancelled connect does not block the next page", () => {
+        const sim = simulator();
+        const session = new BLESession({ transport: sim, clock: sim.clock });
+        const a = session.attach(), token = new CancelToken();
+        a.connect(LAMP, () => {}, { signal: token });
+        sim.clock.advance(50);
+        token.cancel();
+        a.detach();
+        const b = session.attach();
+        let connected = -1;
+        const accepted = b.connect(LAMP, (result) => { connected = result.connected; });
+        sim.clock.advance(2000);
+        return [
+            expect("connect accepted", accepted, true),
+            expect("mstConnect calls", sim.calls.mstConnect, 2),
+            expect("page B connected", connected, 0),
+        ];
+    }],
+    ["session: a page's token does not stop a device another page joined", () => {
+        const sim = simulator();
+        const session = new BLESession({ transport: sim, clock: sim.clock });
+        const a = session.attach(), b = session.attach(), token = new CancelToken();
+        let a_result = -1, b_result = -1;
+        a.connect(LAMP, (result) => { a_result = result.connected; }, { signal: token });
+        b.connect(LAMP, (result) => { b_result = result.connected; });
+        sim.clock.advance(50);
+        token.cancel();
+        sim.clock.advance(2000);
+        const joined_in_flight = [expect("page B connected", b_result, 0), expect("page A not called back", a_result, -1)];
+        const token2 = new CancelToken();
+        a.connect(LAMP, () => {}, { signal: token2 });
+        sim.clock.advance(50);
+        token2.cancel();
+        sim.clock.advance(2000);
+        return [
+            ...joined_in_flight,
+            expect("still connected after A's second cancel", session.get.isConnected(LAMP), true),
+            expect("mstConnect calls", sim.calls.mstConnect, 1),
+        ];
+    }],
+    ["session: the last page's cancel stops the device", () => {
+        const sim = simulator();
+        const session = new BLESession({ transport: sim, clock: sim.clock });
+        const a = session.attach(), token = new CancelToken();
+        a.connect(LAMP, () => {}, { signal: token });
+        sim.clock.advance(2000);
+        token.cancel();
+        sim.clock.advance(2000);
+        return [expect("connected", session.get.isConnected(LAMP), false)];
+    }],
+    ["session: a cancelled startListener does not block the next page", () => {
+        const sim = simulator();
+        const session = new BLESession({ transport: sim, clock: sim.clock });
+        const a = session.attach(), token = new CancelToken();
+        a.connect(LAMP, (result) => {
+            if (result.connected === 0) a.startListener(a.modifyProfileObject(LAMP, PROFILE), () => {}, { signal: token });
+        }, { signal: token });
+        sim.clock.advance(700);
+        token.cancel(); // the connect is done, the profile is being built: A lets go of both
+        a.detach();
+        sim.clock.advance(2000);
+        const b = session.attach();
+        let status = null;
+        b.connect(LAMP, (result) => {
+            if (result.connected === 0) b.startListener(b.modifyProfileObject(LAMP, PROFILE), (s) => { status = s; });
+        });
+        sim.clock.advance(3000);
+        return [expect("page B profile status", status, 0), expect("mstBuildProfile calls", sim.calls.mstBuildProfile, 2)];
+    }],
+    ["session: a page's cancelled startListener does not drop another page's", () => {
+        const sim = simulator();
+        const session = new BLESession({ transport: sim, clock: sim.clock });
+        const a = session.attach(), b = session.attach(), token = new CancelToken();
+        let a_status = null, b_status = null;
+        a.connect(LAMP, (result) => {
+            if (result.connected !== 0) return;
+            a.startListener(a.modifyProfileObject(LAMP, PROFILE), (s) => { a_status = s; }, { signal: token });
+            b.startListener(b.modifyProfileObject(LAMP, PROFILE), (s) => { b_status = s; });
+        });
+        sim.clock.advance(700);
+        token.cancel();
+        sim.clock.advance(3000);
+        return [expect("page B profile status", b_status, 0), expect("page A not called back", a_status, null)];
+    }],
+    ["pool: a connect the backend never answers gives its slot back", () => {
+        const sim = lostAndLamp();
+        const ble = new BLEMaster({ transport: sim, clock: sim.clock, pool: { max: 1 } });
+        let lost = -1, connected = -1;
+        ble.connect(LAMP, (result) => { lost = result.connected; });
+        sim.clock.advance(12000); // past the connect watchdog
+        const cancelled = new CancelToken();
+        ble.connect(LAMP, () => {}, { signal: cancelled });
+        sim.clock.advance(50);
+        cancelled.cancel();
+        const accepted = ble.connect(LAMP2, (result) => { connected = result.connected; });
+        sim.clock.advance(2000);
+        return [
+            expect("lost connect timed out", lost, 1),
+            expect("connect accepted", accepted, true),
+            expect("second lamp connected", connected, 0),
+            expect("pool rejected", ble.pool.report().rejected, 0),
+        ];
+    }],
+    ["admission: a cancelled connect in flight gives its slot back", () => {
+        const sim = lostAndLamp();
+        const ble = new BLEMaster({ transport: sim, clock: sim.clock, admission: { concurrency: 1 } });
+        const token = new CancelToken();
+        let connected = -1;
+        ble.connect(LAMP, () => {}, { signal: token });
+        sim.clock.advance(50);
+        token.cancel();
+        ble.connect(LAMP2, (result) => { connected = result.connected; });
+        sim.clock.advance(2000);
+        return [expect("second lamp connected", connected, 0), expect("in flight", ble.admission.in_flight, 0)];
+    }],
+    ["admission: a scene timeout does not wedge the queue", () => {
+        const sim = lostAndLamp();
+        const ble = new BLEMaster({ transport: sim, clock: sim.clock, admission: { concurrency: 1 } });
+        let report = null, connected = -1;
+        ble.scene([{ dev_addr: LAMP, uuid: CHARA, data: "00" }], (r) => { report = r; }, { profile: PROFILE, timeout: 2000 });
+        sim.clock.advance(2500);
+        ble.connect(LAMP2, (result) => { connected = result.connected; });
+        sim.clock.advance(2000);
+        return [
+            expect("scene result", report && report.devices[LAMP].result, "timeout"),
+            expect("second lamp connected", connected, 0),
+            expect("in flight", ble.admission.in_flight, 0),
+        ];
+    }],
+    ["scene: a failed scene leaves a device the page connected to the page", () => {
+        const sim = simulator({ latency: { connect: 300, prepare: 400, write: 3000 } });
+        const ble = new BLEMaster({ transport: sim, clock: sim.clock });
+        const page = new CancelToken();
+        let report = null;
+        ble.connect(LAMP, () => {}, { signal: page });
+        sim.clock.advance(1000);
+        ble.scene([{ dev_addr: LAMP, uuid: CHARA, data: "01" }], (r) => { report = r; }, { profile: PROFILE, timeout: 1500 }); // prepared, times out in the write
+        sim.clock.advance(2000);
+        const kept = ble.get.isConnected(LAMP);
+        page.cancel();
+        sim.clock.advance(1000);
+        return [
+            expect("scene result", report && report.devices[LAMP].result, "timeout"),
+            expect("connected after the scene", kept, true),
+            expect("connected after the page's cancel", ble.get.isConnected(LAMP), false),
+        ];
+    }],
+    ["core: the core bundle builds no feature in, injected ones work", () => {
+        const sim = simulator({ latency: { connect: 300, prepare: 400, write: 30 } });
+        const bare = new BLEMasterCore({ transport: sim, clock: sim.clock, pool: true });
+        const scene_started = bare.scene([{ dev_addr: LAMP, uuid: CHARA, data: "01" }], () => {}, { profile: PROFILE });
+        const ble = new BLEMasterCore({ transport: sim, clock: sim.clock, pool: { use: ConnectionPool, max: 1 }, scene: runScene });
+        let report = null;
+        ble.scene([{ dev_addr: LAMP, uuid: CHARA, data: "01" }], (r) => { report = r; }, { profile: PROFILE });
+        sim.clock.advance(2000);
+        return [
+            expect("pool: true without a built-in pool", bare.pool, null),
+            expect("scene without options.scene", scene_started, false),
+            expect("injected pool max", ble.pool && ble.pool.report().max, 1),
+            expect("injected scene done", report && report.done, true),
+            expect("pool links", ble.pool && ble.pool.size, 1),
+        ];
+    }],
+    ["trace: a read is counted once, its value separately", () => {
+        const sim = simulator({ latency: { connect: 300, prepare: 400, read: 30 } });
+        const ble = new BLEMaster({ transport: sim, clock: sim.clock, trace: 64 });
+        ble.connect(LAMP, (result) => {
+            if (result.connected === 0) ble.startListener(ble.modifyProfileObject(LAMP, PROFILE), (status) => {
+                if (status === 0) ble.read.characteristic(LAMP, CHARA);
+            });
+        });
+        sim.clock.advance(2000);
+        const { counters, latency } = ble.get.stats();
+        const ops = ble.trace.records().map((record) => record.op);
+        return [
+            expect("read_result counter", counters.read_result, 1),
+            expect("value counter", counters.value, 1),
+            expect("read latency samples", latency.read.count, 1),
+            expect("READ_RESULT records", ops.filter((op) => op === TRACE_OP.READ_RESULT).length, 1),
+            expect("VALUE records", ops.filter((op) => op === TRACE_OP.VALUE).length, 1),
+        ];
+    }],
+    ["watchdog: a second write to a characteristic does not drop the first one's deadline", () => {
+        const sim = simulator();
+        const ble = new BLEMaster({ transport: sim, clock: sim.clock });
+        ble.connect(LAMP, (result) => {
+            if (result.connected === 0) ble.startListener(ble.modifyProfileObject(LAMP, PROFILE), () => {});
+        });
+        sim.clock.advance(2000);
+        const statuses = [];
+        ble.on.charaWriteComplete(({ status }) => statuses.push(status));
+        ble.write.characteristic(LAMP, CHARA, "01");
+        ble.write.characteristic(LAMP, CHARA, "02");
+        sim.clock.advance(200);
+        const answered = statuses.join(",");
+        sim.setFaults({ callback_loss: 1 }, LAMP);
+        ble.write.characteristic(LAMP, CHARA, "03");
+        ble.write.characteristic(LAMP, CHARA, "04");
+        sim.clock.advance(6000); // past the write watchdog
+        const { latency, errors } = ble.get.stats();
+        return [
+            expect("answered writes", answered, "0,0"),
+            expect("write latency samples", latency.write.count, 2),
+            expect("lost writes called back", statuses.slice(2).join(","), "-1,-1"),
+            expect("write timeouts", errors.write.timeout, 2),
+        ];
+    }],
+    ["background: a second start neither restarts the scan nor adds a flush timer", () => {
+        const sim = simulator();
+        const engine = new ScanEngine({ transport: sim, clock: sim.clock });
+        const token = new CancelToken();
+        const first = engine.start({ signal: token });
+        const timers = sim.clock.pending;
+        const second = engine.start({ signal: token });
+        const results = [
+            expect("first start", first, true),
+            expect("second start", second, false),
+            expect("mstStartScan calls", sim.calls.mstStartScan, 1),
+            expect("timers after the second start", sim.clock.pending, timers),
+        ];
+        sim.clock.advance(3000);
+        engine.stop();
+        engine.start();
+        token.cancel(); // the first run's token, stop() let go of it
+        results.push(expect("running after the old token's cancel", engine.running, true));
+        engine.stop();
+        return results;
+    }],
+    ["codecs: str2ab_with_len returns a buffer for every string, data2ab rejects chars above 0xFF", () => {
+        const converted = str2ab_with_len("a\u0101");
+        return [
+            expect("str2ab_with_len data_len", converted && converted.data_len, 2),
+            expect("str2ab_with_len bytes", converted && Array.from(new Uint8Array(converted.data_ab)).join(","), "97,1"),
+            expect("data2ab", data2ab("a\u0101"), null),
+        ];
+    }],
+    ["wire: a malformed message does not cost the batch its other messages", () => {
+        const results = [];
+        for (const format of [WIRE_FORMAT.BINARY, WIRE_FORMAT.JSON]) {
+            const frames = [];
+            const batch = new WireBatch({ format, deliver: (frame) => frames.push(frame) });
+            const valid = batch.push({ dev_addr: LAMP, uuid: CHARA, time: 1, data: new Uint8Array([1, 2]) });
+            const malformed = batch.push({ dev_addr: "not a mac", uuid: CHARA, time: 2, data: new Uint8Array([3]) });
+            const no_seq = batch.push({ time: 3, full: false, upsert: [], remove: [] });
+            batch.flush();
+            const messages = frames.length === 1 ? decodeFrame(frames[0]) : null;
+            results.push(
+                expect(format + " valid push", valid, true),
+                expect(format + " malformed push", malformed, false),
+                expect(format + " diff without seq", no_seq, false),
+                expect(format + " frames", frames.length, 1),
+                expect(format + " messages in the frame", messages && messages.length, 1),
+            );
+        }
+        return results;
+    }],
+];
+
+let failed = 0, ran = 0;
+for (const [name, check] of checks) {
+    if (args.filter && !name.includes(args.filter)) continue;
+    ran++;
+    const failures = check().filter((failure) => failure !== null);
+    console.log((failures.length ? "FAIL " : "ok   ") + name);
+    for (const failure of failures) console.log("       " + failure);
+    if (failures.length) failed++;
+}
+console.log(`${ran - failed}/${ran} checks passed`);
+process.exit(failed ? 1 : 0);
+
+function expect(what, actual, expected) {
+    return actual === expected ? null : `${what}: expected ${expected}, got ${actual}`;
+}
@@ -0,0 +1,117 @@
+/** @about Helpers shared by the dev scripts: command line, table output, the lamp fixture of the scenarios, stats and checks.
+ * Nothing here imports the library, so build.js can use it before ble-master.js exists.
+ */
+
+/**
+ * Parses --key=value and --flag arguments. Arguments without "--" and "=" are collected in order in args._.
+ * @param {Array<string>} [argv] - Defaults to the arguments of the running script.
+ * @returns {Object} Returns { key: value, flag: true, _: [positional] }, values are strings.
+ */
+export function parseArgs(argv = process.argv.slice(2)) {
+    const args = { _: [] };
+    for (const arg of argv) {
+        if (!arg.startsWith("--") && !arg.includes("=")) {
+            args._.push(arg);
+            continue;
+        }
+        const [key, value] = arg.replace(/^--/, "").split("=");
+        args[key] = value === undefined ? true : value;
+    }
+    return args;
+}
+
+export function pad(value, width) {
+    return String(value).padEnd(width);
+}
+
+/**
+ * @param {Array<number>} widths - Column widths, the last cell is never padded.
+ * @param {Array<any>} cells
+ * @returns {string} Returns one table line.
+ */
+export function row(widths, cells) {
+    return cells.map((cell, i) => i === cells.length - 1 ? String(cell) : pad(cell, widths[i])).join("");
+}
+
+/* THE LAMP FIXTURE: service A032 with the writable characteristic A040, like the example page's device */
+
+export const LAMP_SERVICE = "A032";
+export const LAMP_CHARA = "A040";
+export const LAMP_PROFILE = {
+    pair: true, id: 0, profile: "none", dev: null, len: 1,
+    list: [{
+        uuid: true, size: 1, len: 1,
+        list: [{ uuid: LAMP_SERVICE, permission: 0, desc: 1, len: 1, list: [{ uuid: LAMP_CHARA, permission: 32, desc: 0, len: 0, list: [] }] }],
+    }],
+};
+export const LAMP_PROFILE_CCCD = { // the same with the characteristic's 2902 descriptor
+    ...LAMP_PROFILE,
+    list: [{
+        uuid: true, size: 1, len: 1,
+        list: [{ uuid: LAMP_SERVICE, permission: 0, desc: 1, len: 1, list: [{ uuid: LAMP_CHARA, permission: 32, desc: 0, len: 1, list: [{ uuid: "2902", permission: 32 }] }] }],
+    }],
+};
+export const SCALE = { mac: "b1:b2:b3:b4:b5:b6", name: "scale", advert_interval: 150, service_uuids: ["181D"] }; // busy advertiser that is never a target
+
+/**
+ * @param {number} count
+ * @returns {Array<string>} Returns the MACs a1:a2:a3:a4:a5:00, :01, ...
+ */
+export function lampMacs(count) {
+    return Array.from({ length: count }, (_, i) => "a1:a2:a3:a4:a5:" + i.toString(16).padStart(2, "0"));
+}
+
+/**
+ * @param {string} mac
+ * @param {number} index - Names it "lamp" + index.
+ * @param {Object} [options] - Simulator peripheral fields that replace the defaults (advert_interval 300, faults, latency...).
+ * @returns {Object} Returns a BLESimulator peripheral with the lamp's GATT table.
+ */
+export function lampPeripheral(mac, index, options = {}) {
+    return {
+        mac, name: "lamp" + index, advert_interval: 300, service_uuids: [LAMP_SERVICE],
+        gatt: { [LAMP_SERVICE]: { [LAMP_CHARA]: { value: "00" } } },
+        ...options,
+    };
+}
+
+/* STATS */
+
+export function mean(values) {
+    return values.reduce((sum, x) => sum + x, 0) / values.length;
+}
+
+/**
+ * @param {Array<number>} sorted - Ascending.
+ * @param {number} p - 0..1.
+ */
+export function percentile(sorted, p) {
+    return sorted[Math.min(sorted.length - 1, Math.floor(sorted.length * p))];
+}
+
+/* CHECKS */
+
+/**
+ * @param {string} what - What the scenario is expected to show, phrased as a statement.
+ * @param {boolean} holds
+ * @returns {Object} Returns { what, ok }.
+ */
+export function claim(what, holds) {
+    return { what, ok: !!holds };
+}
+
+/**
+ * Prints the failed claims and a count (unless quiet, e.g. for --json) and sets the exit code to 1 if one of them failed.
+ * @param {Array<Object>} claims - claim() results.
+ * @param {boolean} [quiet=false]
+ * @returns {boolean} Returns true if every claim holds.
+ */
+export function verdict(claims, quiet = false) {
+    const failed = claims.filter((c) => !c.ok);
+    if (!quiet) {
+        for (const c of failed) console.log("FAIL " + c.what);
+        console.log(`${claims.length - failed.length}/${claims.length} checks passed`);
+    }
+    if (failed.length) process.exitCode = 1;
+    return failed.length === 0;
+}
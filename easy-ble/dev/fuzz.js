@@ -0,0 +1,350 @@
+/** @about Seeded fuzzers for the library boundary: payload encoders, MAC parsing, scan result shapes, profile objects
+ * and wire frames.
+ * Usage (from easy-ble/):
+ *   npm run fuzz                                 20000 inputs per target, seed 1
+ *   npm run fuzz -- --runs=200000 --seed=42      more inputs, another seed
+ *   npm run fuzz -- --target=data2ab             one target: data2ab, mac2ab, scan, profile, wire
+ * Every input must either be accepted with a correct result or rejected cleanly (null / false / { success: false }),
+ * never throw and never reach the backend malformed. The first failing input is printed with its seed, exit code 1.
+ */
+import BLEMaster, { ab2mac, mac2ab, ab2str_stripped, data2ab, encodeFrame, decodeFrame, WIRE_FORMAT, LOG_LEVEL } from '../ble-master.js';
+import { createRandom } from './ble-sim.js';
+import { parseArgs } from './common.js';
+
+const args = parseArgs();
+const RUNS = Number(args.runs || 20000);
+const SEED = Number(args.seed || 1);
+
+BLEMaster.setLogLevel(LOG_LEVEL.NONE); // rejections log errors, thousands of them
+
+const random = createRandom(SEED);
+const int = (max) => Math.floor(random() * max);
+const pick = (items) => items[int(items.length)];
+const chance = (p) => random() < p;
+
+/* GENERATORS */
+
+const HEX = "0123456789abcdefABCDEF";
+function hexString(length) {
+    let out = "";
+    for (let i = 0; i < length; i++) out += HEX[int(HEX.length)];
+    return out;
+}
+function anyString(length) {
+    let out = "";
+    for (let i = 0; i < length; i++) {
+        out += String.fromCharCode(pick([int(0x80), 0x80 + int(0x80), 0x100 + int(0xFF00), 0xD800 + int(0x800)]));
+    }
+    return out;
+}
+function bytes(length) {
+    return Uint8Array.from({ length }, () => int(256));
+}
+function junk() {
+    return pick([undefined, null, 0, -1, NaN, 1.5, true, {}, [], [1, 2], () => {}, Symbol("x"), 10n, new Date(0), "", "zz"]);
+}
+
+function dataInput() {
+    switch (int(7)) {
+        case 0: return hexString(int(40));                          // even or odd length, mixed case
+        case 1: return hexString(2 * int(20));                      // even length
+        case 2: return anyString(int(20));                          // latin1, non-latin1, lone surrogates
+        case 3: return bytes(int(32)).buffer;
+        case 4: return pick([Uint8Array, Int8Array, Uint16Array, DataView]).name === "DataView"
+            ? new DataView(bytes(16).buffer, int(8), int(8)) : new (pick([Uint8Array, Int8Array, Uint16Array]))(bytes(16).buffer, 0, 4);
+        case 5: return hexString(int(10)) + pick([" ", "g", "-", "é", "中"]) + hexString(int(10));
+        default: return junk();
+    }
+}
+
+function macInput() {
+    const valid = Array.from({ length: 6 }, () => hexString(2)).join(":");
+    switch (int(8)) {
+        case 0: return valid;
+        case 1: return valid.toUpperCase();
+        case 2: return valid.slice(0, int(17));                          // truncated
+        case 3: return valid + pick([":", "0", ":00"]);                  // too long
+        case 4: return valid.replace(/:/g, pick(["-", ".", "", " "]));  // other separators
+        case 5: { const at = int(17); return valid.slice(0, at) + pick(["g", "z", " ", "é", ":", "x"]) + valid.slice(at + 1); }
+        case 6: return anyString(17);
+        default: return junk();
+    }
+}
+
+function scanInput() {
+    if (chance(0.05)) return junk();
+    const result = {
+        dev_addr: pick([() => bytes(6).buffer, () => bytes(6).buffer, () => bytes(int(10)).buffer, () => bytes(6), junk])(),
+        dev_name: pick(["tag", "", undefined, 5, anyString(int(8))]),
+        rssi: pick([-60, 0, undefined, "x", NaN]),
+        vendor_id: pick([undefined, 0x157, -1, "x"]),
+        vendor_data: pick([() => bytes(int(31)).buffer, () => undefined, () => bytes(4), junk])(),
+        service_uuid_array: pick([["181D"], [], undefined, "181D", [undefined]]),
+        service_data_array: pick([
+            () => [{ uuid: "181D", service_data: bytes(int(8)).buffer }],
+            () => [],
+            () => undefined,
+            () => [null],
+            () => [{ uuid: "181D" }],
+            () => [{ uuid: 5, service_data: "ff" }],
+            junk,
+        ])(),
+    };
+    if (chance(0.1)) delete result[pick(Object.keys(result))];
+    return result;
+}
+
+const VALID_PROFILE = () => ({
+    pair: true,
+    id: 1,
+    profile: "tag",
+    dev: bytes(6).buffer,
+    len: 1,
+    list: [{
+        uuid: true, size: 1, len: 1,
+        list: [{
+            uuid: "00001530-0000-3512-2118-0009af100700", permission: 0, serv: 0, len1: 2, len2: 2,
+            list: [
+                { uuid: "00001531-0000-3512-2118-0009af100700", permission: 32, desc: 1, len: 1, list: [{ uuid: "2902", permission: 0 }] },
+                { uuid: "2A04", permission: 16 },
+            ],
+        }],
+    }],
+});
+function profileInput() {
+    if (chance(0.05)) return junk();
+    const profile = VALID_PROFILE();
+    const nodes = [profile, profile.list[0], profile.list[0].list[0], ...profile.list[0].list[0].list, profile.list[0].list[0].list[0].list[0]];
+    for (let m = int(3); m > 0; m--) { // 0..2 mutations
+        const node = pick(nodes);
+        const key = pick(Object.keys(node));
+        switch (int(4)) {
+            case 0: delete node[key]; break;
+            case 1: node[key] = junk(); break;
+            case 2: node[key] = pick([dataInput(), macInput()]); break;
+            default: if (Array.isArray(node.list)) node.list.push(pick([null, {}, { uuid: "2902" }, { uuid: "xyz" }])); break;
+        }
+    }
+    return profile;
+}
+
+function wireMac() {
+    return Array.from({ length: 6 }, () => hexString(2)).join(":");
+}
+function wireMessage() { // well-formed, with every optional field shape the service can produce
+    if (chance(0.5)) {
+        return {
+            dev_addr: wireMac(), uuid: pick(["2A37", "00002a37-0000-1000-8000-00805f9b34fb", ""]), time: 1700000000000 + int(100000),
+            data: pick([() => bytes(int(40)).buffer, () => bytes(int(8)), () => new DataView(bytes(8).buffer, int(4))])(),
+        };
+    }
+    const upsert = [];
+    for (let i = int(6); i > 0; i--) {
+        upsert.push(wireMac().toLowerCase(), pick(["tag", "", undefined, anyString(int(8))]), -int(100), int(5000),
+            pick([undefined, 0x157, 0]), pick([hexString(2 * int(16)).toLowerCase(), "", undefined, anyString(int(6))]),
+            pick([["181D", "180F"], [], undefined]),
+            pick([[{ uuid: "181D", service_data: hexString(2 * int(4)).toLowerCase() }], [], undefined]));
+    }
+    return { seq: int(1000), time: 1700000000000 + int(100000), full: chance(0.2), upsert, remove: Array.from({ length: int(3) }, () => wireMac().toLowerCase()) };
+}
+function wireInput() {
+    const messages = Array.from({ length: int(5) }, wireMessage);
+    if (chance(0.2)) { // break one message
+        const message = messages[0] || (messages[0] = wireMessage());
+        const key = pick(Object.keys(message));
+        message[key] = key === "upsert" ? pick([[1, 2], ["zz", ...Array(7)]]) : key === "time" || key === "seq" ? pick([undefined, -1, 0.5, "7", NaN])
+            : key === "full" ? message[key] : junk();
+    }
+    return { messages, format: pick([WIRE_FORMAT.BINARY, WIRE_FORMAT.JSON]), corrupt: chance(0.3) };
+}
+
+/* ORACLES */
+
+function checkData(input) {
+    const out = data2ab(input);
+    if (out === null) {
+        const acceptable = !(input instanceof ArrayBuffer) && !ArrayBuffer.isView(input) &&
+            (typeof input !== "string" || (/^[0-9A-Fa-f]+$/.test(input) && input.length % 2 === 1) || /[^\u0000-ÿ]/.test(input));
+        return acceptable ? null : "rejected a valid input";
+    }
+    if (!(out instanceof ArrayBuffer)) return "returned " + typeof out;
+    if (input instanceof ArrayBuffer) return out === input ? null : "did not pass the ArrayBuffer through";
+    if (ArrayBuffer.isView(input)) {
+        const expected = new Uint8Array(input.buffer, input.byteOffset, input.byteLength);
+        return same(new Uint8Array(out), expected) ? null : "typed array bytes differ";
+    }
+    if (typeof input !== "string") return "accepted a " + typeof input;
+    if (/^[0-9A-Fa-f]+$/.test(input)) {
+        if (input.length % 2) return "accepted an odd-length hex string";
+        return ab2str_stripped(out) === input.toLowerCase() ? null : "hex round trip differs";
+    }
+    const decoded = new Uint8Array(out);
+    if (decoded.length !== input.length) return "text length differs";
+    for (let i = 0; i < input.length; i++) {
+        if (decoded[i] !== input.charCodeAt(i)) return "text byte " + i + " differs";
+    }
+    return null;
+}
+
+function checkMac(input) {
+    const out = mac2ab(input);
+    const valid = typeof input === "string" && /^([0-9A-Fa-f]{2}:){5}[0-9A-Fa-f]{2}$/.test(input);
+    if (out === null) return valid ? "rejected a valid MAC" : null;
+    if (!valid) return "accepted a malformed MAC";
+    if (!(out instanceof ArrayBuffer) || out.byteLength !== 6) return "not a 6 byte ArrayBuffer";
+    return ab2mac(out) === input.toLowerCase() ? null : "round trip differs";
+}
+
+// the scan callback and startListener run against a transport that records what reaches the backend
+let scan_callback = null;
+let prepare_callback = null;
+const built = [];
+const transport = {
+    mstStartScan: (callback) => { scan_callback = callback; return true; },
+    mstStopScan: () => true,
+    mstOnPrepare: (callback) => { prepare_callback = callback; },
+    mstBuildProfile: (profile) => { // answered right away, profiles are built one at a time
+        built.push(profile);
+        prepare_callback({ status: 0, profile: built.length });
+        return true;
+    },
+    mstOnCharaReadComplete: () => {}, mstOnCharaValueArrived: () => {}, mstOnCharaWriteComplete: () => {},
+    mstOnDescReadComplete: () => {}, mstOnDescValueArrived: () => {}, mstOnDescWriteComplete: () => {},
+    mstOnCharaNotification: () => {},
+};
+const clock = { now: () => 0, setTimeout: (callback) => { callback(); return 0; }, clearTimeout: () => {} }; // prepare is built right away
+const ble = new BLEMaster({ transport, clock, watchdog: false });
+let delivered = null;
+ble.startScan((result) => { delivered = result; });
+
+function checkScan(input) {
+    delivered = null;
+    scan_callback(input);
+    const usable = input && input.dev_addr instanceof ArrayBuffer && input.dev_addr.byteLength === 6;
+    if (!usable) return delivered === null ? null : "delivered a result without a usable dev_addr";
+    if (!delivered) return "dropped a usable result";
+    if (!/^([0-9a-f]{2}:){5}[0-9a-f]{2}$/.test(delivered.dev_addr)) return "dev_addr " + delivered.dev_addr;
+    if (typeof delivered.vendor_data !== "string" || !/^([0-9a-f]{2})*$/.test(delivered.vendor_data)) return "vendor_data " + delivered.vendor_data;
+    if (!Array.isArray(delivered.service_data_array)) return "service_data_array is not an array";
+    for (const service of delivered.service_data_array) {
+        if (typeof service.service_data !== "string") return "service_data is not a string";
+    }
+    return ble.get.hasDevice(delivered.dev_addr) ? null : "not in the registry";
+}
+
+function checkProfile(input) {
+    built.length = 0;
+    const result = ble.startListener(input, () => {});
+    if (!result || typeof result.success !== "boolean") return "no { success } result";
+    if (!result.success) return built.length ? "rejected but built" : null;
+    if (built.length !== 1) return "accepted but not built";
+    const profile = built[0]; // what the backend dereferences must be there
+    const walk = (node, depth) => {
+        if (!node || !Array.isArray(node.list)) return depth === 3;
+        return node.list.every((child) => child && (depth < 1 || typeof child.uuid === "string") && walk(child, depth + 1));
+    };
+    if (!(profile.dev instanceof ArrayBuffer) || profile.dev.byteLength !== 6) return "built with a bad dev";
+    return profile.list.every((group) => group && Array.isArray(group.list) && group.list.every((service) =>
+        service && typeof service.uuid === "string" && Array.isArray(service.list) && service.list.every((chara) =>
+            chara && typeof chara.uuid === "string" && (chara.list === undefined || (Array.isArray(chara.list) &&
+                chara.list.every((desc) => desc && typeof desc.uuid === "string")))))) ? null : "built a malformed profile";
+}
+
+const MAC_PATTERN = /^([0-9A-Fa-f]{2}:){5}[0-9A-Fa-f]{2}$/;
+const wireCount = (value) => Number.isSafeInteger(value) && value >= 0;
+function wireValid(message) {
+    if (Array.isArray(message.upsert)) {
+        if (!wireCount(message.seq) || !wireCount(message.time)) return false;
+        if (message.upsert.length % 8 || !Array.isArray(message.remove) || !message.remove.every((mac) => MAC_PATTERN.test(mac))) return false;
+        for (let i = 0; i < message.upsert.length; i += 8) if (!MAC_PATTERN.test(message.upsert[i])) return false;
+        return true;
+    }
+    return typeof message.dev_addr === "string" && MAC_PATTERN.test(message.dev_addr) && typeof message.uuid === "string" &&
+        (message.time === undefined || wireCount(message.time)) && (message.data instanceof ArrayBuffer || ArrayBuffer.isView(message.data));
+}
+function wireExpected(message, format) { // what the page gets back
+    if (!Array.isArray(message.upsert)) {
+        return { dev_addr: message.dev_addr.toLowerCase(), uuid: message.uuid, time: message.time === undefined ? 0 : message.time, data: data2ab(message.data) };
+    }
+    if (format === WIRE_FORMAT.JSON) return JSON.parse(JSON.stringify(message));
+    const upsert = message.upsert.map((value, i) => i % 8 === 7 && value ? value.map(({ uuid, service_data }) => ({ uuid, service_data })) : value);
+    return { seq: message.seq, time: message.time, full: message.full, upsert, remove: message.remove };
+}
+
+function checkWire({ messages, format, corrupt }) {
+    const frame = encodeFrame(messages, format);
+    const valid = messages.every(wireValid);
+    if (frame === null) return valid ? "rejected valid messages" : null;
+    if (!valid) return "accepted a malformed message";
+    if (corrupt) { // a damaged frame decodes to something or to null, it never throws
+        const bytes = typeof frame === "string" ? frame : new Uint8Array(frame.slice(0));
+        const damaged = typeof bytes === "string" ? bytes.slice(0, int(bytes.length)) : (() => {
+            if (chance(0.5)) return bytes.slice(0, int(bytes.length)).buffer;
+            for (let n = 1 + int(3); n > 0; n--) bytes[int(bytes.length)] = int(256);
+            return bytes.buffer;
+        })();
+        const decoded = decodeFrame(damaged);
+        return decoded === null || Array.isArray(decoded) ? null : "decoded a damaged frame to " + typeof decoded;
+    }
+    const decoded = decodeFrame(frame);
+    if (!decoded) return "could not decode its own frame";
+    return show(decoded) === show(messages.map((message) => wireExpected(message, format))) ? null : "round trip differs: " + show(decoded);
+}
+
+/* RUN */
+
+const targets = {
+    data2ab: [dataInput, checkData],
+    mac2ab: [macInput, checkMac],
+    scan: [scanInput, checkScan],
+    profile: [profileInput, checkProfile],
+    wire: [wireInput, checkWire],
+};
+
+let failed = false;
+for (const name in targets) {
+    if (args.target && args.target !== name) continue;
+    const [generate, check] = targets[name];
+    let accepted = 0;
+    const start = performance.now();
+    for (let run = 0; run < RUNS; run++) {
+        const input = generate();
+        let problem;
+        try {
+            problem = check(input);
+        } catch (error) {
+            problem = "threw " + (error && error.stack ? error.stack.split("\n").slice(0, 3).join(" | ") : error);
+        }
+        if (problem) {
+            console.log(`${name}: FAIL at run ${run} (seed ${SEED}): ${problem}`);
+            console.log("  input: " + show(input));
+            failed = true;
+            break;
+        }
+        accepted++;
+    }
+    if (accepted === RUNS) console.log(`${name.padEnd(8)} ${RUNS} inputs ok (${(performance.now() - start).toFixed(0)}ms)`);
+}
+process.exitCode = failed ? 1 : 0;
+
+/* HELPERS */
+
+function same(a, b) {
+    if (a.length !== b.length) return false;
+    for (let i = 0; i < a.length; i++) if (a[i] !== b[i]) return false;
+    return true;
+}
+
+function show(value) {
+    try {
+        return JSON.stringify(value, (key, item) => {
+            if (item instanceof ArrayBuffer) return "ArrayBuffer(" + ab2str_stripped(item) + ")";
+            if (ArrayBuffer.isView(item)) return item.constructor.name + "(" + item.byteLength + ")";
+            if (typeof item === "bigint" || typeof item === "symbol" || typeof item === "function") return String(item);
+            if (typeof item === "number" && !isFinite(item)) return String(item);
+            return item;
+        });
+    } catch (error) {
+        return String(value);
+    }
+}
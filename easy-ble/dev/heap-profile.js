@@ -0,0 +1,168 @@
+/** @about Heap growth profile of a long-running session: thousands of scan/connect/prepare/write/stop cycles on virtual time.
+ * Usage (from easy-ble/):
+ *   npm run heap                                    2000 cycles against 20 peripherals
+ *   npm run heap -- --cycles=20000 --every=500      more cycles, a sample every 500 cycles
+ *   npm run heap -- --churn=5                        5 peripherals per cycle leave and come back with new (rotating) MACs
+ *   npm run heap -- --registry=compact --snapshots=0
+ * Each sample forces a GC and reports the retained heap, the registry size and the pending timers. Heap snapshots
+ * (first, middle, last by default) count live objects per constructor, the report lists the types that grew.
+ */
+import { getHeapSnapshot } from 'node:v8';
+import BLEMaster from '../ble-master.js';
+import { BLESimulator } from './ble-sim.js';
+import { parseArgs, LAMP_CHARA as CHARA, LAMP_PROFILE_CCCD as PROFILE } from './common.js';
+
+const args = parseArgs();
+const CYCLES = Number(args.cycles || 2000);
+const EVERY = Number(args.every || Math.max(1, Math.floor(CYCLES / 20)));
+const PERIPHERALS = Number(args.peripherals || 20);
+const CHURN = Number(args.churn || 0);            // peripherals replaced per cycle
+const SNAPSHOTS = args.snapshots === undefined ? 3 : Number(args.snapshots);
+const STEP_MILLIS = 50;                           // virtual time per clock step
+const CYCLE_LIMIT = 60000;                        // virtual millis before a cycle counts as stuck
+const TOP_TYPES = 12;
+
+
+if (typeof globalThis.gc !== "function") {
+    console.log("run with node --expose-gc (npm run heap does)");
+    process.exit(1);
+}
+
+/* SESSION */
+
+let next_mac = 0;
+function peripheral() {
+    const i = next_mac++;
+    return {
+        mac: ["c0", "de", (i >> 24) & 0xff, (i >> 16) & 0xff, (i >> 8) & 0xff, i & 0xff].map((b) => typeof b === "string" ? b : b.toString(16).padStart(2, "0")).join(":"),
+        name: "kiosk" + i,
+        advert_interval: 100,
+        service_uuids: ["A032"],
+        gatt: { "A032": { [CHARA]: { value: "00", descriptors: { "2902": "0000" } } } },
+    };
+}
+
+const peripherals = Array.from({ length: PERIPHERALS }, peripheral);
+const sim = new BLESimulator({ seed: Number(args.seed || 1), peripherals });
+const ble = new BLEMaster({ transport: sim, clock: sim.clock, registry: args.registry });
+const failures = { scan: 0, connect: 0, prepare: 0, write: 0, stuck: 0 };
+
+function cycle(n) {
+    if (CHURN) { // privacy addresses: devices disappear and come back under a new MAC
+        for (let i = 0; i < CHURN; i++) {
+            const gone = peripherals.shift();
+            sim.removePeripheral(gone.mac);
+            const fresh = peripheral();
+            peripherals.push(fresh);
+            sim.addPeripheral(fresh);
+        }
+    }
+    const mac = peripherals[n % peripherals.length].mac;
+    let done = false;
+    const finish = (failure) => {
+        if (failure) failures[failure]++;
+        ble.stop(mac);
+        ble.stopScan();
+        done = true;
+    };
+    ble.startScan(() => {
+        if (!ble.get.hasDevice(mac) || done) return;
+        ble.stopScan();
+        ble.connect(mac, (result) => {
+            if (done) return;
+            if (result.connected !== 0) return finish("connect");
+            ble.on.charaWriteComplete((response) => finish(response.status === 0 ? null : "write"));
+            ble.startListener(ble.modifyProfileObject(mac, PROFILE), (status) => {
+                if (status !== 0) return finish("prepare");
+                ble.write.characteristic(mac, CHARA, (n & 0xff).toString(16).padStart(2, "0"));
+            });
+        });
+    });
+    const limit = sim.clock.now() + CYCLE_LIMIT;
+    while (!done && sim.clock.now() < limit) sim.clock.advance(STEP_MILLIS);
+    if (!done) finish("stuck");
+    sim.clock.advance(STEP_MILLIS); // let the disconnect land
+    sim.writes.length = 0; // the simulator's own write log would otherwise be the biggest "leak"
+}
+
+/* SAMPLING */
+
+const samples = [];
+function sample(n) {
+    globalThis.gc();
+    samples.push({
+        cycle: n,
+        heap: process.memoryUsage().heapUsed,
+        devices: Object.keys(ble.get.devices()).length,
+        timers: sim.clock.pending,
+    });
+}
+
+function countObjects() { // live objects per constructor from a heap snapshot
+    globalThis.gc();
+    const snapshot = JSON.parse(readStream(getHeapSnapshot()));
+    const { node_fields, node_types } = snapshot.snapshot.meta;
+    const type_names = node_types[0];
+    const stride = node_fields.length;
+    const type_at = node_fields.indexOf("type"), name_at = node_fields.indexOf("name");
+    const counts = new Map();
+    for (let i = 0; i < snapshot.nodes.length; i += stride) {
+        const type = type_names[snapshot.nodes[i + type_at]];
+        if (type === "hidden" || type === "synthetic" || type === "code" || type === "object shape") continue;
+        const key = type === "object" ? snapshot.strings[snapshot.nodes[i + name_at]] : "(" + type + ")";
+        counts.set(key, (counts.get(key) || 0) + 1);
+    }
+    return counts;
+}
+
+function readStream(stream) {
+    const chunks = [];
+    let chunk;
+    while ((chunk = stream.read()) !== null) chunks.push(chunk);
+    return Buffer.concat(chunks).toString("utf8");
+}
+
+/* RUN */
+
+const snapshot_at = new Set(SNAPSHOTS <= 0 ? [] : SNAPSHOTS === 1 ? [CYCLES] :
+    Array.from({ length: SNAPSHOTS }, (_, i) => Math.round(i * CYCLES / (SNAPSHOTS - 1))));
+const snapshots = [];
+
+const wall_start = Date.now();
+for (let n = 0; n <= CYCLES; n++) {
+    if (n > 0) cycle(n);
+    if (n % EVERY === 0 || n === CYCLES) sample(n);
+    if (snapshot_at.has(n)) snapshots.push({ cycle: n, counts: countObjects() });
+}
+
+/* REPORT */
+
+const kb = (bytes) => (bytes / 1024).toFixed(1) + "KB";
+console.log("cycle".padEnd(8) + "heap".padEnd(12) + "devices".padEnd(10) + "timers");
+for (const { cycle: n, heap, devices, timers } of samples) {
+    console.log(String(n).padEnd(8) + kb(heap).padEnd(12) + String(devices).padEnd(10) + timers);
+}
+
+const first = samples[0], last = samples[samples.length - 1];
+const warm = samples[Math.min(1, samples.length - 1)]; // the first cycles warm up the JIT and the registry
+const per_cycle = last.cycle > warm.cycle ? (last.heap - warm.heap) / (last.cycle - warm.cycle) : 0;
+console.log(`\n${CYCLES} cycles, ${(sim.clock.now() / 3600000).toFixed(2)}h virtual, ${((Date.now() - wall_start) / 1000).toFixed(1)}s wall`);
+console.log(`heap ${kb(first.heap)} > ${kb(last.heap)}, ${per_cycle.toFixed(1)} bytes/cycle after warm-up` +
+    ` (${kb(per_cycle * 24 * 3600000 / (sim.clock.now() / CYCLES))} per 24h at this cycle rate)`);
+console.log(`registry ${first.devices} > ${last.devices} devices, pending timers ${first.timers} > ${last.timers}`);
+console.log(`failures ${JSON.stringify(failures)}, backend calls ${JSON.stringify(sim.calls)}`);
+
+if (snapshots.length >= 2) {
+    const from = snapshots[0], to = snapshots[snapshots.length - 1];
+    const growth = [];
+    for (const [name, count] of to.counts) {
+        const before = from.counts.get(name) || 0;
+        if (count > before) growth.push([name, before, count]);
+    }
+    growth.sort((a, b) => (b[2] - b[1]) - (a[2] - a[1]));
+    console.log(`\nlive objects that grew between cycle ${from.cycle} and ${to.cycle}:`);
+    for (const [name, before, count] of growth.slice(0, TOP_TYPES)) {
+        console.log(`  ${(name || "(anonymous)").slice(0, 40).padEnd(42)} ${String(before).padStart(8)} > ${String(count).padEnd(8)} +${count - before}`);
+    }
+    if (!growth.length) console.log("  none");
+}
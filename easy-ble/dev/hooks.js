@@ -0,0 +1,29 @@
+/** @about Node loader hooks for BLE Master. Maps the ZeppOS @zos/* modules to Node stand-ins and loads app sources as ES modules. */
+
+const ZOS_MODULES = ['ble', 'ui', 'utils', 'device', 'display'];
+
+export async function resolve(specifier, context, next) {
+    if (specifier.startsWith('@zos/')) {
+        const name = specifier.slice(5);
+        if (ZOS_MODULES.includes(name)) {
+            return { url: new URL(`./zos/${name}.js`, import.meta.url).href, shortCircuit: true };
+        }
+    }
+    try {
+        return await next(specifier, context);
+    } catch (e) {
+        // ZeppOS apps import relative modules without an extension
+        if (specifier.startsWith('.') && !specifier.endsWith('.js')) {
+            return next(specifier + '.js', context);
+        }
+        throw e;
+    }
+}
+
+export async function load(url, context, next) {
+    // ZeppOS app folders ship a commonjs package.json, but their sources are ES modules
+    if (url.startsWith('file:') && url.endsWith('.js') && !url.includes('/node_modules/')) {
+        return next(url, { ...context, format: 'module' });
+    }
+    return next(url, context);
+}
@@ -0,0 +1,102 @@
+/** @about Known devices scenario: a lamp-toggle shortcut, first launch scans, later launches connect from options.known.
+ * Usage (from easy-ble/):
+ *   npm run known                               20 launches, lamp advertising every 1000ms
+ *   npm run known -- --launches=50 --advert=2000
+ *   npm run known -- --json                     summary as JSON, for scripts
+ * Every launch is a new BLEMaster on a fresh simulator (a different seed, so a different advert phase) sharing one storage,
+ * like an app that is closed and opened again. A launch is done when the toggle's write completes. The scan-first launches
+ * run the ladder of page/main.js: scan until the lamp shows up, stop, connect, startListener, write.
+ * Exits with 1 if a launch misses its write, a direct launch scans or direct launches are not done sooner on average.
+ */
+import BLEMaster from '../ble-master.js';
+import { BLESimulator } from './ble-sim.js';
+import { parseArgs, row, LAMP_CHARA as CHARA, LAMP_PROFILE as PROFILE, SCALE, lampPeripheral, mean, percentile, claim, verdict } from './common.js';
+
+const args = parseArgs();
+const LAUNCHES = Number(args.launches || 20);
+const ADVERT = Number(args.advert || 1000);
+const TIMEOUT = 30000;
+
+const LAMP = "a1:a2:a3:a4:a5:a6";
+
+class MemoryStorage { // the getItem / setItem surface of localStorage from @zos/storage
+    #items = new Map();
+    getItem(key) {
+        return this.#items.has(key) ? this.#items.get(key) : undefined;
+    }
+    setItem(key, value) {
+        this.#items.set(key, String(value));
+    }
+}
+
+function launch(seed, storage, direct) {
+    const sim = new BLESimulator({
+        seed,
+        latency: { connect: [300, 900], prepare: [400, 1200], write: [20, 60] },
+        peripherals: [lampPeripheral(LAMP, 0, { name: "lamp", advert_interval: ADVERT }), SCALE],
+    });
+    const ble = new BLEMaster({ transport: sim, clock: sim.clock, known: { storage } });
+    const start = sim.clock.now();
+    let done = -1, scanned = 0;
+    ble.on.charaWriteComplete(() => { done = sim.clock.now() - start; });
+    const toggle = () => ble.connect(LAMP, (result) => {
+        if (result.connected !== 0) return;
+        ble.startListener(ble.modifyProfileObject(LAMP, PROFILE), (status) => {
+            if (status === 0) ble.write.characteristic(LAMP, CHARA, "01");
+        });
+    });
+    if (direct && ble.known.has(LAMP)) {
+        toggle();
+    } else {
+        ble.startScan((scan_result) => {
+            scanned++;
+            if (scan_result.dev_addr !== LAMP) return;
+            ble.stopScan();
+            toggle();
+        });
+    }
+    while (done < 0 && sim.clock.now() - start < TIMEOUT) sim.clock.advance(10);
+    ble.stop(LAMP);
+    return { millis: done, scanned, scans: sim.calls.mstStartScan || 0 };
+}
+
+function summary(runs) {
+    const millis = runs.map((run) => run.millis).filter((m) => m >= 0).sort((a, b) => a - b);
+    return {
+        done: millis.length,
+        mean: Math.round(mean(millis)),
+        p50: percentile(millis, 0.5),
+        p90: percentile(millis, 0.9),
+        max: millis[millis.length - 1],
+        scan_results: runs.reduce((sum, run) => sum + run.scanned, 0),
+        scans: runs.reduce((sum, run) => sum + run.scans, 0),
+    };
+}
+
+const scan_first = [], direct = [];
+const storage = new MemoryStorage();
+launch(1000, storage, false); // the first launch ever: scans and learns the lamp
+for (let seed = 1; seed <= LAUNCHES; seed++) {
+    scan_first.push(launch(seed, new MemoryStorage(), false));
+    direct.push(launch(seed, storage, true));
+}
+const results = { scan_first: summary(scan_first), direct: summary(direct) };
+
+const claims = [
+    claim("every launch completes its write", results.scan_first.done === LAUNCHES && results.direct.done === LAUNCHES),
+    claim("direct launches never scan", results.direct.scans === 0),
+    claim("direct launches are done sooner than scan-first ones", results.direct.mean < results.scan_first.mean),
+];
+
+const WIDTHS = [12, 6, 7, 7, 7, 7, 7];
+if (args.json) {
+    console.log(JSON.stringify({ launches: LAUNCHES, advert_interval: ADVERT, ...results, claims }, null, 2));
+} else {
+    console.log(`${LAUNCHES} launches, lamp advertising every ${ADVERT}ms, millis from launch to the completed write`);
+    console.log(row(WIDTHS, ["", "done", "mean", "p50", "p90", "max", "scans", "scan results"]));
+    for (const [name, r] of [["scan first", results.scan_first], ["direct", results.direct]]) {
+        console.log(row(WIDTHS, [name, r.done, r.mean, r.p50, r.p90, r.max, r.scans, r.scan_results]));
+    }
+    console.log(`direct connect saves ${results.scan_first.mean - results.direct.mean}ms per launch on average`);
+}
+verdict(claims, args.json);
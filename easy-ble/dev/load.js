@@ -0,0 +1,197 @@
+/** @about Crowded-environment load test: hundreds of advertising devices feeding startScan on real time.
+ * Usage (from easy-ble/):
+ *   npm run load                                           300 devices, 10 adverts/sec each, 31 byte payloads, 60s
+ *   npm run load -- --devices=800 --rate=5 --payload=20 --duration=600 --registry=compact
+ *   npm run load -- --max --duration=10                    unpaced, as many adverts as the CPU takes
+ *   npm run load -- --json                                 summary as JSON, for scripts
+ * Reports callback throughput, per-advert latency percentiles (time spent inside the scan callback: decode, registry,
+ * metrics, user callback), heap samples, the growth of the heap floor and of the heap retained after a final GC
+ * (needs --expose-gc, the npm script passes it), and GC pauses by kind.
+ * Every advert carries fresh buffers like the real backend, so their allocations count towards the heap and GC numbers.
+ */
+import { PerformanceObserver, constants } from 'node:perf_hooks';
+import BLEMaster from '../ble-master.js';
+import { createRandom } from './ble-sim.js';
+import { parseArgs } from './common.js';
+
+const args = parseArgs();
+const DEVICES = Number(args.devices || 300);
+const RATE = Number(args.rate || 10);             // adverts/sec per device
+const PAYLOAD = Number(args.payload || 31);       // vendor data bytes
+const DURATION = Number(args.duration || 60) * 1000;
+const SAMPLE_MILLIS = Number(args.sample || 500);
+const REPORT_MILLIS = 10000;
+const TICK_MILLIS = 5;
+const MAX_BATCH = 2000;     // unpaced mode, adverts between two event loop turns
+const RESERVOIR = 100000;   // latency samples kept for the percentiles
+
+const GC_KINDS = {
+    [constants.NODE_PERFORMANCE_GC_MINOR]: "minor",
+    [constants.NODE_PERFORMANCE_GC_MAJOR]: "major",
+    [constants.NODE_PERFORMANCE_GC_INCREMENTAL]: "incremental",
+    [constants.NODE_PERFORMANCE_GC_WEAKCB]: "weakcb",
+};
+
+/* DEVICES */
+
+const random = createRandom(Number(args.seed || 1));
+const devices = [];
+for (let i = 0; i < DEVICES; i++) {
+    devices.push({
+        mac: [0xc0, 0xff, 0xee, (i >> 16) & 0xff, (i >> 8) & 0xff, i & 0xff],
+        name: "tag" + i,
+        rssi: -50 - Math.floor(random() * 40),
+        payload: Array.from({ length: PAYLOAD }, () => Math.floor(random() * 256)),
+    });
+}
+
+let counter = 0;
+function advert() {
+    const device = devices[counter++ % DEVICES];
+    device.payload[0] = counter & 0xff; // payloads change between adverts, like sensor tags
+    return {
+        dev_addr: new Uint8Array(device.mac).buffer,
+        dev_name: device.name,
+        rssi: device.rssi + Math.floor(random() * 7) - 3,
+        service_uuid_array: ["181D"],
+        service_data_array: [],
+        vendor_id: 0x0157,
+        vendor_data: new Uint8Array(device.payload).buffer,
+    };
+}
+
+/* MEASUREMENT */
+
+const latencies = new Float64Array(RESERVOIR);
+let latency_count = 0, latency_max = 0;
+function addLatency(micros) {
+    if (micros > latency_max) latency_max = micros;
+    if (latency_count < RESERVOIR) latencies[latency_count] = micros;
+    else { // reservoir sampling keeps a uniform sample of the whole run
+        const slot = Math.floor(random() * (latency_count + 1));
+        if (slot < RESERVOIR) latencies[slot] = micros;
+    }
+    latency_count++;
+}
+function percentiles() {
+    const sorted = latencies.slice(0, Math.min(latency_count, RESERVOIR)).sort();
+    const at = (q) => sorted.length ? sorted[Math.min(sorted.length - 1, Math.ceil(q * sorted.length) - 1)] : 0;
+    return { p50: at(0.5), p90: at(0.9), p99: at(0.99), p999: at(0.999), max: latency_max };
+}
+
+const gc_pauses = {};
+const gc_observer = new PerformanceObserver((list) => {
+    for (const entry of list.getEntries()) {
+        const kind = GC_KINDS[entry.detail ? entry.detail.kind : entry.kind] || "other";
+        const pauses = gc_pauses[kind] || (gc_pauses[kind] = { count: 0, total: 0, max: 0 });
+        pauses.count++;
+        pauses.total += entry.duration;
+        if (entry.duration > pauses.max) pauses.max = entry.duration;
+    }
+});
+gc_observer.observe({ entryTypes: ["gc"] });
+
+const heap = []; // [millis since start, heapUsed]
+function sampleHeap(elapsed) {
+    heap.push([elapsed, process.memoryUsage().heapUsed]);
+}
+const FLOOR_WINDOW = 10; // samples per heap floor point
+function heapSlope() { // least squares over the heap floor (lowest sample per window, i.e. after a scavenge), bytes per minute
+    const floor = [];
+    for (let i = 0; i < heap.length; i += FLOOR_WINDOW) {
+        const window = heap.slice(i, i + FLOOR_WINDOW);
+        floor.push(window.reduce((low, sample) => sample[1] < low[1] ? sample : low));
+    }
+    if (floor.length < 2) return 0;
+    let sx = 0, sy = 0, sxx = 0, sxy = 0;
+    for (const [x, y] of floor) { sx += x; sy += y; sxx += x * x; sxy += x * y; }
+    const n = floor.length;
+    return (n * sxy - sx * sy) / (n * sxx - sx * sx) * 60000;
+}
+
+/* RUN */
+
+let scan = null;
+const transport = { mstStartScan: (callback) => { scan = callback; return true; }, mstStopScan: () => true };
+const ble = new BLEMaster({ transport, registry: args.registry, capacity: DEVICES });
+let user_callbacks = 0;
+ble.startScan(() => { user_callbacks++; });
+
+if (typeof globalThis.gc === "function") globalThis.gc();
+const start = performance.now();
+let emitted = 0, last_sample = -SAMPLE_MILLIS, last_report = 0, last_report_count = 0;
+sampleHeap(0);
+
+function feed(count) {
+    for (let i = 0; i < count; i++) {
+        const response = advert();
+        const t0 = performance.now();
+        scan(response);
+        addLatency((performance.now() - t0) * 1000);
+    }
+    emitted += count;
+}
+
+function tick() {
+    const elapsed = performance.now() - start;
+    if (args.max) feed(MAX_BATCH);
+    else feed(Math.min(Math.floor(elapsed / 1000 * RATE * DEVICES) - emitted, MAX_BATCH * 10));
+    if (elapsed - last_sample >= SAMPLE_MILLIS) {
+        sampleHeap(elapsed);
+        last_sample = elapsed;
+    }
+    if (!args.json && elapsed - last_report >= REPORT_MILLIS) {
+        const rate = (emitted - last_report_count) / ((elapsed - last_report) / 1000);
+        const { p99 } = percentiles();
+        console.log(`${(elapsed / 1000).toFixed(0).padStart(5)}s  ${Math.round(rate).toLocaleString("en").padStart(9)} adv/s  ` +
+            `p99 ${p99.toFixed(1)}us  heap ${(heap[heap.length - 1][1] / 1048576).toFixed(1)}MB`);
+        last_report = elapsed;
+        last_report_count = emitted;
+    }
+    if (elapsed < DURATION) setTimeout(tick, args.max ? 0 : TICK_MILLIS);
+    else setTimeout(() => finish(elapsed), 100); // let the observer deliver the last GC entries
+}
+
+function finish(elapsed) {
+    gc_observer.disconnect();
+    if (typeof globalThis.gc === "function") globalThis.gc();
+    const retained = process.memoryUsage().heapUsed;
+    const heap_values = heap.map(([, bytes]) => bytes);
+    const summary = {
+        config: { devices: DEVICES, rate: args.max ? "max" : RATE, payload: PAYLOAD, duration: DURATION / 1000, registry: args.registry || "object" },
+        adverts: emitted,
+        user_callbacks,
+        throughput: Math.round(emitted / (elapsed / 1000)),
+        latency_us: Object.fromEntries(Object.entries(percentiles()).map(([name, value]) => [name, Number(value.toFixed(2))])),
+        heap: {
+            start: heap_values[0],
+            end: heap_values[heap_values.length - 1],
+            min: Math.min(...heap_values),
+            max: Math.max(...heap_values),
+            growth_per_min: Math.round(heapSlope()),
+            retained_after_gc: typeof globalThis.gc === "function" ? retained : null,
+            retained_growth: typeof globalThis.gc === "function" ? retained - heap_values[0] : null,
+        },
+        gc: Object.fromEntries(Object.entries(gc_pauses).map(([kind, { count, total, max }]) =>
+            [kind, { count, total_ms: Number(total.toFixed(1)), max_ms: Number(max.toFixed(2)) }])),
+        devices_seen: Object.keys(ble.get.devices()).length,
+    };
+    if (args.json) {
+        console.log(JSON.stringify(summary, null, 2));
+        return;
+    }
+    const mb = (bytes) => (bytes / 1048576).toFixed(1) + "MB";
+    console.log(`\n${summary.adverts.toLocaleString("en")} adverts in ${(elapsed / 1000).toFixed(1)}s: ` +
+        `${summary.throughput.toLocaleString("en")} adv/s, ${summary.devices_seen} devices seen`);
+    const l = summary.latency_us;
+    console.log(`latency  p50 ${l.p50}us  p90 ${l.p90}us  p99 ${l.p99}us  p99.9 ${l.p999}us  max ${l.max}us`);
+    const h = summary.heap;
+    console.log(`heap     start ${mb(h.start)}  end ${mb(h.end)}  max ${mb(h.max)}  floor growth ${(h.growth_per_min / 1024).toFixed(1)}KB/min` +
+        (h.retained_after_gc === null ? "" : `  retained ${mb(h.retained_after_gc)} (${(h.retained_growth / 1024).toFixed(1)}KB over the run)`));
+    for (const kind in summary.gc) {
+        const { count, total_ms, max_ms } = summary.gc[kind];
+        console.log(`gc ${kind.padEnd(12)} ${count} pauses, ${total_ms}ms total, ${max_ms}ms max`);
+    }
+}
+
+tick();
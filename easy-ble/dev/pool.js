@@ -0,0 +1,121 @@
+/** @about Connection pool scenario: lamp toggles over a virtual day, comparing stop() after every command, holding every link and options.pool.
+ * Usage (from easy-ble/):
+ *   npm run pool                                 6 lamps, 300 commands, pool of 3 with a 30s idle period
+ *   npm run pool -- --lamps=10 --max=4 --idle=60000 --commands=1000
+ *   npm run pool -- --json                       summary as JSON, for scripts
+ * Commands favour a few lamps (the living room gets most toggles) and come in bursts: a few seconds apart, then minutes
+ * of nothing. A command is done when its write completes, its latency includes connect and startListener when the link
+ * had to be (re)built. Held links are what keeps the radio and the lamps' connection slots busy.
+ * Exits with 1 if a command is lost, the pool holds more than max links or rejects a connect, or it does not need fewer
+ * connects than stop() after every command and fewer link-hours than holding every link.
+ */
+import BLEMaster from '../ble-master.js';
+import { BLESimulator, createRandom } from './ble-sim.js';
+import { parseArgs, row, LAMP_CHARA as CHARA, LAMP_PROFILE as PROFILE, lampMacs, lampPeripheral, mean, percentile, claim, verdict } from './common.js';
+
+const args = parseArgs();
+const LAMPS = Number(args.lamps || 6);
+const COMMANDS = Number(args.commands || 300);
+const MAX = Number(args.max || 3);
+const IDLE = Number(args.idle ?? 30000);
+
+const MACS = lampMacs(LAMPS);
+
+function schedule() { // [millis after the previous command, lamp], the same for every strategy
+    const random = createRandom(7);
+    const commands = [];
+    for (let i = 0; i < COMMANDS; i++) {
+        const gap = random() < 0.7 ? 2000 + random() * 8000 : 60000 + random() * 20 * 60000;
+        const lamp = Math.min(LAMPS - 1, Math.floor(Math.pow(random(), 2.5) * LAMPS)); // lamp 0 most often
+        commands.push([gap, lamp]);
+    }
+    return commands;
+}
+
+function run(strategy, commands) {
+    const sim = new BLESimulator({
+        seed: 1,
+        latency: { connect: [300, 900], prepare: [400, 1200], write: [20, 60] },
+        peripherals: MACS.map((mac, i) => lampPeripheral(mac, i, { advert_interval: 200 })),
+    });
+    const options = { transport: sim, clock: sim.clock };
+    if (strategy === "pool") options.pool = { max: MAX, idle: IDLE };
+    const ble = new BLEMaster(options);
+    ble.startScan(() => {});
+    sim.clock.advance(2000);
+    ble.stopScan();
+
+    const latencies = [];
+    let link_millis = 0, peak = 0, last = sim.clock.now();
+    const held = () => MACS.filter((mac) => ble.get.isConnected(mac)).length;
+    const advance = (millis) => {
+        for (let left = millis; left > 0; left -= 100) { // link time is sampled every 100ms
+            sim.clock.advance(Math.min(100, left));
+            const links = held();
+            link_millis += links * (sim.clock.now() - last);
+            peak = Math.max(peak, links);
+            last = sim.clock.now();
+        }
+    };
+    let pending = null;
+    ble.on.charaWriteComplete(() => {
+        if (!pending) return;
+        latencies.push(sim.clock.now() - pending.start);
+        if (strategy === "stop") ble.stop(pending.mac);
+        pending = null;
+    });
+    const write = (mac) => ble.write.characteristic(mac, CHARA, "01");
+    for (const [gap, lamp] of commands) {
+        advance(gap);
+        const mac = MACS[lamp];
+        pending = { mac, start: sim.clock.now() };
+        if (ble.get.isConnected(mac) && ble.get.device(mac).profile_idp !== undefined) {
+            write(mac);
+        } else {
+            ble.connect(mac, (result) => {
+                if (result.connected !== 0) return;
+                ble.startListener(ble.modifyProfileObject(mac, PROFILE), (status) => { if (status === 0) write(mac); });
+            });
+        }
+        while (pending && sim.clock.now() - pending.start < 10000) advance(50);
+        if (pending) pending = null; // lost, counted as missing from latencies
+    }
+    latencies.sort((a, b) => a - b);
+    return {
+        strategy,
+        done: latencies.length,
+        mean: Math.round(mean(latencies)),
+        p50: percentile(latencies, 0.5),
+        p90: percentile(latencies, 0.9),
+        connects: sim.calls.mstConnect || 0,
+        link_hours: link_millis / 3600000,
+        peak_links: peak,
+        pool: ble.pool && ble.pool.report(),
+    };
+}
+
+const commands = schedule();
+const hours = commands.reduce((sum, [gap]) => sum + gap, 0) / 3600000;
+const results = ["stop", "hold", "pool"].map((strategy) => run(strategy, commands));
+
+const [stop, hold, pool] = results;
+const claims = [
+    claim("every command of every strategy completes", results.every((r) => r.done === COMMANDS)),
+    claim(`the pool never holds more than ${MAX} links`, pool.peak_links <= MAX),
+    claim("the pool rejects no connect", pool.pool.rejected === 0),
+    claim("the pool connects less often than stop() after every command", pool.connects < stop.connects),
+    claim("the pool holds fewer link-hours than holding every link", pool.link_hours < hold.link_hours),
+];
+
+const WIDTHS = [10, 6, 9, 7, 7, 10, 8];
+if (args.json) {
+    console.log(JSON.stringify({ lamps: LAMPS, commands: COMMANDS, max: MAX, idle: IDLE, hours, results, claims }, null, 2));
+} else {
+    console.log(`${COMMANDS} commands to ${LAMPS} lamps over ${hours.toFixed(1)} virtual hours, pool of ${MAX}, idle ${IDLE}ms`);
+    console.log(row(WIDTHS, ["strategy", "done", "mean ms", "p50", "p90", "connects", "link h", "peak links"]));
+    for (const r of results) {
+        console.log(row(WIDTHS, [r.strategy, r.done, r.mean, r.p50, r.p90, r.connects, r.link_hours.toFixed(2), r.peak_links]));
+    }
+    console.log(`pool: ${pool.pool.evicted} evicted, ${pool.pool.idle_closed} closed idle, ${pool.pool.rejected} rejected`);
+}
+verdict(claims, args.json);
@@ -0,0 +1,129 @@
+/** @about Power budget scenario: a lamp-control page left running for hours, with and without options.power, on virtual time.
+ * Usage (from easy-ble/):
+ *   npm run power                               2 virtual hours, default budget (600 units per hour)
+ *   npm run power -- --hours=6 --budget=300     longer run, tighter budget
+ *   npm run power -- --json                     summary as JSON, for scripts
+ * The page keeps a presence scan running, keeps two lamps connected (reconnecting the polled one when it was closed),
+ * polls the first one every 2s (through ble.power.interval) and writes to the second one once. Every 10 virtual minutes
+ * it reports the level, the energy used in the window and what the radio did, then both runs are compared. Energy units:
+ * one unit is one second of scanning.
+ * Exits with 1 if the budget never lowers the level, the window ever uses more than the budget (sampled every second),
+ * the budget is never spent or the page never polls again after it, or the budgeted run does not scan less and use less energy.
+ */
+import BLEMaster, { POWER_LEVEL } from '../ble-master.js';
+import { BLESimulator } from './ble-sim.js';
+import { parseArgs, row, LAMP_CHARA as CHARA, LAMP_PROFILE_CCCD as PROFILE, SCALE, lampPeripheral, claim, verdict } from './common.js';
+
+const args = parseArgs();
+const HOURS = Number(args.hours || 2);
+const BUDGET = Number(args.budget || 600);
+const REPORT_MILLIS = 10 * 60000;
+const POLL_MILLIS = 2000;
+const LEVEL_NAMES = Object.keys(POWER_LEVEL);
+
+const LAMPS = ["a1:a2:a3:a4:a5:01", "a1:a2:a3:a4:a5:02"];
+
+function run(enforced) {
+    const sim = new BLESimulator({
+        seed: 1,
+        peripherals: [
+            ...LAMPS.map((mac, i) => lampPeripheral(mac, i, { advert_interval: 200, gatt: { "A032": { [CHARA]: { value: "00", descriptors: { "2902": "0000" } } } } })),
+            SCALE,
+        ],
+    });
+    // the unenforced run meters with an endless budget, so both runs are measured the same way
+    const ble = new BLEMaster({ transport: sim, clock: sim.clock, power: { budget: enforced ? BUDGET : Infinity } });
+    let reads = 0, peak = 0, opening = false;
+
+    const open = (mac, ready) => ble.connect(mac, (result) => {
+        if (result.connected !== 0) return ready(false);
+        ble.startListener(ble.modifyProfileObject(mac, PROFILE), (status) => ready(status === 0));
+    });
+    const poll = () => {
+        sim.clock.setTimeout(poll, ble.power.interval(POLL_MILLIS));
+        if (ble.get.isConnected(LAMPS[0]) && ble.get.device(LAMPS[0]).profile_idp !== undefined) {
+            if (ble.read.characteristic(LAMPS[0], CHARA).success) reads++;
+        } else if (!opening) { // closed by the budget, or still refused
+            opening = open(LAMPS[0], () => { opening = false; });
+        }
+    };
+    const sample = () => {
+        peak = Math.max(peak, ble.power.used);
+        sim.clock.setTimeout(sample, 1000);
+    };
+    sample();
+    ble.startScan(() => {}); // presence list, never stopped
+    sim.clock.advance(1000);
+    opening = open(LAMPS[0], (ready) => {
+        opening = false;
+        if (ready) poll();
+    });
+    sim.clock.advance(3000);
+    open(LAMPS[1], (ready) => { if (ready) ble.write.characteristic(LAMPS[1], CHARA, "01"); });
+
+    const rows = [];
+    let last = { ...ble.power.report(), reads: 0 };
+    for (let t = REPORT_MILLIS; t <= HOURS * 3600000; t += REPORT_MILLIS) {
+        sim.clock.advance(REPORT_MILLIS - (t === REPORT_MILLIS ? 4000 : 0));
+        const report = ble.power.report();
+        rows.push({
+            minute: t / 60000,
+            level: report.exhausted ? "SPENT" : LEVEL_NAMES[report.level],
+            used: Math.round(report.used),
+            scan_share: (report.scan_millis - last.scan_millis) / REPORT_MILLIS,
+            reads: reads - last.reads,
+            links: report.links,
+        });
+        last = { ...report, reads };
+    }
+    const report = ble.power.report();
+    return {
+        rows,
+        peak,
+        totals: {
+            scan_minutes: report.scan_millis / 60000,
+            link_minutes: report.link_millis / 60000,
+            reads,
+            duty_pauses: report.duty_pauses,
+            idle_closed: report.idle_closed,
+            refused: report.refused,
+            // the same cost model for both runs, over the whole run
+            units: report.scan_millis / 1000 + report.link_millis / 1000 * 0.05 + report.ops * 0.02,
+        },
+    };
+}
+
+const free = run(false);
+const budgeted = run(true);
+
+const spent_at = budgeted.rows.findIndex((r) => r.level === "SPENT");
+const claims = [
+    claim("the budget moves the page out of NORMAL", budgeted.rows.some((r) => r.level !== "NORMAL")),
+    claim("the window never uses more than the budget", budgeted.peak <= BUDGET),
+    claim("the budgeted run scans less than the unlimited one", budgeted.totals.scan_minutes < free.totals.scan_minutes),
+    claim("the budget is spent and the page polls again once the window frees some",
+        spent_at >= 0 && budgeted.rows.slice(spent_at + 1).some((r) => r.reads > 0)),
+    claim("the budgeted run uses less energy than the unlimited one", budgeted.totals.units < free.totals.units),
+];
+
+const ROW_WIDTHS = [8, 10, 7, 7, 7];
+const TOTAL_WIDTHS = [12, 10, 10, 8, 8, 8];
+if (args.json) {
+    console.log(JSON.stringify({ hours: HOURS, budget: BUDGET, unlimited: free, budgeted, claims }, null, 2));
+} else {
+    console.log(`budget ${BUDGET} units per hour, ${HOURS} virtual hours`);
+    console.log(row(ROW_WIDTHS, ["minute", "level", "used", "scan", "reads", "links"]));
+    for (const r of budgeted.rows) {
+        console.log(row(ROW_WIDTHS, [r.minute, r.level, r.used, (r.scan_share * 100).toFixed(0) + "%", r.reads, r.links]));
+    }
+    console.log("");
+    console.log(row(TOTAL_WIDTHS, ["", "scan min", "link min", "reads", "pauses", "closed", "units"]));
+    for (const [name, { totals }] of [["unlimited", free], ["budgeted", budgeted]]) {
+        console.log(row(TOTAL_WIDTHS, [name, totals.scan_minutes.toFixed(1), totals.link_minutes.toFixed(1), totals.reads,
+            totals.duty_pauses, totals.idle_closed, totals.units.toFixed(0)]));
+    }
+    console.log(`budgeted run: ${(100 * budgeted.totals.units / free.totals.units).toFixed(0)}% of the energy, ` +
+        `${(budgeted.totals.units / HOURS).toFixed(0)} units per hour, at most ${budgeted.peak.toFixed(1)} in a window ` +
+        `(budget ${BUDGET}), ${budgeted.totals.refused} connects/reads refused`);
+}
+verdict(claims, args.json);
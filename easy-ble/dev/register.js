@@ -0,0 +1,4 @@
+/** @about Node loader for BLE Master. Usage: node --import ./dev/register.js your-script.js */
+import { register } from 'node:module';
+
+register('./hooks.js', import.meta.url);
@@ -0,0 +1,77 @@
+/** @about Replays a recorded BLE session into BLEMaster and reports decode throughput and latencies.
+ * Usage (from easy-ble/):
+ *   node --import ./dev/register.js dev/replay.js session.eblr                 virtual time, as fast as the CPU allows
+ *   node --import ./dev/register.js dev/replay.js session.eblr --speed=10      real timers, ten times faster than recorded
+ *   node --import ./dev/register.js dev/replay.js session.eblr --registry=compact
+ * The driver follows the recording: it scans for the whole session, connects when a successful connect result is due
+ * and prepares an empty profile for it, so prepare and attribute callbacks reach the library like they did live.
+ * Compare two library versions by running the same file against each.
+ */
+import { readFileSync } from 'node:fs';
+import BLEMaster from '../ble-master.js';
+import { SessionReplay, REC } from './ble-replay.js';
+import { VirtualClock } from './ble-sim.js';
+import { parseArgs } from './common.js';
+
+const args = parseArgs();
+args.file = args._[0];
+if (!args.file) {
+    console.log("usage: dev/replay.js <session.eblr> [--speed=N] [--registry=object|compact]");
+    process.exit(1);
+}
+
+const file = readFileSync(args.file);
+const virtual = args.speed === undefined;
+const speed = virtual ? 1 : Number(args.speed);
+const replay = new SessionReplay(file.buffer.slice(file.byteOffset, file.byteOffset + file.byteLength), {
+    clock: virtual ? new VirtualClock() : undefined,
+    speed,
+});
+const ble = new BLEMaster({ transport: replay, clock: replay.clock, registry: args.registry });
+
+let adverts = 0;
+ble.startScan(() => { adverts++; });
+
+// connect where the recorded app connected
+const connected = new Set();
+for (const { time, kind, response } of replay.records) {
+    if (kind !== REC.CONNECT || response.connected !== 0) continue;
+    const dev_addr = Array.from(new Uint8Array(response.dev_addr), (byte) => byte.toString(16).padStart(2, '0')).join(':');
+    replay.clock.setTimeout(() => {
+        if (connected.has(dev_addr)) return;
+        connected.add(dev_addr);
+        ble.connect(dev_addr, (result) => {
+            if (result.connected !== 0 || !ble.get.hasDevice(dev_addr)) return;
+            ble.startListener(ble.modifyProfileObject(dev_addr, { pair: false, list: [] }), () => {});
+        });
+    }, Math.max(0, time / speed - 1));
+}
+
+const wall_start = process.hrtime.bigint();
+let done = false;
+replay.play(() => { done = true; });
+if (virtual) {
+    replay.clock.runUntilIdle(replay.duration + 60000);
+    report();
+} else {
+    const wait = setInterval(() => {
+        if (!done) return;
+        clearInterval(wait);
+        report();
+    }, 50);
+}
+
+function report() {
+    const wall = Number(process.hrtime.bigint() - wall_start) / 1e6;
+    const stats = ble.get.stats();
+    console.log(`records ${replay.records.length} (${file.byteLength} bytes), session ${(replay.duration / 1000).toFixed(1)}s, ` +
+        `replayed in ${wall.toFixed(1)}ms wall`);
+    console.log(`delivered ${replay.stats.delivered}, held ${replay.stats.held}, dropped ${replay.stats.dropped}, ` +
+        `${Math.round(replay.stats.delivered / (wall / 1000)).toLocaleString("en")} callbacks/sec`);
+    console.log(`scan results ${adverts}, devices ${ble.get.devices() ? Object.keys(ble.get.devices()).length : 0}`);
+    for (const name in stats.latency) {
+        const { count, p50, p90, p99 } = stats.latency[name];
+        if (count) console.log(`${name.padEnd(16)} n=${count} p50=${p50} p90=${p90} p99=${p99}`);
+    }
+    if (Object.values(stats.errors).some((errors) => Object.keys(errors).length)) console.log("errors", JSON.stringify(stats.errors));
+}
@@ -0,0 +1,66 @@
+/** @about Runs the ble-master-example page against the simulator on virtual time.
+ * Usage (from easy-ble/): node --import ./dev/register.js dev/run-example.js [--record=session.eblr] [--visits=2]
+ * --visits opens the page that many times in a row, later visits reuse the app session's connection.
+ */
+import { writeFileSync } from 'node:fs';
+import { BLESimulator } from './ble-sim.js';
+import { SessionRecorder } from './ble-replay.js';
+import { useTransport } from './zos/ble.js';
+import { parseArgs } from './common.js';
+
+const RUN_TIME = 5000; // virtual millis
+
+const sim = new BLESimulator({
+    peripherals: [
+        { mac: "a1:a2:a3:a4:a5:a6", name: "lamp", advert_interval: 200, service_uuids: ["A032"], gatt: { "A032": { "A040": { value: "00" } } } },
+        {
+            mac: "b1:b2:b3:b4:b5:b6", name: "scale", advert_interval: 150, service_uuids: ["181D"],
+            service_data: [{ uuid: "181D", data: "ff5ad4" }],
+            gatt: {
+                "00001530-0000-3512-2118-0009af100700": {
+                    "00001531-0000-3512-2118-0009af100700": { descriptors: { "2902": "0000" } },
+                    "00001532-0000-3512-2118-0009af100700": {},
+                    "00001542-0000-3512-2118-0009af100700": {},
+                    "00001543-0000-3512-2118-0009af100700": {},
+                },
+            },
+        },
+    ],
+});
+
+const args = parseArgs();
+const record_to = args.record;
+const VISITS = Number(args.visits || 1);
+const recorder = record_to ? new SessionRecorder(sim, { clock: sim.clock }) : null;
+useTransport(recorder || sim);
+const restore = sim.clock.install();
+
+let app = null;
+let page = null;
+globalThis.App = (config) => { app = { _options: config }; };
+globalThis.getApp = () => app;
+globalThis.Page = (config) => { page = config; };
+await import('../../ble-master-example/app.js');
+await import('../../ble-master-example/page/main.js');
+
+app._options.onCreate();
+for (let visit = 1; visit <= VISITS; visit++) {
+    const calls = { ...sim.calls };
+    page.build();
+    sim.clock.advance(RUN_TIME);
+    page.onDestroy();
+    if (VISITS > 1) {
+        const issued = Object.keys(sim.calls).filter((name) => sim.calls[name] !== calls[name]).map((name) => `${name}:${sim.calls[name] - (calls[name] || 0)}`);
+        console.log(`visit ${visit}: backend calls ${issued.join(" ")}`);
+    }
+}
+app._options.onDestroy();
+sim.clock.runUntilIdle();
+restore();
+
+console.log("backend calls:", JSON.stringify(sim.calls));
+console.log("writes:", JSON.stringify(sim.writes));
+if (recorder) {
+    writeFileSync(record_to, new Uint8Array(recorder.save()));
+    console.log(`recorded ${recorder.size} callbacks, ${recorder.bytes} bytes`);
+}
@@ -0,0 +1,118 @@
+/** @about Scene scenario: a "leave home" shortcut turning every lamp off, one connect/prepare/write/stop chain after the other against ble.scene.
+ * Usage (from easy-ble/):
+ *   npm run scene                               1, 3 and 5 lamps, 20 seeds each
+ *   npm run scene -- --runs=50 --admission      the scene's connects through options.admission (2 at a time)
+ *   npm run scene -- --json                     summary as JSON, for scripts
+ * The lamps were scanned before (the shortcut runs from a page that already knows them). The chain runs the flow of
+ * page/main.js per lamp: connect, startListener, write "00", stop once the write completed, then the next lamp. The last
+ * lamp of every room fails 20% of its connects, the chain moves on to the next lamp and the scene reports it as failed.
+ * Exits with 1 if the scene is not done sooner than the chain for several lamps, turns fewer lamps off or leaves a link open.
+ */
+import BLEMaster from '../ble-master.js';
+import { BLESimulator } from './ble-sim.js';
+import { parseArgs, row, LAMP_CHARA as CHARA, LAMP_PROFILE as PROFILE, lampMacs, lampPeripheral, mean, percentile, claim, verdict } from './common.js';
+
+const args = parseArgs();
+const RUNS = Number(args.runs || 20);
+const COUNTS = [1, 3, 5];
+const TIMEOUT = 30000;
+const MACS = lampMacs(Math.max(...COUNTS));
+
+function run(strategy, count, seed) {
+    const lamps = MACS.slice(0, count);
+    const sim = new BLESimulator({
+        seed,
+        latency: { connect: [300, 900], prepare: [400, 1200], write: [20, 60] },
+        peripherals: MACS.map((mac, i) => lampPeripheral(mac, i, {
+            gatt: { "A032": { [CHARA]: { value: "01" } } },
+            faults: { connect_failure: i === count - 1 ? 0.2 : 0 },
+        })),
+    });
+    const ble = new BLEMaster({ transport: sim, clock: sim.clock, admission: strategy === "scene" && args.admission ? true : undefined });
+    ble.startScan(() => {});
+    sim.clock.advance(1000);
+    ble.stopScan();
+
+    const start = sim.clock.now();
+    let elapsed = -1, off = 0;
+    if (strategy === "chain") {
+        let current = -1;
+        const next = () => {
+            if (++current === lamps.length) {
+                elapsed = sim.clock.now() - start;
+                return;
+            }
+            const mac = lamps[current];
+            let settled = false;
+            ble.connect(mac, (result) => {
+                if (settled) return;
+                settled = true;
+                if (result.connected !== 0) return next();
+                ble.startListener(ble.modifyProfileObject(mac, PROFILE), (status) => {
+                    if (status !== 0 || !ble.write.characteristic(mac, CHARA, "00").success) {
+                        ble.stop(mac);
+                        next();
+                    }
+                });
+            });
+        };
+        ble.on.charaWriteComplete(({ dev_addr, status }) => {
+            if (status === 0) off++;
+            ble.stop(dev_addr);
+            next();
+        });
+        next();
+    } else {
+        ble.scene(lamps.map((dev_addr) => ({ dev_addr, uuid: CHARA, data: "00" })), (report) => {
+            elapsed = report.elapsed;
+            off = Object.values(report.devices).filter((device) => device.result === "ok").length;
+        }, { profile: PROFILE, stop: true });
+    }
+    while (elapsed < 0 && sim.clock.now() - start < TIMEOUT) sim.clock.advance(10);
+    return { elapsed, off, connected: lamps.filter((mac) => ble.get.isConnected(mac)).length };
+}
+
+function summary(runs) {
+    const millis = runs.map((r) => r.elapsed).filter((m) => m >= 0).sort((a, b) => a - b);
+    return {
+        done: millis.length,
+        off: runs.reduce((sum, r) => sum + r.off, 0) / runs.length,
+        mean: Math.round(mean(millis)),
+        p90: percentile(millis, 0.9),
+        left_connected: runs.reduce((sum, r) => sum + r.connected, 0),
+    };
+}
+
+const results = [];
+for (const count of COUNTS) {
+    for (const strategy of ["chain", "scene"]) {
+        const runs = [];
+        for (let seed = 1; seed <= RUNS; seed++) runs.push(run(strategy, count, seed));
+        results.push({ lamps: count, strategy, ...summary(runs) });
+    }
+}
+
+const claims = [];
+for (let i = 0; i < results.length; i += 2) {
+    const [chain, scene] = [results[i], results[i + 1]];
+    claims.push(
+        claim(`${chain.lamps} lamps: every run of both strategies is done`, chain.done === RUNS && scene.done === RUNS),
+        claim(`${chain.lamps} lamps: the scene turns as many lamps off as the chain`, scene.off >= chain.off),
+        claim(`${chain.lamps} lamps: no link is left open`, chain.left_connected === 0 && scene.left_connected === 0),
+    );
+    if (chain.lamps > 1) claims.push(claim(`${chain.lamps} lamps: the scene is done sooner than the chain`, scene.mean < chain.mean));
+}
+
+const WIDTHS = [7, 10, 6, 6, 7, 7];
+if (args.json) {
+    console.log(JSON.stringify({ runs: RUNS, admission: !!args.admission, results, claims }, null, 2));
+} else {
+    console.log(`${RUNS} runs per row, millis from the shortcut until every lamp is handled${args.admission ? ", scene connects through options.admission" : ""}`);
+    console.log(row(WIDTHS, ["lamps", "strategy", "done", "off", "mean", "p90", "left connected"]));
+    for (const r of results) console.log(row(WIDTHS, [r.lamps, r.strategy, r.done, r.off.toFixed(1), r.mean, r.p90, r.left_connected]));
+    for (let i = 0; i < results.length; i += 2) {
+        console.log(`${results[i].lamps} lamps: the scene is done ${results[i].mean - results[i + 1].mean}ms sooner ` +
+            `(${(100 * (1 - results[i + 1].mean / results[i].mean)).toFixed(0)}%)`);
+    }
+}
+verdict(claims, args.json);
@@ -0,0 +1,90 @@
+/** @about Connect on first sight: time until every target lamp is connected with its profile built, sequential ladder against startScan's options.connect.
+ * Usage (from easy-ble/):
+ *   npm run sight                               1, 3 and 5 target lamps, 20 seeds each, lamps advertising every 1000ms
+ *   npm run sight -- --runs=50 --advert=2000
+ *   npm run sight -- --json                     summary as JSON, for scripts
+ * The ladder is the flow of page/main.js, extended to several lamps: scan until every target is in the registry, stop the
+ * scan, then connect and startListener one lamp after the other. First sight connects each lamp as its advert arrives and
+ * builds the profiles one at a time as the connects complete. Every seed gives the lamps different advert phases.
+ * Exits with 1 if a run misses a lamp, or first sight is not ready sooner than the ladder for several lamps.
+ */
+import BLEMaster from '../ble-master.js';
+import { BLESimulator } from './ble-sim.js';
+import { parseArgs, row, LAMP_PROFILE as PROFILE, SCALE, lampMacs, lampPeripheral, mean, percentile, claim, verdict } from './common.js';
+
+const args = parseArgs();
+const RUNS = Number(args.runs || 20);
+const ADVERT = Number(args.advert || 1000);
+const COUNTS = [1, 3, 5];
+const TIMEOUT = 30000;
+const MACS = lampMacs(Math.max(...COUNTS));
+
+function run(strategy, count, seed) {
+    const targets = MACS.slice(0, count);
+    const sim = new BLESimulator({
+        seed,
+        latency: { connect: [300, 900], prepare: [400, 1200] },
+        peripherals: [...MACS.map((mac, i) => lampPeripheral(mac, i, { advert_interval: ADVERT })), SCALE],
+    });
+    const ble = new BLEMaster({ transport: sim, clock: sim.clock });
+    const start = sim.clock.now();
+    const ready = [];
+    if (strategy === "ladder") {
+        const next = (i) => {
+            if (i === targets.length) return;
+            ble.connect(targets[i], (result) => {
+                if (result.connected !== 0) return;
+                ble.startListener(ble.modifyProfileObject(targets[i], PROFILE), (status) => {
+                    if (status === 0) ready.push(sim.clock.now() - start);
+                    next(i + 1);
+                });
+            });
+        };
+        ble.startScan(() => {
+            if (!targets.every((mac) => ble.get.hasDevice(mac))) return;
+            ble.stopScan();
+            next(0);
+        });
+    } else {
+        ble.startScan(() => {}, {
+            connect: { targets, profile: PROFILE, on_ready: ({ status }) => { if (status === 0) ready.push(sim.clock.now() - start); } },
+        });
+    }
+    while (ready.length < count && sim.clock.now() - start < TIMEOUT) sim.clock.advance(10);
+    return { first: ready[0], all: ready.length === count ? ready[count - 1] : -1 };
+}
+
+function summary(runs) {
+    const all = runs.map((r) => r.all).filter((m) => m >= 0).sort((a, b) => a - b);
+    return { done: all.length, first: Math.round(mean(runs.map((r) => r.first))), all: Math.round(mean(all)), p90: percentile(all, 0.9) };
+}
+
+const results = [];
+for (const count of COUNTS) {
+    for (const strategy of ["ladder", "sight"]) {
+        const runs = [];
+        for (let seed = 1; seed <= RUNS; seed++) runs.push(run(strategy, count, seed));
+        results.push({ targets: count, strategy, ...summary(runs) });
+    }
+}
+
+const claims = [];
+for (let i = 0; i < results.length; i += 2) {
+    const [ladder, sight] = [results[i], results[i + 1]];
+    claims.push(claim(`${ladder.targets} targets: every run of both strategies gets every lamp ready`, ladder.done === RUNS && sight.done === RUNS));
+    if (ladder.targets > 1) claims.push(claim(`${ladder.targets} targets: first sight is ready sooner than the ladder`, sight.all < ladder.all));
+}
+
+const WIDTHS = [9, 10, 6, 7, 7];
+if (args.json) {
+    console.log(JSON.stringify({ runs: RUNS, advert_interval: ADVERT, results, claims }, null, 2));
+} else {
+    console.log(`${RUNS} runs per row, lamps advertising every ${ADVERT}ms, millis from startScan until the lamps are ready`);
+    console.log(row(WIDTHS, ["targets", "strategy", "done", "first", "all", "all p90"]));
+    for (const r of results) console.log(row(WIDTHS, [r.targets, r.strategy, r.done, r.first, r.all, r.p90]));
+    for (let i = 0; i < results.length; i += 2) {
+        console.log(`${results[i].targets} targets: first sight is ready ${results[i].all - results[i + 1].all}ms sooner ` +
+            `(${(100 * (1 - results[i + 1].all / results[i].all)).toFixed(0)}%), the first lamp ${results[i].first - results[i + 1].first}ms sooner`);
+    }
+}
+verdict(claims, args.json);
@@ -0,0 +1,147 @@
+/** @about Wire format comparison: frame size, encode/decode speed and allocations of binary frames against the JSON fallback.
+ * Usage (from easy-ble/):
+ *   npm run wire                           every scenario, both formats
+ *   npm run wire -- --devices=200          devices per scan diff (default 50)
+ *   npm run wire -- --json                 results as JSON, for scripts
+ * Scenarios are built like the service produces them: scan diffs from a ScanEngine fed with sensor-tag adverts
+ * (names, service UUIDs, vendor and service data), and characteristic readings like notifications deliver them.
+ * Node numbers, not watch numbers: the ratios between the formats are what carries over.
+ */
+import { encodeFrame, decodeFrame, WIRE_FORMAT, ScanEngine } from '../ble-master.js';
+import { VirtualClock, createRandom } from './ble-sim.js';
+import { parseArgs, pad } from './common.js';
+
+const args = parseArgs();
+const DEVICES = Number(args.devices || 50);
+const READINGS = 32;
+const SAMPLE_MILLIS = 200;
+const SAMPLES = 5;
+const ALLOC_OPS = 200;
+
+let sink;
+
+/* SCENARIOS */
+
+const random = createRandom(1);
+const clock = new VirtualClock(1700000000000);
+
+function scanDiff() { // one full diff of DEVICES tags, the page's first frame
+    let scan = null;
+    const transport = { mstStartScan: (callback) => { scan = callback; return true; }, mstStopScan: () => true };
+    const engine = new ScanEngine({ transport, clock });
+    engine.start();
+    for (let i = 0; i < DEVICES; i++) {
+        scan({
+            dev_addr: new Uint8Array([0xc0, 0xff, 0xee, 0x00, i >> 8, i & 0xff]).buffer,
+            dev_name: "tag" + i,
+            rssi: -50 - Math.floor(random() * 40),
+            vendor_id: 0x0157,
+            vendor_data: new Uint8Array(Array.from({ length: 12 }, () => Math.floor(random() * 256))).buffer,
+            service_uuid_array: ["181D", "180F"],
+            service_data_array: [{ uuid: "181D", service_data: new Uint8Array([0xff, 0x5a, i & 0xff]).buffer }],
+        });
+        clock.advance(7);
+    }
+    const diff = engine.snapshot();
+    engine.stop();
+    return diff;
+}
+
+function scanUpdate(full) { // a steady-state diff: a fifth of the devices moved, one left
+    const upsert = full.upsert.slice(0, Math.ceil(DEVICES / 5) * 8);
+    for (let i = 2; i < upsert.length; i += 8) upsert[i] -= 5;
+    return { seq: full.seq + 1, time: full.time + 1000, full: false, upsert, remove: [full.upsert[full.upsert.length - 8]] };
+}
+
+function readings() { // heart rate / sensor notifications, 20 byte payloads
+    const out = [];
+    for (let i = 0; i < READINGS; i++) {
+        out.push({
+            dev_addr: "c0:ff:ee:00:00:0" + (i % 4),
+            uuid: "00002a37-0000-1000-8000-00805f9b34fb",
+            time: clock.now() + i * 31,
+            data: new Uint8Array(Array.from({ length: 20 }, () => Math.floor(random() * 256))).buffer,
+        });
+    }
+    return out;
+}
+
+const full = scanDiff();
+const scenarios = [
+    { name: `scan snapshot ${DEVICES} devices`, messages: [full] },
+    { name: `scan diff ${Math.ceil(DEVICES / 5)} changes`, messages: [scanUpdate(full)] },
+    { name: `${READINGS} readings x 20B`, messages: readings() },
+    { name: "diff + readings", messages: [scanUpdate(full), ...readings()] },
+];
+
+/* MEASUREMENT */
+
+function opsPerSec(fn) {
+    run(fn, SAMPLE_MILLIS);
+    let best = 0;
+    for (let s = 0; s < SAMPLES; s++) best = Math.max(best, run(fn, SAMPLE_MILLIS));
+    return best;
+}
+
+function run(fn, millis) {
+    let ops = 0, batch = 16;
+    const start = performance.now();
+    let elapsed = 0;
+    while (elapsed < millis) {
+        for (let i = 0; i < batch; i++) sink = fn();
+        ops += batch;
+        elapsed = performance.now() - start;
+        if (batch < 4096) batch *= 2;
+    }
+    return ops / (elapsed / 1000);
+}
+
+function bytesPerOp(fn) {
+    if (typeof globalThis.gc !== "function") return null;
+    let best = Infinity;
+    for (let s = 0; s < 3; s++) {
+        globalThis.gc();
+        const before = process.memoryUsage().heapUsed;
+        for (let i = 0; i < ALLOC_OPS; i++) sink = fn();
+        const after = process.memoryUsage().heapUsed;
+        if (after >= before) best = Math.min(best, (after - before) / ALLOC_OPS);
+    }
+    return best === Infinity ? null : Math.round(best);
+}
+
+function size(frame) {
+    return typeof frame === "string" ? Buffer.byteLength(frame) : frame.byteLength;
+}
+
+/* REPORT */
+
+const results = [];
+for (const { name, messages } of scenarios) {
+    for (const format of [WIRE_FORMAT.BINARY, WIRE_FORMAT.JSON]) {
+        const frame = encodeFrame(messages, format);
+        const decoded = decodeFrame(frame);
+        if (!decoded || decoded.length !== messages.length) throw new Error(`${name} ${format}: round trip failed`);
+        results.push({
+            scenario: name, format, bytes: size(frame),
+            encode_per_sec: Math.round(opsPerSec(() => encodeFrame(messages, format))),
+            decode_per_sec: Math.round(opsPerSec(() => decodeFrame(frame))),
+            encode_bytes_per_op: bytesPerOp(() => encodeFrame(messages, format)),
+            decode_bytes_per_op: bytesPerOp(() => decodeFrame(frame)),
+        });
+    }
+}
+
+if (args.json) {
+    console.log(JSON.stringify(results, null, 2));
+} else {
+    console.log(pad("scenario", 28) + pad("format", 8) + pad("bytes", 8) + pad("encode/s", 11) + pad("decode/s", 11) + pad("enc B/op", 10) + "dec B/op");
+    for (const r of results) {
+        console.log(pad(r.scenario, 28) + pad(r.format, 8) + pad(r.bytes, 8) + pad(r.encode_per_sec.toLocaleString("en"), 11) +
+            pad(r.decode_per_sec.toLocaleString("en"), 11) + pad(r.encode_bytes_per_op ?? "n/a", 10) + (r.decode_bytes_per_op ?? "n/a"));
+    }
+    for (let i = 0; i < results.length; i += 2) {
+        const [binary, json] = [results[i], results[i + 1]];
+        console.log(`${binary.scenario}: binary is ${(100 * binary.bytes / json.bytes).toFixed(0)}% of the JSON size, ` +
+            `encodes ${(binary.encode_per_sec / json.encode_per_sec).toFixed(1)}x, decodes ${(binary.decode_per_sec / json.decode_per_sec).toFixed(1)}x as fast`);
+    }
+}
@@ -0,0 +1,41 @@
+/** @about Stand-in for @zos/ble outside ZeppOS. Forwards to the transport set with useTransport(), e.g. a BLESimulator. */
+
+const ERR_NO_BACKEND = "eBLE: @zos/ble is not available outside ZeppOS, use new BLEMaster({ transport }) or useTransport()";
+
+let transport = null;
+
+/**
+ * Routes every @zos/ble call to the given transport, so code that uses the default backend runs against it.
+ * @param {Object|null} backend - An object implementing the mst* surface, or null to detach.
+ */
+export function useTransport(backend) {
+    transport = backend;
+}
+
+function forward(name) {
+    return (...args) => {
+        if (!transport) throw new Error(ERR_NO_BACKEND);
+        return transport[name](...args);
+    };
+}
+
+export const mstStartScan = forward('mstStartScan');
+export const mstStopScan = forward('mstStopScan');
+export const mstConnect = forward('mstConnect');
+export const mstDisconnect = forward('mstDisconnect');
+export const mstPair = forward('mstPair');
+export const mstBuildProfile = forward('mstBuildProfile');
+export const mstDestroyProfileInstance = forward('mstDestroyProfileInstance');
+export const mstOnPrepare = forward('mstOnPrepare');
+export const mstReadCharacteristic = forward('mstReadCharacteristic');
+export const mstReadDescriptor = forward('mstReadDescriptor');
+export const mstWriteCharacteristic = forward('mstWriteCharacteristic');
+export const mstWriteDescriptor = forward('mstWriteDescriptor');
+export const mstOnCharaReadComplete = forward('mstOnCharaReadComplete');
+export const mstOnCharaValueArrived = forward('mstOnCharaValueArrived');
+export const mstOnCharaWriteComplete = forward('mstOnCharaWriteComplete');
+export const mstOnDescReadComplete = forward('mstOnDescReadComplete');
+export const mstOnDescValueArrived = forward('mstOnDescValueArrived');
+export const mstOnDescWriteComplete = forward('mstOnDescWriteComplete');
+export const mstOnCharaNotification = forward('mstOnCharaNotification');
+export const mstOffAllCb = forward('mstOffAllCb');
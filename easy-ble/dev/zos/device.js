@@ -0,0 +1,8 @@
+/** @about Minimal @zos/device stand-in, reports a 480x480 round screen. */
+
+export const SCREEN_SHAPE_SQUARE = 0;
+export const SCREEN_SHAPE_ROUND = 1;
+
+export function getDeviceInfo() {
+    return { width: 480, height: 480, screenShape: SCREEN_SHAPE_ROUND };
+}
@@ -0,0 +1,7 @@
+/** @about Minimal @zos/display stand-in. */
+
+export function setPageBrightTime() {
+    return 0;
+}
+
+export function setWakeUpRelaunch() {}
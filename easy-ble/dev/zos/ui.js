@@ -0,0 +1,22 @@
+/** @about Minimal @zos/ui stand-in: widgets are inert objects. */
+
+export const widget = { TEXT: 'TEXT', FILL_RECT: 'FILL_RECT', BUTTON: 'BUTTON', IMG: 'IMG' };
+export const prop = { MORE: 'MORE', VISIBLE: 'VISIBLE', TEXT: 'TEXT' };
+export const align = { LEFT: 0, RIGHT: 1, CENTER_H: 2, TOP: 3, BOTTOM: 4, CENTER_V: 5 };
+export const text_style = { NONE: 0, WRAP: 1, ELLIPSIS: 2, CHAR_WRAP: 3 };
+
+export function createWidget(type, options = {}) {
+    const props = { ...options };
+    return {
+        type,
+        setProperty(key, value) {
+            if (key === prop.MORE) Object.assign(props, value);
+            else props[key] = value;
+        },
+        getProperty(key) {
+            return props[key];
+        },
+    };
+}
+
+export function deleteWidget() {}
@@ -0,0 +1,18 @@
+/** @about Minimal @zos/utils stand-in. */
+
+export function px(value) {
+    return value;
+}
+
+export const log = {
+    getLogger(name) {
+        const prefix = name ? `[${name}]` : '';
+        return {
+            log: (...args) => console.log(prefix, ...args),
+            info: (...args) => console.info(prefix, ...args),
+            warn: (...args) => console.warn(prefix, ...args),
+            error: (...args) => console.error(prefix, ...args),
+            debug: (...args) => console.debug(prefix, ...args),
+        };
+    },
+};
@@ -0,0 +1,1665 @@
+/** @about BLE Master 1.20.1 (background) @min_zeppos 3.0 @author: Silver, Zepp Health. @license: MIT */
+// Built from easy-ble/src by dev/build.js (npm run build), edit the modules there.
+import * as hmBle from '@zos/ble'
+
+/* SERVICE */
+
+/**
+ * Entry of the background scanning bundle (dist/ble-background.js): ScanEngine for the app service, DeviceMirror for pages,
+ * the wire format between them.
+ */
+export { ScanEngine, DeviceMirror };
+export { WIRE_FORMAT, WireBatch, encodeFrame, decodeFrame };
+export { LOG_LEVEL };
+export { STATUS, CancelToken };
+
+/* CORE */
+
+/**
+ * Shared constants, the default clock and the cancellation token. Every other module builds on this one.
+ */
+
+const ERR_IDP_NOT_FOUND             = "eBLE: The ID pointer is not found for this MAC address. Please use startListener before trying to write char/desc!";
+const ERR_IDP_NOT_FOUND_SHORT       = "eBLE: Profile ID pointer not found";
+const ERR_NOT_IMPLEMENTED           = "eBLE: This feature is currently not implemented";
+const ERR_PROFILE_CREATION_FAILED   = "eBLE: Profile creation failed";
+const ERR_CHAR_READ_FAIL            = "eBLE: Failed to read characteristic";
+const ERR_DESC_READ_FAIL            = "eBLE: Failed to read descriptor";
+const ERR_CHAR_WRITE_FAIL           = "eBLE: Failed to write characteristic";
+const ERR_DESC_WRITE_FAIL           = "eBLE: Failed to write descriptor";
+const ERR_CANCELLED                 = "eBLE: Operation cancelled";
+const ERR_INVALID_MAC               = "eBLE: Invalid MAC address, expected \"a1:b2:c3:d4:e5:f6\"";
+const ERR_INVALID_DATA              = "eBLE: Invalid data, expected an ArrayBuffer, a typed array, an even-length hex string or a string of 8-bit characters";
+const ERR_INVALID_PROFILE           = "eBLE: Invalid profile object";
+const ERR_DETACHED                  = "eBLE: The page handle is detached";
+const ERR_WIRE_MESSAGE              = "eBLE: Invalid wire message, expected a ScanEngine diff or { dev_addr, uuid, time, data }";
+const ERR_WIRE_FRAME                = "eBLE: Invalid wire frame";
+const ERR_FEATURE_MISSING           = "eBLE: This feature is not built into this bundle, pass its implementation (e.g. pool: ConnectionPool)";
+const ERR_INVALID_SCENE             = "eBLE: Invalid scene, expected [{ dev_addr, uuid, data }] or [{ dev_addr, chara, desc, data }]";
+
+const SHORT_DELAY = 50; // millis
+
+/**
+ * The default time source. Pass your own { now, setTimeout, clearTimeout } as options.clock to run on virtual time.
+ */
+const SYSTEM_CLOCK = {
+    now: () => Date.now(),
+    setTimeout: (callback, millis) => setTimeout(callback, millis),
+    clearTimeout: (timer) => clearTimeout(timer),
+};
+
+// ScanEngine diff.upsert is flat, DIFF_STRIDE values per device in this order
+const DIFF_FIELDS                   = ["dev_addr", "dev_name", "rssi", "age", "vendor_id", "vendor_data", "service_uuid_array", "service_data_array"];
+const DIFF_STRIDE                   = DIFF_FIELDS.length;
+
+// mstConnect result.connected
+const CONNECT_STATUS_OK             = 0;
+const CONNECT_STATUS_FAILED         = 1;
+const CONNECT_STATUS_DISCONNECTED   = 2;
+
+/**
+ * Library statuses, delivered in place of a backend status when the library ends an operation itself.
+ */
+const STATUS = {
+    OK: 0,
+    TIMEOUT: -1, // the watchdog expired before the backend answered
+    CANCELLED: -2, // the operation's cancel token was cancelled
+    REJECTED: -3, // the backend call itself returned false
+};
+
+/**
+ * Trace record op codes.
+ * For SCAN_RESULT the record status holds the RSSI, for *_RESULT ops the backend status,
+ * for issued calls 0 = accepted by the backend and 1 = rejected. VALUE is the data of a read, which arrives
+ * before its READ_RESULT.
+ */
+const TRACE_OP = {
+    SCAN_START: 1,
+    SCAN_RESULT: 2,
+    SCAN_STOP: 3,
+    CONNECT: 4,
+    CONNECT_RESULT: 5,
+    DISCONNECT: 6,
+    PREPARE: 7,
+    PREPARE_RESULT: 8,
+    READ: 9,
+    READ_RESULT: 10,
+    WRITE: 11,
+    WRITE_RESULT: 12,
+    NOTIFY: 13,
+    VALUE: 14,
+};
+
+// latency metrics
+const METRIC_SCAN_FIRST_SEEN        = 0;
+const METRIC_CONNECT                = 1;
+const METRIC_PREPARE                = 2;
+const METRIC_READ                   = 3;
+const METRIC_WRITE                  = 4;
+const STATUS_MALFORMED              = "malformed"; // a scan result without a usable dev_addr
+
+/**
+ * A cancellation token with the AbortSignal surface (aborted, reason, addEventListener("abort")).
+ * Pass the same token to everything a page starts and cancel it once in onDestroy.
+ */
+class CancelToken {
+    #aborted = false;
+    #reason = undefined;
+    #listeners = new Set();
+
+    /**
+     * @type {boolean} True once cancel() was called.
+     */
+    get aborted() {
+        return this.#aborted;
+    }
+    /**
+     * @type {any} The reason passed to cancel().
+     */
+    get reason() {
+        return this.#reason;
+    }
+    /**
+     * Cancels every operation that was started with this token. Subsequent calls do nothing.
+     * @param {any} [reason] - An optional reason.
+     */
+    cancel(reason = ERR_CANCELLED) {
+        if (this.#aborted) return;
+        this.#aborted = true;
+        this.#reason = reason;
+        const listeners = Array.from(this.#listeners);
+        this.#listeners.clear();
+        for (const listener of listeners) listener();
+    }
+    addEventListener(type, listener) {
+        if (type === "abort" && !this.#aborted) this.#listeners.add(listener);
+    }
+    removeEventListener(type, listener) {
+        if (type === "abort") this.#listeners.delete(listener);
+    }
+}
+
+function metricOf(op) {
+    switch (op) {
+        case TRACE_OP.CONNECT: case TRACE_OP.CONNECT_RESULT: return METRIC_CONNECT;
+        case TRACE_OP.PREPARE: case TRACE_OP.PREPARE_RESULT: return METRIC_PREPARE;
+        case TRACE_OP.READ: case TRACE_OP.READ_RESULT: return METRIC_READ;
+        case TRACE_OP.WRITE: case TRACE_OP.WRITE_RESULT: return METRIC_WRITE;
+        default: return -1;
+    }
+}
+
+function noop() {}
+
+function notify(callback, response) {
+    if (callback) callback(response);
+}
+
+function emitCallback(callbacks, name, response) { // the ble.on callback, then the library's own listeners (scenes)
+    notify(callbacks[name], response);
+    if (callbacks.taps) for (const tap of callbacks.taps) tap(name, response);
+}
+
+function attrKey(dev_addr, uuid, desc) { // pairs a read/write with its completion
+    return desc === undefined ? dev_addr + "/" + uuid.toUpperCase() : dev_addr + "/" + uuid.toUpperCase() + "/" + desc.toUpperCase();
+}
+
+/* LOG */
+
+/**
+ * The library-wide leveled logger.
+ */
+
+const LOG_STRIP = false; // build-time switch. true = every log call becomes dead code and can be dropped by the minifier (npm run build -- --strip-logs)
+
+/**
+ * Log levels. Messages above the current level are skipped before any formatting happens.
+ */
+const LOG_LEVEL = {
+    NONE: 0,
+    ERROR: 1,
+    WARN: 2,
+    INFO: 3,
+    DEBUG: 4,
+};
+const DEFAULT_LOG_LEVEL = LOG_LEVEL.WARN;
+
+/**
+ * Leveled logger. A message can be a string or a function (thunk) that returns the string,
+ * the thunk is only called when the level is enabled, so expensive formatting like JSON.stringify
+ * costs nothing in production.
+ */
+class Logger {
+    level = DEFAULT_LOG_LEVEL;
+
+    error(message, ...params) {
+        if (!LOG_STRIP && this.level >= LOG_LEVEL.ERROR) this.#print(message, params);
+    }
+    warn(message, ...params) {
+        if (!LOG_STRIP && this.level >= LOG_LEVEL.WARN) this.#print(message, params);
+    }
+    info(message, ...params) {
+        if (!LOG_STRIP && this.level >= LOG_LEVEL.INFO) this.#print(message, params);
+    }
+    debug(message, ...params) {
+        if (!LOG_STRIP && this.level >= LOG_LEVEL.DEBUG) this.#print(message, params);
+    }
+    #print(message, params) {
+        console.log(typeof message === "function" ? message() : message, ...params);
+    }
+}
+
+const logger = new Logger();
+
+/* CODECS */
+
+/**
+ * Codecs between the backend's ArrayBuffers and the strings the library hands out, plus input validation.
+ * No dependencies, usable on its own.
+ */
+
+const MAC_BYTES              = 6;
+const MAC_LENGTH                    = 17; // "a1:b2:c3:d4:e5:f6"
+const HEX_PATTERN                   = /^[0-9A-Fa-f]+$/;
+const UUID_PATTERN                  = /^([0-9A-Fa-f]{4}|[0-9A-Fa-f]{8}|[0-9A-Fa-f]{8}-[0-9A-Fa-f]{4}-[0-9A-Fa-f]{4}-[0-9A-Fa-f]{4}-[0-9A-Fa-f]{12})$/;
+const HEX_CODES                     = Array.from("0123456789abcdef", (digit) => digit.charCodeAt(0));
+const CHUNK_CHARS                   = 4096; // String.fromCharCode.apply argument limit per call
+
+function str2ab_with_len(str){ // one byte per char, chars above 0xFF keep their low byte (as since 1.0.0)
+    const bytes = new Uint8Array(str.length);
+    for (let i = 0; i < str.length; i++) bytes[i] = str.charCodeAt(i);
+    return { data_ab: bytes.buffer, data_len: bytes.length };
+}
+
+function latin1ToAb(str) { // str2ab_with_len for data2ab: null if a char does not fit in 8 bits
+    const bytes = new Uint8Array(str.length);
+    for (let i = 0; i < str.length; i++) {
+        const code = str.charCodeAt(i);
+        if (code > 0xFF) return null;
+        bytes[i] = code;
+    }
+    return bytes.buffer;
+}
+
+function bytes2mac(b, i) { // the 6 bytes at b[i] as "a1:b2:..", for MACs inside a larger buffer
+    return String.fromCharCode(
+        HEX_CODES[b[i] >> 4], HEX_CODES[b[i] & 15], 58, HEX_CODES[b[i + 1] >> 4], HEX_CODES[b[i + 1] & 15], 58,
+        HEX_CODES[b[i + 2] >> 4], HEX_CODES[b[i + 2] & 15], 58, HEX_CODES[b[i + 3] >> 4], HEX_CODES[b[i + 3] & 15], 58,
+        HEX_CODES[b[i + 4] >> 4], HEX_CODES[b[i + 4] & 15], 58, HEX_CODES[b[i + 5] >> 4], HEX_CODES[b[i + 5] & 15]);
+}
+
+function ab2mac(ab) { // one flat string, no intermediate arrays or concatenations
+    const b = new Uint8Array(ab);
+    if (b.length !== MAC_BYTES) return ab2str_stripped(ab).replace(/(..)(?!$)/g, "$1:");
+    return String.fromCharCode(
+        HEX_CODES[b[0] >> 4], HEX_CODES[b[0] & 15], 58, HEX_CODES[b[1] >> 4], HEX_CODES[b[1] & 15], 58,
+        HEX_CODES[b[2] >> 4], HEX_CODES[b[2] & 15], 58, HEX_CODES[b[3] >> 4], HEX_CODES[b[3] & 15], 58,
+        HEX_CODES[b[4] >> 4], HEX_CODES[b[4] & 15], 58, HEX_CODES[b[5] >> 4], HEX_CODES[b[5] & 15]);
+}
+
+function mac2ab(mac) { // null for anything but "a1:b2:c3:d4:e5:f6" (any case)
+    if (!isMac(mac)) return null;
+    const bytes = new Uint8Array(MAC_BYTES);
+    for (let i = 0; i < MAC_BYTES; i++) {
+        bytes[i] = hexValue(mac.charCodeAt(i * 3)) * 16 + hexValue(mac.charCodeAt(i * 3 + 1));
+    }
+    return bytes.buffer;
+}
+
+function isMac(mac) {
+    if (typeof mac !== "string" || mac.length !== MAC_LENGTH) return false;
+    for (let i = 0; i < MAC_LENGTH; i++) {
+        const c = mac.charCodeAt(i);
+        if (i % 3 === 2 ? c !== 58 : hexValue(c) < 0) return false; // ':' every third char
+    }
+    return true;
+}
+
+function normalizeMac(mac) {
+    return isMac(mac) ? mac.toLowerCase() : null;
+}
+
+function hexValue(c) { // char code > 0..15, -1 if not a hex digit
+    if (c >= 48 && c <= 57) return c - 48;
+    c |= 0x20; // lowercase
+    return c >= 97 && c <= 102 ? c - 87 : -1;
+}
+
+function mac2num(mac) { // "a1:b2:.." > 48-bit number, no allocations
+    let num = 0;
+    for (let i = 0; i < mac.length; i++) {
+        const c = mac.charCodeAt(i);
+        if (c === 58) continue; // ':'
+        num = num * 16 + (c <= 57 ? c - 48 : (c | 0x20) - 87);
+    }
+    return num;
+}
+
+function num2mac(num) {
+    let mac = "";
+    for (let shift = 40; shift >= 0; shift -= 8) {
+        const byte = Math.floor(num / 2 ** shift) % 256;
+        mac += (byte < 16 ? "0" : "") + byte.toString(16) + (shift ? ":" : "");
+    }
+    return mac;
+}
+
+const hex_scratch = [];
+function ab2str_stripped(buffer) { // strip unicode
+    if (!(buffer instanceof ArrayBuffer)) return "";
+    const bytes = new Uint8Array(buffer);
+    return bytes2hex(bytes, 0, bytes.length);
+}
+
+function bytes2hex(bytes, from, to) { // lowercase hex of bytes[from..to)
+    let str = "";
+    for (let start = from; start < to; start += CHUNK_CHARS / 2) {
+        const end = Math.min(to, start + CHUNK_CHARS / 2);
+        hex_scratch.length = (end - start) * 2;
+        for (let i = start, j = 0; i < end; i++) {
+            hex_scratch[j++] = HEX_CODES[bytes[i] >> 4];
+            hex_scratch[j++] = HEX_CODES[bytes[i] & 15];
+        }
+        str += String.fromCharCode.apply(null, hex_scratch);
+    }
+    return str;
+}
+
+/**
+ * ArrayBuffer as is, typed arrays as a copy of their bytes, even-length hex strings decoded, other strings one byte per char.
+ * @returns {ArrayBuffer|null} null for anything else: odd-length hex, chars above 0xFF, numbers, objects.
+ */
+function data2ab(data) {
+    if (data instanceof ArrayBuffer) {
+        return data;
+    } else if (ArrayBuffer.isView(data)) {
+        return data.buffer.slice(data.byteOffset, data.byteOffset + data.byteLength);
+    } else if (typeof data === "string") {
+        if (HEX_PATTERN.test(data)) { // hex string
+            if (data.length % 2) return null; // the last nibble would be read as a whole byte
+            const bytes = new Uint8Array(data.length / 2);
+            for (let i = 0; i < bytes.length; i++) {
+                bytes[i] = hexValue(data.charCodeAt(i * 2)) * 16 + hexValue(data.charCodeAt(i * 2 + 1));
+            }
+            return bytes.buffer;
+        } else { // normal string
+            return latin1ToAb(data);
+        }
+    }
+    return null;
+}
+
+/**
+ * Checks the parts of a profile object that mstBuildProfile dereferences.
+ * @returns {string|null} What is wrong with it, or null if it is usable.
+ */
+function profileError(profile) {
+    if (!profile || typeof profile !== "object") return "not an object";
+    if (!(profile.dev instanceof ArrayBuffer) || profile.dev.byteLength !== MAC_BYTES) return "dev is not a 6 byte ArrayBuffer";
+    if (!Array.isArray(profile.list)) return "list is not an array";
+    if (profile.len !== undefined && profile.len !== profile.list.length) return "len does not match list";
+    for (const group of profile.list) {
+        if (!group || !Array.isArray(group.list)) return "service group without a list";
+        if (group.len !== undefined && group.len !== group.list.length) return "service group len does not match its list";
+        for (const service of group.list) {
+            if (!service || !isUuid(service.uuid)) return "service without a valid uuid";
+            if (!Array.isArray(service.list)) return "service " + service.uuid + " without a characteristic list";
+            for (const chara of service.list) {
+                if (!chara || !isUuid(chara.uuid)) return "characteristic without a valid uuid in " + service.uuid;
+                if (chara.list === undefined) continue;
+                if (!Array.isArray(chara.list)) return "characteristic " + chara.uuid + " has a list that is not an array";
+                if (chara.len !== undefined && chara.len !== chara.list.length) return "characteristic " + chara.uuid + " len does not match its list";
+                for (const desc of chara.list) {
+                    if (!desc || !isUuid(desc.uuid)) return "descriptor without a valid uuid in " + chara.uuid;
+                }
+            }
+        }
+    }
+    return null;
+}
+
+function isUuid(uuid) {
+    return typeof uuid === "string" && UUID_PATTERN.test(uuid);
+}
+
+/* REGISTRY */
+
+/**
+ * Device registries: where scan results and connection state are kept, and the read-only view pages get through ble.get.
+ */
+
+const REGISTRY_COMPACT              = "compact";
+const DEFAULT_REGISTRY_CAPACITY     = 64; // slots, compact registry grows by doubling
+const FLAG_CONNECTED                = 0x01;
+
+/**
+ * Creates the registry selected by options.registry ("object" by default, "compact") and options.capacity.
+ */
+function createRegistry(options, clock) {
+    return options.registry === REGISTRY_COMPACT
+        ? new CompactRegistry(options.capacity, clock)
+        : new ObjectRegistry(clock);
+}
+
+class ObjectRegistry {
+    #devices = {};
+    #size = 0;
+    #by_connect_id = new Map(); // connect_id > MAC, backend callbacks resolve their device without a walk
+    #by_profile = new Map();    // profile_idp > MAC
+    #clock;
+
+    constructor(clock = SYSTEM_CLOCK) {
+        this.#clock = clock;
+    }
+    /**
+     * @type {number} The number of known devices.
+     */
+    get size() {
+        return this.#size;
+    }
+    has(dev_addr) {
+        return this.#devices.hasOwnProperty(dev_addr);
+    }
+    get(dev_addr) {
+        return this.#devices[dev_addr];
+    }
+    all() {
+        return this.#devices;
+    }
+    scan(dev_addr, scan_result) {
+        let device = this.#devices[dev_addr];
+        if (!device) {
+            device = this.#devices[dev_addr] = {};
+            this.#size++;
+        }
+        const last_seen = device.last_seen === undefined ? -1 : device.last_seen;
+        // update in place, this keeps the connection state (connect_id, profile_idp, is_connected) intact
+        device.dev_name = scan_result.dev_name;
+        device.rssi = scan_result.rssi;
+        device.service_uuid_array = scan_result.service_uuid_array;
+        device.service_data_array = scan_result.service_data_array;
+        device.vendor_id = scan_result.vendor_id;
+        device.vendor_data = scan_result.vendor_data;
+        device.last_seen = this.#clock.now();
+        return last_seen;
+    }
+    remove(dev_addr) {
+        if (!this.has(dev_addr)) return false;
+        const device = this.#devices[dev_addr];
+        unindex(this.#by_connect_id, device.connect_id, dev_addr);
+        unindex(this.#by_profile, device.profile_idp, dev_addr);
+        delete this.#devices[dev_addr];
+        this.#size--;
+        return true;
+    }
+    link(dev_addr, connect_id) {
+        let device = this.#devices[dev_addr];
+        if (!device) {
+            device = this.#devices[dev_addr] = {};
+            this.#size++;
+        }
+        unindex(this.#by_connect_id, device.connect_id, dev_addr);
+        device.connect_id = connect_id;
+        device.is_connected = true;
+        this.#by_connect_id.set(connect_id, dev_addr);
+    }
+    unlink(dev_addr) {
+        const device = this.#devices[dev_addr];
+        if (device) device.is_connected = false;
+    }
+    setProfile(dev_addr, profile_idp) {
+        const device = this.#devices[dev_addr];
+        if (!device) return;
+        unindex(this.#by_profile, device.profile_idp, dev_addr);
+        device.profile_idp = profile_idp;
+        if (profile_idp !== undefined) this.#by_profile.set(profile_idp, dev_addr);
+    }
+    isConnected(dev_addr) {
+        const device = this.#devices[dev_addr];
+        return !!device && device.is_connected === true;
+    }
+    connectId(dev_addr) {
+        const device = this.#devices[dev_addr];
+        return device && device.connect_id;
+    }
+    profile(dev_addr) {
+        const device = this.#devices[dev_addr];
+        return device && device.profile_idp;
+    }
+    findByProfile(profile_idp) {
+        const dev_addr = this.#by_profile.get(profile_idp);
+        return dev_addr === undefined ? null : dev_addr;
+    }
+    findByConnectId(connect_id) {
+        const dev_addr = this.#by_connect_id.get(connect_id);
+        return dev_addr === undefined ? null : dev_addr;
+    }
+}
+
+/**
+ * Struct-of-arrays device registry. Hot per-advert fields (MAC, RSSI, last seen, flags) live in typed-array
+ * columns indexed by slot, everything else is kept by reference in sparse columns. Device objects and MAC
+ * strings are only materialized when requested through get() or all().
+ */
+class CompactRegistry {
+    #capacity;
+    #size = 0;
+    #slots = new Map(); // numeric MAC > slot
+    #mac;               // Float64Array, 48-bit MAC as a number
+    #rssi;              // Int8Array
+    #last_seen;         // Float64Array, millis
+    #flags;             // Uint8Array, FLAG_*
+    // cold columns
+    #dev_name = [];
+    #service_uuid_array = [];
+    #service_data_array = [];
+    #vendor_id = [];
+    #vendor_data = [];
+    #links = new Map(); // slot > { connect_id, profile_idp } (only for devices that were ever connected)
+    #by_connect_id = new Map(); // connect_id > MAC
+    #by_profile = new Map();    // profile_idp > MAC
+    #clock;
+
+    constructor(capacity = DEFAULT_REGISTRY_CAPACITY, clock = SYSTEM_CLOCK) {
+        this.#clock = clock;
+        this.#capacity = Math.max(1, capacity | 0);
+        this.#mac = new Float64Array(this.#capacity);
+        this.#rssi = new Int8Array(this.#capacity);
+        this.#last_seen = new Float64Array(this.#capacity);
+        this.#flags = new Uint8Array(this.#capacity);
+    }
+    /**
+     * @type {number} The number of known devices.
+     */
+    get size() {
+        return this.#size;
+    }
+    has(dev_addr) {
+        return this.#slots.has(mac2num(dev_addr));
+    }
+    get(dev_addr) {
+        const slot = this.#slots.get(mac2num(dev_addr));
+        return slot === undefined ? undefined : this.#view(slot);
+    }
+    all() {
+        const devices = {};
+        for (let slot = 0; slot < this.#size; slot++) {
+            devices[num2mac(this.#mac[slot])] = this.#view(slot);
+        }
+        return devices;
+    }
+    scan(dev_addr, scan_result) {
+        const slot = this.#slotOf(dev_addr);
+        const last_seen = this.#last_seen[slot];
+        this.#rssi[slot] = scan_result.rssi;
+        this.#last_seen[slot] = this.#clock.now();
+        this.#dev_name[slot] = scan_result.dev_name;
+        this.#service_uuid_array[slot] = scan_result.service_uuid_array;
+        this.#service_data_array[slot] = scan_result.service_data_array;
+        this.#vendor_id[slot] = scan_result.vendor_id;
+        this.#vendor_data[slot] = scan_result.vendor_data;
+        return last_seen;
+    }
+    remove(dev_addr) { // the last slot moves into the freed one, columns stay dense
+        const mac = mac2num(dev_addr);
+        const slot = this.#slots.get(mac);
+        if (slot === undefined) return false;
+        const removed = this.#links.get(slot);
+        if (removed) {
+            unindex(this.#by_connect_id, removed.connect_id, num2mac(mac));
+            unindex(this.#by_profile, removed.profile_idp, num2mac(mac));
+        }
+        const last = --this.#size;
+        this.#slots.delete(mac);
+        const link = this.#links.get(last);
+        this.#links.delete(slot);
+        this.#links.delete(last);
+        if (slot !== last) {
+            this.#mac[slot] = this.#mac[last];
+            this.#rssi[slot] = this.#rssi[last];
+            this.#last_seen[slot] = this.#last_seen[last];
+            this.#flags[slot] = this.#flags[last];
+            this.#dev_name[slot] = this.#dev_name[last];
+            this.#service_uuid_array[slot] = this.#service_uuid_array[last];
+            this.#service_data_array[slot] = this.#service_data_array[last];
+            this.#vendor_id[slot] = this.#vendor_id[last];
+            this.#vendor_data[slot] = this.#vendor_data[last];
+            if (link) this.#links.set(slot, link);
+            this.#slots.set(this.#mac[slot], slot);
+        }
+        this.#flags[last] = 0;
+        this.#dev_name.length = this.#service_uuid_array.length = this.#service_data_array.length = last;
+        this.#vendor_id.length = this.#vendor_data.length = last;
+        return true;
+    }
+    link(dev_addr, connect_id) {
+        const slot = this.#slotOf(dev_addr);
+        dev_addr = num2mac(this.#mac[slot]); // the indexes hold the MACs findBy* always returned
+        const link = this.#links.get(slot);
+        if (link) {
+            unindex(this.#by_connect_id, link.connect_id, dev_addr);
+            link.connect_id = connect_id;
+        } else {
+            this.#links.set(slot, { connect_id, profile_idp: undefined });
+        }
+        this.#flags[slot] |= FLAG_CONNECTED;
+        this.#by_connect_id.set(connect_id, dev_addr);
+    }
+    unlink(dev_addr) {
+        const slot = this.#slots.get(mac2num(dev_addr));
+        if (slot !== undefined) this.#flags[slot] &= ~FLAG_CONNECTED;
+    }
+    setProfile(dev_addr, profile_idp) {
+        const mac = mac2num(dev_addr);
+        const link = this.#links.get(this.#slots.get(mac));
+        if (!link) return;
+        dev_addr = num2mac(mac);
+        unindex(this.#by_profile, link.profile_idp, dev_addr);
+        link.profile_idp = profile_idp;
+        if (profile_idp !== undefined) this.#by_profile.set(profile_idp, dev_addr);
+    }
+    isConnected(dev_addr) {
+        const slot = this.#slots.get(mac2num(dev_addr));
+        return slot !== undefined && (this.#flags[slot] & FLAG_CONNECTED) !== 0;
+    }
+    connectId(dev_addr) {
+        const link = this.#links.get(this.#slots.get(mac2num(dev_addr)));
+        return link && link.connect_id;
+    }
+    profile(dev_addr) {
+        const link = this.#links.get(this.#slots.get(mac2num(dev_addr)));
+        return link && link.profile_idp;
+    }
+    findByProfile(profile_idp) {
+        const dev_addr = this.#by_profile.get(profile_idp);
+        return dev_addr === undefined ? null : dev_addr;
+    }
+    findByConnectId(connect_id) {
+        const dev_addr = this.#by_connect_id.get(connect_id);
+        return dev_addr === undefined ? null : dev_addr;
+    }
+    #slotOf(dev_addr) {
+        const mac = mac2num(dev_addr);
+        let slot = this.#slots.get(mac);
+        if (slot === undefined) {
+            if (this.#size === this.#capacity) this.#grow();
+            slot = this.#size++;
+            this.#slots.set(mac, slot);
+            this.#mac[slot] = mac;
+            this.#last_seen[slot] = -1; // never advertised
+        }
+        return slot;
+    }
+    #grow() {
+        this.#capacity *= 2;
+        this.#mac = growTyped(this.#mac, this.#capacity);
+        this.#rssi = growTyped(this.#rssi, this.#capacity);
+        this.#last_seen = growTyped(this.#last_seen, this.#capacity);
+        this.#flags = growTyped(this.#flags, this.#capacity);
+    }
+    #view(slot) {
+        const device = {
+            dev_name: this.#dev_name[slot],
+            rssi: this.#rssi[slot],
+            service_uuid_array: this.#service_uuid_array[slot],
+            service_data_array: this.#service_data_array[slot],
+            vendor_id: this.#vendor_id[slot],
+            vendor_data: this.#vendor_data[slot],
+            last_seen: this.#last_seen[slot] < 0 ? undefined : this.#last_seen[slot]
+        };
+        const link = this.#links.get(slot);
+        if (link) {
+            device.connect_id = link.connect_id;
+            device.profile_idp = link.profile_idp;
+            device.is_connected = (this.#flags[slot] & FLAG_CONNECTED) !== 0;
+        }
+        return device;
+    }
+}
+
+class Get {
+    #registry;
+    #monitor;
+    constructor(registry, monitor) {
+        this.#registry = registry;
+        this.#monitor = monitor;
+    }
+    /**
+     * Returns all devices.
+     * @returns {Object} Returns an object containing information about all devices.
+     */
+    devices() {
+        return this.#registry.all();
+    }
+    /**
+     * Returns one device.
+     * @param {string} dev_addr - The MAC address of the device.
+     * @returns {Object|undefined} Returns the device's information (same shape as an entry of devices()), or undefined if it is not known.
+     */
+    device(dev_addr) {
+        dev_addr = normalizeMac(dev_addr);
+        return dev_addr === null ? undefined : this.#registry.get(dev_addr);
+    }
+    /**
+     * Checks if a device is connected.
+     * @param {string} dev_addr - The MAC address of the device.
+     * @returns {boolean} Returns true if the device is connected, false otherwise.
+     */
+    isConnected(dev_addr){
+        dev_addr = normalizeMac(dev_addr);
+        return dev_addr !== null && this.#registry.isConnected(dev_addr);
+    }
+    /**
+     * Checks if a device exists.
+     * @param {string} dev_addr - The MAC address of the device.
+     * @returns {boolean} Returns true if the device exists, false otherwise.
+     */
+    hasDevice(dev_addr) {
+        dev_addr = normalizeMac(dev_addr);
+        return dev_addr !== null && this.#registry.has(dev_addr);
+    }
+    /**
+     * Returns the built-in metrics.
+     * @returns {Object} Returns { counters, latency, errors }. counters holds the number of each TRACE_OP event (lowercase names),
+     * latency holds { count, min, max, mean, p50, p90, p99, buckets } in millis for scan_first_seen, connect, prepare, read and write,
+     * errors holds the number of non-zero backend statuses (or "rejected" backend calls) per operation.
+     */
+    stats() {
+        return this.#monitor.stats();
+    }
+}
+
+function unindex(index, key, dev_addr) { // drops a reverse index entry unless another device took the key over since
+    if (key !== undefined && index.get(key) === dev_addr) index.delete(key);
+}
+
+function growTyped(arr, length) {
+    const grown = new arr.constructor(length);
+    grown.set(arr);
+    return grown;
+}
+
+/* NO DIAGNOSTICS */
+
+/**
+ * Stand-in for diagnostics.js in builds without diagnostics: no trace, no stats, no watchdog.
+ * Only the cancel token wiring of Monitor.start is kept, pending operations still need it to be abandoned.
+ */
+
+const MAX_PENDING_PER_KEY = 16;
+
+function createMonitor() {
+    return new QuietMonitor();
+}
+
+class QuietMonitor {
+    trace = null;
+    onRecycle = null;
+    #cancels = Array.from({ length: METRIC_WRITE + 1 }, () => new Map()); // key > [{ dispose }], oldest first, per metric
+
+    start(op, dev_addr, key, on_expire, signal, on_cancel) {
+        const metric = metricOf(op);
+        const entry = { dispose: noop };
+        const queue = this.#cancels[metric].get(key);
+        if (queue === undefined) this.#cancels[metric].set(key, [entry]);
+        else if (queue.push(entry) > MAX_PENDING_PER_KEY) this.#settle(metric, key); // no watchdog here, bounds what a silent backend leaves
+        if (!signal) return;
+        const cancel = () => {
+            this.#remove(metric, key, entry);
+            if (on_cancel) on_cancel();
+        };
+        signal.addEventListener("abort", cancel);
+        entry.dispose = () => signal.removeEventListener("abort", cancel);
+    }
+    issued(op, dev_addr, success, size = 0, key = dev_addr) {
+        if (!success) this.#settle(metricOf(op), key, true);
+    }
+    completed(op, dev_addr, status, size = 0, key = dev_addr) {
+        this.#settle(metricOf(op), key);
+    }
+    event() {}
+    error() {}
+    sample() {}
+    reset() {}
+    stats() {
+        return { counters: {}, latency: {}, errors: {} };
+    }
+    #settle(metric, key, newest = false) { // like Monitor: results settle the oldest operation on a key
+        if (metric < 0) return;
+        const queue = this.#cancels[metric].get(key);
+        if (queue === undefined) return;
+        const entry = newest ? queue.pop() : queue.shift();
+        if (queue.length === 0) this.#cancels[metric].delete(key);
+        entry.dispose();
+    }
+    #remove(metric, key, entry) {
+        const queue = this.#cancels[metric].get(key);
+        const index = queue === undefined ? -1 : queue.indexOf(entry);
+        if (index < 0) return;
+        queue.splice(index, 1);
+        if (queue.length === 0) this.#cancels[metric].delete(key);
+        entry.dispose();
+    }
+}
+
+/* SCAN */
+
+/**
+ * Scanning: decodes every advert, keeps the registry up to date and measures the time to first sight.
+ */
+
+class Scanner {
+    #ble;
+    #clock;
+    #registry;
+    #monitor;
+    #scan_started_at = 0;
+    #scan_dispose = noop;
+
+    constructor(ble, clock, registry, monitor) {
+        this.#ble = ble;
+        this.#clock = clock;
+        this.#registry = registry;
+        this.#monitor = monitor;
+    }
+    /**
+     * Starts scanning for devices. See BLEMaster.startScan.
+     */
+    startScan(response_callback, options = {}) {
+        const signal = options.signal;
+        if (signal && signal.aborted) return false;
+        const filter = options.filter;
+        const modified_callback = (scan_result) => {
+            if (!scan_result || !(scan_result.dev_addr instanceof ArrayBuffer) || scan_result.dev_addr.byteLength !== MAC_BYTES) {
+                this.#monitor.error(METRIC_SCAN_FIRST_SEEN, STATUS_MALFORMED); // nothing to key it by, drop it here
+                return;
+            }
+            const scan_result_str = {
+                ...scan_result,
+                dev_addr: ab2mac(scan_result.dev_addr),
+                vendor_data: ab2str_stripped(scan_result.vendor_data), // decode
+                service_data_array: Array.isArray(scan_result.service_data_array) ? scan_result.service_data_array.map(service => ({ // map (!) empty
+                    ...service,
+                    service_data: ab2str_stripped(service && service.service_data)
+                })) : []
+            };
+            if (filter && !filter(scan_result_str)) return; // keeps the registry down to the devices the caller cares about
+            const last_seen = this.#registry.scan(scan_result_str.dev_addr, scan_result_str);
+            if (last_seen < this.#scan_started_at) { // first advert of this device since the scan started
+                this.#monitor.sample(METRIC_SCAN_FIRST_SEEN, this.#clock.now() - this.#scan_started_at);
+            }
+            this.#monitor.event(TRACE_OP.SCAN_RESULT, scan_result_str.dev_addr, scan_result_str.rssi, scan_result.vendor_data ? scan_result.vendor_data.byteLength : 0);
+
+            response_callback(scan_result_str);
+        }
+
+        this.#scan_dispose();
+        this.#scan_started_at = this.#clock.now();
+        const success = this.#ble.mstStartScan(modified_callback);
+        this.#monitor.issued(TRACE_OP.SCAN_START, null, success);
+        let duration_timer = null;
+        if (options.duration !== undefined) {
+            duration_timer = this.#clock.setTimeout(() => {
+                this.stopScan();
+                if (options.on_duration) {
+                    options.on_duration();
+                }
+            }, options.duration);
+        }
+        if (signal) {
+            const stop = () => {
+                this.#clock.clearTimeout(duration_timer);
+                this.stopScan();
+            };
+            signal.addEventListener("abort", stop);
+            this.#scan_dispose = () => {
+                this.#scan_dispose = noop;
+                this.#clock.clearTimeout(duration_timer);
+                signal.removeEventListener("abort", stop);
+            };
+        }
+        return success;
+    }
+    /**
+     * Stops scanning for devices. See BLEMaster.stopScan.
+     */
+    stopScan() {
+        this.#scan_dispose();
+        const success = this.#ble.mstStopScan();
+        this.#monitor.issued(TRACE_OP.SCAN_STOP, null, success);
+        return success;
+    }
+}
+
+/* BACKGROUND */
+
+/**
+ * Background scanning: ScanEngine runs in an app service and keeps scanning while the screen is off, pages keep a
+ * DeviceMirror that is brought up to date with the engine's batched diffs.
+ */
+
+const DEFAULT_BATCH_INTERVAL        = 1000;  // millis between two diffs
+const DEFAULT_MAX_BATCH             = 100;   // devices per diff, the rest waits for the next one
+const DEFAULT_TTL                   = 30000; // millis without an advert before a device is removed
+const DEFAULT_RSSI_DELTA            = 4;     // dBm, smaller RSSI changes are not worth a diff entry
+
+/**
+ * Scans, filters and keeps the device registry inside an app service, and hands out compact registry diffs.
+ * A diff is a plain JSON-safe object, post it to the page over whatever channel the app uses:
+ * { seq, time, full, upsert: [dev_addr, dev_name, rssi, age, vendor_id, vendor_data, service_uuid_array, service_data_array, ...], remove: [dev_addr, ...] }
+ * age is the number of millis between the device's last advert and diff.time. A full diff (snapshot()) replaces the page's list.
+ */
+class ScanEngine {
+    #registry;
+    #monitor;
+    #scanner;
+    #clock;
+    #deliver;
+    #filter;
+    #batch_interval;
+    #max_batch;
+    #ttl;
+    #rssi_delta;
+    #seq = 0;
+    #known = new Map();  // MAC > { rssi, vendor_data, last_seen }, the state the pages were last told about (or will be with the next diff)
+    #dirty = new Set();  // MACs to upsert with the next diff
+    #timer = null;
+    #running = false;
+    #abort = null;       // dispose of the start signal's listener
+
+    /**
+     * Creates a new scan engine.
+     * @param {Object} [options={}] - Optional parameters. registry, capacity, trace, transport and clock as for BLEMaster.
+     * @param {Function} [options.deliver] - Called with every diff, e.g. to post it to the page.
+     * @param {Function|Object} [options.filter] - Keeps only matching devices: a function called with each scan result, or
+     * { dev_name_prefix, service_uuid, vendor_id, min_rssi } (every given field must match).
+     * @param {number} [options.batch_interval=1000] - Millis between two diffs. Nothing is delivered while nothing changed.
+     * @param {number} [options.max_batch=100] - Devices per diff, the rest waits for the next one.
+     * @param {number} [options.ttl=30000] - Millis without an advert before a device is removed from the pages' list.
+     * @param {number} [options.rssi_delta=4] - RSSI changes below this many dBm do not put a device into the next diff.
+     */
+    constructor(options = {}) {
+        this.#clock = options.clock || SYSTEM_CLOCK;
+        this.#registry = createRegistry(options, this.#clock);
+        this.#monitor = createMonitor(options, this.#clock);
+        this.#scanner = new Scanner(options.transport || hmBle, this.#clock, this.#registry, this.#monitor);
+        this.#deliver = options.deliver || noop;
+        this.#filter = scanFilter(options.filter);
+        this.#batch_interval = options.batch_interval || DEFAULT_BATCH_INTERVAL;
+        this.#max_batch = options.max_batch || DEFAULT_MAX_BATCH;
+        this.#ttl = options.ttl || DEFAULT_TTL;
+        this.#rssi_delta = options.rssi_delta === undefined ? DEFAULT_RSSI_DELTA : options.rssi_delta;
+    }
+    /**
+     * @type {Get} The engine's own device registry.
+     */
+    get get() {
+        return new Get(this.#registry, this.#monitor);
+    }
+    /**
+     * @type {boolean} True between start() and stop().
+     */
+    get running() {
+        return this.#running;
+    }
+    /**
+     * Starts scanning and delivering diffs.
+     * @param {Object} [options={}] - { signal }, cancelling the token stops the engine.
+     * @returns {boolean} Returns true if the scan started, false if it failed or the engine is already running.
+     */
+    start(options = {}) {
+        if (this.#running) return false;
+        const signal = options.signal;
+        const success = this.#scanner.startScan((scan_result) => this.#seen(scan_result), { filter: this.#filter, signal });
+        if (!success) return false;
+        this.#running = true;
+        if (signal) {
+            const abort = () => this.stop();
+            signal.addEventListener("abort", abort);
+            this.#abort = () => signal.removeEventListener("abort", abort);
+        }
+        this.#schedule();
+        return true;
+    }
+    /**
+     * Stops scanning. Pending changes are delivered right away.
+     */
+    stop() {
+        if (!this.#running) return;
+        this.#running = false;
+        if (this.#abort) this.#abort();
+        this.#abort = null;
+        this.#scanner.stopScan();
+        this.#clock.clearTimeout(this.#timer);
+        this.#timer = null;
+        this.flush();
+    }
+    /**
+     * Delivers the pending changes now instead of at the end of the batch interval.
+     * @returns {Object|null} Returns the delivered diff, or null if nothing changed.
+     */
+    flush() {
+        const now = this.#clock.now();
+        const remove = [];
+        for (const [dev_addr, known] of this.#known) {
+            if (now - known.last_seen < this.#ttl) continue;
+            this.#known.delete(dev_addr);
+            this.#dirty.delete(dev_addr);
+            this.#registry.remove(dev_addr); // rotating MACs would grow the registry forever otherwise
+            remove.push(dev_addr);
+        }
+        const upsert = [];
+        for (const dev_addr of this.#dirty) {
+            if (upsert.length === this.#max_batch * DIFF_STRIDE) break;
+            this.#dirty.delete(dev_addr);
+            this.#pack(upsert, dev_addr, now);
+        }
+        if (!upsert.length && !remove.length) return null;
+        const diff = { seq: ++this.#seq, time: now, full: false, upsert, remove };
+        this.#deliver(diff);
+        return diff;
+    }
+    /**
+     * Builds a full diff of every device the engine currently keeps, for a page that just opened or missed a diff.
+     * It is returned, not delivered, and carries the seq of the last delivered diff.
+     * @returns {Object} Returns { seq, time, full: true, upsert, remove: [] }.
+     */
+    snapshot() {
+        const now = this.#clock.now();
+        const upsert = [];
+        for (const dev_addr of this.#known.keys()) this.#pack(upsert, dev_addr, now);
+        return { seq: this.#seq, time: now, full: true, upsert, remove: [] };
+    }
+    #seen(scan_result) { // decides whether the advert is news for the pages
+        const dev_addr = scan_result.dev_addr;
+        const now = this.#clock.now();
+        const known = this.#known.get(dev_addr);
+        if (known === undefined) {
+            this.#known.set(dev_addr, { rssi: scan_result.rssi, vendor_data: scan_result.vendor_data, last_seen: now });
+            this.#dirty.add(dev_addr);
+            return;
+        }
+        known.last_seen = now;
+        if (Math.abs(scan_result.rssi - known.rssi) >= this.#rssi_delta || scan_result.vendor_data !== known.vendor_data) {
+            known.rssi = scan_result.rssi;
+            known.vendor_data = scan_result.vendor_data;
+            this.#dirty.add(dev_addr);
+        }
+    }
+    #pack(upsert, dev_addr, now) {
+        const device = this.#registry.get(dev_addr);
+        if (!device) return;
+        upsert.push(dev_addr, device.dev_name, device.rssi, device.last_seen === undefined ? 0 : now - device.last_seen,
+            device.vendor_id, device.vendor_data, device.service_uuid_array, device.service_data_array);
+    }
+    #schedule() {
+        this.#timer = this.#clock.setTimeout(() => {
+            this.#timer = null;
+            if (!this.#running) return;
+            this.flush();
+            this.#schedule();
+        }, this.#batch_interval);
+    }
+}
+
+/**
+ * The page side of a ScanEngine: applies its diffs to a device list with the same shape as get.devices().
+ */
+class DeviceMirror {
+    #devices = {};
+    #size = 0;
+    #seq = 0;
+    #on_change;
+
+    /**
+     * @param {Function} [on_change] - Called after every applied diff with { added, updated, removed } MAC arrays.
+     */
+    constructor(on_change) {
+        this.#on_change = on_change;
+    }
+    /**
+     * @type {number} The number of devices in the list.
+     */
+    get size() {
+        return this.#size;
+    }
+    /**
+     * @type {number} The seq of the last applied diff, 0 before the first one.
+     */
+    get seq() {
+        return this.#seq;
+    }
+    /**
+     * Applies a diff from ScanEngine.
+     * @param {Object} diff - A diff delivered by the engine, or its snapshot().
+     * @returns {boolean} Returns false if a diff is missing in between (or the diff is stale), ask the engine for a snapshot() then.
+     */
+    apply(diff) {
+        if (!diff.full && diff.seq !== this.#seq + 1) {
+            if (diff.seq > this.#seq) logger.warn("eBLE: Missed a scan diff, expected", this.#seq + 1, "got", diff.seq);
+            return false;
+        }
+        const previous = diff.full ? this.#devices : null; // a snapshot replaces the list, known devices keep their objects
+        if (previous) {
+            this.#devices = {};
+            this.#size = 0;
+        }
+        const added = [], updated = [], removed = [];
+        for (let i = 0; i < diff.upsert.length; i += DIFF_STRIDE) {
+            const dev_addr = diff.upsert[i];
+            const known = previous ? previous[dev_addr] : this.#devices[dev_addr];
+            let device = this.#devices[dev_addr];
+            if (!device) {
+                device = this.#devices[dev_addr] = known || {};
+                this.#size++;
+            }
+            (known ? updated : added).push(dev_addr);
+            device.dev_name = diff.upsert[i + 1];
+            device.rssi = diff.upsert[i + 2];
+            device.last_seen = diff.time - diff.upsert[i + 3];
+            device.vendor_id = diff.upsert[i + 4];
+            device.vendor_data = diff.upsert[i + 5];
+            device.service_uuid_array = diff.upsert[i + 6];
+            device.service_data_array = diff.upsert[i + 7];
+        }
+        for (const dev_addr of diff.remove) {
+            if (!this.#devices[dev_addr]) continue;
+            delete this.#devices[dev_addr];
+            this.#size--;
+            removed.push(dev_addr);
+        }
+        if (previous) {
+            for (const dev_addr in previous) {
+                if (!this.#devices[dev_addr]) removed.push(dev_addr);
+            }
+        }
+        this.#seq = diff.seq;
+        if (this.#on_change) this.#on_change({ added, updated, removed });
+        return true;
+    }
+    /**
+     * Returns all devices, same shape as get.devices(). rssi and last_seen are as of the device's last diff entry,
+     * small RSSI changes are not sent. A device stays in the list until the engine removes it (ttl).
+     * @returns {Object} Returns the device list by MAC address.
+     */
+    devices() {
+        return this.#devices;
+    }
+    /**
+     * Checks if a device is in the list.
+     * @param {string} dev_addr - The MAC address of the device.
+     * @returns {boolean} Returns true if the device is in the list.
+     */
+    hasDevice(dev_addr) {
+        return typeof dev_addr === "string" && this.#devices.hasOwnProperty(dev_addr.toLowerCase());
+    }
+}
+
+/**
+ * Turns the filter option into a predicate over decoded scan results, or undefined for no filter.
+ */
+function scanFilter(filter) {
+    if (!filter || typeof filter === "function") return filter || undefined;
+    const { dev_name_prefix, service_uuid, vendor_id, min_rssi } = filter;
+    const uuid = service_uuid === undefined ? undefined : service_uuid.toUpperCase();
+    return (scan_result) =>
+        (min_rssi === undefined || scan_result.rssi >= min_rssi) &&
+        (vendor_id === undefined || scan_result.vendor_id === vendor_id) &&
+        (dev_name_prefix === undefined || (typeof scan_result.dev_name === "string" && scan_result.dev_name.startsWith(dev_name_prefix))) &&
+        (uuid === undefined || (Array.isArray(scan_result.service_uuid_array) &&
+            scan_result.service_uuid_array.some((candidate) => typeof candidate === "string" && candidate.toUpperCase() === uuid)));
+}
+
+/* WIRE */
+
+/**
+ * Wire format between an app service and its pages: ScanEngine diffs and characteristic readings packed into one frame.
+ * Binary frames (ArrayBuffer) carry MACs as 6 bytes, hex payloads as bytes and numbers as varints, names and UUIDs are
+ * interned per frame. JSON frames (string) are the fallback for channels that only carry text. decodeFrame takes both.
+ */
+
+const WIRE_FORMAT = {
+    BINARY: "binary",
+    JSON: "json",
+};
+
+const WIRE_VERSION                  = 1;
+const WIRE_DIFF                     = 1;
+const WIRE_READING                  = 2;
+const WIRE_INITIAL_BYTES            = 4096;
+const DEFAULT_FLUSH_INTERVAL        = 1000; // millis a message waits in a WireBatch at most
+const DEFAULT_MAX_MESSAGES          = 32;   // messages per frame, a full batch is sent right away
+
+/**
+ * Packs messages into one frame.
+ * Binary layout: version, varint count, zigzag base time, then per message its kind and fields:
+ * - diff: varint seq, time - base, full, varint upserts, per device mac, name, rssi, age, vendor_id, vendor_data,
+ *   service_uuid_array, service_data_array ({ uuid, service_data } only), varint removes, macs
+ * - reading: mac, uuid, time - base, varint length, bytes
+ * @param {Array<Object>} messages - ScanEngine diffs and readings { dev_addr, uuid, time, data }, data an ArrayBuffer,
+ * typed array or DataView. A message with an upsert array is a diff, anything else a reading. seq and time are
+ * non-negative integers (millis), a reading without time gets 0 in both formats.
+ * @param {string} [format=WIRE_FORMAT.BINARY] - WIRE_FORMAT.BINARY or WIRE_FORMAT.JSON.
+ * @returns {ArrayBuffer|string|null} Returns the frame, or null if a message is malformed (logged).
+ */
+function encodeFrame(messages, format = WIRE_FORMAT.BINARY) {
+    try {
+        if (!Array.isArray(messages)) throw new Error(ERR_WIRE_MESSAGE);
+        return format === WIRE_FORMAT.JSON ? encodeJson(messages) : encodeBinary(messages);
+    } catch (error) {
+        logger.error(error.message);
+        return null;
+    }
+}
+
+/**
+ * Unpacks a frame from encodeFrame.
+ * @param {ArrayBuffer|Uint8Array|string} frame - A binary or a JSON frame.
+ * @returns {Array<Object>|null} Returns the messages in order (readings with data as an ArrayBuffer), or null if the frame is malformed (logged).
+ */
+function decodeFrame(frame) {
+    try {
+        if (typeof frame === "string") return decodeJson(frame);
+        if (frame instanceof ArrayBuffer) return decodeBinary(new Uint8Array(frame));
+        if (frame instanceof Uint8Array) return decodeBinary(frame);
+        throw new Error(ERR_WIRE_FRAME);
+    } catch (error) {
+        logger.warn(ERR_WIRE_FRAME + ":", error.message);
+        return null;
+    }
+}
+
+/**
+ * Collects messages in the service and delivers them as one frame per flush interval, or as soon as max_messages are queued.
+ * Reading data is encoded at flush time, do not modify it in between.
+ */
+class WireBatch {
+    #deliver;
+    #format;
+    #interval;
+    #max_messages;
+    #clock;
+    #queue = [];
+    #timer = null;
+
+    /**
+     * @param {Object} [options={}]
+     * @param {Function} [options.deliver] - Called with every frame, e.g. to post it to the page.
+     * @param {string} [options.format=WIRE_FORMAT.BINARY] - WIRE_FORMAT.BINARY or WIRE_FORMAT.JSON.
+     * @param {number} [options.interval=1000] - Millis the first queued message waits for company.
+     * @param {number} [options.max_messages=32] - Messages per frame.
+     * @param {Object} [options.clock] - { now, setTimeout, clearTimeout }, defaults to the system timers.
+     */
+    constructor(options = {}) {
+        this.#deliver = options.deliver || noop;
+        this.#format = options.format || WIRE_FORMAT.BINARY;
+        this.#interval = options.interval || DEFAULT_FLUSH_INTERVAL;
+        this.#max_messages = options.max_messages || DEFAULT_MAX_MESSAGES;
+        this.#clock = options.clock || SYSTEM_CLOCK;
+    }
+    /**
+     * @type {number} The number of queued messages.
+     */
+    get size() {
+        return this.#queue.length;
+    }
+    /**
+     * Queues a message, see encodeFrame. A malformed message is rejected here, so it cannot spoil the frame of the others.
+     * @returns {boolean} Returns true if the message was queued, false if it is malformed (logged).
+     */
+    push(message) {
+        if (!isWireMessage(message)) {
+            logger.error(ERR_WIRE_MESSAGE);
+            return false;
+        }
+        this.#queue.push(message);
+        if (this.#queue.length >= this.#max_messages) {
+            this.flush();
+        } else if (this.#timer === null) {
+            this.#timer = this.#clock.setTimeout(() => {
+                this.#timer = null;
+                this.flush();
+            }, this.#interval);
+        }
+        return true;
+    }
+    /**
+     * Delivers the queued messages now.
+     * @returns {ArrayBuffer|string|null} Returns the delivered frame, or null if nothing was queued or a queued message
+     * was modified into a malformed one since push().
+     */
+    flush() {
+        this.#clock.clearTimeout(this.#timer);
+        this.#timer = null;
+        if (!this.#queue.length) return null;
+        const frame = encodeFrame(this.#queue, this.#format);
+        this.#queue = [];
+        if (frame !== null) this.#deliver(frame);
+        return frame;
+    }
+}
+
+/* BINARY */
+
+class WireWriter {
+    #bytes = new Uint8Array(WIRE_INITIAL_BYTES);
+    #length = 0;
+    #strings = new Map(); // string > index, per frame
+
+    begin() {
+        this.#length = 0;
+        this.#strings.clear();
+    }
+    end() {
+        return this.#bytes.slice(0, this.#length).buffer;
+    }
+    byte(value) {
+        this.#reserve(1);
+        this.#bytes[this.#length++] = value;
+    }
+    varint(value) { // unsigned LEB128, safe up to 2^53
+        if (value < 0x80 && value >= 0 && this.#length < this.#bytes.length) { // most lengths, indexes and rssi
+            this.#bytes[this.#length++] = value;
+            return;
+        }
+        this.#reserve(8);
+        while (value >= 0x80) {
+            this.#bytes[this.#length++] = (value % 0x80) | 0x80;
+            value = Math.floor(value / 0x80);
+        }
+        this.#bytes[this.#length++] = value;
+    }
+    int(value) { // zigzag, small negatives (rssi) stay one byte
+        if (typeof value !== "number" || !Number.isFinite(value)) value = 0;
+        this.varint(value < 0 ? -value * 2 - 1 : value * 2);
+    }
+    optionalInt(value) { // 0 = undefined
+        if (typeof value !== "number" || !Number.isFinite(value)) return this.varint(0);
+        this.varint((value < 0 ? -value * 2 - 1 : value * 2) + 1);
+    }
+    mac(mac) {
+        if (!isMac(mac)) throw new Error(ERR_WIRE_MESSAGE);
+        this.#reserve(MAC_BYTES);
+        for (let i = 0; i < MAC_BYTES; i++) {
+            this.#bytes[this.#length++] = hexValue(mac.charCodeAt(i * 3)) * 16 + hexValue(mac.charCodeAt(i * 3 + 1));
+        }
+    }
+    /**
+     * Interned strings: 0 = undefined, 1 = new string (varint length, varint char codes), n = the (n - 2)th string of the frame.
+     */
+    str(value) {
+        if (typeof value !== "string") return this.varint(0);
+        const index = this.#strings.get(value);
+        if (index !== undefined) return this.varint(index + 2);
+        this.#strings.set(value, this.#strings.size);
+        this.varint(1);
+        this.#chars(value);
+    }
+    strs(values) { // 0 = not an array, n + 1 = n strings
+        if (!Array.isArray(values)) return this.varint(0);
+        this.varint(values.length + 1);
+        for (let i = 0; i < values.length; i++) this.str(values[i]);
+    }
+    /**
+     * Decoded payloads (ab2str_stripped output): 0 = undefined, 2n + 1 = n bytes of lowercase hex, 2n + 2 = n chars of anything else.
+     */
+    hex(value) {
+        if (typeof value !== "string") return this.varint(0);
+        if (!isLowerHex(value)) {
+            this.varint(value.length * 2 + 2);
+            for (let i = 0; i < value.length; i++) this.varint(value.charCodeAt(i));
+            return;
+        }
+        const count = value.length / 2;
+        this.varint(count * 2 + 1);
+        this.#reserve(count);
+        for (let i = 0; i < count; i++) {
+            this.#bytes[this.#length++] = hexValue(value.charCodeAt(i * 2)) * 16 + hexValue(value.charCodeAt(i * 2 + 1));
+        }
+    }
+    bytes(data) {
+        const buffer = typeof data === "string" ? null : data2ab(data);
+        if (buffer === null) throw new Error(ERR_WIRE_MESSAGE);
+        this.varint(buffer.byteLength);
+        this.#reserve(buffer.byteLength);
+        this.#bytes.set(new Uint8Array(buffer), this.#length);
+        this.#length += buffer.byteLength;
+    }
+    #chars(value) {
+        this.varint(value.length);
+        this.#reserve(value.length);
+        for (let i = 0; i < value.length; i++) {
+            const c = value.charCodeAt(i);
+            if (c < 0x80) this.#bytes[this.#length++] = c;
+            else this.varint(c);
+        }
+    }
+    #reserve(count) {
+        if (this.#length + count <= this.#bytes.length) return;
+        const grown = new Uint8Array(Math.max(this.#bytes.length * 2, this.#length + count));
+        grown.set(this.#bytes.subarray(0, this.#length));
+        this.#bytes = grown;
+    }
+}
+
+class WireReader {
+    #bytes;
+    #offset = 0;
+    #strings = [];
+
+    constructor(bytes) {
+        this.#bytes = bytes;
+    }
+    get done() {
+        return this.#offset >= this.#bytes.length;
+    }
+    byte() {
+        if (this.#offset >= this.#bytes.length) throw new Error("truncated");
+        return this.#bytes[this.#offset++];
+    }
+    varint() {
+        let value = 0, scale = 1, byte;
+        do {
+            if (scale > 2 ** 49) throw new Error("varint too long");
+            byte = this.byte();
+            value += (byte & 0x7F) * scale;
+            scale *= 0x80;
+        } while (byte & 0x80);
+        return value;
+    }
+    int() {
+        const value = this.varint();
+        return value % 2 ? -(value + 1) / 2 : value / 2;
+    }
+    optionalInt() {
+        const value = this.varint();
+        if (value === 0) return undefined;
+        return (value - 1) % 2 ? -value / 2 : (value - 1) / 2;
+    }
+    count() { // a length that must fit into the rest of the frame, so garbage cannot allocate huge arrays
+        const value = this.varint();
+        if (value > this.#bytes.length - this.#offset) throw new Error("length beyond the end of the frame");
+        return value;
+    }
+    mac() {
+        this.#need(MAC_BYTES);
+        const mac = bytes2mac(this.#bytes, this.#offset);
+        this.#offset += MAC_BYTES;
+        return mac;
+    }
+    str() {
+        const tag = this.varint();
+        if (tag === 0) return undefined;
+        if (tag > 1) {
+            if (tag - 2 >= this.#strings.length) throw new Error("unknown string");
+            return this.#strings[tag - 2];
+        }
+        const value = this.#chars(this.count());
+        this.#strings.push(value);
+        return value;
+    }
+    strs() {
+        const tag = this.count();
+        if (tag === 0) return undefined;
+        const values = new Array(tag - 1);
+        for (let i = 0; i < values.length; i++) values[i] = this.str();
+        return values;
+    }
+    hex() {
+        const tag = this.varint();
+        if (tag === 0) return undefined;
+        if (tag % 2 === 0) return this.#chars((tag - 2) / 2);
+        const count = (tag - 1) / 2;
+        this.#need(count);
+        this.#offset += count;
+        return bytes2hex(this.#bytes, this.#offset - count, this.#offset);
+    }
+    bytes() {
+        const count = this.count();
+        this.#offset += count;
+        return this.#bytes.slice(this.#offset - count, this.#offset).buffer;
+    }
+    #chars(count) {
+        if (count > this.#bytes.length - this.#offset) throw new Error("length beyond the end of the frame");
+        wire_chars.length = count;
+        for (let i = 0; i < count; i++) {
+            const c = this.#bytes[this.#offset];
+            if (c < 0x80) {
+                wire_chars[i] = c;
+                this.#offset++;
+            } else {
+                wire_chars[i] = this.varint();
+            }
+        }
+        return String.fromCharCode.apply(null, wire_chars);
+    }
+    #need(count) {
+        if (this.#offset + count > this.#bytes.length) throw new Error("truncated");
+    }
+}
+
+const wire_writer = new WireWriter(); // shared, every frame is sliced out of it
+const wire_chars = []; // char code scratch of WireReader, strings are short (names, UUIDs)
+
+function encodeBinary(messages) {
+    const w = wire_writer;
+    w.begin();
+    w.byte(WIRE_VERSION);
+    w.varint(messages.length);
+    const base = messages.length ? messageTime(messages[0]) : 0;
+    w.int(base);
+    for (const message of messages) {
+        if (!message || typeof message !== "object") throw new Error(ERR_WIRE_MESSAGE);
+        if (Array.isArray(message.upsert)) {
+            const { upsert, remove } = message;
+            if (upsert.length % DIFF_STRIDE || !Array.isArray(remove) || !isWireCount(message.seq) || !isWireCount(message.time)) {
+                throw new Error(ERR_WIRE_MESSAGE);
+            }
+            w.byte(WIRE_DIFF);
+            w.varint(message.seq);
+            w.int(messageTime(message) - base);
+            w.byte(message.full ? 1 : 0);
+            w.varint(upsert.length / DIFF_STRIDE);
+            for (let i = 0; i < upsert.length; i += DIFF_STRIDE) {
+                w.mac(upsert[i]);
+                w.str(upsert[i + 1]);
+                w.int(upsert[i + 2]);
+                w.int(upsert[i + 3]);
+                w.optionalInt(upsert[i + 4]);
+                w.hex(upsert[i + 5]);
+                w.strs(upsert[i + 6]);
+                const service_data_array = upsert[i + 7];
+                if (!Array.isArray(service_data_array)) {
+                    w.varint(0);
+                    continue;
+                }
+                w.varint(service_data_array.length + 1);
+                for (const service of service_data_array) {
+                    w.str(service && service.uuid);
+                    w.hex(service && service.service_data);
+                }
+            }
+            w.varint(remove.length);
+            for (const dev_addr of remove) w.mac(dev_addr);
+        } else {
+            if (typeof message.uuid !== "string" || !isReadingTime(message.time)) throw new Error(ERR_WIRE_MESSAGE);
+            w.byte(WIRE_READING);
+            w.mac(message.dev_addr);
+            w.str(message.uuid);
+            w.int(messageTime(message) - base);
+            w.bytes(message.data);
+        }
+    }
+    return w.end();
+}
+
+function decodeBinary(bytes) {
+    const r = new WireReader(bytes);
+    const version = r.byte();
+    if (version !== WIRE_VERSION) throw new Error("unsupported version " + version);
+    const messages = new Array(r.count());
+    const base = r.int();
+    for (let m = 0; m < messages.length; m++) {
+        const kind = r.byte();
+        if (kind === WIRE_DIFF) {
+            const seq = r.varint();
+            const time = base + r.int();
+            const full = r.byte() === 1;
+            const upsert = new Array(r.count() * DIFF_STRIDE);
+            for (let i = 0; i < upsert.length; i += DIFF_STRIDE) {
+                upsert[i] = r.mac();
+                upsert[i + 1] = r.str();
+                upsert[i + 2] = r.int();
+                upsert[i + 3] = r.int();
+                upsert[i + 4] = r.optionalInt();
+                upsert[i + 5] = r.hex();
+                upsert[i + 6] = r.strs();
+                const tag = r.count();
+                const service_data_array = tag === 0 ? undefined : new Array(tag - 1);
+                for (let s = 0; s < tag - 1; s++) service_data_array[s] = { uuid: r.str(), service_data: r.hex() };
+                upsert[i + 7] = service_data_array;
+            }
+            const remove = new Array(r.count());
+            for (let i = 0; i < remove.length; i++) remove[i] = r.mac();
+            messages[m] = { seq, time, full, upsert, remove };
+        } else if (kind === WIRE_READING) {
+            const dev_addr = r.mac();
+            const uuid = r.str();
+            const time = base + r.int();
+            messages[m] = { dev_addr, uuid, time, data: r.bytes() };
+        } else {
+            throw new Error("unknown message kind " + kind);
+        }
+    }
+    if (!r.done) throw new Error("trailing bytes");
+    return messages;
+}
+
+/* JSON */
+
+function encodeJson(messages) {
+    const out = new Array(messages.length);
+    for (let i = 0; i < messages.length; i++) {
+        const message = messages[i];
+        if (!message || typeof message !== "object") throw new Error(ERR_WIRE_MESSAGE);
+        if (Array.isArray(message.upsert)) {
+            if (!isWireDiff(message)) throw new Error(ERR_WIRE_MESSAGE);
+            out[i] = message;
+            continue;
+        }
+        const data = typeof message.data === "string" ? null : data2ab(message.data);
+        if (!isMac(message.dev_addr) || typeof message.uuid !== "string" || !isReadingTime(message.time) || data === null) {
+            throw new Error(ERR_WIRE_MESSAGE);
+        }
+        out[i] = { dev_addr: message.dev_addr.toLowerCase(), uuid: message.uuid, time: messageTime(message), data: ab2str_stripped(data) };
+    }
+    return JSON.stringify({ v: WIRE_VERSION, m: out });
+}
+
+function decodeJson(text) {
+    const frame = JSON.parse(text);
+    if (!frame || frame.v !== WIRE_VERSION || !Array.isArray(frame.m)) throw new Error("not a wire frame");
+    for (const message of frame.m) {
+        if (!message || typeof message !== "object") throw new Error("not a message");
+        if (Array.isArray(message.upsert)) continue;
+        if (typeof message.data !== "string" || !isLowerHex(message.data)) throw new Error("reading data is not hex");
+        message.data = data2ab(message.data);
+    }
+    return frame.m;
+}
+
+function isWireMessage(message) { // what both encoders check on the way
+    if (!message || typeof message !== "object") return false;
+    if (Array.isArray(message.upsert)) return isWireDiff(message);
+    return isMac(message.dev_addr) && typeof message.uuid === "string" && isReadingTime(message.time) &&
+        typeof message.data !== "string" && data2ab(message.data) !== null;
+}
+
+function isWireDiff(diff) { // what encodeBinary checks on the way
+    const { upsert, remove } = diff;
+    if (upsert.length % DIFF_STRIDE || !Array.isArray(remove) || !isWireCount(diff.seq) || !isWireCount(diff.time)) return false;
+    for (let i = 0; i < upsert.length; i += DIFF_STRIDE) if (!isMac(upsert[i])) return false;
+    for (let i = 0; i < remove.length; i++) if (!isMac(remove[i])) return false;
+    return true;
+}
+
+function isWireCount(value) { // seq and time: what a varint carries and JSON gives back unchanged
+    return Number.isSafeInteger(value) && value >= 0;
+}
+
+function isReadingTime(value) {
+    return value === undefined || isWireCount(value);
+}
+
+function messageTime(message) { // after the checks above: an integer or missing
+    return message.time === undefined ? 0 : message.time;
+}
+
+function isLowerHex(value) {
+    if (value.length % 2) return false;
+    for (let i = 0; i < value.length; i++) {
+        const c = value.charCodeAt(i);
+        if (!((c >= 48 && c <= 57) || (c >= 97 && c <= 102))) return false;
+    }
+    return true;
+}
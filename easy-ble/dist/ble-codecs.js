@@ -0,0 +1,173 @@
+/** @about BLE Master 1.20.1 (codecs) @min_zeppos 3.0 @author: Silver, Zepp Health. @license: MIT */
+// Built from easy-ble/src by dev/build.js (npm run build), edit the modules there.
+
+/* CODECS */
+
+/**
+ * Codecs between the backend's ArrayBuffers and the strings the library hands out, plus input validation.
+ * No dependencies, usable on its own.
+ */
+
+export const MAC_BYTES              = 6;
+const MAC_LENGTH                    = 17; // "a1:b2:c3:d4:e5:f6"
+const HEX_PATTERN                   = /^[0-9A-Fa-f]+$/;
+const UUID_PATTERN                  = /^([0-9A-Fa-f]{4}|[0-9A-Fa-f]{8}|[0-9A-Fa-f]{8}-[0-9A-Fa-f]{4}-[0-9A-Fa-f]{4}-[0-9A-Fa-f]{4}-[0-9A-Fa-f]{12})$/;
+const HEX_CODES                     = Array.from("0123456789abcdef", (digit) => digit.charCodeAt(0));
+const CHUNK_CHARS                   = 4096; // String.fromCharCode.apply argument limit per call
+
+export function str2ab_with_len(str){ // one byte per char, chars above 0xFF keep their low byte (as since 1.0.0)
+    const bytes = new Uint8Array(str.length);
+    for (let i = 0; i < str.length; i++) bytes[i] = str.charCodeAt(i);
+    return { data_ab: bytes.buffer, data_len: bytes.length };
+}
+
+function latin1ToAb(str) { // str2ab_with_len for data2ab: null if a char does not fit in 8 bits
+    const bytes = new Uint8Array(str.length);
+    for (let i = 0; i < str.length; i++) {
+        const code = str.charCodeAt(i);
+        if (code > 0xFF) return null;
+        bytes[i] = code;
+    }
+    return bytes.buffer;
+}
+
+export function bytes2mac(b, i) { // the 6 bytes at b[i] as "a1:b2:..", for MACs inside a larger buffer
+    return String.fromCharCode(
+        HEX_CODES[b[i] >> 4], HEX_CODES[b[i] & 15], 58, HEX_CODES[b[i + 1] >> 4], HEX_CODES[b[i + 1] & 15], 58,
+        HEX_CODES[b[i + 2] >> 4], HEX_CODES[b[i + 2] & 15], 58, HEX_CODES[b[i + 3] >> 4], HEX_CODES[b[i + 3] & 15], 58,
+        HEX_CODES[b[i + 4] >> 4], HEX_CODES[b[i + 4] & 15], 58, HEX_CODES[b[i + 5] >> 4], HEX_CODES[b[i + 5] & 15]);
+}
+
+export function ab2mac(ab) { // one flat string, no intermediate arrays or concatenations
+    const b = new Uint8Array(ab);
+    if (b.length !== MAC_BYTES) return ab2str_stripped(ab).replace(/(..)(?!$)/g, "$1:");
+    return String.fromCharCode(
+        HEX_CODES[b[0] >> 4], HEX_CODES[b[0] & 15], 58, HEX_CODES[b[1] >> 4], HEX_CODES[b[1] & 15], 58,
+        HEX_CODES[b[2] >> 4], HEX_CODES[b[2] & 15], 58, HEX_CODES[b[3] >> 4], HEX_CODES[b[3] & 15], 58,
+        HEX_CODES[b[4] >> 4], HEX_CODES[b[4] & 15], 58, HEX_CODES[b[5] >> 4], HEX_CODES[b[5] & 15]);
+}
+
+export function mac2ab(mac) { // null for anything but "a1:b2:c3:d4:e5:f6" (any case)
+    if (!isMac(mac)) return null;
+    const bytes = new Uint8Array(MAC_BYTES);
+    for (let i = 0; i < MAC_BYTES; i++) {
+        bytes[i] = hexValue(mac.charCodeAt(i * 3)) * 16 + hexValue(mac.charCodeAt(i * 3 + 1));
+    }
+    return bytes.buffer;
+}
+
+export function isMac(mac) {
+    if (typeof mac !== "string" || mac.length !== MAC_LENGTH) return false;
+    for (let i = 0; i < MAC_LENGTH; i++) {
+        const c = mac.charCodeAt(i);
+        if (i % 3 === 2 ? c !== 58 : hexValue(c) < 0) return false; // ':' every third char
+    }
+    return true;
+}
+
+export function normalizeMac(mac) {
+    return isMac(mac) ? mac.toLowerCase() : null;
+}
+
+export function hexValue(c) { // char code > 0..15, -1 if not a hex digit
+    if (c >= 48 && c <= 57) return c - 48;
+    c |= 0x20; // lowercase
+    return c >= 97 && c <= 102 ? c - 87 : -1;
+}
+
+export function mac2num(mac) { // "a1:b2:.." > 48-bit number, no allocations
+    let num = 0;
+    for (let i = 0; i < mac.length; i++) {
+        const c = mac.charCodeAt(i);
+        if (c === 58) continue; // ':'
+        num = num * 16 + (c <= 57 ? c - 48 : (c | 0x20) - 87);
+    }
+    return num;
+}
+
+export function num2mac(num) {
+    let mac = "";
+    for (let shift = 40; shift >= 0; shift -= 8) {
+        const byte = Math.floor(num / 2 ** shift) % 256;
+        mac += (byte < 16 ? "0" : "") + byte.toString(16) + (shift ? ":" : "");
+    }
+    return mac;
+}
+
+const hex_scratch = [];
+export function ab2str_stripped(buffer) { // strip unicode
+    if (!(buffer instanceof ArrayBuffer)) return "";
+    const bytes = new Uint8Array(buffer);
+    return bytes2hex(bytes, 0, bytes.length);
+}
+
+export function bytes2hex(bytes, from, to) { // lowercase hex of bytes[from..to)
+    let str = "";
+    for (let start = from; start < to; start += CHUNK_CHARS / 2) {
+        const end = Math.min(to, start + CHUNK_CHARS / 2);
+        hex_scratch.length = (end - start) * 2;
+        for (let i = start, j = 0; i < end; i++) {
+            hex_scratch[j++] = HEX_CODES[bytes[i] >> 4];
+            hex_scratch[j++] = HEX_CODES[bytes[i] & 15];
+        }
+        str += String.fromCharCode.apply(null, hex_scratch);
+    }
+    return str;
+}
+
+/**
+ * ArrayBuffer as is, typed arrays as a copy of their bytes, even-length hex strings decoded, other strings one byte per char.
+ * @returns {ArrayBuffer|null} null for anything else: odd-length hex, chars above 0xFF, numbers, objects.
+ */
+export function data2ab(data) {
+    if (data instanceof ArrayBuffer) {
+        return data;
+    } else if (ArrayBuffer.isView(data)) {
+        return data.buffer.slice(data.byteOffset, data.byteOffset + data.byteLength);
+    } else if (typeof data === "string") {
+        if (HEX_PATTERN.test(data)) { // hex string
+            if (data.length % 2) return null; // the last nibble would be read as a whole byte
+            const bytes = new Uint8Array(data.length / 2);
+            for (let i = 0; i < bytes.length; i++) {
+                bytes[i] = hexValue(data.charCodeAt(i * 2)) * 16 + hexValue(data.charCodeAt(i * 2 + 1));
+            }
+            return bytes.buffer;
+        } else { // normal string
+            return latin1ToAb(data);
+        }
+    }
+    return null;
+}
+
+/**
+ * Checks the parts of a profile object that mstBuildProfile dereferences.
+ * @returns {string|null} What is wrong with it, or null if it is usable.
+ */
+export function profileError(profile) {
+    if (!profile || typeof profile !== "object") return "not an object";
+    if (!(profile.dev instanceof ArrayBuffer) || profile.dev.byteLength !== MAC_BYTES) return "dev is not a 6 byte ArrayBuffer";
+    if (!Array.isArray(profile.list)) return "list is not an array";
+    if (profile.len !== undefined && profile.len !== profile.list.length) return "len does not match list";
+    for (const group of profile.list) {
+        if (!group || !Array.isArray(group.list)) return "service group without a list";
+        if (group.len !== undefined && group.len !== group.list.length) return "service group len does not match its list";
+        for (const service of group.list) {
+            if (!service || !isUuid(service.uuid)) return "service without a valid uuid";
+            if (!Array.isArray(service.list)) return "service " + service.uuid + " without a characteristic list";
+            for (const chara of service.list) {
+                if (!chara || !isUuid(chara.uuid)) return "characteristic without a valid uuid in " + service.uuid;
+                if (chara.list === undefined) continue;
+                if (!Array.isArray(chara.list)) return "characteristic " + chara.uuid + " has a list that is not an array";
+                if (chara.len !== undefined && chara.len !== chara.list.length) return "characteristic " + chara.uuid + " len does not match its list";
+                for (const desc of chara.list) {
+                    if (!desc || !isUuid(desc.uuid)) return "descriptor without a valid uuid in " + chara.uuid;
+                }
+            }
+        }
+    }
+    return null;
+}
+
+export function isUuid(uuid) {
+    return typeof uuid === "string" && UUID_PATTERN.test(uuid);
+}
@@ -0,0 +1,1843 @@
+/** @about BLE Master 1.20.1 (core) @min_zeppos 3.0 @author: Silver, Zepp Health. @license: MIT */
+// Built from easy-ble/src by dev/build.js (npm run build), edit the modules there.
+import * as hmBle from '@zos/ble'
+
+/* CORE */
+
+/**
+ * Shared constants, the default clock and the cancellation token. Every other module builds on this one.
+ */
+
+const ERR_IDP_NOT_FOUND             = "eBLE: The ID pointer is not found for this MAC address. Please use startListener before trying to write char/desc!";
+const ERR_IDP_NOT_FOUND_SHORT       = "eBLE: Profile ID pointer not found";
+const ERR_NOT_IMPLEMENTED           = "eBLE: This feature is currently not implemented";
+const ERR_PROFILE_CREATION_FAILED   = "eBLE: Profile creation failed";
+const ERR_CHAR_READ_FAIL            = "eBLE: Failed to read characteristic";
+const ERR_DESC_READ_FAIL            = "eBLE: Failed to read descriptor";
+const ERR_CHAR_WRITE_FAIL           = "eBLE: Failed to write characteristic";
+const ERR_DESC_WRITE_FAIL           = "eBLE: Failed to write descriptor";
+const ERR_CANCELLED                 = "eBLE: Operation cancelled";
+const ERR_INVALID_MAC               = "eBLE: Invalid MAC address, expected \"a1:b2:c3:d4:e5:f6\"";
+const ERR_INVALID_DATA              = "eBLE: Invalid data, expected an ArrayBuffer, a typed array, an even-length hex string or a string of 8-bit characters";
+const ERR_INVALID_PROFILE           = "eBLE: Invalid profile object";
+const ERR_DETACHED                  = "eBLE: The page handle is detached";
+const ERR_WIRE_MESSAGE              = "eBLE: Invalid wire message, expected a ScanEngine diff or { dev_addr, uuid, time, data }";
+const ERR_WIRE_FRAME                = "eBLE: Invalid wire frame";
+const ERR_FEATURE_MISSING           = "eBLE: This feature is not built into this bundle, pass its implementation (e.g. pool: ConnectionPool)";
+const ERR_INVALID_SCENE             = "eBLE: Invalid scene, expected [{ dev_addr, uuid, data }] or [{ dev_addr, chara, desc, data }]";
+
+const SHORT_DELAY = 50; // millis
+
+/**
+ * The default time source. Pass your own { now, setTimeout, clearTimeout } as options.clock to run on virtual time.
+ */
+const SYSTEM_CLOCK = {
+    now: () => Date.now(),
+    setTimeout: (callback, millis) => setTimeout(callback, millis),
+    clearTimeout: (timer) => clearTimeout(timer),
+};
+
+// ScanEngine diff.upsert is flat, DIFF_STRIDE values per device in this order
+const DIFF_FIELDS                   = ["dev_addr", "dev_name", "rssi", "age", "vendor_id", "vendor_data", "service_uuid_array", "service_data_array"];
+const DIFF_STRIDE                   = DIFF_FIELDS.length;
+
+// mstConnect result.connected
+const CONNECT_STATUS_OK             = 0;
+const CONNECT_STATUS_FAILED         = 1;
+const CONNECT_STATUS_DISCONNECTED   = 2;
+
+/**
+ * Library statuses, delivered in place of a backend status when the library ends an operation itself.
+ */
+const STATUS = {
+    OK: 0,
+    TIMEOUT: -1, // the watchdog expired before the backend answered
+    CANCELLED: -2, // the operation's cancel token was cancelled
+    REJECTED: -3, // the backend call itself returned false
+};
+
+/**
+ * Trace record op codes.
+ * For SCAN_RESULT the record status holds the RSSI, for *_RESULT ops the backend status,
+ * for issued calls 0 = accepted by the backend and 1 = rejected. VALUE is the data of a read, which arrives
+ * before its READ_RESULT.
+ */
+const TRACE_OP = {
+    SCAN_START: 1,
+    SCAN_RESULT: 2,
+    SCAN_STOP: 3,
+    CONNECT: 4,
+    CONNECT_RESULT: 5,
+    DISCONNECT: 6,
+    PREPARE: 7,
+    PREPARE_RESULT: 8,
+    READ: 9,
+    READ_RESULT: 10,
+    WRITE: 11,
+    WRITE_RESULT: 12,
+    NOTIFY: 13,
+    VALUE: 14,
+};
+
+// latency metrics
+const METRIC_SCAN_FIRST_SEEN        = 0;
+const METRIC_CONNECT                = 1;
+const METRIC_PREPARE                = 2;
+const METRIC_READ                   = 3;
+const METRIC_WRITE                  = 4;
+const STATUS_MALFORMED              = "malformed"; // a scan result without a usable dev_addr
+
+/**
+ * A cancellation token with the AbortSignal surface (aborted, reason, addEventListener("abort")).
+ * Pass the same token to everything a page starts and cancel it once in onDestroy.
+ */
+class CancelToken {
+    #aborted = false;
+    #reason = undefined;
+    #listeners = new Set();
+
+    /**
+     * @type {boolean} True once cancel() was called.
+     */
+    get aborted() {
+        return this.#aborted;
+    }
+    /**
+     * @type {any} The reason passed to cancel().
+     */
+    get reason() {
+        return this.#reason;
+    }
+    /**
+     * Cancels every operation that was started with this token. Subsequent calls do nothing.
+     * @param {any} [reason] - An optional reason.
+     */
+    cancel(reason = ERR_CANCELLED) {
+        if (this.#aborted) return;
+        this.#aborted = true;
+        this.#reason = reason;
+        const listeners = Array.from(this.#listeners);
+        this.#listeners.clear();
+        for (const listener of listeners) listener();
+    }
+    addEventListener(type, listener) {
+        if (type === "abort" && !this.#aborted) this.#listeners.add(listener);
+    }
+    removeEventListener(type, listener) {
+        if (type === "abort") this.#listeners.delete(listener);
+    }
+}
+
+function metricOf(op) {
+    switch (op) {
+        case TRACE_OP.CONNECT: case TRACE_OP.CONNECT_RESULT: return METRIC_CONNECT;
+        case TRACE_OP.PREPARE: case TRACE_OP.PREPARE_RESULT: return METRIC_PREPARE;
+        case TRACE_OP.READ: case TRACE_OP.READ_RESULT: return METRIC_READ;
+        case TRACE_OP.WRITE: case TRACE_OP.WRITE_RESULT: return METRIC_WRITE;
+        default: return -1;
+    }
+}
+
+function noop() {}
+
+function notify(callback, response) {
+    if (callback) callback(response);
+}
+
+function emitCallback(callbacks, name, response) { // the ble.on callback, then the library's own listeners (scenes)
+    notify(callbacks[name], response);
+    if (callbacks.taps) for (const tap of callbacks.taps) tap(name, response);
+}
+
+function attrKey(dev_addr, uuid, desc) { // pairs a read/write with its completion
+    return desc === undefined ? dev_addr + "/" + uuid.toUpperCase() : dev_addr + "/" + uuid.toUpperCase() + "/" + desc.toUpperCase();
+}
+
+/* LOG */
+
+/**
+ * The library-wide leveled logger.
+ */
+
+const LOG_STRIP = false; // build-time switch. true = every log call becomes dead code and can be dropped by the minifier (npm run build -- --strip-logs)
+
+/**
+ * Log levels. Messages above the current level are skipped before any formatting happens.
+ */
+const LOG_LEVEL = {
+    NONE: 0,
+    ERROR: 1,
+    WARN: 2,
+    INFO: 3,
+    DEBUG: 4,
+};
+const DEFAULT_LOG_LEVEL = LOG_LEVEL.WARN;
+
+/**
+ * Leveled logger. A message can be a string or a function (thunk) that returns the string,
+ * the thunk is only called when the level is enabled, so expensive formatting like JSON.stringify
+ * costs nothing in production.
+ */
+class Logger {
+    level = DEFAULT_LOG_LEVEL;
+
+    error(message, ...params) {
+        if (!LOG_STRIP && this.level >= LOG_LEVEL.ERROR) this.#print(message, params);
+    }
+    warn(message, ...params) {
+        if (!LOG_STRIP && this.level >= LOG_LEVEL.WARN) this.#print(message, params);
+    }
+    info(message, ...params) {
+        if (!LOG_STRIP && this.level >= LOG_LEVEL.INFO) this.#print(message, params);
+    }
+    debug(message, ...params) {
+        if (!LOG_STRIP && this.level >= LOG_LEVEL.DEBUG) this.#print(message, params);
+    }
+    #print(message, params) {
+        console.log(typeof message === "function" ? message() : message, ...params);
+    }
+}
+
+const logger = new Logger();
+
+/* CODECS */
+
+/**
+ * Codecs between the backend's ArrayBuffers and the strings the library hands out, plus input validation.
+ * No dependencies, usable on its own.
+ */
+
+const MAC_BYTES              = 6;
+const MAC_LENGTH                    = 17; // "a1:b2:c3:d4:e5:f6"
+const HEX_PATTERN                   = /^[0-9A-Fa-f]+$/;
+const UUID_PATTERN                  = /^([0-9A-Fa-f]{4}|[0-9A-Fa-f]{8}|[0-9A-Fa-f]{8}-[0-9A-Fa-f]{4}-[0-9A-Fa-f]{4}-[0-9A-Fa-f]{4}-[0-9A-Fa-f]{12})$/;
+const HEX_CODES                     = Array.from("0123456789abcdef", (digit) => digit.charCodeAt(0));
+const CHUNK_CHARS                   = 4096; // String.fromCharCode.apply argument limit per call
+
+function str2ab_with_len(str){ // one byte per char, chars above 0xFF keep their low byte (as since 1.0.0)
+    const bytes = new Uint8Array(str.length);
+    for (let i = 0; i < str.length; i++) bytes[i] = str.charCodeAt(i);
+    return { data_ab: bytes.buffer, data_len: bytes.length };
+}
+
+function latin1ToAb(str) { // str2ab_with_len for data2ab: null if a char does not fit in 8 bits
+    const bytes = new Uint8Array(str.length);
+    for (let i = 0; i < str.length; i++) {
+        const code = str.charCodeAt(i);
+        if (code > 0xFF) return null;
+        bytes[i] = code;
+    }
+    return bytes.buffer;
+}
+
+function bytes2mac(b, i) { // the 6 bytes at b[i] as "a1:b2:..", for MACs inside a larger buffer
+    return String.fromCharCode(
+        HEX_CODES[b[i] >> 4], HEX_CODES[b[i] & 15], 58, HEX_CODES[b[i + 1] >> 4], HEX_CODES[b[i + 1] & 15], 58,
+        HEX_CODES[b[i + 2] >> 4], HEX_CODES[b[i + 2] & 15], 58, HEX_CODES[b[i + 3] >> 4], HEX_CODES[b[i + 3] & 15], 58,
+        HEX_CODES[b[i + 4] >> 4], HEX_CODES[b[i + 4] & 15], 58, HEX_CODES[b[i + 5] >> 4], HEX_CODES[b[i + 5] & 15]);
+}
+
+function ab2mac(ab) { // one flat string, no intermediate arrays or concatenations
+    const b = new Uint8Array(ab);
+    if (b.length !== MAC_BYTES) return ab2str_stripped(ab).replace(/(..)(?!$)/g, "$1:");
+    return String.fromCharCode(
+        HEX_CODES[b[0] >> 4], HEX_CODES[b[0] & 15], 58, HEX_CODES[b[1] >> 4], HEX_CODES[b[1] & 15], 58,
+        HEX_CODES[b[2] >> 4], HEX_CODES[b[2] & 15], 58, HEX_CODES[b[3] >> 4], HEX_CODES[b[3] & 15], 58,
+        HEX_CODES[b[4] >> 4], HEX_CODES[b[4] & 15], 58, HEX_CODES[b[5] >> 4], HEX_CODES[b[5] & 15]);
+}
+
+function mac2ab(mac) { // null for anything but "a1:b2:c3:d4:e5:f6" (any case)
+    if (!isMac(mac)) return null;
+    const bytes = new Uint8Array(MAC_BYTES);
+    for (let i = 0; i < MAC_BYTES; i++) {
+        bytes[i] = hexValue(mac.charCodeAt(i * 3)) * 16 + hexValue(mac.charCodeAt(i * 3 + 1));
+    }
+    return bytes.buffer;
+}
+
+function isMac(mac) {
+    if (typeof mac !== "string" || mac.length !== MAC_LENGTH) return false;
+    for (let i = 0; i < MAC_LENGTH; i++) {
+        const c = mac.charCodeAt(i);
+        if (i % 3 === 2 ? c !== 58 : hexValue(c) < 0) return false; // ':' every third char
+    }
+    return true;
+}
+
+function normalizeMac(mac) {
+    return isMac(mac) ? mac.toLowerCase() : null;
+}
+
+function hexValue(c) { // char code > 0..15, -1 if not a hex digit
+    if (c >= 48 && c <= 57) return c - 48;
+    c |= 0x20; // lowercase
+    return c >= 97 && c <= 102 ? c - 87 : -1;
+}
+
+function mac2num(mac) { // "a1:b2:.." > 48-bit number, no allocations
+    let num = 0;
+    for (let i = 0; i < mac.length; i++) {
+        const c = mac.charCodeAt(i);
+        if (c === 58) continue; // ':'
+        num = num * 16 + (c <= 57 ? c - 48 : (c | 0x20) - 87);
+    }
+    return num;
+}
+
+function num2mac(num) {
+    let mac = "";
+    for (let shift = 40; shift >= 0; shift -= 8) {
+        const byte = Math.floor(num / 2 ** shift) % 256;
+        mac += (byte < 16 ? "0" : "") + byte.toString(16) + (shift ? ":" : "");
+    }
+    return mac;
+}
+
+const hex_scratch = [];
+function ab2str_stripped(buffer) { // strip unicode
+    if (!(buffer instanceof ArrayBuffer)) return "";
+    const bytes = new Uint8Array(buffer);
+    return bytes2hex(bytes, 0, bytes.length);
+}
+
+function bytes2hex(bytes, from, to) { // lowercase hex of bytes[from..to)
+    let str = "";
+    for (let start = from; start < to; start += CHUNK_CHARS / 2) {
+        const end = Math.min(to, start + CHUNK_CHARS / 2);
+        hex_scratch.length = (end - start) * 2;
+        for (let i = start, j = 0; i < end; i++) {
+            hex_scratch[j++] = HEX_CODES[bytes[i] >> 4];
+            hex_scratch[j++] = HEX_CODES[bytes[i] & 15];
+        }
+        str += String.fromCharCode.apply(null, hex_scratch);
+    }
+    return str;
+}
+
+/**
+ * ArrayBuffer as is, typed arrays as a copy of their bytes, even-length hex strings decoded, other strings one byte per char.
+ * @returns {ArrayBuffer|null} null for anything else: odd-length hex, chars above 0xFF, numbers, objects.
+ */
+function data2ab(data) {
+    if (data instanceof ArrayBuffer) {
+        return data;
+    } else if (ArrayBuffer.isView(data)) {
+        return data.buffer.slice(data.byteOffset, data.byteOffset + data.byteLength);
+    } else if (typeof data === "string") {
+        if (HEX_PATTERN.test(data)) { // hex string
+            if (data.length % 2) return null; // the last nibble would be read as a whole byte
+            const bytes = new Uint8Array(data.length / 2);
+            for (let i = 0; i < bytes.length; i++) {
+                bytes[i] = hexValue(data.charCodeAt(i * 2)) * 16 + hexValue(data.charCodeAt(i * 2 + 1));
+            }
+            return bytes.buffer;
+        } else { // normal string
+            return latin1ToAb(data);
+        }
+    }
+    return null;
+}
+
+/**
+ * Checks the parts of a profile object that mstBuildProfile dereferences.
+ * @returns {string|null} What is wrong with it, or null if it is usable.
+ */
+function profileError(profile) {
+    if (!profile || typeof profile !== "object") return "not an object";
+    if (!(profile.dev instanceof ArrayBuffer) || profile.dev.byteLength !== MAC_BYTES) return "dev is not a 6 byte ArrayBuffer";
+    if (!Array.isArray(profile.list)) return "list is not an array";
+    if (profile.len !== undefined && profile.len !== profile.list.length) return "len does not match list";
+    for (const group of profile.list) {
+        if (!group || !Array.isArray(group.list)) return "service group without a list";
+        if (group.len !== undefined && group.len !== group.list.length) return "service group len does not match its list";
+        for (const service of group.list) {
+            if (!service || !isUuid(service.uuid)) return "service without a valid uuid";
+            if (!Array.isArray(service.list)) return "service " + service.uuid + " without a characteristic list";
+            for (const chara of service.list) {
+                if (!chara || !isUuid(chara.uuid)) return "characteristic without a valid uuid in " + service.uuid;
+                if (chara.list === undefined) continue;
+                if (!Array.isArray(chara.list)) return "characteristic " + chara.uuid + " has a list that is not an array";
+                if (chara.len !== undefined && chara.len !== chara.list.length) return "characteristic " + chara.uuid + " len does not match its list";
+                for (const desc of chara.list) {
+                    if (!desc || !isUuid(desc.uuid)) return "descriptor without a valid uuid in " + chara.uuid;
+                }
+            }
+        }
+    }
+    return null;
+}
+
+function isUuid(uuid) {
+    return typeof uuid === "string" && UUID_PATTERN.test(uuid);
+}
+
+/* REGISTRY */
+
+/**
+ * Device registries: where scan results and connection state are kept, and the read-only view pages get through ble.get.
+ */
+
+const REGISTRY_COMPACT              = "compact";
+const DEFAULT_REGISTRY_CAPACITY     = 64; // slots, compact registry grows by doubling
+const FLAG_CONNECTED                = 0x01;
+
+/**
+ * Creates the registry selected by options.registry ("object" by default, "compact") and options.capacity.
+ */
+function createRegistry(options, clock) {
+    return options.registry === REGISTRY_COMPACT
+        ? new CompactRegistry(options.capacity, clock)
+        : new ObjectRegistry(clock);
+}
+
+class ObjectRegistry {
+    #devices = {};
+    #size = 0;
+    #by_connect_id = new Map(); // connect_id > MAC, backend callbacks resolve their device without a walk
+    #by_profile = new Map();    // profile_idp > MAC
+    #clock;
+
+    constructor(clock = SYSTEM_CLOCK) {
+        this.#clock = clock;
+    }
+    /**
+     * @type {number} The number of known devices.
+     */
+    get size() {
+        return this.#size;
+    }
+    has(dev_addr) {
+        return this.#devices.hasOwnProperty(dev_addr);
+    }
+    get(dev_addr) {
+        return this.#devices[dev_addr];
+    }
+    all() {
+        return this.#devices;
+    }
+    scan(dev_addr, scan_result) {
+        let device = this.#devices[dev_addr];
+        if (!device) {
+            device = this.#devices[dev_addr] = {};
+            this.#size++;
+        }
+        const last_seen = device.last_seen === undefined ? -1 : device.last_seen;
+        // update in place, this keeps the connection state (connect_id, profile_idp, is_connected) intact
+        device.dev_name = scan_result.dev_name;
+        device.rssi = scan_result.rssi;
+        device.service_uuid_array = scan_result.service_uuid_array;
+        device.service_data_array = scan_result.service_data_array;
+        device.vendor_id = scan_result.vendor_id;
+        device.vendor_data = scan_result.vendor_data;
+        device.last_seen = this.#clock.now();
+        return last_seen;
+    }
+    remove(dev_addr) {
+        if (!this.has(dev_addr)) return false;
+        const device = this.#devices[dev_addr];
+        unindex(this.#by_connect_id, device.connect_id, dev_addr);
+        unindex(this.#by_profile, device.profile_idp, dev_addr);
+        delete this.#devices[dev_addr];
+        this.#size--;
+        return true;
+    }
+    link(dev_addr, connect_id) {
+        let device = this.#devices[dev_addr];
+        if (!device) {
+            device = this.#devices[dev_addr] = {};
+            this.#size++;
+        }
+        unindex(this.#by_connect_id, device.connect_id, dev_addr);
+        device.connect_id = connect_id;
+        device.is_connected = true;
+        this.#by_connect_id.set(connect_id, dev_addr);
+    }
+    unlink(dev_addr) {
+        const device = this.#devices[dev_addr];
+        if (device) device.is_connected = false;
+    }
+    setProfile(dev_addr, profile_idp) {
+        const device = this.#devices[dev_addr];
+        if (!device) return;
+        unindex(this.#by_profile, device.profile_idp, dev_addr);
+        device.profile_idp = profile_idp;
+        if (profile_idp !== undefined) this.#by_profile.set(profile_idp, dev_addr);
+    }
+    isConnected(dev_addr) {
+        const device = this.#devices[dev_addr];
+        return !!device && device.is_connected === true;
+    }
+    connectId(dev_addr) {
+        const device = this.#devices[dev_addr];
+        return device && device.connect_id;
+    }
+    profile(dev_addr) {
+        const device = this.#devices[dev_addr];
+        return device && device.profile_idp;
+    }
+    findByProfile(profile_idp) {
+        const dev_addr = this.#by_profile.get(profile_idp);
+        return dev_addr === undefined ? null : dev_addr;
+    }
+    findByConnectId(connect_id) {
+        const dev_addr = this.#by_connect_id.get(connect_id);
+        return dev_addr === undefined ? null : dev_addr;
+    }
+}
+
+/**
+ * Struct-of-arrays device registry. Hot per-advert fields (MAC, RSSI, last seen, flags) live in typed-array
+ * columns indexed by slot, everything else is kept by reference in sparse columns. Device objects and MAC
+ * strings are only materialized when requested through get() or all().
+ */
+class CompactRegistry {
+    #capacity;
+    #size = 0;
+    #slots = new Map(); // numeric MAC > slot
+    #mac;               // Float64Array, 48-bit MAC as a number
+    #rssi;              // Int8Array
+    #last_seen;         // Float64Array, millis
+    #flags;             // Uint8Array, FLAG_*
+    // cold columns
+    #dev_name = [];
+    #service_uuid_array = [];
+    #service_data_array = [];
+    #vendor_id = [];
+    #vendor_data = [];
+    #links = new Map(); // slot > { connect_id, profile_idp } (only for devices that were ever connected)
+    #by_connect_id = new Map(); // connect_id > MAC
+    #by_profile = new Map();    // profile_idp > MAC
+    #clock;
+
+    constructor(capacity = DEFAULT_REGISTRY_CAPACITY, clock = SYSTEM_CLOCK) {
+        this.#clock = clock;
+        this.#capacity = Math.max(1, capacity | 0);
+        this.#mac = new Float64Array(this.#capacity);
+        this.#rssi = new Int8Array(this.#capacity);
+        this.#last_seen = new Float64Array(this.#capacity);
+        this.#flags = new Uint8Array(this.#capacity);
+    }
+    /**
+     * @type {number} The number of known devices.
+     */
+    get size() {
+        return this.#size;
+    }
+    has(dev_addr) {
+        return this.#slots.has(mac2num(dev_addr));
+    }
+    get(dev_addr) {
+        const slot = this.#slots.get(mac2num(dev_addr));
+        return slot === undefined ? undefined : this.#view(slot);
+    }
+    all() {
+        const devices = {};
+        for (let slot = 0; slot < this.#size; slot++) {
+            devices[num2mac(this.#mac[slot])] = this.#view(slot);
+        }
+        return devices;
+    }
+    scan(dev_addr, scan_result) {
+        const slot = this.#slotOf(dev_addr);
+        const last_seen = this.#last_seen[slot];
+        this.#rssi[slot] = scan_result.rssi;
+        this.#last_seen[slot] = this.#clock.now();
+        this.#dev_name[slot] = scan_result.dev_name;
+        this.#service_uuid_array[slot] = scan_result.service_uuid_array;
+        this.#service_data_array[slot] = scan_result.service_data_array;
+        this.#vendor_id[slot] = scan_result.vendor_id;
+        this.#vendor_data[slot] = scan_result.vendor_data;
+        return last_seen;
+    }
+    remove(dev_addr) { // the last slot moves into the freed one, columns stay dense
+        const mac = mac2num(dev_addr);
+        const slot = this.#slots.get(mac);
+        if (slot === undefined) return false;
+        const removed = this.#links.get(slot);
+        if (removed) {
+            unindex(this.#by_connect_id, removed.connect_id, num2mac(mac));
+            unindex(this.#by_profile, removed.profile_idp, num2mac(mac));
+        }
+        const last = --this.#size;
+        this.#slots.delete(mac);
+        const link = this.#links.get(last);
+        this.#links.delete(slot);
+        this.#links.delete(last);
+        if (slot !== last) {
+            this.#mac[slot] = this.#mac[last];
+            this.#rssi[slot] = this.#rssi[last];
+            this.#last_seen[slot] = this.#last_seen[last];
+            this.#flags[slot] = this.#flags[last];
+            this.#dev_name[slot] = this.#dev_name[last];
+            this.#service_uuid_array[slot] = this.#service_uuid_array[last];
+            this.#service_data_array[slot] = this.#service_data_array[last];
+            this.#vendor_id[slot] = this.#vendor_id[last];
+            this.#vendor_data[slot] = this.#vendor_data[last];
+            if (link) this.#links.set(slot, link);
+            this.#slots.set(this.#mac[slot], slot);
+        }
+        this.#flags[last] = 0;
+        this.#dev_name.length = this.#service_uuid_array.length = this.#service_data_array.length = last;
+        this.#vendor_id.length = this.#vendor_data.length = last;
+        return true;
+    }
+    link(dev_addr, connect_id) {
+        const slot = this.#slotOf(dev_addr);
+        dev_addr = num2mac(this.#mac[slot]); // the indexes hold the MACs findBy* always returned
+        const link = this.#links.get(slot);
+        if (link) {
+            unindex(this.#by_connect_id, link.connect_id, dev_addr);
+            link.connect_id = connect_id;
+        } else {
+            this.#links.set(slot, { connect_id, profile_idp: undefined });
+        }
+        this.#flags[slot] |= FLAG_CONNECTED;
+        this.#by_connect_id.set(connect_id, dev_addr);
+    }
+    unlink(dev_addr) {
+        const slot = this.#slots.get(mac2num(dev_addr));
+        if (slot !== undefined) this.#flags[slot] &= ~FLAG_CONNECTED;
+    }
+    setProfile(dev_addr, profile_idp) {
+        const mac = mac2num(dev_addr);
+        const link = this.#links.get(this.#slots.get(mac));
+        if (!link) return;
+        dev_addr = num2mac(mac);
+        unindex(this.#by_profile, link.profile_idp, dev_addr);
+        link.profile_idp = profile_idp;
+        if (profile_idp !== undefined) this.#by_profile.set(profile_idp, dev_addr);
+    }
+    isConnected(dev_addr) {
+        const slot = this.#slots.get(mac2num(dev_addr));
+        return slot !== undefined && (this.#flags[slot] & FLAG_CONNECTED) !== 0;
+    }
+    connectId(dev_addr) {
+        const link = this.#links.get(this.#slots.get(mac2num(dev_addr)));
+        return link && link.connect_id;
+    }
+    profile(dev_addr) {
+        const link = this.#links.get(this.#slots.get(mac2num(dev_addr)));
+        return link && link.profile_idp;
+    }
+    findByProfile(profile_idp) {
+        const dev_addr = this.#by_profile.get(profile_idp);
+        return dev_addr === undefined ? null : dev_addr;
+    }
+    findByConnectId(connect_id) {
+        const dev_addr = this.#by_connect_id.get(connect_id);
+        return dev_addr === undefined ? null : dev_addr;
+    }
+    #slotOf(dev_addr) {
+        const mac = mac2num(dev_addr);
+        let slot = this.#slots.get(mac);
+        if (slot === undefined) {
+            if (this.#size === this.#capacity) this.#grow();
+            slot = this.#size++;
+            this.#slots.set(mac, slot);
+            this.#mac[slot] = mac;
+            this.#last_seen[slot] = -1; // never advertised
+        }
+        return slot;
+    }
+    #grow() {
+        this.#capacity *= 2;
+        this.#mac = growTyped(this.#mac, this.#capacity);
+        this.#rssi = growTyped(this.#rssi, this.#capacity);
+        this.#last_seen = growTyped(this.#last_seen, this.#capacity);
+        this.#flags = growTyped(this.#flags, this.#capacity);
+    }
+    #view(slot) {
+        const device = {
+            dev_name: this.#dev_name[slot],
+            rssi: this.#rssi[slot],
+            service_uuid_array: this.#service_uuid_array[slot],
+            service_data_array: this.#service_data_array[slot],
+            vendor_id: this.#vendor_id[slot],
+            vendor_data: this.#vendor_data[slot],
+            last_seen: this.#last_seen[slot] < 0 ? undefined : this.#last_seen[slot]
+        };
+        const link = this.#links.get(slot);
+        if (link) {
+            device.connect_id = link.connect_id;
+            device.profile_idp = link.profile_idp;
+            device.is_connected = (this.#flags[slot] & FLAG_CONNECTED) !== 0;
+        }
+        return device;
+    }
+}
+
+class Get {
+    #registry;
+    #monitor;
+    constructor(registry, monitor) {
+        this.#registry = registry;
+        this.#monitor = monitor;
+    }
+    /**
+     * Returns all devices.
+     * @returns {Object} Returns an object containing information about all devices.
+     */
+    devices() {
+        return this.#registry.all();
+    }
+    /**
+     * Returns one device.
+     * @param {string} dev_addr - The MAC address of the device.
+     * @returns {Object|undefined} Returns the device's information (same shape as an entry of devices()), or undefined if it is not known.
+     */
+    device(dev_addr) {
+        dev_addr = normalizeMac(dev_addr);
+        return dev_addr === null ? undefined : this.#registry.get(dev_addr);
+    }
+    /**
+     * Checks if a device is connected.
+     * @param {string} dev_addr - The MAC address of the device.
+     * @returns {boolean} Returns true if the device is connected, false otherwise.
+     */
+    isConnected(dev_addr){
+        dev_addr = normalizeMac(dev_addr);
+        return dev_addr !== null && this.#registry.isConnected(dev_addr);
+    }
+    /**
+     * Checks if a device exists.
+     * @param {string} dev_addr - The MAC address of the device.
+     * @returns {boolean} Returns true if the device exists, false otherwise.
+     */
+    hasDevice(dev_addr) {
+        dev_addr = normalizeMac(dev_addr);
+        return dev_addr !== null && this.#registry.has(dev_addr);
+    }
+    /**
+     * Returns the built-in metrics.
+     * @returns {Object} Returns { counters, latency, errors }. counters holds the number of each TRACE_OP event (lowercase names),
+     * latency holds { count, min, max, mean, p50, p90, p99, buckets } in millis for scan_first_seen, connect, prepare, read and write,
+     * errors holds the number of non-zero backend statuses (or "rejected" backend calls) per operation.
+     */
+    stats() {
+        return this.#monitor.stats();
+    }
+}
+
+function unindex(index, key, dev_addr) { // drops a reverse index entry unless another device took the key over since
+    if (key !== undefined && index.get(key) === dev_addr) index.delete(key);
+}
+
+function growTyped(arr, length) {
+    const grown = new arr.constructor(length);
+    grown.set(arr);
+    return grown;
+}
+
+/* NO DIAGNOSTICS */
+
+/**
+ * Stand-in for diagnostics.js in builds without diagnostics: no trace, no stats, no watchdog.
+ * Only the cancel token wiring of Monitor.start is kept, pending operations still need it to be abandoned.
+ */
+
+const MAX_PENDING_PER_KEY = 16;
+
+function createMonitor() {
+    return new QuietMonitor();
+}
+
+class QuietMonitor {
+    trace = null;
+    onRecycle = null;
+    #cancels = Array.from({ length: METRIC_WRITE + 1 }, () => new Map()); // key > [{ dispose }], oldest first, per metric
+
+    start(op, dev_addr, key, on_expire, signal, on_cancel) {
+        const metric = metricOf(op);
+        const entry = { dispose: noop };
+        const queue = this.#cancels[metric].get(key);
+        if (queue === undefined) this.#cancels[metric].set(key, [entry]);
+        else if (queue.push(entry) > MAX_PENDING_PER_KEY) this.#settle(metric, key); // no watchdog here, bounds what a silent backend leaves
+        if (!signal) return;
+        const cancel = () => {
+            this.#remove(metric, key, entry);
+            if (on_cancel) on_cancel();
+        };
+        signal.addEventListener("abort", cancel);
+        entry.dispose = () => signal.removeEventListener("abort", cancel);
+    }
+    issued(op, dev_addr, success, size = 0, key = dev_addr) {
+        if (!success) this.#settle(metricOf(op), key, true);
+    }
+    completed(op, dev_addr, status, size = 0, key = dev_addr) {
+        this.#settle(metricOf(op), key);
+    }
+    event() {}
+    error() {}
+    sample() {}
+    reset() {}
+    stats() {
+        return { counters: {}, latency: {}, errors: {} };
+    }
+    #settle(metric, key, newest = false) { // like Monitor: results settle the oldest operation on a key
+        if (metric < 0) return;
+        const queue = this.#cancels[metric].get(key);
+        if (queue === undefined) return;
+        const entry = newest ? queue.pop() : queue.shift();
+        if (queue.length === 0) this.#cancels[metric].delete(key);
+        entry.dispose();
+    }
+    #remove(metric, key, entry) {
+        const queue = this.#cancels[metric].get(key);
+        const index = queue === undefined ? -1 : queue.indexOf(entry);
+        if (index < 0) return;
+        queue.splice(index, 1);
+        if (queue.length === 0) this.#cancels[metric].delete(key);
+        entry.dispose();
+    }
+}
+
+/* SCAN */
+
+/**
+ * Scanning: decodes every advert, keeps the registry up to date and measures the time to first sight.
+ */
+
+class Scanner {
+    #ble;
+    #clock;
+    #registry;
+    #monitor;
+    #scan_started_at = 0;
+    #scan_dispose = noop;
+
+    constructor(ble, clock, registry, monitor) {
+        this.#ble = ble;
+        this.#clock = clock;
+        this.#registry = registry;
+        this.#monitor = monitor;
+    }
+    /**
+     * Starts scanning for devices. See BLEMaster.startScan.
+     */
+    startScan(response_callback, options = {}) {
+        const signal = options.signal;
+        if (signal && signal.aborted) return false;
+        const filter = options.filter;
+        const modified_callback = (scan_result) => {
+            if (!scan_result || !(scan_result.dev_addr instanceof ArrayBuffer) || scan_result.dev_addr.byteLength !== MAC_BYTES) {
+                this.#monitor.error(METRIC_SCAN_FIRST_SEEN, STATUS_MALFORMED); // nothing to key it by, drop it here
+                return;
+            }
+            const scan_result_str = {
+                ...scan_result,
+                dev_addr: ab2mac(scan_result.dev_addr),
+                vendor_data: ab2str_stripped(scan_result.vendor_data), // decode
+                service_data_array: Array.isArray(scan_result.service_data_array) ? scan_result.service_data_array.map(service => ({ // map (!) empty
+                    ...service,
+                    service_data: ab2str_stripped(service && service.service_data)
+                })) : []
+            };
+            if (filter && !filter(scan_result_str)) return; // keeps the registry down to the devices the caller cares about
+            const last_seen = this.#registry.scan(scan_result_str.dev_addr, scan_result_str);
+            if (last_seen < this.#scan_started_at) { // first advert of this device since the scan started
+                this.#monitor.sample(METRIC_SCAN_FIRST_SEEN, this.#clock.now() - this.#scan_started_at);
+            }
+            this.#monitor.event(TRACE_OP.SCAN_RESULT, scan_result_str.dev_addr, scan_result_str.rssi, scan_result.vendor_data ? scan_result.vendor_data.byteLength : 0);
+
+            response_callback(scan_result_str);
+        }
+
+        this.#scan_dispose();
+        this.#scan_started_at = this.#clock.now();
+        const success = this.#ble.mstStartScan(modified_callback);
+        this.#monitor.issued(TRACE_OP.SCAN_START, null, success);
+        let duration_timer = null;
+        if (options.duration !== undefined) {
+            duration_timer = this.#clock.setTimeout(() => {
+                this.stopScan();
+                if (options.on_duration) {
+                    options.on_duration();
+                }
+            }, options.duration);
+        }
+        if (signal) {
+            const stop = () => {
+                this.#clock.clearTimeout(duration_timer);
+                this.stopScan();
+            };
+            signal.addEventListener("abort", stop);
+            this.#scan_dispose = () => {
+                this.#scan_dispose = noop;
+                this.#clock.clearTimeout(duration_timer);
+                signal.removeEventListener("abort", stop);
+            };
+        }
+        return success;
+    }
+    /**
+     * Stops scanning for devices. See BLEMaster.stopScan.
+     */
+    stopScan() {
+        this.#scan_dispose();
+        const success = this.#ble.mstStopScan();
+        this.#monitor.issued(TRACE_OP.SCAN_STOP, null, success);
+        return success;
+    }
+}
+
+/* CONNECTION */
+
+/**
+ * Connections: connect, disconnect, pair and stop, plus the devices owned by a cancel token.
+ */
+
+class Connections {
+    #ble;
+    #registry;
+    #monitor;
+    #connected = new Set(); // MACs with a live link
+    #owned = new Map(); // MAC > dispose, devices that are stopped when the token they were connected with is cancelled
+    /**
+     * @type {Function|null} Called with the MAC address of every device that connected successfully.
+     */
+    onConnected = null;
+    /**
+     * @type {Function|null} Called with the MAC address of a connect given up before the backend answered (watchdog expiry or cancel).
+     */
+    onAbandoned = null;
+
+    constructor(ble, registry, monitor) {
+        this.#ble = ble;
+        this.#registry = registry;
+        this.#monitor = monitor;
+    }
+    /**
+     * Connects to a device. See BLEMaster.connect.
+     */
+    connect(dev_addr, response_callback, options = {}) {
+        dev_addr = normalizeMac(dev_addr); // failsafe
+        if (dev_addr === null) {
+            logger.error(ERR_INVALID_MAC);
+            return false;
+        }
+        const signal = options.signal;
+        if (signal && signal.aborted) return false;
+        const dev_addr_ab = mac2ab(dev_addr);
+        let abandoned = false; // timed out or cancelled
+        const modified_callback = (result) => {
+            const result_str = {
+                ...result,
+                dev_addr: ab2mac(result.dev_addr) // dev_addr
+            };
+            if (abandoned) { // the request was already failed, release a late connection
+                if (result_str.connected === CONNECT_STATUS_OK) {
+                    this.#ble.mstDisconnect(result_str.connect_id);
+                }
+                return;
+            }
+            if (result_str.connected === CONNECT_STATUS_OK) {
+                this.#registry.link(result_str.dev_addr, result_str.connect_id);
+                this.#connected.add(result_str.dev_addr);
+                if (signal) this.own(signal, result_str.dev_addr);
+                if (this.onConnected) this.onConnected(result_str.dev_addr);
+            } else if (result_str.connected === CONNECT_STATUS_DISCONNECTED) {
+                this.#registry.unlink(result_str.dev_addr);
+                this.#connected.delete(result_str.dev_addr);
+                this.#disown(result_str.dev_addr);
+            }
+            if (result_str.connected === CONNECT_STATUS_DISCONNECTED) {
+                this.#monitor.event(TRACE_OP.DISCONNECT, result_str.dev_addr);
+            } else {
+                this.#monitor.completed(TRACE_OP.CONNECT_RESULT, result_str.dev_addr, result_str.connected);
+            }
+            response_callback(result_str);
+        }
+
+        this.#monitor.start(TRACE_OP.CONNECT, dev_addr, dev_addr, () => {
+            abandoned = true;
+            if (this.onAbandoned) this.onAbandoned(dev_addr);
+            response_callback({ dev_addr, connected: CONNECT_STATUS_FAILED, status: STATUS.TIMEOUT });
+        }, signal, () => {
+            abandoned = true;
+            if (this.onAbandoned) this.onAbandoned(dev_addr);
+        });
+        const success = this.#ble.mstConnect(dev_addr_ab, modified_callback);
+        this.#monitor.issued(TRACE_OP.CONNECT, dev_addr, success);
+        return success;
+    }
+    /**
+     * Disconnects from a device. See BLEMaster.disconnect.
+     */
+    disconnect(dev_addr) {
+        dev_addr = normalizeMac(dev_addr);
+        if (dev_addr !== null && this.#registry.isConnected(dev_addr)) {
+            const success = this.#ble.mstDisconnect(this.#registry.connectId(dev_addr));
+            this.#monitor.issued(TRACE_OP.DISCONNECT, dev_addr, success);
+            return success;
+        }
+    }
+    /**
+     * Pairs with a device. See BLEMaster.pair.
+     */
+    pair(dev_addr) {
+        dev_addr = normalizeMac(dev_addr);
+        if (dev_addr !== null && this.#registry.isConnected(dev_addr)) {
+            return this.#ble.mstPair(this.#registry.connectId(dev_addr));
+        }
+    }
+    /**
+     * Stops all interactions with a device. See BLEMaster.stop.
+     */
+    stop(dev_addr) {
+        dev_addr = normalizeMac(dev_addr);
+        if (dev_addr !== null && this.#registry.isConnected(dev_addr)) {
+            this.#connected.delete(dev_addr);
+            if (this.#connected.size === 0) this.#ble.mstOffAllCb(); // the backend callbacks are shared by every device
+            const profile_idp = this.#registry.profile(dev_addr);
+            if (profile_idp !== undefined) {
+                this.#ble.mstDestroyProfileInstance(profile_idp);
+                this.#registry.setProfile(dev_addr, undefined);
+            }
+            const success = this.#ble.mstDisconnect(this.#registry.connectId(dev_addr));
+            this.#registry.unlink(dev_addr);
+            this.#disown(dev_addr);
+            this.#monitor.issued(TRACE_OP.DISCONNECT, dev_addr, success);
+        }
+    }
+    /**
+     * Stops the device when the token is cancelled, until the device disconnects.
+     */
+    own(signal, dev_addr) {
+        this.#disown(dev_addr);
+        const stop = () => {
+            this.#owned.delete(dev_addr);
+            this.stop(dev_addr);
+        };
+        signal.addEventListener("abort", stop);
+        this.#owned.set(dev_addr, () => signal.removeEventListener("abort", stop));
+    }
+    #disown(dev_addr) {
+        const dispose = this.#owned.get(dev_addr);
+        if (dispose) {
+            this.#owned.delete(dev_addr);
+            dispose();
+        }
+    }
+}
+
+/* GATT */
+
+/**
+ * GATT: profile preparation, characteristic/descriptor reads and writes, and the ble.on.* callbacks.
+ */
+
+class Profiles {
+    #ble;
+    #clock;
+    #registry;
+    #monitor;
+    #callbacks;
+    #connections;
+    #known;
+    #preparing = false; // a profile is being built
+    #prepare_queue = []; // startListener calls waiting for it
+
+    constructor(ble, clock, registry, monitor, callbacks, connections, known = null) {
+        this.#ble = ble;
+        this.#clock = clock;
+        this.#registry = registry;
+        this.#monitor = monitor;
+        this.#callbacks = callbacks;
+        this.#connections = connections;
+        this.#known = known;
+    }
+    /**
+     * Builds a profile for the device of profile_object.dev. See BLEMaster.startListener.
+     * The backend has one mstOnPrepare callback, so profiles are built one at a time: a call made while another profile
+     * is being built waits for it.
+     */
+    startListener(profile_object, response_callback, options = {}) {
+        logger.debug(() => "eBLE: startListener called with profile_object: " + JSON.stringify(profile_object));
+        const signal = options.signal;
+        if (signal && signal.aborted) {
+            return { success: false, error: ERR_CANCELLED };
+        }
+        const invalid = profileError(profile_object);
+        if (invalid) { // mstBuildProfile does not validate, a malformed profile fails deep inside the backend
+            logger.error(ERR_INVALID_PROFILE + ":", invalid);
+            return { success: false, error: ERR_INVALID_PROFILE };
+        }
+        const request = { profile_object, response_callback, signal, drop: null };
+        if (this.#preparing) {
+            if (signal) { // a cancelled request leaves the queue without calling back
+                request.drop = () => {
+                    const index = this.#prepare_queue.indexOf(request);
+                    if (index >= 0) this.#prepare_queue.splice(index, 1);
+                };
+                signal.addEventListener("abort", request.drop);
+            }
+            this.#prepare_queue.push(request);
+        } else {
+            this.#prepare(request);
+        }
+
+        // the profile is built asynchronously, its status is delivered to the response_callback
+        return {
+            success: true,
+            error: null,
+        };
+    }
+    #prepare({ profile_object, response_callback, signal }) {
+        const dev_addr = ab2mac(profile_object.dev); // the device the profile is for, connects to other devices may have completed since
+        let abandoned = false; // timed out or cancelled
+        let finished = false;
+        const finish = () => { // the backend is free for the next profile
+            if (finished) return;
+            finished = true;
+            this.#prepareNext();
+        };
+        this.#preparing = true;
+        // 1. register the mstOnPrepare callback to handle profile preparation
+        this.#ble.mstOnPrepare((backend_response) => {
+            logger.debug(() => "eBLE: mstOnPrepare called with backend_response: " + JSON.stringify(backend_response));
+            if (abandoned) { // the request was already failed, release a late profile
+                if (backend_response.status === 0) {
+                    this.#ble.mstDestroyProfileInstance(backend_response.profile);
+                }
+                return;
+            }
+            this.#monitor.completed(TRACE_OP.PREPARE_RESULT, dev_addr, backend_response.status);
+            if (backend_response.status === 0) {
+                // save profile pointer (only if we were able to properly connect)
+                this.#registry.setProfile(dev_addr, backend_response.profile); // profile, status
+                if (signal) this.#connections.own(signal, dev_addr);
+            } else {
+                logger.warn("eBLE: Error mstOnPrepare. Status:", backend_response.status);
+            }
+
+            // 3. [old] execute the response_callback with the profile pointer (profile_idp) as the argument 
+            //    [new] returns status to the end user. (profile_idp) is now hidden from the end user interactions
+            logger.debug("eBLE: Executing backend_response");
+            finish();
+            response_callback(backend_response.status); // backend_response.profile
+        });
+        this.#listenAttributes();
+    
+        // add a delay before calling mstBuildProfile
+        let build_timer = null;
+        const cancel_build = () => {
+            abandoned = true;
+            this.#clock.clearTimeout(build_timer);
+            finish();
+        };
+        if (signal) signal.addEventListener("abort", cancel_build);
+        build_timer = this.#clock.setTimeout(() => {
+            if (signal) signal.removeEventListener("abort", cancel_build);
+            // 2. build the profile
+            this.#monitor.start(TRACE_OP.PREPARE, dev_addr, dev_addr, () => {
+                abandoned = true;
+                finish();
+                response_callback(STATUS.TIMEOUT);
+            }, signal, () => {
+                abandoned = true;
+                finish();
+            });
+            const success = this.#ble.mstBuildProfile(profile_object);
+            logger.debug("eBLE: mstBuildProfile called with success:", success);
+            this.#monitor.issued(TRACE_OP.PREPARE, dev_addr, success);
+            if (!success) { // nothing will answer, the caller still gets its status
+                logger.error(ERR_PROFILE_CREATION_FAILED);
+                abandoned = true;
+                finish();
+                response_callback(STATUS.REJECTED);
+            }
+        }, SHORT_DELAY);  // 100ms
+    }
+    #prepareNext() {
+        this.#preparing = false;
+        const request = this.#prepare_queue.shift();
+        if (!request) return;
+        if (request.drop) request.signal.removeEventListener("abort", request.drop);
+        this.#prepare(request);
+    }
+    /**
+     * Fills in connect_id, profile and dev of a profile object. See BLEMaster.modifyProfileObject.
+     */
+    modifyProfileObject(dev_addr, profile_object) {
+        dev_addr = normalizeMac(dev_addr);
+        const device = dev_addr === null ? undefined : this.#registry.get(dev_addr);
+        // a device connected directly (without a scan) has no dev_name in the registry, the known-devices store may have it
+        const known = dev_addr !== null && this.#known ? this.#known.get(dev_addr) : undefined;
+        if (!device && !known) {
+            logger.warn("eBLE: Device not found:", dev_addr);
+            return null;
+        }
+    
+        const modified_profile_object = {
+            ...profile_object,
+            id: device ? device.connect_id : undefined,
+            profile: device && device.dev_name !== undefined ? device.dev_name : known && known.dev_name,
+            dev: mac2ab(dev_addr),
+        };
+    
+        return modified_profile_object;
+    }
+    /**
+     * @warning [NOT IMPLEMENTED] See BLEMaster.generateProfileObject.
+     */
+     generateProfileObject(dev_addr) {
+        const device = this.#registry.get(dev_addr);
+        if (!device) {
+            logger.warn("eBLE: Device not found:", dev_addr);
+            return { success: false, error: "Device not found: " + dev_addr };
+        }
+    
+        logger.warn(ERR_NOT_IMPLEMENTED);
+        return { success: false, error: ERR_NOT_IMPLEMENTED }; // exit point
+        // TODO: implementation (most devices don't have enough data to generate a profile from the scan, needs a generalized approach)
+        const profile_object = {
+            pair: true,
+            id: device.connect_id,
+            profile: device.dev_name,
+            dev: mac2ab(dev_addr),
+            len: 1,
+            list: []
+        };
+    
+        // add services
+        for (const service_uuid of device.service_uuid_array || []) { // empty arr if we have nothing + need to make sure we gen all 5 levels
+            const service = {
+                uuid: true,
+                size: 1,
+                len: 1,
+                list: []
+            };
+            profile_object.list.push(service);
+    
+            // add characteristics
+            for (const characteristic of device.characteristics || []) {
+                if (characteristic.service_uuid === service_uuid) {
+                    const characteristic_obj = {
+                        uuid: characteristic.uuid,
+                        permission: 0,
+                        desc: 1,
+                        len: 1,
+                        list: []
+                    };
+                    service.list.push(characteristic_obj);
+    
+                    // add descriptors
+                    for (const descriptor of characteristic.descriptors || []) {
+                        const descriptor_obj = {
+                            uuid: descriptor.uuid,
+                            permission: 0
+                        };
+                        characteristic_obj.list.push(descriptor_obj);
+                    }
+                }
+            }
+        }
+    }
+    /**
+     * Registers the backend read/write/notification callbacks. Every response is measured and handed over
+     * to the matching ble.on callback with the device's MAC address and hex-string data.
+     */
+    #listenAttributes() {
+        const dispatch = (name, op, response, size) => {
+            const dev_addr = this.#registry.findByProfile(response.profile);
+            const status = response.status === undefined ? 0 : response.status;
+            if (op === TRACE_OP.NOTIFY || op === TRACE_OP.VALUE) { // a read settles on its ReadComplete
+                this.#monitor.event(op, dev_addr, status, size);
+            } else {
+                const key = response.uuid !== undefined ? attrKey(dev_addr, response.uuid) : attrKey(dev_addr, response.chara, response.desc);
+                this.#monitor.completed(op, dev_addr, status, size, key);
+            }
+            const callbacks = this.#callbacks;
+            if (callbacks[name] || (callbacks.taps && callbacks.taps.size > 0)) {
+                const response_str = { ...response, dev_addr };
+                if (response.data !== undefined) response_str.data = ab2str_stripped(response.data);
+                emitCallback(callbacks, name, response_str);
+            }
+        };
+        this.#ble.mstOnCharaReadComplete((response) => dispatch("charaReadComplete", TRACE_OP.READ_RESULT, response, 0));
+        this.#ble.mstOnCharaValueArrived((response) => dispatch("charaValueArrived", TRACE_OP.VALUE, response, response.length));
+        this.#ble.mstOnCharaWriteComplete((response) => dispatch("charaWriteComplete", TRACE_OP.WRITE_RESULT, response, 0));
+        this.#ble.mstOnDescReadComplete((response) => dispatch("descReadComplete", TRACE_OP.READ_RESULT, response, 0));
+        this.#ble.mstOnDescValueArrived((response) => dispatch("descValueArrived", TRACE_OP.VALUE, response, response.length));
+        this.#ble.mstOnDescWriteComplete((response) => dispatch("descWriteComplete", TRACE_OP.WRITE_RESULT, response, 0));
+        this.#ble.mstOnCharaNotification((response) => dispatch("charaNotification", TRACE_OP.NOTIFY, response, response.length));
+    }
+}
+
+class Write {
+    #ble;
+    #registry;
+    #monitor;
+    #callbacks;
+    
+    constructor(ble, registry, monitor, callbacks) {
+        this.#ble = ble;
+        this.#registry = registry;
+        this.#monitor = monitor;
+        this.#callbacks = callbacks;
+    }
+    /**
+     * Writes to a characteristic of a device.
+     * @param {string} dev_addr - The MAC address of the device.
+     * @param {string} uuid - The UUID of the characteristic to write to.
+     * @param {string|ArrayBuffer} data - The data to write to the characteristic.
+     * @param {Object} [options={}] - Optional parameters.
+     * @param {CancelToken} [options.signal] - Cancelling it before the write is issued skips it, after that it stops waiting for the completion.
+     * @returns {Object} Returns an object with a 'success' property indicating whether the write succeeded and an 'error' property containing an error message if the write failed.
+     */
+    characteristic(dev_addr, uuid, data, options = {}) {
+        dev_addr = normalizeMac(dev_addr);
+        if (dev_addr === null) {
+            logger.error(ERR_INVALID_MAC);
+            return { success: false, error: ERR_INVALID_MAC };
+        }
+        const signal = options.signal;
+        if (signal && signal.aborted) {
+            return { success: false, error: ERR_CANCELLED };
+        }
+        const profile_idp = this.#registry.profile(dev_addr);
+        if (profile_idp === undefined) {
+            logger.error(ERR_IDP_NOT_FOUND);
+            return { success: false, error: ERR_IDP_NOT_FOUND_SHORT }; // handle layering
+        }
+        const data_ab = data2ab(data);
+        if (data_ab === null) {
+            logger.error(ERR_INVALID_DATA);
+            return { success: false, error: ERR_INVALID_DATA };
+        }
+        const data_len = data_ab.byteLength;
+        const key = attrKey(dev_addr, uuid);
+        this.#monitor.start(TRACE_OP.WRITE, dev_addr, key, () => {
+            emitCallback(this.#callbacks, "charaWriteComplete", { dev_addr, uuid, status: STATUS.TIMEOUT });
+        }, signal);
+        const success = this.#ble.mstWriteCharacteristic(profile_idp, uuid, data_ab, data_len);
+        this.#monitor.issued(TRACE_OP.WRITE, dev_addr, success, data_len, key);
+        return {
+            success,
+            error: success ? null : ERR_CHAR_WRITE_FAIL,
+        };
+    }
+    /**
+     * Writes to a descriptor of a characteristic of a device.
+     * @param {string} dev_addr - The MAC address of the device.
+     * @param {string} chara - The UUID of the characteristic that the descriptor belongs to.
+     * @param {string} desc - The UUID of the descriptor to write to.
+     * @param {string|ArrayBuffer} data - The data to write to the descriptor.
+     * @param {Object} [options={}] - Optional parameters.
+     * @param {CancelToken} [options.signal] - Cancelling it before the write is issued skips it, after that it stops waiting for the completion.
+     * @returns {Object} Returns an object with a 'success' property indicating whether the write succeeded and an 'error' property containing an error message if the write failed.
+     */
+    descriptor(dev_addr, chara, desc, data, options = {}) {
+        dev_addr = normalizeMac(dev_addr);
+        if (dev_addr === null) {
+            logger.error(ERR_INVALID_MAC);
+            return { success: false, error: ERR_INVALID_MAC };
+        }
+        const signal = options.signal;
+        if (signal && signal.aborted) {
+            return { success: false, error: ERR_CANCELLED };
+        }
+        const profile_idp = this.#registry.profile(dev_addr);
+        if (profile_idp === undefined) {
+            logger.error(ERR_IDP_NOT_FOUND);
+            return { success: false, error: ERR_IDP_NOT_FOUND_SHORT };
+        }
+        const data_ab = data2ab(data);
+        if (data_ab === null) {
+            logger.error(ERR_INVALID_DATA);
+            return { success: false, error: ERR_INVALID_DATA };
+        }
+        const data_len = data_ab.byteLength;
+        const key = attrKey(dev_addr, chara, desc);
+        this.#monitor.start(TRACE_OP.WRITE, dev_addr, key, () => {
+            emitCallback(this.#callbacks, "descWriteComplete", { dev_addr, chara, desc, status: STATUS.TIMEOUT });
+        }, signal);
+        const success = this.#ble.mstWriteDescriptor(profile_idp, chara, desc, data_ab, data_len);
+        this.#monitor.issued(TRACE_OP.WRITE, dev_addr, success, data_len, key);
+        return {
+            success,
+            error: success ? null : ERR_DESC_WRITE_FAIL,
+        };
+    }
+}
+
+class Read {
+    #ble;
+    #registry;
+    #monitor;
+    #callbacks;
+    
+    constructor(ble, registry, monitor, callbacks) {
+        this.#ble = ble;
+        this.#registry = registry;
+        this.#monitor = monitor;
+        this.#callbacks = callbacks;
+    }
+    /**
+     * Reads from a characteristic of a device.
+     * @param {string} dev_addr - The MAC address of the device.
+     * @param {string} uuid - The UUID of the characteristic to read from.
+     * @param {Object} [options={}] - Optional parameters.
+     * @param {CancelToken} [options.signal] - Cancelling it before the read is issued skips it, after that it stops waiting for the completion.
+     * @returns {Object} Returns an object with a 'success' property indicating whether the read succeeded and an 'error' property containing an error message if the read failed.
+     */
+    characteristic(dev_addr, uuid, options = {}) {
+        dev_addr = normalizeMac(dev_addr);
+        if (dev_addr === null) {
+            logger.error(ERR_INVALID_MAC);
+            return { success: false, error: ERR_INVALID_MAC };
+        }
+        const signal = options.signal;
+        if (signal && signal.aborted) {
+            return { success: false, error: ERR_CANCELLED };
+        }
+        const profile_idp = this.#registry.profile(dev_addr);
+        if (profile_idp === undefined) {
+            logger.error(ERR_IDP_NOT_FOUND);
+            return { success: false, error: ERR_IDP_NOT_FOUND_SHORT };
+        }
+        const key = attrKey(dev_addr, uuid);
+        this.#monitor.start(TRACE_OP.READ, dev_addr, key, () => {
+            emitCallback(this.#callbacks, "charaReadComplete", { dev_addr, uuid, status: STATUS.TIMEOUT });
+        }, signal);
+        const success = this.#ble.mstReadCharacteristic(profile_idp, uuid);
+        this.#monitor.issued(TRACE_OP.READ, dev_addr, success, 0, key);
+        return {
+            success,
+            error: success ? null : ERR_CHAR_READ_FAIL,
+        };
+    }
+    /**
+     * Reads from a descriptor of a characteristic of a device.
+     * @param {string} dev_addr - The MAC address of the device.
+     * @param {string} uuid - The UUID of the characteristic that the descriptor belongs to.
+     * @param {string} desc - The UUID of the descriptor to read from.
+     * @param {Object} [options={}] - Optional parameters.
+     * @param {CancelToken} [options.signal] - Cancelling it before the read is issued skips it, after that it stops waiting for the completion.
+     * @returns {Object} Returns an object with a 'success' property indicating whether the read succeeded and an 'error' property containing an error message if the read failed.
+     */
+    descriptor(dev_addr, uuid, desc, options = {}) {
+        dev_addr = normalizeMac(dev_addr);
+        if (dev_addr === null) {
+            logger.error(ERR_INVALID_MAC);
+            return { success: false, error: ERR_INVALID_MAC };
+        }
+        const signal = options.signal;
+        if (signal && signal.aborted) {
+            return { success: false, error: ERR_CANCELLED };
+        }
+        const profile_idp = this.#registry.profile(dev_addr);
+        if (profile_idp === undefined) {
+            logger.error(ERR_IDP_NOT_FOUND);
+            return { success: false, error: ERR_IDP_NOT_FOUND_SHORT };
+        }
+        const key = attrKey(dev_addr, uuid, desc);
+        this.#monitor.start(TRACE_OP.READ, dev_addr, key, () => {
+            emitCallback(this.#callbacks, "descReadComplete", { dev_addr, chara: uuid, desc, status: STATUS.TIMEOUT });
+        }, signal);
+        const success = this.#ble.mstReadDescriptor(profile_idp, uuid, desc);
+        this.#monitor.issued(TRACE_OP.READ, dev_addr, success, 0, key);
+        return {
+            success,
+            error: success ? null : ERR_DESC_READ_FAIL,
+        };
+    }
+}
+
+class On {
+    #callbacks;
+
+    constructor(callbacks) {
+        this.#callbacks = callbacks;
+    }
+    /**
+     * Registers a callback for characteristic read completion.
+     * @param {Function} callback - Called with { dev_addr, profile, uuid, status }, status is STATUS.TIMEOUT if the watchdog expired.
+     */
+    charaReadComplete(callback) {
+        this.#callbacks.charaReadComplete = callback;
+    }
+    /**
+     * Registers a callback for characteristic values that arrive after a read.
+     * @param {Function} callback - Called with { dev_addr, profile, uuid, data, length }, data is a hex string.
+     */
+    charaValueArrived(callback) {
+        this.#callbacks.charaValueArrived = callback;
+    }
+    /**
+     * Registers a callback for characteristic write completion.
+     * @param {Function} callback - Called with { dev_addr, profile, uuid, status }, status is STATUS.TIMEOUT if the watchdog expired.
+     */
+    charaWriteComplete(callback) {
+        this.#callbacks.charaWriteComplete = callback;
+    }
+    /**
+     * Registers a callback for descriptor read completion.
+     * @param {Function} callback - Called with { dev_addr, profile, chara, desc, status }, status is STATUS.TIMEOUT if the watchdog expired.
+     */
+    descReadComplete(callback) {
+        this.#callbacks.descReadComplete = callback;
+    }
+    /**
+     * Registers a callback for descriptor values that arrive after a read.
+     * @param {Function} callback - Called with { dev_addr, profile, chara, desc, data, length }, data is a hex string.
+     */
+    descValueArrived(callback) {
+        this.#callbacks.descValueArrived = callback;
+    }
+    /**
+     * Registers a callback for descriptor write completion.
+     * @param {Function} callback - Called with { dev_addr, profile, chara, desc, status }, status is STATUS.TIMEOUT if the watchdog expired.
+     */
+    descWriteComplete(callback) {
+        this.#callbacks.descWriteComplete = callback;
+    }
+    /**
+     * Registers a callback for characteristic notifications.
+     * @param {Function} callback - Called with { dev_addr, profile, uuid, data, length }, data is a hex string.
+     */
+    charaNotification(callback) {
+        this.#callbacks.charaNotification = callback;
+    }
+}
+
+/* MASTER */
+
+/**
+ * BLEMaster: the page-level facade over scanning, connections, GATT and diagnostics.
+ */
+
+const BUILT_IN = {}; // the opt-in features the bundle's entry ships, see provideFeatures
+
+/**
+ * Builds opt-in features into every BLEMaster of a bundle, so options.pool: true (or an options object) and ble.scene()
+ * find their implementation. Called by the entries that ship them (index.js), the core bundle ships none.
+ * @param {Object} features - { power: PowerBudget, pool: ConnectionPool, known: KnownDevices, admission: ConnectScheduler,
+ * sight: connectOnSight, scene: runScene }.
+ */
+function provideFeatures(features) {
+    Object.assign(BUILT_IN, features);
+}
+
+/**
+ * Resolves an opt-in feature option: the implementation itself (pool: ConnectionPool) enables it with its defaults,
+ * { use: ConnectionPool, ...options } with options, true or an options object use the built-in implementation.
+ * @returns {Array|null} Returns [implementation, options], or null if the feature is off or not available.
+ */
+function featureOption(name, option) {
+    if (!option) return null;
+    if (typeof option === "function") return [option, {}];
+    const implementation = (option !== true && option.use) || BUILT_IN[name];
+    if (!implementation) {
+        logger.error(ERR_FEATURE_MISSING + `, options.${name} ignored`);
+        return null;
+    }
+    if (option === true) return [implementation, {}];
+    const { use, ...feature_options } = option;
+    return [implementation, feature_options];
+}
+
+class BLEMaster {
+    #registry;
+    #monitor;
+    #scanner;
+    #connections;
+    #profiles;
+    #power = null;
+    #pool = null;
+    #known = null;
+    #admission = null;
+    #sight;     // startScan's options.connect
+    #scene;
+    #clock;
+    #taps = new Set(); // the library's own listeners on the ble.on callbacks
+
+    /**
+     * @type {Write} A device writer.
+     */
+    write;
+
+    /**
+     * @type {Read} A device reader.
+     */
+    read;
+
+    /**
+     * @type {On} Read, write and notification callbacks.
+     */
+    on;
+
+    /**
+     * Creates a new BLE Master instance.
+     * @param {Object} [options={}] - Optional parameters.
+     * @param {string} [options.registry="object"] - The device registry backend. "object" keeps a plain object per device,
+     * "compact" stores scan data in typed-array columns and materializes device objects only when requested (recommended for 500+ advertising devices).
+     * @param {number} [options.capacity=64] - The number of preallocated slots for the "compact" registry. Grows automatically when exceeded.
+     * @param {number} [options.trace] - Enables the binary trace recorder with room for this many operation records (16 bytes each).
+     * @param {Object|boolean} [options.watchdog] - Deadlines in millis for outstanding backend operations, false disables the watchdog.
+     * An expired operation is failed with STATUS.TIMEOUT. Defaults: { connect: 10000, prepare: 10000, read: 5000, write: 5000, recycle: false }.
+     * With recycle: true an expired prepare/read/write also stops the device (destroys the profile and disconnects).
+     * @param {Object} [options.transport] - An object implementing the hmBle mst* surface. Defaults to @zos/ble, use it to run
+     * against a simulator or an instrumented backend.
+     * @param {Object} [options.clock] - The time source { now, setTimeout, clearTimeout }. Defaults to the system timers.
+     * @param {Object|boolean} [options.power] - Meters radio use against an energy budget and degrades gracefully when it runs low,
+     * a spent budget closes every link and refuses connects and reads/writes. One unit is one second of scanning. true for the defaults: { budget: 600, window: 3600000,
+     * costs: { scan: 1, link: 0.05, op: 0.02 }, saving_at: 0.7, critical_at: 0.9, check_interval: 10000, scan_period: 10000,
+     * scan_duty: [1, 0.4, 0.1], poll_factor: [1, 2, 4], idle_close: [0, 60000, 15000], on_level }, the arrays are per POWER_LEVEL.
+     * @param {Object|boolean} [options.pool] - Keeps links open between commands within a pool. true for the defaults: { max: 4, idle: 30000 }.
+     * A link without reads, writes or notifications for idle millis is stopped, a connect to a new device when max links
+     * (connects in flight included) are held stops the least recently used one.
+     * @param {Object|boolean} [options.known] - Remembers every device it connects to (name, service UUIDs, vendor id), so a later
+     * launch can connect to it without scanning. true keeps them in memory, { storage, key: "eble_known", max: 32 } persists them
+     * with storage.getItem / setItem (localStorage from @zos/storage).
+     * @param {Object|boolean} [options.admission] - Queues connect() calls and lets a few reach the backend at once. true for the
+     * defaults: { concurrency: 2, retries: 2, retry_delay: 500, order: "rssi" }. The queue is ordered by connect's options.priority,
+     * then first attempts before retries, then the strongest RSSI ("rssi") or call order ("fifo"). A failed attempt is queued
+     * again after retry_delay millis, the callback only sees the last one.
+     * power, pool, known and admission also take their implementation, alone (pool: ConnectionPool) or with options
+     * ({ use: ConnectionPool, max: 3 }). true and plain options objects need a bundle that builds them in (ble-master.js,
+     * ble-master-lite.js), dist/ble-master-core.js builds in none.
+     * @param {Function} [options.sight] - connectOnSight, the implementation of startScan's options.connect. Built in like power.
+     * @param {Function} [options.scene] - runScene, the implementation of scene(). Built in like power.
+     */
+    constructor(options = {}){
+        let ble = options.transport || hmBle;
+        const clock = options.clock || SYSTEM_CLOCK;
+        const callbacks = { taps: this.#taps };
+        this.#clock = clock;
+        this.#sight = options.sight || BUILT_IN.sight || null;
+        this.#scene = options.scene || BUILT_IN.scene || null;
+        const power = featureOption("power", options.power);
+        if (power) {
+            const [PowerFeature, power_options] = power;
+            this.#power = new PowerFeature(power_options, clock);
+            ble = this.#power.wrap(ble, (profile) => this.#registry.findByProfile(profile), (dev_addr) => this.stop(dev_addr));
+        }
+        const pool = featureOption("pool", options.pool);
+        if (pool) {
+            const [PoolFeature, pool_options] = pool;
+            this.#pool = new PoolFeature(pool_options, clock);
+            ble = this.#pool.wrap(ble, (profile) => this.#registry.findByProfile(profile), (dev_addr) => this.stop(dev_addr));
+        }
+        this.#registry = createRegistry(options, clock);
+        this.#monitor = createMonitor(options, clock);
+        this.#monitor.onRecycle = (dev_addr) => this.stop(dev_addr);
+        this.#scanner = new Scanner(ble, clock, this.#registry, this.#monitor);
+        this.#connections = new Connections(ble, this.#registry, this.#monitor);
+        if (this.#pool) this.#connections.onAbandoned = (dev_addr) => this.#pool.abandon(dev_addr);
+        const known = featureOption("known", options.known);
+        if (known) {
+            const [KnownFeature, known_options] = known;
+            this.#known = new KnownFeature(known_options, clock);
+            this.#connections.onConnected = (dev_addr) => this.#known.connected(dev_addr, this.#registry.get(dev_addr));
+        }
+        const admission = featureOption("admission", options.admission);
+        if (admission) {
+            const [AdmissionFeature, admission_options] = admission;
+            this.#admission = new AdmissionFeature(admission_options, clock,
+                (dev_addr, callback, connect_options) => this.#connections.connect(dev_addr, callback, connect_options),
+                (dev_addr) => {
+                    const device = this.#registry.get(dev_addr);
+                    return device && device.last_seen !== undefined ? device.rssi : undefined;
+                });
+        }
+        this.#profiles = new Profiles(ble, clock, this.#registry, this.#monitor, callbacks, this.#connections, this.#known);
+        this.write = new Write(ble, this.#registry, this.#monitor, callbacks);
+        this.read = new Read(ble, this.#registry, this.#monitor, callbacks);
+        this.on = new On(callbacks);
+    }
+    /**
+     * @type {TraceRecorder|null} The operation trace recorder, or null if tracing was not enabled with options.trace.
+     */
+    get trace() {
+        return this.#monitor.trace;
+    }
+    /**
+     * @type {PowerBudget|null} The power budget, or null if it was not enabled with options.power.
+     */
+    get power() {
+        return this.#power;
+    }
+    /**
+     * @type {ConnectionPool|null} The connection pool, or null if it was not enabled with options.pool.
+     */
+    get pool() {
+        return this.#pool;
+    }
+    /**
+     * @type {KnownDevices|null} The known-devices store, or null if it was not enabled with options.known.
+     */
+    get known() {
+        return this.#known;
+    }
+    /**
+     * @type {ConnectScheduler|null} The connection admission queue, or null if it was not enabled with options.admission.
+     */
+    get admission() {
+        return this.#admission;
+    }
+    /**
+     * @type {Get} A device information getter.
+     */
+    get get() {
+        return new Get(this.#registry, this.#monitor);
+    }
+    /**
+     * Resets all counters and latency histograms reported by get.stats().
+     */
+    resetStats() {
+        this.#monitor.reset();
+    }
+    /**
+     * Sets the library-wide log level. Messages above this level are neither formatted nor printed.
+     * @param {number} level - One of LOG_LEVEL.NONE, ERROR, WARN (default), INFO or DEBUG.
+     */
+    static setLogLevel(level) {
+        logger.level = level;
+    }
+    /**
+     * Starts scanning for devices.
+     * @param {Function} response_callback - The callback function that will be called with the scan result for each device.
+     * @param {Object} [options={}] - Optional parameters for the scan.
+     * @param {number} [options.duration] - The duration of the scan in milliseconds. If specified, the scan will automatically stop after this duration.
+     * @param {Function} [options.on_duration] - A callback function that will be called when the scan stops due to reaching the specified duration.
+     * @param {CancelToken} [options.signal] - Stops the scan when cancelled. Any AbortSignal-like object works.
+     * @param {Function} [options.filter] - Called with every decoded scan result, results it returns false for are dropped
+     * before they reach the registry and the response_callback.
+     * @param {Object} [options.connect] - Connects to targets the moment their first advert arrives (after options.filter):
+     * { targets: MAC or [MAC], profile, stop_scan: true, on_ready }. With a profile object (or a function MAC > profile object)
+     * the profile is built right after the connect, profiles are built one at a time. stop_scan: true stops the scan once every
+     * target was sighted, false keeps it running. on_ready is called once per target with { dev_addr, connected, connect_id, status },
+     * status being the startListener status (undefined without a profile), or { ..., error } if the profile was rejected.
+     * A target that is already connected is reported right away. options.signal applies to the connects and profiles too.
+     * @returns {boolean} Returns true if the call to start the scan succeeded, false if it failed.
+     */
+    startScan(response_callback, options = {}) {
+        if (options.connect) {
+            if (!this.#sight) {
+                logger.error(ERR_FEATURE_MISSING + ", options.connect needs options.sight");
+                return false;
+            }
+            response_callback = this.#sight(this, response_callback, options);
+            if (response_callback === null) return false;
+        }
+        return this.#scanner.startScan(response_callback, options);
+    }
+    /**
+     * Stops scanning for devices.
+     * @returns {boolean} Returns true if the call to stop the scan succeeded, false if it failed.
+     */
+    stopScan() {
+        return this.#scanner.stopScan();
+    }
+    /**
+     * Connects to a device.
+     * @param {string} dev_addr - The MAC address of the device to connect to.
+     * @param {Function} response_callback - The callback function that will be called with the result of the connection attempt.
+     * @param {Object} [options={}] - Optional parameters.
+     * @param {CancelToken} [options.signal] - Cancelling it abandons a pending connection attempt (without calling back)
+     * or stops the device once connected.
+     * @param {number} [options.priority=0] - With options.admission, higher priorities reach the backend first.
+     * @returns {boolean} Returns true if the call to connect to the device succeeded (with options.admission: was queued), false if it failed.
+     */
+    connect(dev_addr, response_callback, options = {}) {
+        if (this.#admission) return this.#admission.connect(dev_addr, response_callback, options);
+        return this.#connections.connect(dev_addr, response_callback, options);
+    }
+    /**
+     * Runs a scene: writes to several devices at once under one deadline, e.g. every lamp off when leaving home.
+     * The devices run in parallel, each one is connected (through options.admission if enabled) and gets its profile
+     * if it has none yet, then its writes are issued in order, each after the previous one completed.
+     * @param {Object[]} commands - { dev_addr, uuid, data } for a characteristic or { dev_addr, chara, desc, data } for
+     * a descriptor write, optionally with the device's profile object. data as for write.characteristic.
+     * @param {Function} response_callback - Called once with { done, elapsed, devices }. done is true if every device
+     * succeeded, devices maps each MAC to { result: "ok" | "failed" | "timeout", step, writes, error }: step is where it
+     * ended ("connect", "prepare", "write" or "done"), writes the number of completed writes, error the connect result,
+     * the backend status or the error message of the call that failed.
+     * @param {Object} [options={}] - Optional parameters.
+     * @param {Object|Function} [options.profile] - The profile object (or a function MAC > profile object) for devices
+     * without a profile, modified with modifyProfileObject.
+     * @param {number} [options.timeout=10000] - The deadline in millis for the whole scene, the devices not done by then time out.
+     * @param {boolean} [options.stop=false] - Stops every device once its writes completed.
+     * @param {number} [options.priority] - The connects' priority with options.admission.
+     * @param {CancelToken} [options.signal] - Cancelling it abandons the scene without calling back.
+     * A device that fails or times out is stopped if the scene connected it.
+     * @returns {boolean} Returns true if the scene started, false if a command is invalid or the signal is already cancelled.
+     */
+    scene(commands, response_callback, options = {}) {
+        if (!this.#scene) {
+            logger.error(ERR_FEATURE_MISSING + ", scene() needs options.scene");
+            return false;
+        }
+        return this.#scene(this, this.#clock, this.#taps, commands, response_callback, options);
+    }
+    /**
+     * Disconnects from a device.
+     * @param {string} dev_addr - The MAC address of the device to disconnect from.
+     * @returns {boolean} Returns true if the call to disconnect from the device succeeded, false if it failed or if the device was not connected.
+     */
+    disconnect(dev_addr) {
+        return this.#connections.disconnect(dev_addr);
+    }
+    /**
+     * Pairs with a device.
+     * @param {string} dev_addr - The MAC address of the device to pair with.
+     * @returns {boolean} Returns true if the call to pair with the device succeeded, false if it failed or if the device was not connected.
+     */
+    pair(dev_addr) {
+        return this.#connections.pair(dev_addr);
+    }
+    /**
+     * Starts listening for profile preparation events and builds a profile for interaction with a device.
+     * @param {Object} profile_object - The profile object that describes how to interact with the device.
+     * @param {Function} response_callback - The callback function that will be called when a profile preparation event occurs.
+     * Receives the backend status (0 = OK), STATUS.TIMEOUT when the backend did not answer in time or STATUS.REJECTED
+     * when it refused to build the profile.
+     * @param {Object} [options={}] - Optional parameters.
+     * @param {CancelToken} [options.signal] - Cancelling it abandons the profile preparation (without calling back)
+     * or stops the device once the profile is ready.
+     * @returns {Object} Returns an object with a 'success' property indicating whether the call succeeded and an 'error' property containing an error message if the call failed.
+     */
+    startListener(profile_object, response_callback, options = {}) {
+        return this.#profiles.startListener(profile_object, response_callback, options);
+    }
+    /**
+     * Temporary replacement for the generateProfileObject function. 
+     * Modifies a profile object with required values for a device. Works for scanned devices, connected ones and,
+     * with options.known, for known devices that were neither scanned nor connected in this launch.
+     * @param {string} dev_addr - The MAC address of the device.
+     * @param {Object} profile_object - The profile object to be modified.
+     * @returns {Object|null} Returns the modified profile object for the device, or null if the device was not found.
+     */
+    modifyProfileObject(dev_addr, profile_object) {
+        return this.#profiles.modifyProfileObject(dev_addr, profile_object);
+    }
+    /**
+     * @warning [NOT IMPLEMENTED] Generates a generic profile object for a device.
+     * @param {string} dev_addr - The MAC address of the device.
+     * @returns {Object|null} Returns a generic profile object for the device, or null if the device was not found.
+     */
+    generateProfileObject(dev_addr) {
+        return this.#profiles.generateProfileObject(dev_addr);
+    }
+    /**
+     * Stops all interactions with a device.
+     * @param {string} dev_addr - The MAC address of the device.
+     */
+    stop(dev_addr) {
+        this.#connections.stop(dev_addr);
+    }
+}
+
+/* MASTER CORE */
+
+/**
+ * Entry of the core bundle (dist/ble-master-core.js): BLEMaster with scanning, connections and GATT only. The opt-in
+ * features (power, pool, known, admission, startScan's options.connect, scene), BLESession, the background engine and
+ * the wire format are not part of it, pass an implementation to enable one (e.g. pool: ConnectionPool).
+ */
+
+export { LOG_LEVEL };
+export { STATUS, TRACE_OP, CancelToken };
+export { ab2mac, mac2ab, ab2str_stripped, data2ab, str2ab_with_len };
+export default BLEMaster;
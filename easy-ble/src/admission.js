@@ -0,0 +1,168 @@
+/**
+ * Connection admission: connect() calls wait in a priority queue and reach the backend a few at a time, failed attempts
+ * are retried behind the first attempts of the same priority. Firing every connect at once overloads the backend,
+ * one at a time leaves it idle while a slow device answers.
+ */
+import { SYSTEM_CLOCK, ERR_INVALID_MAC, CONNECT_STATUS_OK, CONNECT_STATUS_FAILED } from './core.js'
+import { logger } from './log.js'
+import { normalizeMac } from './codecs.js'
+
+const ADMISSION_ORDER_RSSI = "rssi";
+const ADMISSION_NO_RSSI = -128; // devices that were never scanned go last among equals
+
+const DEFAULT_ADMISSION = {
+    concurrency: 2,     // connects the backend works on at once
+    retries: 2,         // extra attempts after a failed connect (connected: 1, a watchdog timeout included)
+    retry_delay: 500,   // millis before a failed attempt is queued again
+    order: ADMISSION_ORDER_RSSI, // among equal priorities: "rssi" strongest first, "fifo" in call order
+};
+
+/**
+ * The admission queue of one BLEMaster. Created by new BLEMaster({ admission }), read through ble.admission.
+ */
+export class ConnectScheduler {
+    #clock;
+    #options;
+    #connect;       // (dev_addr, callback, options) > boolean, Connections.connect
+    #rssi;          // MAC > RSSI of its last advert, or undefined
+    #queue = [];    // requests waiting for a slot, unsorted, picked by #next()
+    #in_flight = 0;
+    #seq = 0;
+    #totals = { admitted: 0, retries: 0, connected: 0, failed: 0 };
+
+    /**
+     * @param {Object} [options={}] - See BLEMaster's options.admission.
+     * @param {Object} [clock] - { now, setTimeout, clearTimeout }.
+     * @param {Function} connect - Issues a connect to the backend (Connections.connect).
+     * @param {Function} rssi - MAC > RSSI of its last advert.
+     */
+    constructor(options = {}, clock = SYSTEM_CLOCK, connect, rssi) {
+        this.#clock = clock;
+        this.#options = { ...DEFAULT_ADMISSION, ...options };
+        this.#connect = connect;
+        this.#rssi = rssi;
+    }
+    /**
+     * @type {number} The number of connects waiting for a slot (retries waiting for their delay excluded).
+     */
+    get queued() {
+        return this.#queue.length;
+    }
+    /**
+     * @type {number} The number of connects the backend is working on.
+     */
+    get in_flight() {
+        return this.#in_flight;
+    }
+    /**
+     * @returns {Object} Returns { queued, in_flight, admitted, retries, connected, failed }, the totals count since creation.
+     */
+    report() {
+        return { queued: this.#queue.length, in_flight: this.#in_flight, ...this.#totals };
+    }
+    /**
+     * Queues a connect. See BLEMaster.connect, options.priority orders the queue (higher first, default 0).
+     * @returns {boolean} Returns true if the connect was queued, false if the MAC address is invalid or the signal is already cancelled.
+     */
+    connect(dev_addr, response_callback, options = {}) {
+        const mac = normalizeMac(dev_addr);
+        if (mac === null) {
+            logger.error(ERR_INVALID_MAC);
+            return false;
+        }
+        const signal = options.signal;
+        if (signal && signal.aborted) return false;
+        const request = { dev_addr: mac, callback: response_callback, options, priority: options.priority || 0, attempt: 0, seq: ++this.#seq, drop: null };
+        this.#enqueue(request);
+        this.#pump();
+        return true;
+    }
+
+    #enqueue(request) {
+        const signal = request.options.signal;
+        if (signal) { // a cancelled request leaves the queue without calling back
+            request.drop = () => {
+                const index = this.#queue.indexOf(request);
+                if (index >= 0) this.#queue.splice(index, 1);
+            };
+            signal.addEventListener("abort", request.drop);
+        }
+        this.#queue.push(request);
+    }
+    #dequeue(request) {
+        const index = this.#queue.indexOf(request);
+        if (index >= 0) this.#queue.splice(index, 1);
+        if (request.drop) request.options.signal.removeEventListener("abort", request.drop);
+        request.drop = null;
+    }
+    #next() { // priority, then first attempts before retries, then RSSI (or call order)
+        const by_rssi = this.#options.order === ADMISSION_ORDER_RSSI;
+        let best = null, best_rssi = 0;
+        for (const request of this.#queue) {
+            const rssi = by_rssi ? this.#rssiOf(request.dev_addr) : 0;
+            if (best === null || request.priority > best.priority
+                || (request.priority === best.priority && (request.attempt < best.attempt
+                || (request.attempt === best.attempt && (rssi > best_rssi || (rssi === best_rssi && request.seq < best.seq)))))) {
+                best = request;
+                best_rssi = rssi;
+            }
+        }
+        return best;
+    }
+    #rssiOf(dev_addr) {
+        const rssi = this.#rssi(dev_addr);
+        return typeof rssi === "number" ? rssi : ADMISSION_NO_RSSI;
+    }
+    #pump() {
+        while (this.#in_flight < this.#options.concurrency && this.#queue.length > 0) {
+            const request = this.#next();
+            this.#dequeue(request);
+            this.#admit(request);
+        }
+    }
+    #admit(request) {
+        request.attempt++;
+        this.#in_flight++;
+        this.#totals.admitted++;
+        const signal = request.options.signal;
+        let settled = false; // the first result frees the slot, later ones (disconnects) go straight to the caller
+        const settle = () => {
+            if (settled) return false;
+            settled = true;
+            if (signal) signal.removeEventListener("abort", settle);
+            this.#in_flight--;
+            this.#clock.setTimeout(() => this.#pump(), 0); // out of the backend callback
+            return true;
+        };
+        if (signal) signal.addEventListener("abort", settle); // a cancelled connect never calls back, its slot is freed here
+        const success = this.#connect(request.dev_addr, (result) => {
+            if (!settle()) {
+                request.callback(result);
+                return;
+            }
+            if (result.connected === CONNECT_STATUS_FAILED && this.#retry(request)) return;
+            this.#totals[result.connected === CONNECT_STATUS_OK ? "connected" : "failed"]++;
+            request.callback(result);
+        }, request.options);
+        if (!success) {
+            settle();
+            if (this.#retry(request)) return;
+            this.#totals.failed++;
+            request.callback({ dev_addr: request.dev_addr, connected: CONNECT_STATUS_FAILED });
+        }
+    }
+    #retry(request) {
+        const signal = request.options.signal;
+        if (request.attempt > this.#options.retries || (signal && signal.aborted)) return false;
+        this.#totals.retries++;
+        logger.info(() => `eBLE: Connect to ${request.dev_addr} failed, attempt ${request.attempt + 1} in ${this.#options.retry_delay}ms`);
+        const timer = this.#clock.setTimeout(() => {
+            if (signal) signal.removeEventListener("abort", cancel);
+            this.#enqueue(request);
+            this.#pump();
+        }, this.#options.retry_delay);
+        const cancel = () => this.#clock.clearTimeout(timer);
+        if (signal) signal.addEventListener("abort", cancel);
+        return true;
+    }
+}
@@ -0,0 +1,282 @@
+/**
+ * Background scanning: ScanEngine runs in an app service and keeps scanning while the screen is off, pages keep a
+ * DeviceMirror that is brought up to date with the engine's batched diffs.
+ */
+import * as hmBle from '@zos/ble'
+import { SYSTEM_CLOCK, DIFF_STRIDE, noop } from './core.js'
+import { logger } from './log.js'
+import { createRegistry, Get } from './registry.js'
+import { createMonitor } from './diagnostics.js'
+import { Scanner } from './scan.js'
+
+const DEFAULT_BATCH_INTERVAL        = 1000;  // millis between two diffs
+const DEFAULT_MAX_BATCH             = 100;   // devices per diff, the rest waits for the next one
+const DEFAULT_TTL                   = 30000; // millis without an advert before a device is removed
+const DEFAULT_RSSI_DELTA            = 4;     // dBm, smaller RSSI changes are not worth a diff entry
+
+/**
+ * Scans, filters and keeps the device registry inside an app service, and hands out compact registry diffs.
+ * A diff is a plain JSON-safe object, post it to the page over whatever channel the app uses:
+ * { seq, time, full, upsert: [dev_addr, dev_name, rssi, age, vendor_id, vendor_data, service_uuid_array, service_data_array, ...], remove: [dev_addr, ...] }
+ * age is the number of millis between the device's last advert and diff.time. A full diff (snapshot()) replaces the page's list.
+ */
+export class ScanEngine {
+    #registry;
+    #monitor;
+    #scanner;
+    #clock;
+    #deliver;
+    #filter;
+    #batch_interval;
+    #max_batch;
+    #ttl;
+    #rssi_delta;
+    #seq = 0;
+    #known = new Map();  // MAC > { rssi, vendor_data, last_seen }, the state the pages were last told about (or will be with the next diff)
+    #dirty = new Set();  // MACs to upsert with the next diff
+    #timer = null;
+    #running = false;
+    #abort = null;       // dispose of the start signal's listener
+
+    /**
+     * Creates a new scan engine.
+     * @param {Object} [options={}] - Optional parameters. registry, capacity, trace, transport and clock as for BLEMaster.
+     * @param {Function} [options.deliver] - Called with every diff, e.g. to post it to the page.
+     * @param {Function|Object} [options.filter] - Keeps only matching devices: a function called with each scan result, or
+     * { dev_name_prefix, service_uuid, vendor_id, min_rssi } (every given field must match).
+     * @param {number} [options.batch_interval=1000] - Millis between two diffs. Nothing is delivered while nothing changed.
+     * @param {number} [options.max_batch=100] - Devices per diff, the rest waits for the next one.
+     * @param {number} [options.ttl=30000] - Millis without an advert before a device is removed from the pages' list.
+     * @param {number} [options.rssi_delta=4] - RSSI changes below this many dBm do not put a device into the next diff.
+     */
+    constructor(options = {}) {
+        this.#clock = options.clock || SYSTEM_CLOCK;
+        this.#registry = createRegistry(options, this.#clock);
+        this.#monitor = createMonitor(options, this.#clock);
+        this.#scanner = new Scanner(options.transport || hmBle, this.#clock, this.#registry, this.#monitor);
+        this.#deliver = options.deliver || noop;
+        this.#filter = scanFilter(options.filter);
+        this.#batch_interval = options.batch_interval || DEFAULT_BATCH_INTERVAL;
+        this.#max_batch = options.max_batch || DEFAULT_MAX_BATCH;
+        this.#ttl = options.ttl || DEFAULT_TTL;
+        this.#rssi_delta = options.rssi_delta === undefined ? DEFAULT_RSSI_DELTA : options.rssi_delta;
+    }
+    /**
+     * @type {Get} The engine's own device registry.
+     */
+    get get() {
+        return new Get(this.#registry, this.#monitor);
+    }
+    /**
+     * @type {boolean} True between start() and stop().
+     */
+    get running() {
+        return this.#running;
+    }
+    /**
+     * Starts scanning and delivering diffs.
+     * @param {Object} [options={}] - { signal }, cancelling the token stops the engine.
+     * @returns {boolean} Returns true if the scan started, false if it failed or the engine is already running.
+     */
+    start(options = {}) {
+        if (this.#running) return false;
+        const signal = options.signal;
+        const success = this.#scanner.startScan((scan_result) => this.#seen(scan_result), { filter: this.#filter, signal });
+        if (!success) return false;
+        this.#running = true;
+        if (signal) {
+            const abort = () => this.stop();
+            signal.addEventListener("abort", abort);
+            this.#abort = () => signal.removeEventListener("abort", abort);
+        }
+        this.#schedule();
+        return true;
+    }
+    /**
+     * Stops scanning. Pending changes are delivered right away.
+     */
+    stop() {
+        if (!this.#running) return;
+        this.#running = false;
+        if (this.#abort) this.#abort();
+        this.#abort = null;
+        this.#scanner.stopScan();
+        this.#clock.clearTimeout(this.#timer);
+        this.#timer = null;
+        this.flush();
+    }
+    /**
+     * Delivers the pending changes now instead of at the end of the batch interval.
+     * @returns {Object|null} Returns the delivered diff, or null if nothing changed.
+     */
+    flush() {
+        const now = this.#clock.now();
+        const remove = [];
+        for (const [dev_addr, known] of this.#known) {
+            if (now - known.last_seen < this.#ttl) continue;
+            this.#known.delete(dev_addr);
+            this.#dirty.delete(dev_addr);
+            this.#registry.remove(dev_addr); // rotating MACs would grow the registry forever otherwise
+            remove.push(dev_addr);
+        }
+        const upsert = [];
+        for (const dev_addr of this.#dirty) {
+            if (upsert.length === this.#max_batch * DIFF_STRIDE) break;
+            this.#dirty.delete(dev_addr);
+            this.#pack(upsert, dev_addr, now);
+        }
+        if (!upsert.length && !remove.length) return null;
+        const diff = { seq: ++this.#seq, time: now, full: false, upsert, remove };
+        this.#deliver(diff);
+        return diff;
+    }
+    /**
+     * Builds a full diff of every device the engine currently keeps, for a page that just opened or missed a diff.
+     * It is returned, not delivered, and carries the seq of the last delivered diff.
+     * @returns {Object} Returns { seq, time, full: true, upsert, remove: [] }.
+     */
+    snapshot() {
+        const now = this.#clock.now();
+        const upsert = [];
+        for (const dev_addr of this.#known.keys()) this.#pack(upsert, dev_addr, now);
+        return { seq: this.#seq, time: now, full: true, upsert, remove: [] };
+    }
+    #seen(scan_result) { // decides whether the advert is news for the pages
+        const dev_addr = scan_result.dev_addr;
+        const now = this.#clock.now();
+        const known = this.#known.get(dev_addr);
+        if (known === undefined) {
+            this.#known.set(dev_addr, { rssi: scan_result.rssi, vendor_data: scan_result.vendor_data, last_seen: now });
+            this.#dirty.add(dev_addr);
+            return;
+        }
+        known.last_seen = now;
+        if (Math.abs(scan_result.rssi - known.rssi) >= this.#rssi_delta || scan_result.vendor_data !== known.vendor_data) {
+            known.rssi = scan_result.rssi;
+            known.vendor_data = scan_result.vendor_data;
+            this.#dirty.add(dev_addr);
+        }
+    }
+    #pack(upsert, dev_addr, now) {
+        const device = this.#registry.get(dev_addr);
+        if (!device) return;
+        upsert.push(dev_addr, device.dev_name, device.rssi, device.last_seen === undefined ? 0 : now - device.last_seen,
+            device.vendor_id, device.vendor_data, device.service_uuid_array, device.service_data_array);
+    }
+    #schedule() {
+        this.#timer = this.#clock.setTimeout(() => {
+            this.#timer = null;
+            if (!this.#running) return;
+            this.flush();
+            this.#schedule();
+        }, this.#batch_interval);
+    }
+}
+
+/**
+ * The page side of a ScanEngine: applies its diffs to a device list with the same shape as get.devices().
+ */
+export class DeviceMirror {
+    #devices = {};
+    #size = 0;
+    #seq = 0;
+    #on_change;
+
+    /**
+     * @param {Function} [on_change] - Called after every applied diff with { added, updated, removed } MAC arrays.
+     */
+    constructor(on_change) {
+        this.#on_change = on_change;
+    }
+    /**
+     * @type {number} The number of devices in the list.
+     */
+    get size() {
+        return this.#size;
+    }
+    /**
+     * @type {number} The seq of the last applied diff, 0 before the first one.
+     */
+    get seq() {
+        return this.#seq;
+    }
+    /**
+     * Applies a diff from ScanEngine.
+     * @param {Object} diff - A diff delivered by the engine, or its snapshot().
+     * @returns {boolean} Returns false if a diff is missing in between (or the diff is stale), ask the engine for a snapshot() then.
+     */
+    apply(diff) {
+        if (!diff.full && diff.seq !== this.#seq + 1) {
+            if (diff.seq > this.#seq) logger.warn("eBLE: Missed a scan diff, expected", this.#seq + 1, "got", diff.seq);
+            return false;
+        }
+        const previous = diff.full ? this.#devices : null; // a snapshot replaces the list, known devices keep their objects
+        if (previous) {
+            this.#devices = {};
+            this.#size = 0;
+        }
+        const added = [], updated = [], removed = [];
+        for (let i = 0; i < diff.upsert.length; i += DIFF_STRIDE) {
+            const dev_addr = diff.upsert[i];
+            const known = previous ? previous[dev_addr] : this.#devices[dev_addr];
+            let device = this.#devices[dev_addr];
+            if (!device) {
+                device = this.#devices[dev_addr] = known || {};
+                this.#size++;
+            }
+            (known ? updated : added).push(dev_addr);
+            device.dev_name = diff.upsert[i + 1];
+            device.rssi = diff.upsert[i + 2];
+            device.last_seen = diff.time - diff.upsert[i + 3];
+            device.vendor_id = diff.upsert[i + 4];
+            device.vendor_data = diff.upsert[i + 5];
+            device.service_uuid_array = diff.upsert[i + 6];
+            device.service_data_array = diff.upsert[i + 7];
+        }
+        for (const dev_addr of diff.remove) {
+            if (!this.#devices[dev_addr]) continue;
+            delete this.#devices[dev_addr];
+            this.#size--;
+            removed.push(dev_addr);
+        }
+        if (previous) {
+            for (const dev_addr in previous) {
+                if (!this.#devices[dev_addr]) removed.push(dev_addr);
+            }
+        }
+        this.#seq = diff.seq;
+        if (this.#on_change) this.#on_change({ added, updated, removed });
+        return true;
+    }
+    /**
+     * Returns all devices, same shape as get.devices(). rssi and last_seen are as of the device's last diff entry,
+     * small RSSI changes are not sent. A device stays in the list until the engine removes it (ttl).
+     * @returns {Object} Returns the device list by MAC address.
+     */
+    devices() {
+        return this.#devices;
+    }
+    /**
+     * Checks if a device is in the list.
+     * @param {string} dev_addr - The MAC address of the device.
+     * @returns {boolean} Returns true if the device is in the list.
+     */
+    hasDevice(dev_addr) {
+        return typeof dev_addr === "string" && this.#devices.hasOwnProperty(dev_addr.toLowerCase());
+    }
+}
+
+/**
+ * Turns the filter option into a predicate over decoded scan results, or undefined for no filter.
+ */
+function scanFilter(filter) {
+    if (!filter || typeof filter === "function") return filter || undefined;
+    const { dev_name_prefix, service_uuid, vendor_id, min_rssi } = filter;
+    const uuid = service_uuid === undefined ? undefined : service_uuid.toUpperCase();
+    return (scan_result) =>
+        (min_rssi === undefined || scan_result.rssi >= min_rssi) &&
+        (vendor_id === undefined || scan_result.vendor_id === vendor_id) &&
+        (dev_name_prefix === undefined || (typeof scan_result.dev_name === "string" && scan_result.dev_name.startsWith(dev_name_prefix))) &&
+        (uuid === undefined || (Array.isArray(scan_result.service_uuid_array) &&
+            scan_result.service_uuid_array.some((candidate) => typeof candidate === "string" && candidate.toUpperCase() === uuid)));
+}
@@ -0,0 +1,143 @@
+/**
+ * Connections: connect, disconnect, pair and stop, plus the devices owned by a cancel token.
+ */
+import {
+    ERR_INVALID_MAC, STATUS, TRACE_OP,
+    CONNECT_STATUS_OK, CONNECT_STATUS_FAILED, CONNECT_STATUS_DISCONNECTED,
+} from './core.js'
+import { logger } from './log.js'
+import { ab2mac, mac2ab, normalizeMac } from './codecs.js'
+
+export class Connections {
+    #ble;
+    #registry;
+    #monitor;
+    #connected = new Set(); // MACs with a live link
+    #owned = new Map(); // MAC > dispose, devices that are stopped when the token they were connected with is cancelled
+    /**
+     * @type {Function|null} Called with the MAC address of every device that connected successfully.
+     */
+    onConnected = null;
+    /**
+     * @type {Function|null} Called with the MAC address of a connect given up before the backend answered (watchdog expiry or cancel).
+     */
+    onAbandoned = null;
+
+    constructor(ble, registry, monitor) {
+        this.#ble = ble;
+        this.#registry = registry;
+        this.#monitor = monitor;
+    }
+    /**
+     * Connects to a device. See BLEMaster.connect.
+     */
+    connect(dev_addr, response_callback, options = {}) {
+        dev_addr = normalizeMac(dev_addr); // failsafe
+        if (dev_addr === null) {
+            logger.error(ERR_INVALID_MAC);
+            return false;
+        }
+        const signal = options.signal;
+        if (signal && signal.aborted) return false;
+        const dev_addr_ab = mac2ab(dev_addr);
+        let abandoned = false; // timed out or cancelled
+        const modified_callback = (result) => {
+            const result_str = {
+                ...result,
+                dev_addr: ab2mac(result.dev_addr) // dev_addr
+            };
+            if (abandoned) { // the request was already failed, release a late connection
+                if (result_str.connected === CONNECT_STATUS_OK) {
+                    this.#ble.mstDisconnect(result_str.connect_id);
+                }
+                return;
+            }
+            if (result_str.connected === CONNECT_STATUS_OK) {
+                this.#registry.link(result_str.dev_addr, result_str.connect_id);
+                this.#connected.add(result_str.dev_addr);
+                if (signal) this.own(signal, result_str.dev_addr);
+                if (this.onConnected) this.onConnected(result_str.dev_addr);
+            } else if (result_str.connected === CONNECT_STATUS_DISCONNECTED) {
+                this.#registry.unlink(result_str.dev_addr);
+                this.#connected.delete(result_str.dev_addr);
+                this.#disown(result_str.dev_addr);
+            }
+            if (result_str.connected === CONNECT_STATUS_DISCONNECTED) {
+                this.#monitor.event(TRACE_OP.DISCONNECT, result_str.dev_addr);
+            } else {
+                this.#monitor.completed(TRACE_OP.CONNECT_RESULT, result_str.dev_addr, result_str.connected);
+            }
+            response_callback(result_str);
+        }
+
+        this.#monitor.start(TRACE_OP.CONNECT, dev_addr, dev_addr, () => {
+            abandoned = true;
+            if (this.onAbandoned) this.onAbandoned(dev_addr);
+            response_callback({ dev_addr, connected: CONNECT_STATUS_FAILED, status: STATUS.TIMEOUT });
+        }, signal, () => {
+            abandoned = true;
+            if (this.onAbandoned) this.onAbandoned(dev_addr);
+        });
+        const success = this.#ble.mstConnect(dev_addr_ab, modified_callback);
+        this.#monitor.issued(TRACE_OP.CONNECT, dev_addr, success);
+        return success;
+    }
+    /**
+     * Disconnects from a device. See BLEMaster.disconnect.
+     */
+    disconnect(dev_addr) {
+        dev_addr = normalizeMac(dev_addr);
+        if (dev_addr !== null && this.#registry.isConnected(dev_addr)) {
+            const success = this.#ble.mstDisconnect(this.#registry.connectId(dev_addr));
+            this.#monitor.issued(TRACE_OP.DISCONNECT, dev_addr, success);
+            return success;
+        }
+    }
+    /**
+     * Pairs with a device. See BLEMaster.pair.
+     */
+    pair(dev_addr) {
+        dev_addr = normalizeMac(dev_addr);
+        if (dev_addr !== null && this.#registry.isConnected(dev_addr)) {
+            return this.#ble.mstPair(this.#registry.connectId(dev_addr));
+        }
+    }
+    /**
+     * Stops all interactions with a device. See BLEMaster.stop.
+     */
+    stop(dev_addr) {
+        dev_addr = normalizeMac(dev_addr);
+        if (dev_addr !== null && this.#registry.isConnected(dev_addr)) {
+            this.#connected.delete(dev_addr);
+            if (this.#connected.size === 0) this.#ble.mstOffAllCb(); // the backend callbacks are shared by every device
+            const profile_idp = this.#registry.profile(dev_addr);
+            if (profile_idp !== undefined) {
+                this.#ble.mstDestroyProfileInstance(profile_idp);
+                this.#registry.setProfile(dev_addr, undefined);
+            }
+            const success = this.#ble.mstDisconnect(this.#registry.connectId(dev_addr));
+            this.#registry.unlink(dev_addr);
+            this.#disown(dev_addr);
+            this.#monitor.issued(TRACE_OP.DISCONNECT, dev_addr, success);
+        }
+    }
+    /**
+     * Stops the device when the token is cancelled, until the device disconnects.
+     */
+    own(signal, dev_addr) {
+        this.#disown(dev_addr);
+        const stop = () => {
+            this.#owned.delete(dev_addr);
+            this.stop(dev_addr);
+        };
+        signal.addEventListener("abort", stop);
+        this.#owned.set(dev_addr, () => signal.removeEventListener("abort", stop));
+    }
+    #disown(dev_addr) {
+        const dispose = this.#owned.get(dev_addr);
+        if (dispose) {
+            this.#owned.delete(dev_addr);
+            dispose();
+        }
+    }
+}
@@ -0,0 +1,148 @@
+/**
+ * Shared constants, the default clock and the cancellation token. Every other module builds on this one.
+ */
+
+export const ERR_IDP_NOT_FOUND             = "eBLE: The ID pointer is not found for this MAC address. Please use startListener before trying to write char/desc!";
+export const ERR_IDP_NOT_FOUND_SHORT       = "eBLE: Profile ID pointer not found";
+export const ERR_NOT_IMPLEMENTED           = "eBLE: This feature is currently not implemented";
+export const ERR_PROFILE_CREATION_FAILED   = "eBLE: Profile creation failed";
+export const ERR_CHAR_READ_FAIL            = "eBLE: Failed to read characteristic";
+export const ERR_DESC_READ_FAIL            = "eBLE: Failed to read descriptor";
+export const ERR_CHAR_WRITE_FAIL           = "eBLE: Failed to write characteristic";
+export const ERR_DESC_WRITE_FAIL           = "eBLE: Failed to write descriptor";
+export const ERR_CANCELLED                 = "eBLE: Operation cancelled";
+export const ERR_INVALID_MAC               = "eBLE: Invalid MAC address, expected \"a1:b2:c3:d4:e5:f6\"";
+export const ERR_INVALID_DATA              = "eBLE: Invalid data, expected an ArrayBuffer, a typed array, an even-length hex string or a string of 8-bit characters";
+export const ERR_INVALID_PROFILE           = "eBLE: Invalid profile object";
+export const ERR_DETACHED                  = "eBLE: The page handle is detached";
+export const ERR_WIRE_MESSAGE              = "eBLE: Invalid wire message, expected a ScanEngine diff or { dev_addr, uuid, time, data }";
+export const ERR_WIRE_FRAME                = "eBLE: Invalid wire frame";
+export const ERR_FEATURE_MISSING           = "eBLE: This feature is not built into this bundle, pass its implementation (e.g. pool: ConnectionPool)";
+export const ERR_INVALID_SCENE             = "eBLE: Invalid scene, expected [{ dev_addr, uuid, data }] or [{ dev_addr, chara, desc, data }]";
+
+export const SHORT_DELAY = 50; // millis
+
+/**
+ * The default time source. Pass your own { now, setTimeout, clearTimeout } as options.clock to run on virtual time.
+ */
+export const SYSTEM_CLOCK = {
+    now: () => Date.now(),
+    setTimeout: (callback, millis) => setTimeout(callback, millis),
+    clearTimeout: (timer) => clearTimeout(timer),
+};
+
+// ScanEngine diff.upsert is flat, DIFF_STRIDE values per device in this order
+export const DIFF_FIELDS                   = ["dev_addr", "dev_name", "rssi", "age", "vendor_id", "vendor_data", "service_uuid_array", "service_data_array"];
+export const DIFF_STRIDE                   = DIFF_FIELDS.length;
+
+// mstConnect result.connected
+export const CONNECT_STATUS_OK             = 0;
+export const CONNECT_STATUS_FAILED         = 1;
+export const CONNECT_STATUS_DISCONNECTED   = 2;
+
+/**
+ * Library statuses, delivered in place of a backend status when the library ends an operation itself.
+ */
+export const STATUS = {
+    OK: 0,
+    TIMEOUT: -1, // the watchdog expired before the backend answered
+    CANCELLED: -2, // the operation's cancel token was cancelled
+    REJECTED: -3, // the backend call itself returned false
+};
+
+/**
+ * Trace record op codes.
+ * For SCAN_RESULT the record status holds the RSSI, for *_RESULT ops the backend status,
+ * for issued calls 0 = accepted by the backend and 1 = rejected. VALUE is the data of a read, which arrives
+ * before its READ_RESULT.
+ */
+export const TRACE_OP = {
+    SCAN_START: 1,
+    SCAN_RESULT: 2,
+    SCAN_STOP: 3,
+    CONNECT: 4,
+    CONNECT_RESULT: 5,
+    DISCONNECT: 6,
+    PREPARE: 7,
+    PREPARE_RESULT: 8,
+    READ: 9,
+    READ_RESULT: 10,
+    WRITE: 11,
+    WRITE_RESULT: 12,
+    NOTIFY: 13,
+    VALUE: 14,
+};
+
+// latency metrics
+export const METRIC_SCAN_FIRST_SEEN        = 0;
+export const METRIC_CONNECT                = 1;
+export const METRIC_PREPARE                = 2;
+export const METRIC_READ                   = 3;
+export const METRIC_WRITE                  = 4;
+export const STATUS_MALFORMED              = "malformed"; // a scan result without a usable dev_addr
+
+/**
+ * A cancellation token with the AbortSignal surface (aborted, reason, addEventListener("abort")).
+ * Pass the same token to everything a page starts and cancel it once in onDestroy.
+ */
+export class CancelToken {
+    #aborted = false;
+    #reason = undefined;
+    #listeners = new Set();
+
+    /**
+     * @type {boolean} True once cancel() was called.
+     */
+    get aborted() {
+        return this.#aborted;
+    }
+    /**
+     * @type {any} The reason passed to cancel().
+     */
+    get reason() {
+        return this.#reason;
+    }
+    /**
+     * Cancels every operation that was started with this token. Subsequent calls do nothing.
+     * @param {any} [reason] - An optional reason.
+     */
+    cancel(reason = ERR_CANCELLED) {
+        if (this.#aborted) return;
+        this.#aborted = true;
+        this.#reason = reason;
+        const listeners = Array.from(this.#listeners);
+        this.#listeners.clear();
+        for (const listener of listeners) listener();
+    }
+    addEventListener(type, listener) {
+        if (type === "abort" && !this.#aborted) this.#listeners.add(listener);
+    }
+    removeEventListener(type, listener) {
+        if (type === "abort") this.#listeners.delete(listener);
+    }
+}
+
+export function metricOf(op) {
+    switch (op) {
+        case TRACE_OP.CONNECT: case TRACE_OP.CONNECT_RESULT: return METRIC_CONNECT;
+        case TRACE_OP.PREPARE: case TRACE_OP.PREPARE_RESULT: return METRIC_PREPARE;
+        case TRACE_OP.READ: case TRACE_OP.READ_RESULT: return METRIC_READ;
+        case TRACE_OP.WRITE: case TRACE_OP.WRITE_RESULT: return METRIC_WRITE;
+        default: return -1;
+    }
+}
+
+export function noop() {}
+
+export function notify(callback, response) {
+    if (callback) callback(response);
+}
+
+export function emitCallback(callbacks, name, response) { // the ble.on callback, then the library's own listeners (scenes)
+    notify(callbacks[name], response);
+    if (callbacks.taps) for (const tap of callbacks.taps) tap(name, response);
+}
+
+export function attrKey(dev_addr, uuid, desc) { // pairs a read/write with its completion
+    return desc === undefined ? dev_addr + "/" + uuid.toUpperCase() : dev_addr + "/" + uuid.toUpperCase() + "/" + desc.toUpperCase();
+}
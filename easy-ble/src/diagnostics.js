@@ -0,0 +1,396 @@
+/**
+ * Diagnostics: the binary trace recorder, latency histograms, op/error counters and the operation watchdog.
+ * Builds without diagnostics swap this module for no-diagnostics.js.
+ */
+import { SYSTEM_CLOCK, STATUS, TRACE_OP, METRIC_CONNECT, noop, metricOf } from './core.js'
+import { logger } from './log.js'
+
+const TRACE_RECORD_WORDS            = 4;        // 16 bytes: time, op|slot, status, size
+const TRACE_NO_SLOT                 = 0xFFFFFF; // record without a device
+const METRIC_NAMES                  = ["scan_first_seen", "connect", "prepare", "read", "write"];
+const HISTOGRAM_BUCKETS             = 18; // log2 millis buckets: <1ms, <2ms, <4ms ... <65s, rest
+const STATUS_REJECTED               = "rejected"; // the backend call itself returned false
+const STATUS_EXPIRED                = "timeout";
+const STATUS_SUPERSEDED             = "superseded"; // dropped for a newer operation on the same key
+
+// watchdog deadlines per metric, millis. 0 = not watched
+const DEFAULT_TIMEOUTS              = [0, 10000, 10000, 5000, 5000];
+const WATCHDOG_TICK                 = 250; // millis
+const MAX_PENDING_PER_KEY           = 16; // operations waiting on one attribute, beyond that the oldest is given up
+const RESULT_OPS                    = [0, TRACE_OP.CONNECT_RESULT, TRACE_OP.PREPARE_RESULT, TRACE_OP.READ_RESULT, TRACE_OP.WRITE_RESULT];
+
+/**
+ * Creates the monitor for options.trace and options.watchdog (see the BLEMaster constructor).
+ */
+export function createMonitor(options, clock) {
+    const trace = options.trace > 0 ? new TraceRecorder(options.trace, clock) : null;
+    return new Monitor(trace, options.watchdog, clock);
+}
+
+/**
+ * Binary ring buffer of BLE operation records. Every record is 16 bytes:
+ * [0] millis since the trace started, [1] op code << 24 | device slot, [2] status (int32), [3] size in bytes.
+ * Recording never allocates once a device slot is known, so it is cheap enough to keep on in production.
+ * A slot is freed when the last record that names its device is overwritten, so the slot table never outgrows
+ * the buffer, however many MACs rotate through a crowded scan.
+ */
+export class TraceRecorder {
+    #capacity;
+    #words;
+    #status;            // Int32Array view over the same buffer, keeps the status sign
+    #head = 0;          // next record to write
+    #count = 0;
+    #clock;
+    #t0;
+    #slots = new Map(); // MAC > slot
+    #macs;              // slot > MAC
+    #refs;              // slot > live records naming it
+    #free;              // stack of free slots
+    #free_count;
+
+    constructor(capacity, clock = SYSTEM_CLOCK) {
+        this.#clock = clock;
+        this.#t0 = clock.now();
+        this.#capacity = capacity;
+        this.#words = new Uint32Array(capacity * TRACE_RECORD_WORDS);
+        this.#status = new Int32Array(this.#words.buffer);
+        this.#macs = new Array(capacity);
+        this.#refs = new Uint32Array(capacity); // a record names one device at most, capacity slots always suffice
+        this.#free = new Uint32Array(capacity);
+        this.#releaseAll();
+    }
+    /**
+     * @type {number} The number of records currently held (up to the capacity).
+     */
+    get size() {
+        return this.#count;
+    }
+    /**
+     * Appends a record, overwriting the oldest one when the buffer is full.
+     * @param {number} op - A TRACE_OP code.
+     * @param {string|null} dev_addr - The MAC address of the device, or null.
+     * @param {number} [status=0] - The status (see TRACE_OP).
+     * @param {number} [size=0] - The payload size in bytes.
+     */
+    record(op, dev_addr, status = 0, size = 0) {
+        const i = this.#head * TRACE_RECORD_WORDS;
+        if (this.#count === this.#capacity) this.#release(this.#words[i + 1] & TRACE_NO_SLOT); // the record it overwrites
+        this.#words[i] = this.#clock.now() - this.#t0;
+        this.#words[i + 1] = (op << 24 | this.#slotOf(dev_addr)) >>> 0;
+        this.#status[i + 2] = status;
+        this.#words[i + 3] = size;
+        this.#head = (this.#head + 1) % this.#capacity;
+        if (this.#count < this.#capacity) this.#count++;
+    }
+    /**
+     * Decodes the records, oldest first.
+     * @returns {Array<Object>} Returns an array of { time, op, dev_addr, status, size }, time is a clock timestamp in millis.
+     */
+    records() {
+        const records = [];
+        const first = (this.#head - this.#count + this.#capacity) % this.#capacity;
+        for (let n = 0; n < this.#count; n++) {
+            const i = ((first + n) % this.#capacity) * TRACE_RECORD_WORDS;
+            const slot = this.#words[i + 1] & TRACE_NO_SLOT;
+            records.push({
+                time: this.#t0 + this.#words[i],
+                op: this.#words[i + 1] >>> 24,
+                dev_addr: slot === TRACE_NO_SLOT ? null : this.#macs[slot],
+                status: this.#status[i + 2],
+                size: this.#words[i + 3],
+            });
+        }
+        return records;
+    }
+    /**
+     * Copies the raw records into a new buffer, oldest first. Use it to ship a trace off the device.
+     * @returns {{ buffer: ArrayBuffer, t0: number, macs: Array<string> }} Returns the records, the start timestamp and the slot > MAC table.
+     */
+    dump() {
+        const out = new Uint32Array(this.#count * TRACE_RECORD_WORDS);
+        const first = (this.#head - this.#count + this.#capacity) % this.#capacity;
+        const tail = Math.min(this.#count, this.#capacity - first) * TRACE_RECORD_WORDS;
+        out.set(this.#words.subarray(first * TRACE_RECORD_WORDS, first * TRACE_RECORD_WORDS + tail));
+        out.set(this.#words.subarray(0, out.length - tail), tail);
+        return { buffer: out.buffer, t0: this.#t0, macs: this.#macs.slice() };
+    }
+    /**
+     * @type {number} The number of device slots in use, at most the capacity.
+     */
+    get devices() {
+        return this.#slots.size;
+    }
+    /**
+     * Drops all records and their device slots.
+     */
+    clear() {
+        this.#head = 0;
+        this.#count = 0;
+        this.#t0 = this.#clock.now();
+        this.#releaseAll();
+    }
+    #slotOf(dev_addr) {
+        if (dev_addr === null || dev_addr === undefined) return TRACE_NO_SLOT;
+        let slot = this.#slots.get(dev_addr);
+        if (slot === undefined) {
+            slot = this.#free[--this.#free_count];
+            this.#slots.set(dev_addr, slot);
+            this.#macs[slot] = dev_addr;
+        }
+        this.#refs[slot]++;
+        return slot;
+    }
+    #release(slot) {
+        if (slot === TRACE_NO_SLOT || --this.#refs[slot] > 0) return;
+        this.#slots.delete(this.#macs[slot]);
+        this.#macs[slot] = undefined;
+        this.#free[this.#free_count++] = slot;
+    }
+    #releaseAll() {
+        this.#slots.clear();
+        this.#macs.fill(undefined);
+        this.#refs.fill(0);
+        for (let slot = 0; slot < this.#capacity; slot++) this.#free[slot] = this.#capacity - 1 - slot; // slot 0 is handed out first
+        this.#free_count = this.#capacity;
+    }
+}
+
+/**
+ * Fixed-memory latency histogram with log2 millisecond buckets.
+ */
+export class Histogram {
+    #buckets = new Uint32Array(HISTOGRAM_BUCKETS);
+    #count = 0;
+    #sum = 0;
+    #min = Infinity;
+    #max = 0;
+
+    add(millis) {
+        const bucket = millis < 1 ? 0 : Math.min(HISTOGRAM_BUCKETS - 1, Math.floor(Math.log2(millis)) + 1);
+        this.#buckets[bucket]++;
+        this.#count++;
+        this.#sum += millis;
+        if (millis < this.#min) this.#min = millis;
+        if (millis > this.#max) this.#max = millis;
+    }
+    reset() {
+        this.#buckets.fill(0);
+        this.#count = 0;
+        this.#sum = 0;
+        this.#min = Infinity;
+        this.#max = 0;
+    }
+    summary() {
+        return {
+            count: this.#count,
+            min: this.#count ? this.#min : 0,
+            max: this.#max,
+            mean: this.#count ? Math.round(this.#sum / this.#count) : 0,
+            p50: this.#percentile(0.5),
+            p90: this.#percentile(0.9),
+            p99: this.#percentile(0.99),
+            buckets: Array.from(this.#buckets),
+        };
+    }
+    #percentile(q) { // upper bound of the bucket that holds the q-th sample
+        if (!this.#count) return 0;
+        const rank = Math.ceil(q * this.#count);
+        let seen = 0;
+        for (let i = 0; i < HISTOGRAM_BUCKETS; i++) {
+            seen += this.#buckets[i];
+            if (seen >= rank) return Math.min(this.#max, 2 ** i);
+        }
+        return this.#max;
+    }
+}
+
+/**
+ * Single entry point for operation instrumentation. Feeds the optional trace recorder,
+ * counts every op, times operations until their result arrives, counts backend errors
+ * and acts as a watchdog that expires operations the backend never answers.
+ */
+export class Monitor {
+    trace;
+    /**
+     * @type {Function|null} Called with the MAC address of a device whose operation expired, when recycling is enabled.
+     */
+    onRecycle = null;
+    #counters = new Uint32Array(TRACE_OP.VALUE + 1);
+    #latency = METRIC_NAMES.map(() => new Histogram());
+    #pending = METRIC_NAMES.map(() => new Map()); // key > [{ started_at, dev_addr, on_expire, dispose }], oldest first
+    #errors = METRIC_NAMES.map(() => ({}));
+    #timeouts;
+    #recycle;
+    #timer = null;
+    #clock;
+
+    constructor(trace, watchdog = {}, clock = SYSTEM_CLOCK) {
+        this.trace = trace;
+        this.#clock = clock;
+        this.#timeouts = METRIC_NAMES.map((name, i) => {
+            if (watchdog === false || !DEFAULT_TIMEOUTS[i]) return 0;
+            return watchdog[name] !== undefined ? watchdog[name] : DEFAULT_TIMEOUTS[i];
+        });
+        this.#recycle = watchdog !== false && watchdog.recycle === true;
+    }
+    /**
+     * Starts the latency timer and the watchdog of an operation. Call it right before the backend call,
+     * so a result that is delivered synchronously still finds its operation. Operations on the same key queue up,
+     * a result settles the oldest one (the backend answers one attribute in order).
+     * @param {number} op - A TRACE_OP code.
+     * @param {string} dev_addr - The MAC address of the device.
+     * @param {string} key - Pairs the operation with its result, e.g. per characteristic.
+     * @param {Function} [on_expire] - Fails the request when the watchdog expires.
+     * @param {CancelToken} [signal] - Drops the operation when cancelled.
+     * @param {Function} [on_cancel] - Called when the operation is dropped by the signal.
+     */
+    start(op, dev_addr, key, on_expire, signal, on_cancel) {
+        const metric = metricOf(op);
+        const pending = { started_at: this.#clock.now(), dev_addr, on_expire, dispose: noop };
+        const queue = this.#pending[metric].get(key);
+        if (queue === undefined) {
+            this.#pending[metric].set(key, [pending]);
+        } else {
+            queue.push(pending);
+            if (queue.length > MAX_PENDING_PER_KEY) this.#expire(metric, this.#settle(metric, key), STATUS_SUPERSEDED);
+        }
+        if (signal) {
+            const cancel = () => {
+                this.#remove(metric, key, pending);
+                if (this.trace) this.trace.record(RESULT_OPS[metric], dev_addr, STATUS.CANCELLED);
+                if (on_cancel) on_cancel();
+            };
+            signal.addEventListener("abort", cancel);
+            pending.dispose = () => signal.removeEventListener("abort", cancel);
+        }
+        if (this.#timeouts[metric] && this.#timer === null) {
+            this.#timer = this.#clock.setTimeout(() => this.#tick(), WATCHDOG_TICK);
+        }
+    }
+    /**
+     * Records an operation handed over to the backend. A rejected call drops its started timer.
+     * @param {number} op - A TRACE_OP code.
+     * @param {string|null} dev_addr - The MAC address of the device, or null.
+     * @param {boolean} success - The return value of the backend call.
+     * @param {number} [size=0] - The payload size in bytes.
+     * @param {string} [key=dev_addr] - The key the operation was started with.
+     */
+    issued(op, dev_addr, success, size = 0, key = dev_addr) {
+        this.#counters[op]++;
+        if (this.trace) this.trace.record(op, dev_addr, success ? 0 : 1, size);
+        const metric = metricOf(op);
+        if (metric >= 0 && !success) {
+            this.#settle(metric, key, true);
+            this.#countError(metric, STATUS_REJECTED);
+        }
+    }
+    /**
+     * Records the result of an issued operation.
+     * @param {number} op - A TRACE_OP *_RESULT code.
+     * @param {string|null} dev_addr - The MAC address of the device, or null.
+     * @param {number} status - The backend status, 0 = OK.
+     * @param {number} [size=0] - The payload size in bytes.
+     * @param {string} [key=dev_addr] - The key the operation was issued with.
+     */
+    completed(op, dev_addr, status, size = 0, key = dev_addr) {
+        this.#counters[op]++;
+        if (this.trace) this.trace.record(op, dev_addr, status, size);
+        const metric = metricOf(op);
+        const pending = this.#settle(metric, key);
+        if (pending !== undefined) {
+            this.#latency[metric].add(this.#clock.now() - pending.started_at);
+        }
+        if (status !== 0) this.#countError(metric, status);
+    }
+    /**
+     * Records an event that settles no operation (scan result, notification, read value, disconnect).
+     */
+    event(op, dev_addr, status = 0, size = 0) {
+        this.#counters[op]++;
+        if (this.trace) this.trace.record(op, dev_addr, status, size);
+    }
+    /**
+     * Counts an error that is not tied to an issued operation, e.g. a malformed scan result.
+     * @param {number} metric - A METRIC_* index.
+     * @param {number|string} status - What went wrong.
+     */
+    error(metric, status) {
+        this.#countError(metric, status);
+    }
+    /**
+     * Adds a latency sample that is measured by the caller.
+     * @param {number} metric - A METRIC_* index.
+     * @param {number} millis - The latency.
+     */
+    sample(metric, millis) {
+        this.#latency[metric].add(millis);
+    }
+    reset() {
+        this.#counters.fill(0);
+        for (let i = 0; i < METRIC_NAMES.length; i++) {
+            this.#latency[i].reset();
+            this.#errors[i] = {};
+        }
+    }
+    stats() {
+        const counters = {};
+        for (const name in TRACE_OP) {
+            counters[name.toLowerCase()] = this.#counters[TRACE_OP[name]];
+        }
+        const latency = {};
+        const errors = {};
+        for (let i = 0; i < METRIC_NAMES.length; i++) {
+            latency[METRIC_NAMES[i]] = this.#latency[i].summary();
+            errors[METRIC_NAMES[i]] = { ...this.#errors[i] };
+        }
+        return { counters, latency, errors };
+    }
+    #settle(metric, key, newest = false) { // removes the oldest (or newest) pending operation and its cancel listener
+        const queue = this.#pending[metric].get(key);
+        if (queue === undefined) return undefined;
+        const pending = newest ? queue.pop() : queue.shift();
+        if (queue.length === 0) this.#pending[metric].delete(key);
+        pending.dispose();
+        return pending;
+    }
+    #remove(metric, key, pending) {
+        const queue = this.#pending[metric].get(key);
+        const index = queue === undefined ? -1 : queue.indexOf(pending);
+        if (index < 0) return;
+        queue.splice(index, 1);
+        if (queue.length === 0) this.#pending[metric].delete(key);
+        pending.dispose();
+    }
+    #countError(metric, status) {
+        const errors = this.#errors[metric];
+        errors[status] = (errors[status] || 0) + 1;
+    }
+    #tick() {
+        this.#timer = null;
+        const now = this.#clock.now();
+        let watching = false;
+        for (let metric = 0; metric < METRIC_NAMES.length; metric++) {
+            const timeout = this.#timeouts[metric];
+            if (!timeout) continue;
+            for (const [key, queue] of Array.from(this.#pending[metric])) {
+                while (queue.length > 0 && now - queue[0].started_at >= timeout) { // oldest first
+                    this.#expire(metric, this.#settle(metric, key), STATUS_EXPIRED);
+                }
+                if (queue.length > 0) watching = true;
+            }
+        }
+        if (watching && this.#timer === null) {
+            this.#timer = this.#clock.setTimeout(() => this.#tick(), WATCHDOG_TICK);
+        }
+    }
+    #expire(metric, pending, reason) {
+        logger.warn(reason === STATUS_EXPIRED ? "eBLE: Watchdog expired:" : "eBLE: Operation superseded:", METRIC_NAMES[metric], pending.dev_addr);
+        this.#counters[RESULT_OPS[metric]]++;
+        if (this.trace) this.trace.record(RESULT_OPS[metric], pending.dev_addr, STATUS.TIMEOUT);
+        this.#countError(metric, reason);
+        if (pending.on_expire) pending.on_expire();
+        if (this.#recycle && reason === STATUS_EXPIRED && metric !== METRIC_CONNECT && this.onRecycle) {
+            this.onRecycle(pending.dev_addr);
+        }
+    }
+}
@@ -0,0 +1,486 @@
+/**
+ * GATT: profile preparation, characteristic/descriptor reads and writes, and the ble.on.* callbacks.
+ */
+import {
+    ERR_IDP_NOT_FOUND, ERR_IDP_NOT_FOUND_SHORT, ERR_NOT_IMPLEMENTED, ERR_PROFILE_CREATION_FAILED,
+    ERR_CHAR_READ_FAIL, ERR_DESC_READ_FAIL, ERR_CHAR_WRITE_FAIL, ERR_DESC_WRITE_FAIL,
+    ERR_CANCELLED, ERR_INVALID_MAC, ERR_INVALID_DATA, ERR_INVALID_PROFILE,
+    SHORT_DELAY, STATUS, TRACE_OP, emitCallback, attrKey,
+} from './core.js'
+import { logger } from './log.js'
+import { ab2mac, mac2ab, normalizeMac, ab2str_stripped, data2ab, profileError } from './codecs.js'
+
+export class Profiles {
+    #ble;
+    #clock;
+    #registry;
+    #monitor;
+    #callbacks;
+    #connections;
+    #known;
+    #preparing = false; // a profile is being built
+    #prepare_queue = []; // startListener calls waiting for it
+
+    constructor(ble, clock, registry, monitor, callbacks, connections, known = null) {
+        this.#ble = ble;
+        this.#clock = clock;
+        this.#registry = registry;
+        this.#monitor = monitor;
+        this.#callbacks = callbacks;
+        this.#connections = connections;
+        this.#known = known;
+    }
+    /**
+     * Builds a profile for the device of profile_object.dev. See BLEMaster.startListener.
+     * The backend has one mstOnPrepare callback, so profiles are built one at a time: a call made while another profile
+     * is being built waits for it.
+     */
+    startListener(profile_object, response_callback, options = {}) {
+        logger.debug(() => "eBLE: startListener called with profile_object: " + JSON.stringify(profile_object));
+        const signal = options.signal;
+        if (signal && signal.aborted) {
+            return { success: false, error: ERR_CANCELLED };
+        }
+        const invalid = profileError(profile_object);
+        if (invalid) { // mstBuildProfile does not validate, a malformed profile fails deep inside the backend
+            logger.error(ERR_INVALID_PROFILE + ":", invalid);
+            return { success: false, error: ERR_INVALID_PROFILE };
+        }
+        const request = { profile_object, response_callback, signal, drop: null };
+        if (this.#preparing) {
+            if (signal) { // a cancelled request leaves the queue without calling back
+                request.drop = () => {
+                    const index = this.#prepare_queue.indexOf(request);
+                    if (index >= 0) this.#prepare_queue.splice(index, 1);
+                };
+                signal.addEventListener("abort", request.drop);
+            }
+            this.#prepare_queue.push(request);
+        } else {
+            this.#prepare(request);
+        }
+
+        // the profile is built asynchronously, its status is delivered to the response_callback
+        return {
+            success: true,
+            error: null,
+        };
+    }
+    #prepare({ profile_object, response_callback, signal }) {
+        const dev_addr = ab2mac(profile_object.dev); // the device the profile is for, connects to other devices may have completed since
+        let abandoned = false; // timed out or cancelled
+        let finished = false;
+        const finish = () => { // the backend is free for the next profile
+            if (finished) return;
+            finished = true;
+            this.#prepareNext();
+        };
+        this.#preparing = true;
+        // 1. register the mstOnPrepare callback to handle profile preparation
+        this.#ble.mstOnPrepare((backend_response) => {
+            logger.debug(() => "eBLE: mstOnPrepare called with backend_response: " + JSON.stringify(backend_response));
+            if (abandoned) { // the request was already failed, release a late profile
+                if (backend_response.status === 0) {
+                    this.#ble.mstDestroyProfileInstance(backend_response.profile);
+                }
+                return;
+            }
+            this.#monitor.completed(TRACE_OP.PREPARE_RESULT, dev_addr, backend_response.status);
+            if (backend_response.status === 0) {
+                // save profile pointer (only if we were able to properly connect)
+                this.#registry.setProfile(dev_addr, backend_response.profile); // profile, status
+                if (signal) this.#connections.own(signal, dev_addr);
+            } else {
+                logger.warn("eBLE: Error mstOnPrepare. Status:", backend_response.status);
+            }
+
+            // 3. [old] execute the response_callback with the profile pointer (profile_idp) as the argument 
+            //    [new] returns status to the end user. (profile_idp) is now hidden from the end user interactions
+            logger.debug("eBLE: Executing backend_response");
+            finish();
+            response_callback(backend_response.status); // backend_response.profile
+        });
+        this.#listenAttributes();
+    
+        // add a delay before calling mstBuildProfile
+        let build_timer = null;
+        const cancel_build = () => {
+            abandoned = true;
+            this.#clock.clearTimeout(build_timer);
+            finish();
+        };
+        if (signal) signal.addEventListener("abort", cancel_build);
+        build_timer = this.#clock.setTimeout(() => {
+            if (signal) signal.removeEventListener("abort", cancel_build);
+            // 2. build the profile
+            this.#monitor.start(TRACE_OP.PREPARE, dev_addr, dev_addr, () => {
+                abandoned = true;
+                finish();
+                response_callback(STATUS.TIMEOUT);
+            }, signal, () => {
+                abandoned = true;
+                finish();
+            });
+            const success = this.#ble.mstBuildProfile(profile_object);
+            logger.debug("eBLE: mstBuildProfile called with success:", success);
+            this.#monitor.issued(TRACE_OP.PREPARE, dev_addr, success);
+            if (!success) { // nothing will answer, the caller still gets its status
+                logger.error(ERR_PROFILE_CREATION_FAILED);
+                abandoned = true;
+                finish();
+                response_callback(STATUS.REJECTED);
+            }
+        }, SHORT_DELAY);  // 100ms
+    }
+    #prepareNext() {
+        this.#preparing = false;
+        const request = this.#prepare_queue.shift();
+        if (!request) return;
+        if (request.drop) request.signal.removeEventListener("abort", request.drop);
+        this.#prepare(request);
+    }
+    /**
+     * Fills in connect_id, profile and dev of a profile object. See BLEMaster.modifyProfileObject.
+     */
+    modifyProfileObject(dev_addr, profile_object) {
+        dev_addr = normalizeMac(dev_addr);
+        const device = dev_addr === null ? undefined : this.#registry.get(dev_addr);
+        // a device connected directly (without a scan) has no dev_name in the registry, the known-devices store may have it
+        const known = dev_addr !== null && this.#known ? this.#known.get(dev_addr) : undefined;
+        if (!device && !known) {
+            logger.warn("eBLE: Device not found:", dev_addr);
+            return null;
+        }
+    
+        const modified_profile_object = {
+            ...profile_object,
+            id: device ? device.connect_id : undefined,
+            profile: device && device.dev_name !== undefined ? device.dev_name : known && known.dev_name,
+            dev: mac2ab(dev_addr),
+        };
+    
+        return modified_profile_object;
+    }
+    /**
+     * @warning [NOT IMPLEMENTED] See BLEMaster.generateProfileObject.
+     */
+     generateProfileObject(dev_addr) {
+        const device = this.#registry.get(dev_addr);
+        if (!device) {
+            logger.warn("eBLE: Device not found:", dev_addr);
+            return { success: false, error: "Device not found: " + dev_addr };
+        }
+    
+        logger.warn(ERR_NOT_IMPLEMENTED);
+        return { success: false, error: ERR_NOT_IMPLEMENTED }; // exit point
+        // TODO: implementation (most devices don't have enough data to generate a profile from the scan, needs a generalized approach)
+        const profile_object = {
+            pair: true,
+            id: device.connect_id,
+            profile: device.dev_name,
+            dev: mac2ab(dev_addr),
+            len: 1,
+            list: []
+        };
+    
+        // add services
+        for (const service_uuid of device.service_uuid_array || []) { // empty arr if we have nothing + need to make sure we gen all 5 levels
+            const service = {
+                uuid: true,
+                size: 1,
+                len: 1,
+                list: []
+            };
+            profile_object.list.push(service);
+    
+            // add characteristics
+            for (const characteristic of device.characteristics || []) {
+                if (characteristic.service_uuid === service_uuid) {
+                    const characteristic_obj = {
+                        uuid: characteristic.uuid,
+                        permission: 0,
+                        desc: 1,
+                        len: 1,
+                        list: []
+                    };
+                    service.list.push(characteristic_obj);
+    
+                    // add descriptors
+                    for (const descriptor of characteristic.descriptors || []) {
+                        const descriptor_obj = {
+                            uuid: descriptor.uuid,
+                            permission: 0
+                        };
+                        characteristic_obj.list.push(descriptor_obj);
+                    }
+                }
+            }
+        }
+    }
+    /**
+     * Registers the backend read/write/notification callbacks. Every response is measured and handed over
+     * to the matching ble.on callback with the device's MAC address and hex-string data.
+     */
+    #listenAttributes() {
+        const dispatch = (name, op, response, size) => {
+            const dev_addr = this.#registry.findByProfile(response.profile);
+            const status = response.status === undefined ? 0 : response.status;
+            if (op === TRACE_OP.NOTIFY || op === TRACE_OP.VALUE) { // a read settles on its ReadComplete
+                this.#monitor.event(op, dev_addr, status, size);
+            } else {
+                const key = response.uuid !== undefined ? attrKey(dev_addr, response.uuid) : attrKey(dev_addr, response.chara, response.desc);
+                this.#monitor.completed(op, dev_addr, status, size, key);
+            }
+            const callbacks = this.#callbacks;
+            if (callbacks[name] || (callbacks.taps && callbacks.taps.size > 0)) {
+                const response_str = { ...response, dev_addr };
+                if (response.data !== undefined) response_str.data = ab2str_stripped(response.data);
+                emitCallback(callbacks, name, response_str);
+            }
+        };
+        this.#ble.mstOnCharaReadComplete((response) => dispatch("charaReadComplete", TRACE_OP.READ_RESULT, response, 0));
+        this.#ble.mstOnCharaValueArrived((response) => dispatch("charaValueArrived", TRACE_OP.VALUE, response, response.length));
+        this.#ble.mstOnCharaWriteComplete((response) => dispatch("charaWriteComplete", TRACE_OP.WRITE_RESULT, response, 0));
+        this.#ble.mstOnDescReadComplete((response) => dispatch("descReadComplete", TRACE_OP.READ_RESULT, response, 0));
+        this.#ble.mstOnDescValueArrived((response) => dispatch("descValueArrived", TRACE_OP.VALUE, response, response.length));
+        this.#ble.mstOnDescWriteComplete((response) => dispatch("descWriteComplete", TRACE_OP.WRITE_RESULT, response, 0));
+        this.#ble.mstOnCharaNotification((response) => dispatch("charaNotification", TRACE_OP.NOTIFY, response, response.length));
+    }
+}
+
+export class Write {
+    #ble;
+    #registry;
+    #monitor;
+    #callbacks;
+    
+    constructor(ble, registry, monitor, callbacks) {
+        this.#ble = ble;
+        this.#registry = registry;
+        this.#monitor = monitor;
+        this.#callbacks = callbacks;
+    }
+    /**
+     * Writes to a characteristic of a device.
+     * @param {string} dev_addr - The MAC address of the device.
+     * @param {string} uuid - The UUID of the characteristic to write to.
+     * @param {string|ArrayBuffer} data - The data to write to the characteristic.
+     * @param {Object} [options={}] - Optional parameters.
+     * @param {CancelToken} [options.signal] - Cancelling it before the write is issued skips it, after that it stops waiting for the completion.
+     * @returns {Object} Returns an object with a 'success' property indicating whether the write succeeded and an 'error' property containing an error message if the write failed.
+     */
+    characteristic(dev_addr, uuid, data, options = {}) {
+        dev_addr = normalizeMac(dev_addr);
+        if (dev_addr === null) {
+            logger.error(ERR_INVALID_MAC);
+            return { success: false, error: ERR_INVALID_MAC };
+        }
+        const signal = options.signal;
+        if (signal && signal.aborted) {
+            return { success: false, error: ERR_CANCELLED };
+        }
+        const profile_idp = this.#registry.profile(dev_addr);
+        if (profile_idp === undefined) {
+            logger.error(ERR_IDP_NOT_FOUND);
+            return { success: false, error: ERR_IDP_NOT_FOUND_SHORT }; // handle layering
+        }
+        const data_ab = data2ab(data);
+        if (data_ab === null) {
+            logger.error(ERR_INVALID_DATA);
+            return { success: false, error: ERR_INVALID_DATA };
+        }
+        const data_len = data_ab.byteLength;
+        const key = attrKey(dev_addr, uuid);
+        this.#monitor.start(TRACE_OP.WRITE, dev_addr, key, () => {
+            emitCallback(this.#callbacks, "charaWriteComplete", { dev_addr, uuid, status: STATUS.TIMEOUT });
+        }, signal);
+        const success = this.#ble.mstWriteCharacteristic(profile_idp, uuid, data_ab, data_len);
+        this.#monitor.issued(TRACE_OP.WRITE, dev_addr, success, data_len, key);
+        return {
+            success,
+            error: success ? null : ERR_CHAR_WRITE_FAIL,
+        };
+    }
+    /**
+     * Writes to a descriptor of a characteristic of a device.
+     * @param {string} dev_addr - The MAC address of the device.
+     * @param {string} chara - The UUID of the characteristic that the descriptor belongs to.
+     * @param {string} desc - The UUID of the descriptor to write to.
+     * @param {string|ArrayBuffer} data - The data to write to the descriptor.
+     * @param {Object} [options={}] - Optional parameters.
+     * @param {CancelToken} [options.signal] - Cancelling it before the write is issued skips it, after that it stops waiting for the completion.
+     * @returns {Object} Returns an object with a 'success' property indicating whether the write succeeded and an 'error' property containing an error message if the write failed.
+     */
+    descriptor(dev_addr, chara, desc, data, options = {}) {
+        dev_addr = normalizeMac(dev_addr);
+        if (dev_addr === null) {
+            logger.error(ERR_INVALID_MAC);
+            return { success: false, error: ERR_INVALID_MAC };
+        }
+        const signal = options.signal;
+        if (signal && signal.aborted) {
+            return { success: false, error: ERR_CANCELLED };
+        }
+        const profile_idp = this.#registry.profile(dev_addr);
+        if (profile_idp === undefined) {
+            logger.error(ERR_IDP_NOT_FOUND);
+            return { success: false, error: ERR_IDP_NOT_FOUND_SHORT };
+        }
+        const data_ab = data2ab(data);
+        if (data_ab === null) {
+            logger.error(ERR_INVALID_DATA);
+            return { success: false, error: ERR_INVALID_DATA };
+        }
+        const data_len = data_ab.byteLength;
+        const key = attrKey(dev_addr, chara, desc);
+        this.#monitor.start(TRACE_OP.WRITE, dev_addr, key, () => {
+            emitCallback(this.#callbacks, "descWriteComplete", { dev_addr, chara, desc, status: STATUS.TIMEOUT });
+        }, signal);
+        const success = this.#ble.mstWriteDescriptor(profile_idp, chara, desc, data_ab, data_len);
+        this.#monitor.issued(TRACE_OP.WRITE, dev_addr, success, data_len, key);
+        return {
+            success,
+            error: success ? null : ERR_DESC_WRITE_FAIL,
+        };
+    }
+}
+
+export class Read {
+    #ble;
+    #registry;
+    #monitor;
+    #callbacks;
+    
+    constructor(ble, registry, monitor, callbacks) {
+        this.#ble = ble;
+        this.#registry = registry;
+        this.#monitor = monitor;
+        this.#callbacks = callbacks;
+    }
+    /**
+     * Reads from a characteristic of a device.
+     * @param {string} dev_addr - The MAC address of the device.
+     * @param {string} uuid - The UUID of the characteristic to read from.
+     * @param {Object} [options={}] - Optional parameters.
+     * @param {CancelToken} [options.signal] - Cancelling it before the read is issued skips it, after that it stops waiting for the completion.
+     * @returns {Object} Returns an object with a 'success' property indicating whether the read succeeded and an 'error' property containing an error message if the read failed.
+     */
+    characteristic(dev_addr, uuid, options = {}) {
+        dev_addr = normalizeMac(dev_addr);
+        if (dev_addr === null) {
+            logger.error(ERR_INVALID_MAC);
+            return { success: false, error: ERR_INVALID_MAC };
+        }
+        const signal = options.signal;
+        if (signal && signal.aborted) {
+            return { success: false, error: ERR_CANCELLED };
+        }
+        const profile_idp = this.#registry.profile(dev_addr);
+        if (profile_idp === undefined) {
+            logger.error(ERR_IDP_NOT_FOUND);
+            return { success: false, error: ERR_IDP_NOT_FOUND_SHORT };
+        }
+        const key = attrKey(dev_addr, uuid);
+        this.#monitor.start(TRACE_OP.READ, dev_addr, key, () => {
+            emitCallback(this.#callbacks, "charaReadComplete", { dev_addr, uuid, status: STATUS.TIMEOUT });
+        }, signal);
+        const success = this.#ble.mstReadCharacteristic(profile_idp, uuid);
+        this.#monitor.issued(TRACE_OP.READ, dev_addr, success, 0, key);
+        return {
+            success,
+            error: success ? null : ERR_CHAR_READ_FAIL,
+        };
+    }
+    /**
+     * Reads from a descriptor of a characteristic of a device.
+     * @param {string} dev_addr - The MAC address of the device.
+     * @param {string} uuid - The UUID of the characteristic that the descriptor belongs to.
+     * @param {string} desc - The UUID of the descriptor to read from.
+     * @param {Object} [options={}] - Optional parameters.
+     * @param {CancelToken} [options.signal] - Cancelling it before the read is issued skips it, after that it stops waiting for the completion.
+     * @returns {Object} Returns an object with a 'success' property indicating whether the read succeeded and an 'error' property containing an error message if the read failed.
+     */
+    descriptor(dev_addr, uuid, desc, options = {}) {
+        dev_addr = normalizeMac(dev_addr);
+        if (dev_addr === null) {
+            logger.error(ERR_INVALID_MAC);
+            return { success: false, error: ERR_INVALID_MAC };
+        }
+        const signal = options.signal;
+        if (signal && signal.aborted) {
+            return { success: false, error: ERR_CANCELLED };
+        }
+        const profile_idp = this.#registry.profile(dev_addr);
+        if (profile_idp === undefined) {
+            logger.error(ERR_IDP_NOT_FOUND);
+            return { success: false, error: ERR_IDP_NOT_FOUND_SHORT };
+        }
+        const key = attrKey(dev_addr, uuid, desc);
+        this.#monitor.start(TRACE_OP.READ, dev_addr, key, () => {
+            emitCallback(this.#callbacks, "descReadComplete", { dev_addr, chara: uuid, desc, status: STATUS.TIMEOUT });
+        }, signal);
+        const success = this.#ble.mstReadDescriptor(profile_idp, uuid, desc);
+        this.#monitor.issued(TRACE_OP.READ, dev_addr, success, 0, key);
+        return {
+            success,
+            error: success ? null : ERR_DESC_READ_FAIL,
+        };
+    }
+}
+
+export class On {
+    #callbacks;
+
+    constructor(callbacks) {
+        this.#callbacks = callbacks;
+    }
+    /**
+     * Registers a callback for characteristic read completion.
+     * @param {Function} callback - Called with { dev_addr, profile, uuid, status }, status is STATUS.TIMEOUT if the watchdog expired.
+     */
+    charaReadComplete(callback) {
+        this.#callbacks.charaReadComplete = callback;
+    }
+    /**
+     * Registers a callback for characteristic values that arrive after a read.
+     * @param {Function} callback - Called with { dev_addr, profile, uuid, data, length }, data is a hex string.
+     */
+    charaValueArrived(callback) {
+        this.#callbacks.charaValueArrived = callback;
+    }
+    /**
+     * Registers a callback for characteristic write completion.
+     * @param {Function} callback - Called with { dev_addr, profile, uuid, status }, status is STATUS.TIMEOUT if the watchdog expired.
+     */
+    charaWriteComplete(callback) {
+        this.#callbacks.charaWriteComplete = callback;
+    }
+    /**
+     * Registers a callback for descriptor read completion.
+     * @param {Function} callback - Called with { dev_addr, profile, chara, desc, status }, status is STATUS.TIMEOUT if the watchdog expired.
+     */
+    descReadComplete(callback) {
+        this.#callbacks.descReadComplete = callback;
+    }
+    /**
+     * Registers a callback for descriptor values that arrive after a read.
+     * @param {Function} callback - Called with { dev_addr, profile, chara, desc, data, length }, data is a hex string.
+     */
+    descValueArrived(callback) {
+        this.#callbacks.descValueArrived = callback;
+    }
+    /**
+     * Registers a callback for descriptor write completion.
+     * @param {Function} callback - Called with { dev_addr, profile, chara, desc, status }, status is STATUS.TIMEOUT if the watchdog expired.
+     */
+    descWriteComplete(callback) {
+        this.#callbacks.descWriteComplete = callback;
+    }
+    /**
+     * Registers a callback for characteristic notifications.
+     * @param {Function} callback - Called with { dev_addr, profile, uuid, data, length }, data is a hex string.
+     */
+    charaNotification(callback) {
+        this.#callbacks.charaNotification = callback;
+    }
+}
@@ -0,0 +1,144 @@
+/** @about BLE Master 1.20.1 @min_zeppos 3.0 @author: Silver, Zepp Health. @license: MIT */
+import { BLEMaster, provideFeatures } from './master.js'
+import { PowerBudget } from './power.js'
+import { ConnectionPool } from './pool.js'
+import { KnownDevices } from './known.js'
+import { ConnectScheduler } from './admission.js'
+import { connectOnSight } from './sight.js'
+import { runScene } from './scene.js'
+
+provideFeatures({ power: PowerBudget, pool: ConnectionPool, known: KnownDevices, admission: ConnectScheduler, sight: connectOnSight, scene: runScene });
+
+export { LOG_LEVEL } from './log.js'
+export { STATUS, TRACE_OP, CancelToken } from './core.js'
+export { ScanEngine, DeviceMirror } from './background.js'
+export { BLESession } from './session.js'
+export { POWER_LEVEL, PowerBudget } from './power.js'
+export { ConnectionPool } from './pool.js'
+export { KnownDevices } from './known.js'
+export { ConnectScheduler } from './admission.js'
+export { connectOnSight } from './sight.js'
+export { runScene } from './scene.js'
+export { WIRE_FORMAT, WireBatch, encodeFrame, decodeFrame } from './wire.js'
+export { ab2mac, mac2ab, ab2str_stripped, data2ab, str2ab_with_len } from './codecs.js'
+export default BLEMaster;
+
+/**
+ * @changelog
+ * 1.20.1
+ * - @fix the trace recorder's MAC table is bounded by its capacity, slots of devices no longer referenced by any kept record
+ *   are reused
+ * - @fix startListener calls back with STATUS.REJECTED when mstBuildProfile refuses the profile, it used to never call back
+ * - @fix npm run build writes ble-master-example/libs/ble-master.js too, --check fails when that copy is stale
+ * - @fix BLESession: a page that cancels its connect or startListener no longer leaves the device stuck for other pages,
+ *   nor stops a device another page holds. npm run checks asserts it
+ * - @fix WireBatch.push rejects malformed messages, one of them used to make flush drop every queued message
+ * - @fix connection pool: a connect the watchdog expired or a signal cancelled held its slot forever when the backend never
+ *   answered, with max: 1 every later connect was rejected as "pool full"
+ * - @fix connection admission: a connect cancelled in flight (options.signal, a scene timeout) frees its slot, it used to hold it
+ *   forever and stall the queue
+ * - @fix the scenario scripts check the behaviour they demonstrate and exit with 1 when it fails, their shared helpers moved
+ *   to dev/common.js
+ * - @fix a read counted twice in the trace and read_result, its ValueArrived now records TRACE_OP.VALUE
+ * - @fix a second read/write to the same attribute dropped the first one's watchdog and cancel wiring, pending operations
+ *   now queue per attribute
+ * - @fix ScanEngine.start on a running engine restarted the scan and added a second flush timer, it now returns false.
+ *   stop() removes the start signal's listener
+ * - @fix wire messages: a diff without a valid seq/time, or a reading with a non-integer time, encoded as 0 in binary and
+ *   differently in JSON. They are rejected now, a reading without time is 0 in both formats
+ * - @fix str2ab_with_len returns { data_ab, data_len } for every string again, it returned null for chars above 0xFF
+ *   since 1.9.0. Only data2ab (writes) rejects those chars
+ * - @fix ble.scene: preparing a device a page had connected gave the device to the scene's token, so a failed or timed out
+ *   scene stopped it. Only devices the scene connects itself are tied to its token
+ * - @fix options.power enforces its budget: a spent budget closes every link and refuses connects and reads/writes
+ *   (power.report().refused) besides pausing scans, and the next check runs before the budget would run out. A window
+ *   used to exceed it by what links and reads cost. npm run power checks the window never does
+ * - @fix the per-feature builds did not shrink: master.js imported every opt-in feature. It no longer does, options.power,
+ *   pool, known and admission also take their implementation (pool: ConnectionPool or { use: ConnectionPool, max: 3 }),
+ *   options.sight / options.scene the ones of startScan's options.connect and scene(). ble-master.js and the lite build
+ *   build them all in and export them. New dist/ble-master-core.js without any of them, BLESession, background or wire
+ *   (80 KB, lite 183 KB). npm run build -- --check enforces a size budget per bundle
+ * 1.20.0
+ * - @perf read/write/notification callbacks look their device up by profile pointer in an index instead of walking the
+ *   registry (11x faster with 256 scanned and 64 connected devices). The registries also index connect_id (findByConnectId)
+ * - @rem the unused last-connected-device tracking, startListener targets profile_object.dev since 1.17.0
+ * 1.19.0
+ * - @add ble.scene(commands, callback, options): writes to several devices in parallel under one deadline, with a result
+ *   per device. npm run scene compares it with one connect/prepare/write/stop chain after the other
+ * - @fix startListener calls made while a profile is being built wait for it, the backend has one mstOnPrepare callback
+ * 1.18.0
+ * - @add options.admission: connect() calls are queued and reach the backend a few at a time, ordered by connect's
+ *   options.priority and RSSI, failed attempts are retried. npm run admission compares it with all at once and one at a time
+ * - @add BLESimulator connect_slots: a backend that fails connects beyond a number in flight
+ * 1.17.0
+ * - @add startScan options.connect: targets are connected the moment their first advert arrives and their profiles built
+ *   right after, while the scan looks for the others. npm run sight compares it with the scan > stop > connect ladder
+ * - @fix startListener builds the profile for profile_object.dev instead of the device that connected last
+ * 1.16.0
+ * - @add options.known: devices the library connected to are remembered (optionally in localStorage), a later launch
+ *   connects to them directly. modifyProfileObject works for known devices that were not scanned. npm run known times it
+ * 1.15.0
+ * - @add options.pool: links stay open between commands, idle ones are stopped after options.pool.idle and a connect
+ *   that needs a slot stops the least recently used link. npm run pool compares it with stop() after every command
+ * 1.14.0
+ * - @add options.power: an estimated energy budget over a rolling window. Scans are duty-cycled and then paused,
+ *   idle links closed and ble.power.interval() stretches polling as the budget runs low. npm run power shows the effect
+ * 1.13.0
+ * - @add wire format for service > page messages: encodeFrame / decodeFrame pack ScanEngine diffs and readings into
+ *   binary frames (~1/3 of the JSON size for diffs, ~1/5 for readings) or JSON, WireBatch batches them per interval.
+ *   Part of dist/ble-background.js, npm run wire compares the formats
+ * 1.12.0
+ * - @add BLESession: an app-scoped BLEMaster, pages attach handles with the same API and detach them on navigation,
+ *   connections and profiles are reused instead of rebuilt
+ * - @add get.device(dev_addr) returns one device record
+ * - @fix stop() keeps the shared backend callbacks while other devices are still connected
+ * 1.11.0
+ * - @add ScanEngine and DeviceMirror: scanning, filtering and registry upkeep in an app service, pages get batched
+ *   registry diffs (seq numbered, snapshot() to catch up). Bundled as dist/ble-background.js
+ * - @add startScan options.filter drops scan results before they reach the registry
+ * 1.10.0
+ * - @add modular source: src/ holds core, log, codecs, registry, diagnostics, scan, connection and gatt modules,
+ *   npm run build bundles them into ble-master.js and the per-feature builds in dist/:
+ *   ble-master-lite.js (no trace, stats or watchdog), ble-scan.js (BLEScanner, scan only) and ble-codecs.js
+ * - @add BLEScanner: startScan, stopScan and get without connections and GATT
+ * 1.9.0
+ * - @add boundary validation: malformed MACs, write data and profile objects are rejected with { success: false, error }
+ *   (false / null for connect, modifyProfileObject), scan results without a 6 byte dev_addr are dropped and counted
+ *   as errors.scan_first_seen.malformed in get.stats()
+ * - @add writes accept typed arrays and DataViews
+ * - @fix odd-length hex strings no longer write the last nibble as a whole byte, they are rejected
+ * - @fix strings with chars above 0xFF are rejected by writes (data2ab) instead of silently truncated
+ * - @fix mac2ab returns null instead of NaN bytes, modifyProfileObject accepts uppercase MACs
+ * - @perf ab2mac, ab2str_stripped and data2ab no longer build intermediate arrays (scan callback ~5x faster, ~5x less garbage)
+ * 1.8.0
+ * - @add named exports of the codec helpers: ab2mac, mac2ab, ab2str_stripped, data2ab, str2ab_with_len
+ * 1.7.1
+ * - @fix scan_first_seen missed devices whose first advert shared the clock value of the scan start
+ * 1.7.0
+ * - @add injectable transport and clock: new BLEMaster({ transport, clock }), defaults to @zos/ble and the system timers
+ * 1.6.0
+ * - @add CancelToken: pass { signal: token } to startScan, connect, startListener, write.* and read.*,
+ *   token.cancel() stops the scan, abandons pending operations and stops the devices connected with it
+ * 1.5.0
+ * - @add operation watchdog: connect, prepare, read and write fail with STATUS.TIMEOUT when the backend never answers,
+ *   new BLEMaster({ watchdog: { connect, prepare, read, write, recycle } }), watchdog: false disables it
+ * - @add STATUS export
+ * 1.4.0
+ * - @add ble.get.stats(): op counters, log-bucketed latency histograms (scan to first seen, connect, prepare, read, write)
+ *   and error counters by backend status. ble.resetStats() starts over
+ * 1.3.0
+ * - @add optional binary trace recorder: new BLEMaster({ trace: 512 }), ble.trace.records() / dump()
+ * - @add ble.on.* callbacks for read/write completion, arrived values and notifications
+ * - @fix a disconnect reported by the connect callback now marks the device as disconnected
+ * 1.2.0
+ * - @add leveled logger with lazy messages: BLEMaster.setLogLevel(LOG_LEVEL.DEBUG), default level is WARN
+ * - @add LOG_STRIP build-time switch to remove all logging
+ * - @rem debugLog and the hard-coded ENABLE_DEBUG_LOG
+ * - @fix startListener no longer throws a ReferenceError on return, profile build failures are logged
+ * 1.1.0
+ * - @add compact (struct-of-arrays) device registry: new BLEMaster({ registry: "compact" })
+ * - @add last_seen timestamp to the device records
+ * - @fix scanning a connected device no longer drops its connect_id and profile pointer
+ * 1.0.0
+ * - initial release
+ */
@@ -0,0 +1,157 @@
+/**
+ * Known devices: what the library learned about every device it connected to, kept across app launches in a key-value
+ * storage, so the next launch can connect to them directly instead of scanning first.
+ */
+import { SYSTEM_CLOCK } from './core.js'
+import { logger } from './log.js'
+import { normalizeMac } from './codecs.js'
+
+const DEFAULT_KNOWN = {
+    storage: null,          // { getItem(key), setItem(key, value) }, e.g. localStorage from @zos/storage. null keeps them in memory
+    key: "eble_known",      // storage key
+    max: 32,                // devices kept, the least recently connected one is forgotten first
+};
+
+/**
+ * The known-devices store of one BLEMaster. Created by new BLEMaster({ known }), read through ble.known.
+ */
+export class KnownDevices {
+    #clock;
+    #options;
+    #devices = new Map(); // MAC > record, least recently connected first
+
+    /**
+     * @param {Object} [options={}] - See BLEMaster's options.known.
+     * @param {Object} [clock] - { now, setTimeout, clearTimeout }.
+     */
+    constructor(options = {}, clock = SYSTEM_CLOCK) {
+        this.#clock = clock;
+        this.#options = { ...DEFAULT_KNOWN, ...options };
+        this.#load();
+    }
+    /**
+     * @type {number} The number of known devices.
+     */
+    get size() {
+        return this.#devices.size;
+    }
+    /**
+     * @param {string} dev_addr - The MAC address of the device.
+     * @returns {boolean} Returns true if the device is known.
+     */
+    has(dev_addr) {
+        dev_addr = normalizeMac(dev_addr);
+        return dev_addr !== null && this.#devices.has(dev_addr);
+    }
+    /**
+     * @param {string} dev_addr - The MAC address of the device.
+     * @returns {Object|undefined} Returns { dev_addr, dev_name, service_uuid_array, vendor_id, connected_at, connects }, or undefined.
+     */
+    get(dev_addr) {
+        dev_addr = normalizeMac(dev_addr);
+        return dev_addr === null ? undefined : this.#devices.get(dev_addr);
+    }
+    /**
+     * @returns {Array<Object>} Returns every known device, most recently connected first.
+     */
+    list() {
+        return Array.from(this.#devices.values()).reverse();
+    }
+    /**
+     * Adds or updates a device without connecting to it, e.g. one the user set up in a settings page.
+     * @param {string} dev_addr - The MAC address of the device.
+     * @param {Object} [info={}] - { dev_name, service_uuid_array, vendor_id }.
+     * @returns {boolean} Returns true if the device was stored, false if the MAC address is invalid.
+     */
+    remember(dev_addr, info = {}) {
+        dev_addr = normalizeMac(dev_addr);
+        if (dev_addr === null) return false;
+        const record = this.#devices.get(dev_addr) || newKnownRecord(dev_addr);
+        if (info.dev_name !== undefined) record.dev_name = info.dev_name;
+        if (info.service_uuid_array !== undefined) record.service_uuid_array = info.service_uuid_array;
+        if (info.vendor_id !== undefined) record.vendor_id = info.vendor_id;
+        this.#put(record);
+        this.#save();
+        return true;
+    }
+    /**
+     * Forgets a device.
+     * @param {string} dev_addr - The MAC address of the device.
+     * @returns {boolean} Returns true if the device was known.
+     */
+    forget(dev_addr) {
+        dev_addr = normalizeMac(dev_addr);
+        if (dev_addr === null || !this.#devices.delete(dev_addr)) return false;
+        this.#save();
+        return true;
+    }
+    /**
+     * Forgets every device.
+     */
+    clear() {
+        this.#devices.clear();
+        this.#save();
+    }
+    /**
+     * Records a successful connection, with what the registry knows about the device. Used by BLEMaster.
+     * @param {string} dev_addr - The normalized MAC address.
+     * @param {Object} [device] - The registry's device record.
+     */
+    connected(dev_addr, device) {
+        const record = this.#devices.get(dev_addr) || newKnownRecord(dev_addr);
+        if (device && device.dev_name !== undefined) {
+            record.dev_name = device.dev_name;
+            record.service_uuid_array = device.service_uuid_array;
+            record.vendor_id = device.vendor_id;
+        }
+        record.connected_at = this.#clock.now();
+        record.connects++;
+        this.#put(record);
+        this.#save();
+    }
+
+    #put(record) { // moves the record to the most recently connected end, forgets the oldest beyond max
+        this.#devices.delete(record.dev_addr);
+        this.#devices.set(record.dev_addr, record);
+        while (this.#devices.size > this.#options.max) this.#devices.delete(this.#devices.keys().next().value);
+    }
+    #load() {
+        const storage = this.#options.storage;
+        if (!storage) return;
+        let records;
+        try {
+            const text = storage.getItem(this.#options.key);
+            if (!text) return;
+            records = JSON.parse(text);
+        } catch (error) {
+            logger.warn("eBLE: Known devices could not be loaded:", error);
+            return;
+        }
+        if (!Array.isArray(records)) return;
+        for (const record of records) { // stored oldest first
+            const dev_addr = record ? normalizeMac(record.dev_addr) : null;
+            if (dev_addr === null) continue;
+            this.#put({
+                dev_addr,
+                dev_name: typeof record.dev_name === "string" ? record.dev_name : undefined,
+                service_uuid_array: Array.isArray(record.service_uuid_array) ? record.service_uuid_array : undefined,
+                vendor_id: typeof record.vendor_id === "number" ? record.vendor_id : undefined,
+                connected_at: typeof record.connected_at === "number" ? record.connected_at : undefined,
+                connects: typeof record.connects === "number" ? record.connects : 0,
+            });
+        }
+    }
+    #save() {
+        const storage = this.#options.storage;
+        if (!storage) return;
+        try {
+            storage.setItem(this.#options.key, JSON.stringify(Array.from(this.#devices.values())));
+        } catch (error) {
+            logger.warn("eBLE: Known devices could not be saved:", error);
+        }
+    }
+}
+
+function newKnownRecord(dev_addr) {
+    return { dev_addr, dev_name: undefined, service_uuid_array: undefined, vendor_id: undefined, connected_at: undefined, connects: 0 };
+}
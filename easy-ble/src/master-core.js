@@ -0,0 +1,11 @@
+/**
+ * Entry of the core bundle (dist/ble-master-core.js): BLEMaster with scanning, connections and GATT only. The opt-in
+ * features (power, pool, known, admission, startScan's options.connect, scene), BLESession, the background engine and
+ * the wire format are not part of it, pass an implementation to enable one (e.g. pool: ConnectionPool).
+ */
+import { BLEMaster } from './master.js'
+
+export { LOG_LEVEL } from './log.js'
+export { STATUS, TRACE_OP, CancelToken } from './core.js'
+export { ab2mac, mac2ab, ab2str_stripped, data2ab, str2ab_with_len } from './codecs.js'
+export default BLEMaster;
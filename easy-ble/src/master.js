@@ -0,0 +1,333 @@
+/**
+ * BLEMaster: the page-level facade over scanning, connections, GATT and diagnostics.
+ */
+import * as hmBle from '@zos/ble'
+import { SYSTEM_CLOCK, ERR_FEATURE_MISSING } from './core.js'
+import { logger } from './log.js'
+import { createRegistry, Get } from './registry.js'
+import { createMonitor } from './diagnostics.js'
+import { Scanner } from './scan.js'
+import { Connections } from './connection.js'
+import { Profiles, Write, Read, On } from './gatt.js'
+
+const BUILT_IN = {}; // the opt-in features the bundle's entry ships, see provideFeatures
+
+/**
+ * Builds opt-in features into every BLEMaster of a bundle, so options.pool: true (or an options object) and ble.scene()
+ * find their implementation. Called by the entries that ship them (index.js), the core bundle ships none.
+ * @param {Object} features - { power: PowerBudget, pool: ConnectionPool, known: KnownDevices, admission: ConnectScheduler,
+ * sight: connectOnSight, scene: runScene }.
+ */
+export function provideFeatures(features) {
+    Object.assign(BUILT_IN, features);
+}
+
+/**
+ * Resolves an opt-in feature option: the implementation itself (pool: ConnectionPool) enables it with its defaults,
+ * { use: ConnectionPool, ...options } with options, true or an options object use the built-in implementation.
+ * @returns {Array|null} Returns [implementation, options], or null if the feature is off or not available.
+ */
+function featureOption(name, option) {
+    if (!option) return null;
+    if (typeof option === "function") return [option, {}];
+    const implementation = (option !== true && option.use) || BUILT_IN[name];
+    if (!implementation) {
+        logger.error(ERR_FEATURE_MISSING + `, options.${name} ignored`);
+        return null;
+    }
+    if (option === true) return [implementation, {}];
+    const { use, ...feature_options } = option;
+    return [implementation, feature_options];
+}
+
+export class BLEMaster {
+    #registry;
+    #monitor;
+    #scanner;
+    #connections;
+    #profiles;
+    #power = null;
+    #pool = null;
+    #known = null;
+    #admission = null;
+    #sight;     // startScan's options.connect
+    #scene;
+    #clock;
+    #taps = new Set(); // the library's own listeners on the ble.on callbacks
+
+    /**
+     * @type {Write} A device writer.
+     */
+    write;
+
+    /**
+     * @type {Read} A device reader.
+     */
+    read;
+
+    /**
+     * @type {On} Read, write and notification callbacks.
+     */
+    on;
+
+    /**
+     * Creates a new BLE Master instance.
+     * @param {Object} [options={}] - Optional parameters.
+     * @param {string} [options.registry="object"] - The device registry backend. "object" keeps a plain object per device,
+     * "compact" stores scan data in typed-array columns and materializes device objects only when requested (recommended for 500+ advertising devices).
+     * @param {number} [options.capacity=64] - The number of preallocated slots for the "compact" registry. Grows automatically when exceeded.
+     * @param {number} [options.trace] - Enables the binary trace recorder with room for this many operation records (16 bytes each).
+     * @param {Object|boolean} [options.watchdog] - Deadlines in millis for outstanding backend operations, false disables the watchdog.
+     * An expired operation is failed with STATUS.TIMEOUT. Defaults: { connect: 10000, prepare: 10000, read: 5000, write: 5000, recycle: false }.
+     * With recycle: true an expired prepare/read/write also stops the device (destroys the profile and disconnects).
+     * @param {Object} [options.transport] - An object implementing the hmBle mst* surface. Defaults to @zos/ble, use it to run
+     * against a simulator or an instrumented backend.
+     * @param {Object} [options.clock] - The time source { now, setTimeout, clearTimeout }. Defaults to the system timers.
+     * @param {Object|boolean} [options.power] - Meters radio use against an energy budget and degrades gracefully when it runs low,
+     * a spent budget closes every link and refuses connects and reads/writes. One unit is one second of scanning. true for the defaults: { budget: 600, window: 3600000,
+     * costs: { scan: 1, link: 0.05, op: 0.02 }, saving_at: 0.7, critical_at: 0.9, check_interval: 10000, scan_period: 10000,
+     * scan_duty: [1, 0.4, 0.1], poll_factor: [1, 2, 4], idle_close: [0, 60000, 15000], on_level }, the arrays are per POWER_LEVEL.
+     * @param {Object|boolean} [options.pool] - Keeps links open between commands within a pool. true for the defaults: { max: 4, idle: 30000 }.
+     * A link without reads, writes or notifications for idle millis is stopped, a connect to a new device when max links
+     * (connects in flight included) are held stops the least recently used one.
+     * @param {Object|boolean} [options.known] - Remembers every device it connects to (name, service UUIDs, vendor id), so a later
+     * launch can connect to it without scanning. true keeps them in memory, { storage, key: "eble_known", max: 32 } persists them
+     * with storage.getItem / setItem (localStorage from @zos/storage).
+     * @param {Object|boolean} [options.admission] - Queues connect() calls and lets a few reach the backend at once. true for the
+     * defaults: { concurrency: 2, retries: 2, retry_delay: 500, order: "rssi" }. The queue is ordered by connect's options.priority,
+     * then first attempts before retries, then the strongest RSSI ("rssi") or call order ("fifo"). A failed attempt is queued
+     * again after retry_delay millis, the callback only sees the last one.
+     * power, pool, known and admission also take their implementation, alone (pool: ConnectionPool) or with options
+     * ({ use: ConnectionPool, max: 3 }). true and plain options objects need a bundle that builds them in (ble-master.js,
+     * ble-master-lite.js), dist/ble-master-core.js builds in none.
+     * @param {Function} [options.sight] - connectOnSight, the implementation of startScan's options.connect. Built in like power.
+     * @param {Function} [options.scene] - runScene, the implementation of scene(). Built in like power.
+     */
+    constructor(options = {}){
+        let ble = options.transport || hmBle;
+        const clock = options.clock || SYSTEM_CLOCK;
+        const callbacks = { taps: this.#taps };
+        this.#clock = clock;
+        this.#sight = options.sight || BUILT_IN.sight || null;
+        this.#scene = options.scene || BUILT_IN.scene || null;
+        const power = featureOption("power", options.power);
+        if (power) {
+            const [PowerFeature, power_options] = power;
+            this.#power = new PowerFeature(power_options, clock);
+            ble = this.#power.wrap(ble, (profile) => this.#registry.findByProfile(profile), (dev_addr) => this.stop(dev_addr));
+        }
+        const pool = featureOption("pool", options.pool);
+        if (pool) {
+            const [PoolFeature, pool_options] = pool;
+            this.#pool = new PoolFeature(pool_options, clock);
+            ble = this.#pool.wrap(ble, (profile) => this.#registry.findByProfile(profile), (dev_addr) => this.stop(dev_addr));
+        }
+        this.#registry = createRegistry(options, clock);
+        this.#monitor = createMonitor(options, clock);
+        this.#monitor.onRecycle = (dev_addr) => this.stop(dev_addr);
+        this.#scanner = new Scanner(ble, clock, this.#registry, this.#monitor);
+        this.#connections = new Connections(ble, this.#registry, this.#monitor);
+        if (this.#pool) this.#connections.onAbandoned = (dev_addr) => this.#pool.abandon(dev_addr);
+        const known = featureOption("known", options.known);
+        if (known) {
+            const [KnownFeature, known_options] = known;
+            this.#known = new KnownFeature(known_options, clock);
+            this.#connections.onConnected = (dev_addr) => this.#known.connected(dev_addr, this.#registry.get(dev_addr));
+        }
+        const admission = featureOption("admission", options.admission);
+        if (admission) {
+            const [AdmissionFeature, admission_options] = admission;
+            this.#admission = new AdmissionFeature(admission_options, clock,
+                (dev_addr, callback, connect_options) => this.#connections.connect(dev_addr, callback, connect_options),
+                (dev_addr) => {
+                    const device = this.#registry.get(dev_addr);
+                    return device && device.last_seen !== undefined ? device.rssi : undefined;
+                });
+        }
+        this.#profiles = new Profiles(ble, clock, this.#registry, this.#monitor, callbacks, this.#connections, this.#known);
+        this.write = new Write(ble, this.#registry, this.#monitor, callbacks);
+        this.read = new Read(ble, this.#registry, this.#monitor, callbacks);
+        this.on = new On(callbacks);
+    }
+    /**
+     * @type {TraceRecorder|null} The operation trace recorder, or null if tracing was not enabled with options.trace.
+     */
+    get trace() {
+        return this.#monitor.trace;
+    }
+    /**
+     * @type {PowerBudget|null} The power budget, or null if it was not enabled with options.power.
+     */
+    get power() {
+        return this.#power;
+    }
+    /**
+     * @type {ConnectionPool|null} The connection pool, or null if it was not enabled with options.pool.
+     */
+    get pool() {
+        return this.#pool;
+    }
+    /**
+     * @type {KnownDevices|null} The known-devices store, or null if it was not enabled with options.known.
+     */
+    get known() {
+        return this.#known;
+    }
+    /**
+     * @type {ConnectScheduler|null} The connection admission queue, or null if it was not enabled with options.admission.
+     */
+    get admission() {
+        return this.#admission;
+    }
+    /**
+     * @type {Get} A device information getter.
+     */
+    get get() {
+        return new Get(this.#registry, this.#monitor);
+    }
+    /**
+     * Resets all counters and latency histograms reported by get.stats().
+     */
+    resetStats() {
+        this.#monitor.reset();
+    }
+    /**
+     * Sets the library-wide log level. Messages above this level are neither formatted nor printed.
+     * @param {number} level - One of LOG_LEVEL.NONE, ERROR, WARN (default), INFO or DEBUG.
+     */
+    static setLogLevel(level) {
+        logger.level = level;
+    }
+    /**
+     * Starts scanning for devices.
+     * @param {Function} response_callback - The callback function that will be called with the scan result for each device.
+     * @param {Object} [options={}] - Optional parameters for the scan.
+     * @param {number} [options.duration] - The duration of the scan in milliseconds. If specified, the scan will automatically stop after this duration.
+     * @param {Function} [options.on_duration] - A callback function that will be called when the scan stops due to reaching the specified duration.
+     * @param {CancelToken} [options.signal] - Stops the scan when cancelled. Any AbortSignal-like object works.
+     * @param {Function} [options.filter] - Called with every decoded scan result, results it returns false for are dropped
+     * before they reach the registry and the response_callback.
+     * @param {Object} [options.connect] - Connects to targets the moment their first advert arrives (after options.filter):
+     * { targets: MAC or [MAC], profile, stop_scan: true, on_ready }. With a profile object (or a function MAC > profile object)
+     * the profile is built right after the connect, profiles are built one at a time. stop_scan: true stops the scan once every
+     * target was sighted, false keeps it running. on_ready is called once per target with { dev_addr, connected, connect_id, status },
+     * status being the startListener status (undefined without a profile), or { ..., error } if the profile was rejected.
+     * A target that is already connected is reported right away. options.signal applies to the connects and profiles too.
+     * @returns {boolean} Returns true if the call to start the scan succeeded, false if it failed.
+     */
+    startScan(response_callback, options = {}) {
+        if (options.connect) {
+            if (!this.#sight) {
+                logger.error(ERR_FEATURE_MISSING + ", options.connect needs options.sight");
+                return false;
+            }
+            response_callback = this.#sight(this, response_callback, options);
+            if (response_callback === null) return false;
+        }
+        return this.#scanner.startScan(response_callback, options);
+    }
+    /**
+     * Stops scanning for devices.
+     * @returns {boolean} Returns true if the call to stop the scan succeeded, false if it failed.
+     */
+    stopScan() {
+        return this.#scanner.stopScan();
+    }
+    /**
+     * Connects to a device.
+     * @param {string} dev_addr - The MAC address of the device to connect to.
+     * @param {Function} response_callback - The callback function that will be called with the result of the connection attempt.
+     * @param {Object} [options={}] - Optional parameters.
+     * @param {CancelToken} [options.signal] - Cancelling it abandons a pending connection attempt (without calling back)
+     * or stops the device once connected.
+     * @param {number} [options.priority=0] - With options.admission, higher priorities reach the backend first.
+     * @returns {boolean} Returns true if the call to connect to the device succeeded (with options.admission: was queued), false if it failed.
+     */
+    connect(dev_addr, response_callback, options = {}) {
+        if (this.#admission) return this.#admission.connect(dev_addr, response_callback, options);
+        return this.#connections.connect(dev_addr, response_callback, options);
+    }
+    /**
+     * Runs a scene: writes to several devices at once under one deadline, e.g. every lamp off when leaving home.
+     * The devices run in parallel, each one is connected (through options.admission if enabled) and gets its profile
+     * if it has none yet, then its writes are issued in order, each after the previous one completed.
+     * @param {Object[]} commands - { dev_addr, uuid, data } for a characteristic or { dev_addr, chara, desc, data } for
+     * a descriptor write, optionally with the device's profile object. data as for write.characteristic.
+     * @param {Function} response_callback - Called once with { done, elapsed, devices }. done is true if every device
+     * succeeded, devices maps each MAC to { result: "ok" | "failed" | "timeout", step, writes, error }: step is where it
+     * ended ("connect", "prepare", "write" or "done"), writes the number of completed writes, error the connect result,
+     * the backend status or the error message of the call that failed.
+     * @param {Object} [options={}] - Optional parameters.
+     * @param {Object|Function} [options.profile] - The profile object (or a function MAC > profile object) for devices
+     * without a profile, modified with modifyProfileObject.
+     * @param {number} [options.timeout=10000] - The deadline in millis for the whole scene, the devices not done by then time out.
+     * @param {boolean} [options.stop=false] - Stops every device once its writes completed.
+     * @param {number} [options.priority] - The connects' priority with options.admission.
+     * @param {CancelToken} [options.signal] - Cancelling it abandons the scene without calling back.
+     * A device that fails or times out is stopped if the scene connected it.
+     * @returns {boolean} Returns true if the scene started, false if a command is invalid or the signal is already cancelled.
+     */
+    scene(commands, response_callback, options = {}) {
+        if (!this.#scene) {
+            logger.error(ERR_FEATURE_MISSING + ", scene() needs options.scene");
+            return false;
+        }
+        return this.#scene(this, this.#clock, this.#taps, commands, response_callback, options);
+    }
+    /**
+     * Disconnects from a device.
+     * @param {string} dev_addr - The MAC address of the device to disconnect from.
+     * @returns {boolean} Returns true if the call to disconnect from the device succeeded, false if it failed or if the device was not connected.
+     */
+    disconnect(dev_addr) {
+        return this.#connections.disconnect(dev_addr);
+    }
+    /**
+     * Pairs with a device.
+     * @param {string} dev_addr - The MAC address of the device to pair with.
+     * @returns {boolean} Returns true if the call to pair with the device succeeded, false if it failed or if the device was not connected.
+     */
+    pair(dev_addr) {
+        return this.#connections.pair(dev_addr);
+    }
+    /**
+     * Starts listening for profile preparation events and builds a profile for interaction with a device.
+     * @param {Object} profile_object - The profile object that describes how to interact with the device.
+     * @param {Function} response_callback - The callback function that will be called when a profile preparation event occurs.
+     * Receives the backend status (0 = OK), STATUS.TIMEOUT when the backend did not answer in time or STATUS.REJECTED
+     * when it refused to build the profile.
+     * @param {Object} [options={}] - Optional parameters.
+     * @param {CancelToken} [options.signal] - Cancelling it abandons the profile preparation (without calling back)
+     * or stops the device once the profile is ready.
+     * @returns {Object} Returns an object with a 'success' property indicating whether the call succeeded and an 'error' property containing an error message if the call failed.
+     */
+    startListener(profile_object, response_callback, options = {}) {
+        return this.#profiles.startListener(profile_object, response_callback, options);
+    }
+    /**
+     * Temporary replacement for the generateProfileObject function. 
+     * Modifies a profile object with required values for a device. Works for scanned devices, connected ones and,
+     * with options.known, for known devices that were neither scanned nor connected in this launch.
+     * @param {string} dev_addr - The MAC address of the device.
+     * @param {Object} profile_object - The profile object to be modified.
+     * @returns {Object|null} Returns the modified profile object for the device, or null if the device was not found.
+     */
+    modifyProfileObject(dev_addr, profile_object) {
+        return this.#profiles.modifyProfileObject(dev_addr, profile_object);
+    }
+    /**
+     * @warning [NOT IMPLEMENTED] Generates a generic profile object for a device.
+     * @param {string} dev_addr - The MAC address of the device.
+     * @returns {Object|null} Returns a generic profile object for the device, or null if the device was not found.
+     */
+    generateProfileObject(dev_addr) {
+        return this.#profiles.generateProfileObject(dev_addr);
+    }
+    /**
+     * Stops all interactions with a device.
+     * @param {string} dev_addr - The MAC address of the device.
+     */
+    stop(dev_addr) {
+        this.#connections.stop(dev_addr);
+    }
+}
@@ -0,0 +1,61 @@
+/**
+ * Stand-in for diagnostics.js in builds without diagnostics: no trace, no stats, no watchdog.
+ * Only the cancel token wiring of Monitor.start is kept, pending operations still need it to be abandoned.
+ */
+import { METRIC_WRITE, noop, metricOf } from './core.js'
+
+const MAX_PENDING_PER_KEY = 16;
+
+export function createMonitor() {
+    return new QuietMonitor();
+}
+
+class QuietMonitor {
+    trace = null;
+    onRecycle = null;
+    #cancels = Array.from({ length: METRIC_WRITE + 1 }, () => new Map()); // key > [{ dispose }], oldest first, per metric
+
+    start(op, dev_addr, key, on_expire, signal, on_cancel) {
+        const metric = metricOf(op);
+        const entry = { dispose: noop };
+        const queue = this.#cancels[metric].get(key);
+        if (queue === undefined) this.#cancels[metric].set(key, [entry]);
+        else if (queue.push(entry) > MAX_PENDING_PER_KEY) this.#settle(metric, key); // no watchdog here, bounds what a silent backend leaves
+        if (!signal) return;
+        const cancel = () => {
+            this.#remove(metric, key, entry);
+            if (on_cancel) on_cancel();
+        };
+        signal.addEventListener("abort", cancel);
+        entry.dispose = () => signal.removeEventListener("abort", cancel);
+    }
+    issued(op, dev_addr, success, size = 0, key = dev_addr) {
+        if (!success) this.#settle(metricOf(op), key, true);
+    }
+    completed(op, dev_addr, status, size = 0, key = dev_addr) {
+        this.#settle(metricOf(op), key);
+    }
+    event() {}
+    error() {}
+    sample() {}
+    reset() {}
+    stats() {
+        return { counters: {}, latency: {}, errors: {} };
+    }
+    #settle(metric, key, newest = false) { // like Monitor: results settle the oldest operation on a key
+        if (metric < 0) return;
+        const queue = this.#cancels[metric].get(key);
+        if (queue === undefined) return;
+        const entry = newest ? queue.pop() : queue.shift();
+        if (queue.length === 0) this.#cancels[metric].delete(key);
+        entry.dispose();
+    }
+    #remove(metric, key, entry) {
+        const queue = this.#cancels[metric].get(key);
+        const index = queue === undefined ? -1 : queue.indexOf(entry);
+        if (index < 0) return;
+        queue.splice(index, 1);
+        if (queue.length === 0) this.#cancels[metric].delete(key);
+        entry.dispose();
+    }
+}
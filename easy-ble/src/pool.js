@@ -0,0 +1,194 @@
+/**
+ * Connection pool: links stay open between commands, up to a maximum number of devices. A link without reads, writes
+ * or notifications for the idle period is closed, and a connect that needs a slot evicts the least recently used link.
+ */
+import { SYSTEM_CLOCK, CONNECT_STATUS_OK, CONNECT_STATUS_DISCONNECTED } from './core.js'
+import { logger } from './log.js'
+import { MAC_BYTES, ab2mac } from './codecs.js'
+
+const DEFAULT_POOL = {
+    max: 4,         // links held at once, connects in flight included
+    idle: 30000,    // millis without activity before a link is closed, 0 keeps links until evicted
+};
+
+// the backend surface the wrapper forwards
+const POOL_PASS_THROUGH = ["mstStartScan", "mstStopScan", "mstPair", "mstOnPrepare", "mstDestroyProfileInstance", "mstOffAllCb"];
+const POOL_OPS = ["mstReadCharacteristic", "mstReadDescriptor", "mstWriteCharacteristic", "mstWriteDescriptor"];
+const POOL_ARRIVALS = ["mstOnCharaReadComplete", "mstOnCharaValueArrived", "mstOnCharaWriteComplete", "mstOnDescReadComplete",
+    "mstOnDescValueArrived", "mstOnDescWriteComplete", "mstOnCharaNotification"];
+
+/**
+ * Keeps the links of one BLEMaster within options.pool. Created by new BLEMaster({ pool }), read through ble.pool.
+ */
+export class ConnectionPool {
+    #clock;
+    #options;
+    #resolve = null;        // profile > MAC
+    #stop = null;           // MAC > void, closes a link
+    #links = new Map();     // connect_id > MAC
+    #recent = new Map();    // MAC > millis of its last activity, least recently used first
+    #connecting = new Map(); // MAC > the connect in flight, its slot is held until the backend answers or it is abandoned
+    #timer = null;
+    #totals = { connects: 0, evicted: 0, idle_closed: 0, rejected: 0 };
+
+    /**
+     * @param {Object} [options={}] - See BLEMaster's options.pool.
+     * @param {Object} [clock] - { now, setTimeout, clearTimeout }.
+     */
+    constructor(options = {}, clock = SYSTEM_CLOCK) {
+        this.#clock = clock;
+        this.#options = { ...DEFAULT_POOL, ...options };
+    }
+    /**
+     * @type {number} The number of links the pool holds.
+     */
+    get size() {
+        return this.#recent.size;
+    }
+    /**
+     * @returns {Array<string>} Returns the MACs of the pooled devices, least recently used first (the next one to be evicted).
+     */
+    devices() {
+        return Array.from(this.#recent.keys());
+    }
+    /**
+     * @returns {Object} Returns { size, max, idle, connects, evicted, idle_closed, rejected }, the totals count since creation.
+     */
+    report() {
+        return { size: this.#recent.size, max: this.#options.max, idle: this.#options.idle, ...this.#totals };
+    }
+    /**
+     * Frees the slot of a connect the library gave up on (watchdog expiry or cancel), the backend may never answer it.
+     * A late connection is still counted until it is closed. Used by BLEMaster.
+     * @param {string} dev_addr - The MAC address of the device.
+     */
+    abandon(dev_addr) {
+        this.#connecting.delete(dev_addr);
+    }
+    /**
+     * Wraps a backend so links are counted and their use is tracked. Used by BLEMaster.
+     * @param {Object} target - @zos/ble or any transport.
+     * @param {Function} resolve - profile > MAC of its device.
+     * @param {Function} stop - Closes the link of a MAC (BLEMaster.stop).
+     * @returns {Object} Returns the pooled transport.
+     */
+    wrap(target, resolve, stop) {
+        this.#resolve = resolve;
+        this.#stop = stop;
+        const transport = {};
+        for (const name of POOL_PASS_THROUGH) transport[name] = (...args) => target[name](...args);
+        for (const name of POOL_OPS) {
+            transport[name] = (profile, ...args) => {
+                this.#touch(this.#resolve(profile));
+                return target[name](profile, ...args);
+            };
+        }
+        for (const name of POOL_ARRIVALS) {
+            transport[name] = (callback) => target[name]((response) => {
+                if (response) this.#touch(this.#resolve(response.profile));
+                callback(response);
+            });
+        }
+        transport.mstBuildProfile = (profile_object) => {
+            this.#touch(macOf(profile_object && profile_object.dev));
+            return target.mstBuildProfile(profile_object);
+        };
+        transport.mstConnect = (dev_addr, callback) => {
+            const mac = macOf(dev_addr);
+            if (mac !== null && !this.#admit(mac)) return false;
+            const attempt = {};
+            if (mac !== null) this.#connecting.set(mac, attempt);
+            const settle = () => { // a newer connect to the same device keeps its slot
+                if (this.#connecting.get(mac) === attempt) this.#connecting.delete(mac);
+            };
+            const success = target.mstConnect(dev_addr, (result) => {
+                settle();
+                if (result) this.#connectResult(result);
+                callback(result);
+            });
+            if (!success) settle();
+            return success;
+        };
+        transport.mstDisconnect = (connect_id) => {
+            const success = target.mstDisconnect(connect_id);
+            if (success) this.#unlink(connect_id);
+            return success;
+        };
+        return transport;
+    }
+
+    /* SLOTS */
+
+    #admit(dev_addr) { // makes room for a connect to dev_addr, false if every slot is a connect in flight
+        if (this.#recent.has(dev_addr) || this.#connecting.has(dev_addr)) return true;
+        while (this.#recent.size + this.#connecting.size >= this.#options.max) {
+            const oldest = this.#recent.keys().next();
+            if (oldest.done) {
+                logger.warn(`eBLE: Connection pool full, ${this.#options.max} connects in flight, ${dev_addr} rejected`);
+                this.#totals.rejected++;
+                return false;
+            }
+            logger.info(() => `eBLE: Connection pool full, evicting ${oldest.value} for ${dev_addr}`);
+            this.#totals.evicted++;
+            this.#close(oldest.value);
+        }
+        return true;
+    }
+    #connectResult(result) {
+        if (result.connected === CONNECT_STATUS_OK) {
+            const dev_addr = macOf(result.dev_addr);
+            if (dev_addr === null) return;
+            this.#totals.connects++;
+            this.#links.set(result.connect_id, dev_addr);
+            this.#recent.delete(dev_addr);
+            this.#recent.set(dev_addr, this.#clock.now());
+            this.#schedule();
+        } else if (result.connected === CONNECT_STATUS_DISCONNECTED) {
+            this.#unlink(result.connect_id);
+        }
+    }
+    #unlink(connect_id) {
+        const dev_addr = this.#links.get(connect_id);
+        if (dev_addr === undefined) return;
+        this.#links.delete(connect_id);
+        this.#recent.delete(dev_addr);
+    }
+    #touch(dev_addr) { // moves a pooled device to the most recently used end
+        if (dev_addr === null || !this.#recent.delete(dev_addr)) return;
+        this.#recent.set(dev_addr, this.#clock.now());
+    }
+    #close(dev_addr) {
+        this.#recent.delete(dev_addr);
+        for (const [connect_id, linked] of this.#links) {
+            if (linked === dev_addr) this.#links.delete(connect_id);
+        }
+        this.#stop(dev_addr);
+    }
+
+    /* IDLE REAPER */
+
+    #schedule() { // one timer, due when the least recently used link turns idle
+        const idle = this.#options.idle;
+        if (this.#timer !== null || !idle) return;
+        const oldest = this.#recent.values().next();
+        if (oldest.done) return;
+        this.#timer = this.#clock.setTimeout(() => {
+            this.#timer = null;
+            this.#reap();
+            this.#schedule();
+        }, Math.max(0, oldest.value + idle - this.#clock.now()));
+    }
+    #reap() {
+        const now = this.#clock.now();
+        for (const [dev_addr, active_at] of Array.from(this.#recent)) {
+            if (now - active_at < this.#options.idle) break; // the rest were used more recently
+            logger.info(() => `eBLE: Closing idle link to ${dev_addr}`);
+            this.#totals.idle_closed++;
+            this.#close(dev_addr);
+        }
+    }
+}
+
+function macOf(dev_addr) {
+    return dev_addr instanceof ArrayBuffer && dev_addr.byteLength === MAC_BYTES ? ab2mac(dev_addr) : null;
+}
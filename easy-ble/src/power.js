@@ -0,0 +1,357 @@
+/**
+ * Power budget: meters radio use (scan time, held links, reads/writes/notifications) against an energy budget over a
+ * rolling window and degrades gracefully when it runs low: duty-cycled scans, longer polling intervals, idle links closed.
+ * A spent budget is enforced until the window frees some of it: scans pause, every link is closed, connects and
+ * reads/writes are refused.
+ */
+import { SYSTEM_CLOCK, CONNECT_STATUS_OK, CONNECT_STATUS_DISCONNECTED } from './core.js'
+import { logger } from './log.js'
+import { MAC_BYTES, ab2mac } from './codecs.js'
+
+export const POWER_LEVEL = {
+    NORMAL: 0,
+    SAVING: 1,
+    CRITICAL: 2,
+};
+
+const POWER_BUCKETS                 = 60;   // the window is metered in this many slices
+const POWER_HYSTERESIS              = 0.05; // a level is left this far below its threshold, so it does not flap
+
+// energy units: one unit is one second of scanning
+const DEFAULT_POWER = {
+    budget: 600,            // units per window, 10 minutes of scanning per hour
+    window: 3600000,        // millis
+    costs: { scan: 1, link: 0.05, op: 0.02 }, // per second of scanning, per second per held link, per read/write/notification
+    saving_at: 0.7,         // fraction of the budget used
+    critical_at: 0.9,
+    check_interval: 10000,  // millis between two checks while the radio is in use
+    scan_period: 10000,     // millis, one duty cycle
+    scan_duty: [1, 0.4, 0.1],           // share of each scan period the radio listens, per level
+    poll_factor: [1, 2, 4],             // interval() multiplier per level
+    idle_close: [0, 60000, 15000],      // millis without reads/writes/notifications before a link is closed, per level (0 = never)
+};
+
+// the backend surface the wrapper forwards
+const POWER_PASS_THROUGH = ["mstPair", "mstBuildProfile", "mstOnPrepare", "mstDestroyProfileInstance", "mstOffAllCb",
+    "mstOnCharaReadComplete", "mstOnCharaWriteComplete", "mstOnDescReadComplete", "mstOnDescValueArrived", "mstOnDescWriteComplete"];
+const POWER_OPS = ["mstReadCharacteristic", "mstReadDescriptor", "mstWriteCharacteristic", "mstWriteDescriptor"];
+const POWER_ARRIVALS = ["mstOnCharaValueArrived", "mstOnCharaNotification"];
+
+/**
+ * Meters and enforces the energy budget of one BLEMaster. Created by new BLEMaster({ power }), read through ble.power.
+ */
+export class PowerBudget {
+    #clock;
+    #options;
+    #buckets = new Float64Array(POWER_BUCKETS);
+    #bucket_millis;
+    #bucket = 0;        // index of the current bucket since the epoch
+    #accrued_at;
+    #level = POWER_LEVEL.NORMAL;
+    #exhausted = false; // the whole budget is spent, the radio stays off until the window frees some
+    #reserve;           // units kept back so a last operation and the value that answers it fit the budget
+    #timer = null;
+    #timer_at = 0;      // millis the check timer fires at
+    #target = null;
+    #resolve = null;    // profile > MAC
+    #stop = null;       // MAC > void, closes a link
+    #links = new Map(); // connect_id > MAC
+    #active = new Map(); // MAC > millis of its last read, write or notification
+    #scan_callback = null;
+    #scan_wanted = false;
+    #radio_on = false;
+    #duty_timer = null;
+    #totals = { scan_millis: 0, link_millis: 0, ops: 0, duty_pauses: 0, idle_closed: 0, refused: 0 };
+
+    /**
+     * @param {Object} [options={}] - See BLEMaster's options.power.
+     * @param {Object} [clock] - { now, setTimeout, clearTimeout }.
+     */
+    constructor(options = {}, clock = SYSTEM_CLOCK) {
+        this.#clock = clock;
+        this.#options = { ...DEFAULT_POWER, ...options, costs: { ...DEFAULT_POWER.costs, ...options.costs } };
+        this.#bucket_millis = this.#options.window / POWER_BUCKETS;
+        this.#reserve = 2 * this.#options.costs.op; // a read is charged again when its value arrives
+        this.#accrued_at = clock.now();
+        this.#bucket = Math.floor(this.#accrued_at / this.#bucket_millis);
+    }
+    /**
+     * @type {number} The current POWER_LEVEL.
+     */
+    get level() {
+        return this.#level;
+    }
+    /**
+     * @type {number} Energy units spent in the current window.
+     */
+    get used() {
+        this.#accrue();
+        let sum = 0;
+        for (let i = 0; i < POWER_BUCKETS; i++) sum += this.#buckets[i];
+        return sum;
+    }
+    /**
+     * @type {number} Energy units left in the current window, 0 when overspent.
+     */
+    get remaining() {
+        return Math.max(0, this.#options.budget - this.used);
+    }
+    /**
+     * Stretches a polling interval by the current level's poll_factor. Use it for every periodic read of the app.
+     * @param {number} millis - The interval at POWER_LEVEL.NORMAL.
+     * @returns {number} Returns the interval to use now.
+     */
+    interval(millis) {
+        return millis * this.#options.poll_factor[this.#level];
+    }
+    /**
+     * @type {boolean} True while the whole budget is spent: scans are paused, links closed, connects and reads/writes refused.
+     */
+    get exhausted() {
+        return this.#exhausted;
+    }
+    /**
+     * @returns {Object} Returns { level, exhausted, used, budget, scan_millis, link_millis, ops, duty_pauses, idle_closed, refused,
+     * links }, the totals count since creation (or reset()), used is the current window.
+     */
+    report() {
+        const used = this.used;
+        return { level: this.#level, exhausted: this.#exhausted, used, budget: this.#options.budget, ...this.#totals, links: this.#links.size };
+    }
+    /**
+     * Forgets the spent energy and the totals, back to POWER_LEVEL.NORMAL.
+     */
+    reset() {
+        this.#accrue();
+        this.#buckets.fill(0);
+        for (const key in this.#totals) this.#totals[key] = 0;
+        this.#check();
+    }
+    /**
+     * Records energy spent outside the library (e.g. an app's own sensor use) against the same budget.
+     * @param {number} units - Energy units, one unit is one second of scanning.
+     */
+    spend(units) {
+        this.#accrue();
+        this.#spend(units);
+        this.#check();
+        this.#schedule(true);
+    }
+    /**
+     * Wraps a backend so every scan, link and operation is metered, and refused while the budget is spent. Used by BLEMaster.
+     * @param {Object} target - @zos/ble or any transport.
+     * @param {Function} resolve - profile > MAC of its device.
+     * @param {Function} stop - Closes the link of a MAC (BLEMaster.stop).
+     * @returns {Object} Returns the metered transport.
+     */
+    wrap(target, resolve, stop) {
+        this.#target = target;
+        this.#resolve = resolve;
+        this.#stop = stop;
+        const transport = {};
+        for (const name of POWER_PASS_THROUGH) transport[name] = (...args) => target[name](...args);
+        for (const name of POWER_OPS) {
+            transport[name] = (profile, ...args) => {
+                if (!this.#admit("operation")) return false;
+                this.#operation(profile);
+                return target[name](profile, ...args);
+            };
+        }
+        for (const name of POWER_ARRIVALS) {
+            transport[name] = (callback) => target[name]((response) => {
+                if (response) this.#operation(response.profile);
+                callback(response);
+            });
+        }
+        transport.mstStartScan = (callback) => this.#startScan(callback);
+        transport.mstStopScan = () => this.#stopScan();
+        transport.mstConnect = (dev_addr, callback) => {
+            if (!this.#admit("connect")) return false;
+            return target.mstConnect(dev_addr, (result) => {
+                if (result) this.#connectResult(result);
+                callback(result);
+            });
+        };
+        transport.mstDisconnect = (connect_id) => {
+            const success = target.mstDisconnect(connect_id);
+            if (success) this.#unlink(connect_id);
+            return success;
+        };
+        return transport;
+    }
+
+    /* METERING */
+
+    #accrue() { // charges the time since the last call to the radio state of that time
+        const now = this.#clock.now();
+        const seconds = (now - this.#accrued_at) / 1000;
+        if (seconds <= 0) return;
+        this.#accrued_at = now;
+        const costs = this.#options.costs;
+        if (this.#radio_on) this.#totals.scan_millis += seconds * 1000;
+        this.#totals.link_millis += seconds * 1000 * this.#links.size;
+        this.#spend(seconds * ((this.#radio_on ? costs.scan : 0) + this.#links.size * costs.link));
+    }
+    #spend(units) {
+        const bucket = Math.floor(this.#clock.now() / this.#bucket_millis);
+        for (let b = Math.max(this.#bucket + 1, bucket - POWER_BUCKETS + 1); b <= bucket; b++) this.#buckets[b % POWER_BUCKETS] = 0;
+        this.#bucket = Math.max(this.#bucket, bucket);
+        this.#buckets[bucket % POWER_BUCKETS] += units;
+    }
+    #operation(profile) {
+        this.#accrue();
+        this.#totals.ops++;
+        this.#spend(this.#options.costs.op);
+        const dev_addr = this.#resolve(profile);
+        if (dev_addr) this.#active.set(dev_addr, this.#clock.now());
+        this.#schedule(true);
+    }
+    #admit(what) { // false while the budget is spent
+        this.#accrue();
+        if (this.#exhausted) this.#check(); // the window may have freed some
+        if (!this.#exhausted && this.used < this.#options.budget - this.#reserve) return true;
+        this.#schedule(true); // spent between two checks, the next one closes the links now
+        logger.info(() => `eBLE: Power budget spent, ${what} refused`);
+        this.#totals.refused++;
+        return false;
+    }
+    #connectResult(result) {
+        this.#accrue();
+        if (result.connected === CONNECT_STATUS_OK) {
+            const dev_addr = result.dev_addr instanceof ArrayBuffer && result.dev_addr.byteLength === MAC_BYTES ? ab2mac(result.dev_addr) : null;
+            if (dev_addr === null) return;
+            this.#links.set(result.connect_id, dev_addr);
+            this.#active.set(dev_addr, this.#clock.now());
+            this.#schedule(true);
+        } else if (result.connected === CONNECT_STATUS_DISCONNECTED) {
+            this.#unlink(result.connect_id);
+        }
+    }
+    #unlink(connect_id) {
+        const dev_addr = this.#links.get(connect_id);
+        if (dev_addr === undefined) return;
+        this.#accrue();
+        this.#links.delete(connect_id);
+        this.#active.delete(dev_addr);
+    }
+
+    /* SCAN DUTY CYCLE */
+
+    #startScan(callback) {
+        this.#scan_callback = callback;
+        this.#check(); // the level may have recovered while nothing was metered
+        if (this.#exhausted) { // starts once the window frees some budget
+            this.#scan_wanted = true;
+            this.#schedule();
+            return true;
+        }
+        const success = this.#target.mstStartScan(callback);
+        this.#scan_wanted = success;
+        this.#radio(success);
+        this.#duty();
+        this.#schedule(true);
+        return success;
+    }
+    #stopScan() {
+        this.#scan_wanted = false;
+        this.#clock.clearTimeout(this.#duty_timer);
+        this.#duty_timer = null;
+        if (!this.#radio_on) return true; // paused by the duty cycle
+        this.#radio(false);
+        return this.#target.mstStopScan();
+    }
+    #radio(on) {
+        this.#accrue();
+        this.#radio_on = on;
+    }
+    #duty() { // (re)starts the duty cycle of the current level from the current radio state
+        this.#clock.clearTimeout(this.#duty_timer);
+        this.#duty_timer = null;
+        if (!this.#scan_wanted) return;
+        const duty = this.#exhausted ? 0 : this.#options.scan_duty[this.#level];
+        if (duty <= 0) {
+            if (this.#radio_on) {
+                this.#radio(false);
+                this.#target.mstStopScan();
+                this.#totals.duty_pauses++;
+            }
+            return;
+        }
+        if (duty >= 1) {
+            if (!this.#radio_on && this.#target.mstStartScan(this.#scan_callback)) {
+                this.#radio(true);
+                this.#schedule(true);
+            }
+            return;
+        }
+        const period = this.#options.scan_period;
+        this.#duty_timer = this.#clock.setTimeout(() => {
+            this.#duty_timer = null;
+            if (!this.#scan_wanted) return;
+            if (this.#radio_on) {
+                this.#radio(false);
+                this.#target.mstStopScan();
+                this.#totals.duty_pauses++;
+            } else if (this.#target.mstStartScan(this.#scan_callback)) {
+                this.#radio(true);
+                this.#schedule(true);
+            }
+            this.#duty();
+        }, this.#radio_on ? period * duty : period * (1 - duty));
+    }
+
+    /* POLICY */
+
+    #schedule(sooner = false) { // checks run while the radio is in use, the next one no later than the budget would be spent
+        if ((this.#timer !== null && !sooner) || (!this.#scan_wanted && this.#links.size === 0)) return;
+        const costs = this.#options.costs;
+        const rate = (this.#radio_on ? costs.scan : 0) + this.#links.size * costs.link; // units per second
+        const left = this.#options.budget - this.#reserve - this.used;
+        const delay = rate > 0 && !this.#exhausted ? Math.min(this.#options.check_interval, Math.max(0, Math.ceil(left / rate * 1000))) : this.#options.check_interval;
+        if (this.#timer !== null) { // a spend or a new drain only ever brings the check forward
+            if (this.#timer_at <= this.#clock.now() + delay) return;
+            this.#clock.clearTimeout(this.#timer);
+        }
+        this.#timer_at = this.#clock.now() + delay;
+        this.#timer = this.#clock.setTimeout(() => {
+            this.#timer = null;
+            this.#check();
+            this.#schedule();
+        }, delay);
+    }
+    #check() {
+        const used = this.used;
+        const fraction = used / this.#options.budget;
+        const { saving_at, critical_at } = this.#options;
+        let level = this.#level;
+        if (fraction >= critical_at) level = POWER_LEVEL.CRITICAL;
+        else if (fraction >= saving_at) level = Math.max(level, POWER_LEVEL.SAVING);
+        if (level === POWER_LEVEL.CRITICAL && fraction < critical_at - POWER_HYSTERESIS) level = POWER_LEVEL.SAVING;
+        if (level === POWER_LEVEL.SAVING && fraction < saving_at - POWER_HYSTERESIS) level = POWER_LEVEL.NORMAL;
+        const exhausted = used >= this.#options.budget - this.#reserve || (this.#exhausted && fraction >= 1 - POWER_HYSTERESIS);
+        if (exhausted !== this.#exhausted) {
+            logger.info(() => `eBLE: Power budget ${exhausted ? "spent, radio off" : "available again"}`);
+            this.#exhausted = exhausted;
+            this.#duty();
+        }
+        if (level !== this.#level) {
+            logger.info(() => `eBLE: Power level ${this.#level} > ${level}, ${(fraction * 100).toFixed(0)}% of the budget used`);
+            this.#level = level;
+            this.#duty();
+            if (this.#options.on_level) this.#options.on_level(level, this.report());
+        }
+        this.#closeIdle();
+    }
+    #closeIdle() { // every link once the budget is spent
+        const idle = this.#exhausted ? 0 : this.#options.idle_close[this.#level];
+        if (!idle && !this.#exhausted) return;
+        const now = this.#clock.now();
+        for (const [dev_addr, active_at] of Array.from(this.#active)) {
+            if (now - active_at < idle) continue;
+            logger.info(() => this.#exhausted ? `eBLE: Power budget spent, closing link to ${dev_addr}` : `eBLE: Power saving, closing idle link to ${dev_addr}`);
+            this.#active.delete(dev_addr);
+            this.#totals.idle_closed++;
+            this.#stop(dev_addr);
+        }
+    }
+}
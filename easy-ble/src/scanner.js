@@ -0,0 +1,77 @@
+/**
+ * Entry of the scan-only bundle (dist/ble-scan.js).
+ */
+import * as hmBle from '@zos/ble'
+import { SYSTEM_CLOCK } from './core.js'
+import { logger } from './log.js'
+import { createRegistry, Get } from './registry.js'
+import { createMonitor } from './diagnostics.js'
+import { Scanner } from './scan.js'
+
+/**
+ * Scan-only BLE Master for pages that look for devices but never connect (presence, beacons, sensor tags).
+ * startScan, stopScan and get behave exactly like BLEMaster's, connections and GATT are not part of this build.
+ */
+class BLEScanner {
+    #registry;
+    #monitor;
+    #scanner;
+
+    /**
+     * Creates a new BLE Scanner instance.
+     * @param {Object} [options={}] - Optional parameters, the scan related subset of BLEMaster's: registry, capacity, trace, transport and clock.
+     */
+    constructor(options = {}){
+        const ble = options.transport || hmBle;
+        const clock = options.clock || SYSTEM_CLOCK;
+        this.#registry = createRegistry(options, clock);
+        this.#monitor = createMonitor(options, clock);
+        this.#scanner = new Scanner(ble, clock, this.#registry, this.#monitor);
+    }
+    /**
+     * @type {TraceRecorder|null} The operation trace recorder, or null if tracing was not enabled with options.trace.
+     */
+    get trace() {
+        return this.#monitor.trace;
+    }
+    /**
+     * @type {Get} A device information getter.
+     */
+    get get() {
+        return new Get(this.#registry, this.#monitor);
+    }
+    /**
+     * Resets all counters and latency histograms reported by get.stats().
+     */
+    resetStats() {
+        this.#monitor.reset();
+    }
+    /**
+     * Sets the library-wide log level. Messages above this level are neither formatted nor printed.
+     * @param {number} level - One of LOG_LEVEL.NONE, ERROR, WARN (default), INFO or DEBUG.
+     */
+    static setLogLevel(level) {
+        logger.level = level;
+    }
+    /**
+     * Starts scanning for devices. Same as BLEMaster.startScan.
+     * @param {Function} response_callback - The callback function that will be called with the scan result for each device.
+     * @param {Object} [options={}] - { duration, on_duration, signal, filter }, see BLEMaster.startScan.
+     * @returns {boolean} Returns true if the call to start the scan succeeded, false if it failed.
+     */
+    startScan(response_callback, options = {}) {
+        return this.#scanner.startScan(response_callback, options);
+    }
+    /**
+     * Stops scanning for devices.
+     * @returns {boolean} Returns true if the call to stop the scan succeeded, false if it failed.
+     */
+    stopScan() {
+        return this.#scanner.stopScan();
+    }
+}
+
+export { LOG_LEVEL } from './log.js'
+export { STATUS, TRACE_OP, CancelToken } from './core.js'
+export { ab2mac, mac2ab, ab2str_stripped, data2ab, str2ab_with_len } from './codecs.js'
+export default BLEScanner;
@@ -0,0 +1,158 @@
+/**
+ * Scenes: a list of writes across several devices, run in parallel under one deadline. Each device is connected and
+ * gets its profile if it needs them, then its writes run in order, each one waiting for its completion.
+ */
+import { ERR_INVALID_SCENE, ERR_INVALID_PROFILE, CONNECT_STATUS_OK, CONNECT_STATUS_FAILED, CancelToken } from './core.js'
+import { logger } from './log.js'
+import { normalizeMac, data2ab } from './codecs.js'
+
+const DEFAULT_SCENE_TIMEOUT = 10000; // millis
+
+/**
+ * Runs a scene. Used by BLEMaster.scene, see there for the commands, options and the report.
+ * @param {Object} ble - The BLEMaster that runs it: connect, startListener, modifyProfileObject, write, get, stop.
+ * @param {Object} clock - { now, setTimeout, clearTimeout }.
+ * @param {Set} taps - The library's listeners on the ble.on callbacks, the scene adds one while it runs.
+ * @returns {boolean} Returns true if the scene started, false if a command is invalid or the signal is already cancelled.
+ */
+export function runScene(ble, clock, taps, commands, response_callback, options = {}) {
+    const plan = planScene(commands);
+    if (plan === null) {
+        logger.error(ERR_INVALID_SCENE);
+        return false;
+    }
+    const signal = options.signal;
+    if (signal && signal.aborted) return false;
+    const start = clock.now();
+    const devices = {};
+    const runs = [];
+    let open = plan.size;
+    let finished = false;
+
+    const finish = () => {
+        finished = true;
+        clock.clearTimeout(deadline);
+        taps.delete(tap);
+        if (signal) signal.removeEventListener("abort", abort);
+        let done = true;
+        for (const run of runs) done = done && run.report.result === "ok";
+        response_callback({ done, elapsed: clock.now() - start, devices });
+    };
+    const settle = (run, result, error) => {
+        if (finished || run.report.result !== "pending") return;
+        run.report.result = result;
+        if (error !== undefined) run.report.error = error;
+        if (result !== "ok") run.token.cancel(); // drops what is still in flight, stops a device the scene connected
+        if (--open === 0 && !starting) finish();
+    };
+    const step = (run) => {
+        const report = run.report;
+        if (report.result !== "pending") return;
+        if (!ble.get.isConnected(run.dev_addr)) {
+            report.step = "connect";
+            let settled = false; // later callbacks of this connection report disconnects
+            const success = ble.connect(run.dev_addr, (result) => {
+                if (settled) return;
+                settled = true;
+                if (result.connected !== CONNECT_STATUS_OK) return settle(run, "failed", result.connected);
+                run.owner = true;
+                step(run);
+            }, { signal: run.token, priority: options.priority });
+            if (!success) settle(run, "failed", CONNECT_STATUS_FAILED);
+            return;
+        }
+        if (ble.get.device(run.dev_addr).profile_idp === undefined) {
+            report.step = "prepare";
+            const profile = run.profile || options.profile;
+            const profile_object = profile && ble.modifyProfileObject(run.dev_addr, typeof profile === "function" ? profile(run.dev_addr) : profile);
+            const listening = profile_object ? ble.startListener(profile_object, (status) => {
+                if (status !== 0) return settle(run, "failed", status);
+                step(run);
+            }, run.owner ? { signal: run.token } : {}) : { success: false, error: ERR_INVALID_PROFILE }; // the token would take over a device the page connected
+            if (!listening.success) settle(run, "failed", listening.error);
+            return;
+        }
+        const command = run.commands[report.writes];
+        if (command === undefined) {
+            report.step = "done";
+            if (options.stop) ble.stop(run.dev_addr);
+            return settle(run, "ok");
+        }
+        report.step = "write";
+        run.waiting = command;
+        const written = command.uuid !== undefined
+            ? ble.write.characteristic(run.dev_addr, command.uuid, command.data, { signal: run.token })
+            : ble.write.descriptor(run.dev_addr, command.chara, command.desc, command.data, { signal: run.token });
+        if (!written.success) {
+            run.waiting = null;
+            settle(run, "failed", written.error);
+        }
+    };
+    const tap = (name, response) => { // the write completions, matched to the write each device waits for
+        if (name !== "charaWriteComplete" && name !== "descWriteComplete") return;
+        const run = plan.get(response.dev_addr);
+        const command = run && run.waiting;
+        if (!command || !sameAttribute(command, response)) return;
+        run.waiting = null;
+        if (response.status !== 0) return settle(run, "failed", response.status);
+        run.report.writes++;
+        step(run);
+    };
+    const expire = () => {
+        for (const run of runs) {
+            if (run.report.result === "pending") {
+                run.report.result = "timeout";
+                run.token.cancel();
+            }
+        }
+        finish();
+    };
+    const abort = () => { // a cancelled scene does not call back
+        finished = true;
+        clock.clearTimeout(deadline);
+        taps.delete(tap);
+        for (const run of runs) run.token.cancel();
+    };
+
+    const deadline = clock.setTimeout(expire, options.timeout === undefined ? DEFAULT_SCENE_TIMEOUT : options.timeout);
+    if (signal) signal.addEventListener("abort", abort);
+    taps.add(tap);
+    let starting = true; // a scene that ends before runScene returns still calls back afterwards
+    for (const [dev_addr, run] of plan) {
+        run.dev_addr = dev_addr;
+        run.token = new CancelToken();
+        run.waiting = null;
+        run.owner = false; // the scene made the connect, so its token may stop the device
+        run.report = { result: "pending", step: "connect", writes: 0 };
+        devices[dev_addr] = run.report;
+        runs.push(run);
+    }
+    for (const run of runs) {
+        if (!finished) step(run);
+    }
+    starting = false;
+    if (open === 0 && !finished) clock.setTimeout(() => { if (!finished) finish(); }, 0);
+    return true;
+}
+
+function planScene(commands) { // MAC > { commands, profile }, in the order the devices first appear
+    if (!Array.isArray(commands) || commands.length === 0) return null;
+    const plan = new Map();
+    for (const command of commands) {
+        const dev_addr = command && normalizeMac(command.dev_addr);
+        if (!dev_addr || data2ab(command.data) === null) return null;
+        if (typeof command.uuid !== "string" && (typeof command.chara !== "string" || typeof command.desc !== "string")) return null;
+        let run = plan.get(dev_addr);
+        if (!run) plan.set(dev_addr, run = { commands: [], profile: undefined });
+        run.commands.push(command);
+        if (command.profile) run.profile = command.profile;
+    }
+    return plan;
+}
+
+function sameAttribute(command, response) {
+    const same = (a, b) => typeof b === "string" && a.toUpperCase() === b.toUpperCase();
+    return command.uuid !== undefined
+        ? response.uuid !== undefined && same(command.uuid, response.uuid)
+        : same(command.chara, response.chara) && same(command.desc, response.desc);
+}
@@ -0,0 +1,8 @@
+/**
+ * Entry of the background scanning bundle (dist/ble-background.js): ScanEngine for the app service, DeviceMirror for pages,
+ * the wire format between them.
+ */
+export { ScanEngine, DeviceMirror } from './background.js'
+export { WIRE_FORMAT, WireBatch, encodeFrame, decodeFrame } from './wire.js'
+export { LOG_LEVEL } from './log.js'
+export { STATUS, CancelToken } from './core.js'
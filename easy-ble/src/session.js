@@ -0,0 +1,394 @@
+/**
+ * App-scoped session: one BLEMaster that outlives page navigation. Pages attach a handle with the BLEMaster API
+ * and detach it in onDestroy, connections and profiles stay with the session.
+ */
+import { SYSTEM_CLOCK, ERR_DETACHED, ERR_CANCELLED, CONNECT_STATUS_OK, CancelToken, noop, notify } from './core.js'
+import { MAC_BYTES, ab2mac, normalizeMac } from './codecs.js'
+import { BLEMaster } from './master.js'
+import { On } from './gatt.js'
+import { connectOnSight } from './sight.js'
+
+const ON_CALLBACKS = ["charaReadComplete", "charaValueArrived", "charaWriteComplete", "descReadComplete", "descValueArrived", "descWriteComplete", "charaNotification"];
+
+export class BLESession {
+    #ble;
+    #handles = new Map(); // handle > its ble.on callbacks
+    #shared;
+
+    /**
+     * Creates the session. Keep it in app.js globalData (or an app service) and close it in the app's onDestroy.
+     * @param {Object} [options={}] - BLEMaster options (registry, capacity, trace, watchdog, transport, clock, power, pool, known, admission).
+     */
+    constructor(options = {}) {
+        this.#ble = new BLEMaster(options);
+        this.#shared = {
+            clock: options.clock || SYSTEM_CLOCK,
+            connects: new Map(),    // MAC > Set of { handle, callback }, the pages waiting for or holding a connection
+            connecting: new Set(),  // MACs with a connect in flight
+            prepares: new Map(),    // MAC > Set of { handle, callback }, the pages waiting for a profile
+            tokens: new Map(),      // MAC > CancelToken of the session's connect and profile, cancelled once no page holds the device
+            scans: new Map(),       // handle > scan callback
+            scan: (scan_result) => {
+                for (const callback of Array.from(this.#shared.scans.values())) callback(scan_result);
+            },
+        };
+        for (const name of ON_CALLBACKS) {
+            this.#ble.on[name]((response) => {
+                for (const callbacks of this.#handles.values()) notify(callbacks[name], response);
+            });
+        }
+    }
+    /**
+     * @type {number} The number of attached handles.
+     */
+    get size() {
+        return this.#handles.size;
+    }
+    /**
+     * @type {Get} The session's device information getter.
+     */
+    get get() {
+        return this.#ble.get;
+    }
+    /**
+     * @type {PowerBudget|null} The session's power budget (options.power).
+     */
+    get power() {
+        return this.#ble.power;
+    }
+    /**
+     * @type {ConnectionPool|null} The session's connection pool (options.pool).
+     */
+    get pool() {
+        return this.#ble.pool;
+    }
+    /**
+     * @type {KnownDevices|null} The session's known-devices store (options.known).
+     */
+    get known() {
+        return this.#ble.known;
+    }
+    /**
+     * @type {ConnectScheduler|null} The session's connection admission queue (options.admission).
+     */
+    get admission() {
+        return this.#ble.admission;
+    }
+    /**
+     * Attaches a page.
+     * @returns {SessionHandle} Returns a handle with the BLEMaster API, detach it in the page's onDestroy.
+     */
+    attach() {
+        const callbacks = {};
+        const handle = new SessionHandle(this.#ble, this.#shared, callbacks, () => this.#handles.delete(handle));
+        this.#handles.set(handle, callbacks);
+        return handle;
+    }
+    /**
+     * Detaches every page, stops the scan and stops every connected device.
+     */
+    close() {
+        for (const handle of Array.from(this.#handles.keys())) handle.detach();
+        const devices = this.#ble.get.devices();
+        for (const dev_addr in devices) {
+            if (devices[dev_addr].is_connected) this.#ble.stop(dev_addr);
+        }
+        this.#shared.connects.clear();
+        this.#shared.connecting.clear();
+        this.#shared.prepares.clear();
+        this.#shared.tokens.clear();
+    }
+}
+
+/**
+ * A page's view of a BLESession. Same methods as BLEMaster, with these differences:
+ * - connect() to a device the session is already connected to calls back right away with { connected: 0, reused: true },
+ *   concurrent connects to the same device share one backend connect
+ * - startListener() for a device that already has a profile calls back with 0 without building it again
+ *   (the first profile object wins, stop(dev_addr) to rebuild), concurrent ones share one build
+ * - scans are shared: the backend scan runs while at least one handle scans, options.filter only filters this handle's callbacks
+ * - ble.on.* callbacks are per handle, every attached handle receives every response
+ * - options.signal only releases this page's hold: the connect or profile is abandoned (or the device stopped)
+ *   once no other page waits for or holds the device
+ * - nothing calls back into a detached handle
+ */
+class SessionHandle {
+    #ble;
+    #shared;
+    #release;
+    #attached = true;
+    #scan_dispose = noop;
+
+    /**
+     * @type {Write} A device writer.
+     */
+    write;
+
+    /**
+     * @type {Read} A device reader.
+     */
+    read;
+
+    /**
+     * @type {On} Read, write and notification callbacks of this handle.
+     */
+    on;
+
+    constructor(ble, shared, callbacks, release) {
+        this.#ble = ble;
+        this.#shared = shared;
+        this.#release = release;
+        this.write = ble.write;
+        this.read = ble.read;
+        this.on = new On(callbacks);
+    }
+    /**
+     * @type {boolean} True until detach().
+     */
+    get attached() {
+        return this.#attached;
+    }
+    /**
+     * @type {Get} A device information getter.
+     */
+    get get() {
+        return this.#ble.get;
+    }
+    /**
+     * @type {PowerBudget|null} The session's power budget.
+     */
+    get power() {
+        return this.#ble.power;
+    }
+    /**
+     * @type {ConnectionPool|null} The session's connection pool.
+     */
+    get pool() {
+        return this.#ble.pool;
+    }
+    /**
+     * @type {KnownDevices|null} The session's known-devices store.
+     */
+    get known() {
+        return this.#ble.known;
+    }
+    /**
+     * @type {ConnectScheduler|null} The session's connection admission queue.
+     */
+    get admission() {
+        return this.#ble.admission;
+    }
+    /**
+     * @type {TraceRecorder|null} The session's trace recorder.
+     */
+    get trace() {
+        return this.#ble.trace;
+    }
+    resetStats() {
+        this.#ble.resetStats();
+    }
+    /**
+     * Starts scanning for devices, see BLEMaster.startScan.
+     */
+    startScan(response_callback, options = {}) {
+        const signal = options.signal;
+        if (!this.#attached || (signal && signal.aborted)) return false;
+        if (options.connect) {
+            response_callback = connectOnSight(this, response_callback, options);
+            if (response_callback === null) return false;
+        }
+        const shared = this.#shared;
+        const filter = options.filter;
+        this.#scan_dispose();
+        shared.scans.set(this, filter ? (scan_result) => { if (filter(scan_result)) response_callback(scan_result); } : response_callback);
+        if (shared.scans.size === 1 && !this.#ble.startScan(shared.scan)) {
+            shared.scans.delete(this);
+            return false;
+        }
+        let duration_timer = null;
+        if (options.duration !== undefined) {
+            duration_timer = shared.clock.setTimeout(() => {
+                this.stopScan();
+                if (options.on_duration) options.on_duration();
+            }, options.duration);
+        }
+        const stop = () => this.stopScan();
+        if (signal) signal.addEventListener("abort", stop);
+        this.#scan_dispose = () => {
+            this.#scan_dispose = noop;
+            shared.clock.clearTimeout(duration_timer);
+            if (signal) signal.removeEventListener("abort", stop);
+        };
+        return true;
+    }
+    /**
+     * Stops this handle's scan. The backend scan stops with the last scanning handle.
+     */
+    stopScan() {
+        this.#scan_dispose();
+        const shared = this.#shared;
+        if (!shared.scans.delete(this) || shared.scans.size > 0) return true;
+        return this.#ble.stopScan();
+    }
+    /**
+     * Connects to a device, or joins the session's connection to it. See BLEMaster.connect.
+     */
+    connect(dev_addr, response_callback, options = {}) {
+        const mac = normalizeMac(dev_addr);
+        if (mac === null) return this.#ble.connect(dev_addr, response_callback, options); // rejected and logged there
+        const signal = options.signal;
+        if (!this.#attached || (signal && signal.aborted)) return false;
+        const shared = this.#shared;
+        const subscriber = { handle: this, callback: response_callback, dispose: noop };
+        let subscribers = shared.connects.get(mac);
+        if (this.#ble.get.isConnected(mac) || (subscribers && shared.connecting.has(mac))) {
+            if (!subscribers) shared.connects.set(mac, subscribers = new Set());
+            subscribers.add(subscriber);
+            this.#hold(mac, subscribers, subscriber, signal);
+            if (!shared.connecting.has(mac)) {
+                const connect_id = this.#ble.get.device(mac).connect_id;
+                shared.clock.setTimeout(() => {
+                    if (subscribers.has(subscriber)) response_callback({ dev_addr: mac, connected: CONNECT_STATUS_OK, connect_id, reused: true });
+                }, 0);
+            }
+            return true;
+        }
+        subscribers = new Set([subscriber]);
+        shared.connects.set(mac, subscribers);
+        shared.connecting.add(mac);
+        const token = sessionToken(shared, mac);
+        this.#hold(mac, subscribers, subscriber, signal);
+        const success = this.#ble.connect(mac, (result) => {
+            shared.connecting.delete(mac);
+            const current = Array.from(subscribers);
+            if (result.connected !== CONNECT_STATUS_OK && shared.connects.get(mac) === subscribers) {
+                shared.connects.delete(mac);
+                for (const { dispose } of current) dispose();
+                if (!shared.prepares.has(mac) && shared.tokens.get(mac) === token) shared.tokens.delete(mac);
+            }
+            for (const { callback } of current) callback(result);
+        }, { ...options, signal: token });
+        if (!success) {
+            subscriber.dispose();
+            shared.connecting.delete(mac);
+            shared.connects.delete(mac);
+        }
+        return success;
+    }
+    /**
+     * Builds a profile, or reuses the one the session already has for the device. See BLEMaster.startListener.
+     */
+    startListener(profile_object, response_callback, options = {}) {
+        if (!this.#attached) return { success: false, error: ERR_DETACHED };
+        const dev = profile_object && profile_object.dev;
+        if (!(dev instanceof ArrayBuffer) || dev.byteLength !== MAC_BYTES) {
+            return this.#ble.startListener(profile_object, response_callback, options); // rejected and logged there
+        }
+        const signal = options.signal;
+        if (signal && signal.aborted) return { success: false, error: ERR_CANCELLED };
+        const shared = this.#shared;
+        const mac = ab2mac(dev);
+        const subscriber = { handle: this, callback: response_callback, dispose: noop };
+        const device = this.#ble.get.device(mac);
+        if (device && device.is_connected && device.profile_idp !== undefined) {
+            shared.clock.setTimeout(() => {
+                if (this.#attached && !(signal && signal.aborted)) response_callback(0);
+            }, 0);
+            return { success: true, error: null };
+        }
+        let waiting = shared.prepares.get(mac);
+        if (waiting) {
+            waiting.add(subscriber);
+            this.#hold(mac, waiting, subscriber, signal);
+            return { success: true, error: null };
+        }
+        waiting = new Set([subscriber]);
+        shared.prepares.set(mac, waiting);
+        const token = sessionToken(shared, mac);
+        this.#hold(mac, waiting, subscriber, signal);
+        const result = this.#ble.startListener(profile_object, (status) => {
+            if (shared.prepares.get(mac) === waiting) shared.prepares.delete(mac);
+            const current = Array.from(waiting);
+            for (const { dispose } of current) dispose(); // the profile is built, the connect holds the device from here on
+            for (const { callback } of current) callback(status);
+        }, { ...options, signal: token });
+        if (!result.success) {
+            subscriber.dispose();
+            shared.prepares.delete(mac);
+        }
+        return result;
+    }
+    /**
+     * Runs a scene on the session's connections, see BLEMaster.scene.
+     */
+    scene(commands, response_callback, options = {}) {
+        if (!this.#attached) return false;
+        return this.#ble.scene(commands, (report) => { if (this.#attached) response_callback(report); }, options);
+    }
+    disconnect(dev_addr) {
+        return this.#ble.disconnect(dev_addr);
+    }
+    pair(dev_addr) {
+        return this.#ble.pair(dev_addr);
+    }
+    modifyProfileObject(dev_addr, profile_object) {
+        return this.#ble.modifyProfileObject(dev_addr, profile_object);
+    }
+    generateProfileObject(dev_addr) {
+        return this.#ble.generateProfileObject(dev_addr);
+    }
+    /**
+     * Stops the device for the whole session, every page loses it.
+     */
+    stop(dev_addr) {
+        const mac = normalizeMac(dev_addr);
+        if (mac !== null) {
+            this.#shared.connects.delete(mac);
+            this.#shared.prepares.delete(mac);
+            this.#shared.tokens.delete(mac);
+        }
+        this.#ble.stop(dev_addr);
+    }
+    #hold(mac, subscribers, subscriber, signal) { // the page's token only drops the page's own subscription
+        if (!signal) return;
+        const token = this.#shared.tokens.get(mac);
+        const release = () => {
+            if (subscribers.delete(subscriber)) releaseDevice(this.#shared, mac, token);
+        };
+        signal.addEventListener("abort", release);
+        subscriber.dispose = () => signal.removeEventListener("abort", release);
+    }
+    /**
+     * Detaches the page: stops its scan and drops its pending callbacks. Connections and profiles stay with the session.
+     */
+    detach() {
+        if (!this.#attached) return;
+        this.#attached = false;
+        this.stopScan();
+        for (const subscribers of [...this.#shared.connects.values(), ...this.#shared.prepares.values()]) {
+            for (const subscriber of subscribers) {
+                if (subscriber.handle !== this) continue;
+                subscribers.delete(subscriber);
+                subscriber.dispose();
+            }
+        }
+        this.#release();
+    }
+}
+
+function sessionToken(shared, mac) { // the token the session connects and builds profiles with
+    let token = shared.tokens.get(mac);
+    if (!token || token.aborted) shared.tokens.set(mac, token = new CancelToken());
+    return token;
+}
+
+function releaseDevice(shared, mac, token) { // once no page waits for or holds the device, the session lets go of it too
+    const connects = shared.connects.get(mac);
+    const prepares = shared.prepares.get(mac);
+    if ((connects && connects.size > 0) || (prepares && prepares.size > 0) || shared.tokens.get(mac) !== token) return;
+    shared.connects.delete(mac);
+    shared.connecting.delete(mac);
+    shared.prepares.delete(mac);
+    shared.tokens.delete(mac);
+    if (token) token.cancel(); // abandons a pending connect or profile, stops a device the session connected
+}
@@ -0,0 +1,70 @@
+/**
+ * Connect on first sight: startScan's options.connect. A target is connected the moment its first advert arrives and its
+ * profile is built right after, while the scan keeps looking for the other targets.
+ */
+import { ERR_INVALID_MAC, ERR_INVALID_PROFILE, CONNECT_STATUS_OK, CONNECT_STATUS_FAILED, notify } from './core.js'
+import { logger } from './log.js'
+import { normalizeMac } from './codecs.js'
+
+/**
+ * Wraps a scan callback so it connects the targets of options.connect on first sight. Used by BLEMaster and SessionHandle.
+ * @param {Object} ble - The BLEMaster (or SessionHandle) that scans: connect, startListener, modifyProfileObject, stopScan, get.
+ * @param {Function} response_callback - The caller's scan callback, called after the target is handled.
+ * @param {Object} options - startScan's options, see BLEMaster.startScan.
+ * @returns {Function|null} Returns the scan callback to use, or null if options.connect.targets holds an invalid MAC address.
+ */
+export function connectOnSight(ble, response_callback, options) {
+    const { targets, profile, stop_scan = true, on_ready } = options.connect;
+    const pending = new Set();
+    for (const target of Array.isArray(targets) ? targets : [targets]) {
+        const dev_addr = normalizeMac(target);
+        if (dev_addr === null) {
+            logger.error(ERR_INVALID_MAC);
+            return null;
+        }
+        pending.add(dev_addr);
+    }
+    const signal = options.signal;
+
+    const ready = (response) => notify(on_ready, response);
+    const connected = (result) => { // startListener builds the profiles one at a time
+        if (result.connected !== CONNECT_STATUS_OK || !profile) {
+            ready(result);
+            return;
+        }
+        const dev_addr = result.dev_addr;
+        const profile_object = ble.modifyProfileObject(dev_addr, typeof profile === "function" ? profile(dev_addr) : profile);
+        const listening = profile_object === null ? { success: false, error: ERR_INVALID_PROFILE } : ble.startListener(profile_object, (status) => {
+            ready({ ...result, status });
+        }, { signal });
+        if (!listening.success) ready({ ...result, error: listening.error }); // rejected before it reached the backend
+    };
+    const sighted = (dev_addr) => {
+        pending.delete(dev_addr);
+        logger.debug(() => "eBLE: Target sighted, connecting: " + dev_addr);
+        if (pending.size === 0 && stop_scan) ble.stopScan();
+        if (ble.get.isConnected(dev_addr)) {
+            const device = ble.get.device(dev_addr);
+            if (!profile || device.profile_idp !== undefined) {
+                ready({ dev_addr, connected: CONNECT_STATUS_OK, connect_id: device.connect_id, status: profile ? 0 : undefined });
+            } else {
+                connected({ dev_addr, connected: CONNECT_STATUS_OK, connect_id: device.connect_id });
+            }
+            return;
+        }
+        let settled = false; // later callbacks of this connection report disconnects, not the first-sight result
+        const success = ble.connect(dev_addr, (result) => {
+            if (settled) return;
+            settled = true;
+            connected(result);
+        }, { signal });
+        if (!success) {
+            settled = true;
+            ready({ dev_addr, connected: CONNECT_STATUS_FAILED });
+        }
+    };
+    return (scan_result) => {
+        if (pending.has(scan_result.dev_addr)) sighted(scan_result.dev_addr);
+        response_callback(scan_result);
+    };
+}
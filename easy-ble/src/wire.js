@@ -0,0 +1,494 @@
+/**
+ * Wire format between an app service and its pages: ScanEngine diffs and characteristic readings packed into one frame.
+ * Binary frames (ArrayBuffer) carry MACs as 6 bytes, hex payloads as bytes and numbers as varints, names and UUIDs are
+ * interned per frame. JSON frames (string) are the fallback for channels that only carry text. decodeFrame takes both.
+ */
+import { SYSTEM_CLOCK, DIFF_STRIDE, ERR_WIRE_MESSAGE, ERR_WIRE_FRAME, noop } from './core.js'
+import { logger } from './log.js'
+import { MAC_BYTES, isMac, hexValue, bytes2mac, bytes2hex, data2ab, ab2str_stripped } from './codecs.js'
+
+export const WIRE_FORMAT = {
+    BINARY: "binary",
+    JSON: "json",
+};
+
+const WIRE_VERSION                  = 1;
+const WIRE_DIFF                     = 1;
+const WIRE_READING                  = 2;
+const WIRE_INITIAL_BYTES            = 4096;
+const DEFAULT_FLUSH_INTERVAL        = 1000; // millis a message waits in a WireBatch at most
+const DEFAULT_MAX_MESSAGES          = 32;   // messages per frame, a full batch is sent right away
+
+/**
+ * Packs messages into one frame.
+ * Binary layout: version, varint count, zigzag base time, then per message its kind and fields:
+ * - diff: varint seq, time - base, full, varint upserts, per device mac, name, rssi, age, vendor_id, vendor_data,
+ *   service_uuid_array, service_data_array ({ uuid, service_data } only), varint removes, macs
+ * - reading: mac, uuid, time - base, varint length, bytes
+ * @param {Array<Object>} messages - ScanEngine diffs and readings { dev_addr, uuid, time, data }, data an ArrayBuffer,
+ * typed array or DataView. A message with an upsert array is a diff, anything else a reading. seq and time are
+ * non-negative integers (millis), a reading without time gets 0 in both formats.
+ * @param {string} [format=WIRE_FORMAT.BINARY] - WIRE_FORMAT.BINARY or WIRE_FORMAT.JSON.
+ * @returns {ArrayBuffer|string|null} Returns the frame, or null if a message is malformed (logged).
+ */
+export function encodeFrame(messages, format = WIRE_FORMAT.BINARY) {
+    try {
+        if (!Array.isArray(messages)) throw new Error(ERR_WIRE_MESSAGE);
+        return format === WIRE_FORMAT.JSON ? encodeJson(messages) : encodeBinary(messages);
+    } catch (error) {
+        logger.error(error.message);
+        return null;
+    }
+}
+
+/**
+ * Unpacks a frame from encodeFrame.
+ * @param {ArrayBuffer|Uint8Array|string} frame - A binary or a JSON frame.
+ * @returns {Array<Object>|null} Returns the messages in order (readings with data as an ArrayBuffer), or null if the frame is malformed (logged).
+ */
+export function decodeFrame(frame) {
+    try {
+        if (typeof frame === "string") return decodeJson(frame);
+        if (frame instanceof ArrayBuffer) return decodeBinary(new Uint8Array(frame));
+        if (frame instanceof Uint8Array) return decodeBinary(frame);
+        throw new Error(ERR_WIRE_FRAME);
+    } catch (error) {
+        logger.warn(ERR_WIRE_FRAME + ":", error.message);
+        return null;
+    }
+}
+
+/**
+ * Collects messages in the service and delivers them as one frame per flush interval, or as soon as max_messages are queued.
+ * Reading data is encoded at flush time, do not modify it in between.
+ */
+export class WireBatch {
+    #deliver;
+    #format;
+    #interval;
+    #max_messages;
+    #clock;
+    #queue = [];
+    #timer = null;
+
+    /**
+     * @param {Object} [options={}]
+     * @param {Function} [options.deliver] - Called with every frame, e.g. to post it to the page.
+     * @param {string} [options.format=WIRE_FORMAT.BINARY] - WIRE_FORMAT.BINARY or WIRE_FORMAT.JSON.
+     * @param {number} [options.interval=1000] - Millis the first queued message waits for company.
+     * @param {number} [options.max_messages=32] - Messages per frame.
+     * @param {Object} [options.clock] - { now, setTimeout, clearTimeout }, defaults to the system timers.
+     */
+    constructor(options = {}) {
+        this.#deliver = options.deliver || noop;
+        this.#format = options.format || WIRE_FORMAT.BINARY;
+        this.#interval = options.interval || DEFAULT_FLUSH_INTERVAL;
+        this.#max_messages = options.max_messages || DEFAULT_MAX_MESSAGES;
+        this.#clock = options.clock || SYSTEM_CLOCK;
+    }
+    /**
+     * @type {number} The number of queued messages.
+     */
+    get size() {
+        return this.#queue.length;
+    }
+    /**
+     * Queues a message, see encodeFrame. A malformed message is rejected here, so it cannot spoil the frame of the others.
+     * @returns {boolean} Returns true if the message was queued, false if it is malformed (logged).
+     */
+    push(message) {
+        if (!isWireMessage(message)) {
+            logger.error(ERR_WIRE_MESSAGE);
+            return false;
+        }
+        this.#queue.push(message);
+        if (this.#queue.length >= this.#max_messages) {
+            this.flush();
+        } else if (this.#timer === null) {
+            this.#timer = this.#clock.setTimeout(() => {
+                this.#timer = null;
+                this.flush();
+            }, this.#interval);
+        }
+        return true;
+    }
+    /**
+     * Delivers the queued messages now.
+     * @returns {ArrayBuffer|string|null} Returns the delivered frame, or null if nothing was queued or a queued message
+     * was modified into a malformed one since push().
+     */
+    flush() {
+        this.#clock.clearTimeout(this.#timer);
+        this.#timer = null;
+        if (!this.#queue.length) return null;
+        const frame = encodeFrame(this.#queue, this.#format);
+        this.#queue = [];
+        if (frame !== null) this.#deliver(frame);
+        return frame;
+    }
+}
+
+/* BINARY */
+
+class WireWriter {
+    #bytes = new Uint8Array(WIRE_INITIAL_BYTES);
+    #length = 0;
+    #strings = new Map(); // string > index, per frame
+
+    begin() {
+        this.#length = 0;
+        this.#strings.clear();
+    }
+    end() {
+        return this.#bytes.slice(0, this.#length).buffer;
+    }
+    byte(value) {
+        this.#reserve(1);
+        this.#bytes[this.#length++] = value;
+    }
+    varint(value) { // unsigned LEB128, safe up to 2^53
+        if (value < 0x80 && value >= 0 && this.#length < this.#bytes.length) { // most lengths, indexes and rssi
+            this.#bytes[this.#length++] = value;
+            return;
+        }
+        this.#reserve(8);
+        while (value >= 0x80) {
+            this.#bytes[this.#length++] = (value % 0x80) | 0x80;
+            value = Math.floor(value / 0x80);
+        }
+        this.#bytes[this.#length++] = value;
+    }
+    int(value) { // zigzag, small negatives (rssi) stay one byte
+        if (typeof value !== "number" || !Number.isFinite(value)) value = 0;
+        this.varint(value < 0 ? -value * 2 - 1 : value * 2);
+    }
+    optionalInt(value) { // 0 = undefined
+        if (typeof value !== "number" || !Number.isFinite(value)) return this.varint(0);
+        this.varint((value < 0 ? -value * 2 - 1 : value * 2) + 1);
+    }
+    mac(mac) {
+        if (!isMac(mac)) throw new Error(ERR_WIRE_MESSAGE);
+        this.#reserve(MAC_BYTES);
+        for (let i = 0; i < MAC_BYTES; i++) {
+            this.#bytes[this.#length++] = hexValue(mac.charCodeAt(i * 3)) * 16 + hexValue(mac.charCodeAt(i * 3 + 1));
+        }
+    }
+    /**
+     * Interned strings: 0 = undefined, 1 = new string (varint length, varint char codes), n = the (n - 2)th string of the frame.
+     */
+    str(value) {
+        if (typeof value !== "string") return this.varint(0);
+        const index = this.#strings.get(value);
+        if (index !== undefined) return this.varint(index + 2);
+        this.#strings.set(value, this.#strings.size);
+        this.varint(1);
+        this.#chars(value);
+    }
+    strs(values) { // 0 = not an array, n + 1 = n strings
+        if (!Array.isArray(values)) return this.varint(0);
+        this.varint(values.length + 1);
+        for (let i = 0; i < values.length; i++) this.str(values[i]);
+    }
+    /**
+     * Decoded payloads (ab2str_stripped output): 0 = undefined, 2n + 1 = n bytes of lowercase hex, 2n + 2 = n chars of anything else.
+     */
+    hex(value) {
+        if (typeof value !== "string") return this.varint(0);
+        if (!isLowerHex(value)) {
+            this.varint(value.length * 2 + 2);
+            for (let i = 0; i < value.length; i++) this.varint(value.charCodeAt(i));
+            return;
+        }
+        const count = value.length / 2;
+        this.varint(count * 2 + 1);
+        this.#reserve(count);
+        for (let i = 0; i < count; i++) {
+            this.#bytes[this.#length++] = hexValue(value.charCodeAt(i * 2)) * 16 + hexValue(value.charCodeAt(i * 2 + 1));
+        }
+    }
+    bytes(data) {
+        const buffer = typeof data === "string" ? null : data2ab(data);
+        if (buffer === null) throw new Error(ERR_WIRE_MESSAGE);
+        this.varint(buffer.byteLength);
+        this.#reserve(buffer.byteLength);
+        this.#bytes.set(new Uint8Array(buffer), this.#length);
+        this.#length += buffer.byteLength;
+    }
+    #chars(value) {
+        this.varint(value.length);
+        this.#reserve(value.length);
+        for (let i = 0; i < value.length; i++) {
+            const c = value.charCodeAt(i);
+            if (c < 0x80) this.#bytes[this.#length++] = c;
+            else this.varint(c);
+        }
+    }
+    #reserve(count) {
+        if (this.#length + count <= this.#bytes.length) return;
+        const grown = new Uint8Array(Math.max(this.#bytes.length * 2, this.#length + count));
+        grown.set(this.#bytes.subarray(0, this.#length));
+        this.#bytes = grown;
+    }
+}
+
+class WireReader {
+    #bytes;
+    #offset = 0;
+    #strings = [];
+
+    constructor(bytes) {
+        this.#bytes = bytes;
+    }
+    get done() {
+        return this.#offset >= this.#bytes.length;
+    }
+    byte() {
+        if (this.#offset >= this.#bytes.length) throw new Error("truncated");
+        return this.#bytes[this.#offset++];
+    }
+    varint() {
+        let value = 0, scale = 1, byte;
+        do {
+            if (scale > 2 ** 49) throw new Error("varint too long");
+            byte = this.byte();
+            value += (byte & 0x7F) * scale;
+            scale *= 0x80;
+        } while (byte & 0x80);
+        return value;
+    }
+    int() {
+        const value = this.varint();
+        return value % 2 ? -(value + 1) / 2 : value / 2;
+    }
+    optionalInt() {
+        const value = this.varint();
+        if (value === 0) return undefined;
+        return (value - 1) % 2 ? -value / 2 : (value - 1) / 2;
+    }
+    count() { // a length that must fit into the rest of the frame, so garbage cannot allocate huge arrays
+        const value = this.varint();
+        if (value > this.#bytes.length - this.#offset) throw new Error("length beyond the end of the frame");
+        return value;
+    }
+    mac() {
+        this.#need(MAC_BYTES);
+        const mac = bytes2mac(this.#bytes, this.#offset);
+        this.#offset += MAC_BYTES;
+        return mac;
+    }
+    str() {
+        const tag = this.varint();
+        if (tag === 0) return undefined;
+        if (tag > 1) {
+            if (tag - 2 >= this.#strings.length) throw new Error("unknown string");
+            return this.#strings[tag - 2];
+        }
+        const value = this.#chars(this.count());
+        this.#strings.push(value);
+        return value;
+    }
+    strs() {
+        const tag = this.count();
+        if (tag === 0) return undefined;
+        const values = new Array(tag - 1);
+        for (let i = 0; i < values.length; i++) values[i] = this.str();
+        return values;
+    }
+    hex() {
+        const tag = this.varint();
+        if (tag === 0) return undefined;
+        if (tag % 2 === 0) return this.#chars((tag - 2) / 2);
+        const count = (tag - 1) / 2;
+        this.#need(count);
+        this.#offset += count;
+        return bytes2hex(this.#bytes, this.#offset - count, this.#offset);
+    }
+    bytes() {
+        const count = this.count();
+        this.#offset += count;
+        return this.#bytes.slice(this.#offset - count, this.#offset).buffer;
+    }
+    #chars(count) {
+        if (count > this.#bytes.length - this.#offset) throw new Error("length beyond the end of the frame");
+        wire_chars.length = count;
+        for (let i = 0; i < count; i++) {
+            const c = this.#bytes[this.#offset];
+            if (c < 0x80) {
+                wire_chars[i] = c;
+                this.#offset++;
+            } else {
+                wire_chars[i] = this.varint();
+            }
+        }
+        return String.fromCharCode.apply(null, wire_chars);
+    }
+    #need(count) {
+        if (this.#offset + count > this.#bytes.length) throw new Error("truncated");
+    }
+}
+
+const wire_writer = new WireWriter(); // shared, every frame is sliced out of it
+const wire_chars = []; // char code scratch of WireReader, strings are short (names, UUIDs)
+
+function encodeBinary(messages) {
+    const w = wire_writer;
+    w.begin();
+    w.byte(WIRE_VERSION);
+    w.varint(messages.length);
+    const base = messages.length ? messageTime(messages[0]) : 0;
+    w.int(base);
+    for (const message of messages) {
+        if (!message || typeof message !== "object") throw new Error(ERR_WIRE_MESSAGE);
+        if (Array.isArray(message.upsert)) {
+            const { upsert, remove } = message;
+            if (upsert.length % DIFF_STRIDE || !Array.isArray(remove) || !isWireCount(message.seq) || !isWireCount(message.time)) {
+                throw new Error(ERR_WIRE_MESSAGE);
+            }
+            w.byte(WIRE_DIFF);
+            w.varint(message.seq);
+            w.int(messageTime(message) - base);
+            w.byte(message.full ? 1 : 0);
+            w.varint(upsert.length / DIFF_STRIDE);
+            for (let i = 0; i < upsert.length; i += DIFF_STRIDE) {
+                w.mac(upsert[i]);
+                w.str(upsert[i + 1]);
+                w.int(upsert[i + 2]);
+                w.int(upsert[i + 3]);
+                w.optionalInt(upsert[i + 4]);
+                w.hex(upsert[i + 5]);
+                w.strs(upsert[i + 6]);
+                const service_data_array = upsert[i + 7];
+                if (!Array.isArray(service_data_array)) {
+                    w.varint(0);
+                    continue;
+                }
+                w.varint(service_data_array.length + 1);
+                for (const service of service_data_array) {
+                    w.str(service && service.uuid);
+                    w.hex(service && service.service_data);
+                }
+            }
+            w.varint(remove.length);
+            for (const dev_addr of remove) w.mac(dev_addr);
+        } else {
+            if (typeof message.uuid !== "string" || !isReadingTime(message.time)) throw new Error(ERR_WIRE_MESSAGE);
+            w.byte(WIRE_READING);
+            w.mac(message.dev_addr);
+            w.str(message.uuid);
+            w.int(messageTime(message) - base);
+            w.bytes(message.data);
+        }
+    }
+    return w.end();
+}
+
+function decodeBinary(bytes) {
+    const r = new WireReader(bytes);
+    const version = r.byte();
+    if (version !== WIRE_VERSION) throw new Error("unsupported version " + version);
+    const messages = new Array(r.count());
+    const base = r.int();
+    for (let m = 0; m < messages.length; m++) {
+        const kind = r.byte();
+        if (kind === WIRE_DIFF) {
+            const seq = r.varint();
+            const time = base + r.int();
+            const full = r.byte() === 1;
+            const upsert = new Array(r.count() * DIFF_STRIDE);
+            for (let i = 0; i < upsert.length; i += DIFF_STRIDE) {
+                upsert[i] = r.mac();
+                upsert[i + 1] = r.str();
+                upsert[i + 2] = r.int();
+                upsert[i + 3] = r.int();
+                upsert[i + 4] = r.optionalInt();
+                upsert[i + 5] = r.hex();
+                upsert[i + 6] = r.strs();
+                const tag = r.count();
+                const service_data_array = tag === 0 ? undefined : new Array(tag - 1);
+                for (let s = 0; s < tag - 1; s++) service_data_array[s] = { uuid: r.str(), service_data: r.hex() };
+                upsert[i + 7] = service_data_array;
+            }
+            const remove = new Array(r.count());
+            for (let i = 0; i < remove.length; i++) remove[i] = r.mac();
+            messages[m] = { seq, time, full, upsert, remove };
+        } else if (kind === WIRE_READING) {
+            const dev_addr = r.mac();
+            const uuid = r.str();
+            const time = base + r.int();
+            messages[m] = { dev_addr, uuid, time, data: r.bytes() };
+        } else {
+            throw new Error("unknown message kind " + kind);
+        }
+    }
+    if (!r.done) throw new Error("trailing bytes");
+    return messages;
+}
+
+/* JSON */
+
+function encodeJson(messages) {
+    const out = new Array(messages.length);
+    for (let i = 0; i < messages.length; i++) {
+        const message = messages[i];
+        if (!message || typeof message !== "object") throw new Error(ERR_WIRE_MESSAGE);
+        if (Array.isArray(message.upsert)) {
+            if (!isWireDiff(message)) throw new Error(ERR_WIRE_MESSAGE);
+            out[i] = message;
+            continue;
+        }
+        const data = typeof message.data === "string" ? null : data2ab(message.data);
+        if (!isMac(message.dev_addr) || typeof message.uuid !== "string" || !isReadingTime(message.time) || data === null) {
+            throw new Error(ERR_WIRE_MESSAGE);
+        }
+        out[i] = { dev_addr: message.dev_addr.toLowerCase(), uuid: message.uuid, time: messageTime(message), data: ab2str_stripped(data) };
+    }
+    return JSON.stringify({ v: WIRE_VERSION, m: out });
+}
+
+function decodeJson(text) {
+    const frame = JSON.parse(text);
+    if (!frame || frame.v !== WIRE_VERSION || !Array.isArray(frame.m)) throw new Error("not a wire frame");
+    for (const message of frame.m) {
+        if (!message || typeof message !== "object") throw new Error("not a message");
+        if (Array.isArray(message.upsert)) continue;
+        if (typeof message.data !== "string" || !isLowerHex(message.data)) throw new Error("reading data is not hex");
+        message.data = data2ab(message.data);
+    }
+    return frame.m;
+}
+
+function isWireMessage(message) { // what both encoders check on the way
+    if (!message || typeof message !== "object") return false;
+    if (Array.isArray(message.upsert)) return isWireDiff(message);
+    return isMac(message.dev_addr) && typeof message.uuid === "string" && isReadingTime(message.time) &&
+        typeof message.data !== "string" && data2ab(message.data) !== null;
+}
+
+function isWireDiff(diff) { // what encodeBinary checks on the way
+    const { upsert, remove } = diff;
+    if (upsert.length % DIFF_STRIDE || !Array.isArray(remove) || !isWireCount(diff.seq) || !isWireCount(diff.time)) return false;
+    for (let i = 0; i < upsert.length; i += DIFF_STRIDE) if (!isMac(upsert[i])) return false;
+    for (let i = 0; i < remove.length; i++) if (!isMac(remove[i])) return false;
+    return true;
+}
+
+function isWireCount(value) { // seq and time: what a varint carries and JSON gives back unchanged
+    return Number.isSafeInteger(value) && value >= 0;
+}
+
+function isReadingTime(value) {
+    return value === undefined || isWireCount(value);
+}
+
+function messageTime(message) { // after the checks above: an integer or missing
+    return message.time === undefined ? 0 : message.time;
+}
+
+function isLowerHex(value) {
+    if (value.length % 2) return false;
+    for (let i = 0; i < value.length; i++) {
+        const c = value.charCodeAt(i);
+        if (!((c >= 48 && c <= 57) || (c >= 97 && c <= 102))) return false;
+    }
+    return true;
+}